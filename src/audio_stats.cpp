@@ -0,0 +1,218 @@
+#include "audio_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Float accumulators are flushed into the double totals every block so long windows keep
+// the precision of the original double-accumulating helpers.
+static constexpr size_t k_block = 1024;
+
+struct block_sums {
+    float n_active = 0.0f;
+    float sum_sq = 0.0f;
+    float sum_abs = 0.0f;
+    float peak = 0.0f;
+};
+
+static void block_scalar(const float * x, size_t n, float thold, block_sums & r) {
+    for (size_t i = 0; i < n; ++i) {
+        const float a = std::fabs(x[i]);
+        r.n_active += a > thold ? 1.0f : 0.0f;
+        r.sum_sq += x[i] * x[i];
+        r.sum_abs += a;
+        r.peak = std::max(r.peak, a);
+    }
+}
+
+#if defined(AI_SUBTITLER_SIMD_X86)
+static float hsum128(__m128 v) {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 0x55));
+    return _mm_cvtss_f32(v);
+}
+
+static float hmax128(__m128 v) {
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 0x55));
+    return _mm_cvtss_f32(v);
+}
+
+static void block_sse(const float * x, size_t n, float thold, block_sums & r) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 th = _mm_set1_ps(thold);
+    __m128 cnt = _mm_setzero_ps();
+    __m128 sq = _mm_setzero_ps();
+    __m128 ab = _mm_setzero_ps();
+    __m128 mx = _mm_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 v = _mm_loadu_ps(x + i);
+        const __m128 a = _mm_andnot_ps(sign, v);
+        cnt = _mm_add_ps(cnt, _mm_and_ps(_mm_cmpgt_ps(a, th), one));
+        sq = _mm_add_ps(sq, _mm_mul_ps(v, v));
+        ab = _mm_add_ps(ab, a);
+        mx = _mm_max_ps(mx, a);
+    }
+    r.n_active += hsum128(cnt);
+    r.sum_sq += hsum128(sq);
+    r.sum_abs += hsum128(ab);
+    r.peak = std::max(r.peak, hmax128(mx));
+    block_scalar(x + i, n - i, thold, r);
+}
+
+AI_SUBTITLER_TARGET_AVX
+static void block_avx(const float * x, size_t n, float thold, block_sums & r) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 th = _mm256_set1_ps(thold);
+    __m256 cnt = _mm256_setzero_ps();
+    __m256 sq = _mm256_setzero_ps();
+    __m256 ab = _mm256_setzero_ps();
+    __m256 mx = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 v = _mm256_loadu_ps(x + i);
+        const __m256 a = _mm256_andnot_ps(sign, v);
+        cnt = _mm256_add_ps(cnt, _mm256_and_ps(_mm256_cmp_ps(a, th, _CMP_GT_OQ), one));
+        sq = _mm256_fmadd_ps(v, v, sq);
+        ab = _mm256_add_ps(ab, a);
+        mx = _mm256_max_ps(mx, a);
+    }
+    r.n_active += hsum128(_mm_add_ps(_mm256_castps256_ps128(cnt), _mm256_extractf128_ps(cnt, 1)));
+    r.sum_sq += hsum128(_mm_add_ps(_mm256_castps256_ps128(sq), _mm256_extractf128_ps(sq, 1)));
+    r.sum_abs += hsum128(_mm_add_ps(_mm256_castps256_ps128(ab), _mm256_extractf128_ps(ab, 1)));
+    r.peak = std::max(r.peak, hmax128(_mm_max_ps(_mm256_castps256_ps128(mx), _mm256_extractf128_ps(mx, 1))));
+    block_scalar(x + i, n - i, thold, r);
+}
+#endif
+
+#if defined(AI_SUBTITLER_SIMD_NEON)
+static float hsum_neon(float32x4_t v) {
+    const float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+
+static void block_neon(const float * x, size_t n, float thold, block_sums & r) {
+    const float32x4_t th = vdupq_n_f32(thold);
+    uint32x4_t cnt = vdupq_n_u32(0);
+    float32x4_t sq = vdupq_n_f32(0.0f);
+    float32x4_t ab = vdupq_n_f32(0.0f);
+    float32x4_t mx = vdupq_n_f32(0.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t v = vld1q_f32(x + i);
+        const float32x4_t a = vabsq_f32(v);
+        cnt = vsubq_u32(cnt, vcgtq_f32(a, th)); // true lanes are all-ones (-1)
+        sq = vmlaq_f32(sq, v, v);
+        ab = vaddq_f32(ab, a);
+        mx = vmaxq_f32(mx, a);
+    }
+    const uint32x2_t c = vadd_u32(vget_low_u32(cnt), vget_high_u32(cnt));
+    r.n_active += (float) (vget_lane_u32(c, 0) + vget_lane_u32(c, 1));
+    r.sum_sq += hsum_neon(sq);
+    r.sum_abs += hsum_neon(ab);
+    const float32x2_t m = vmax_f32(vget_low_f32(mx), vget_high_f32(mx));
+    r.peak = std::max(r.peak, std::max(vget_lane_f32(m, 0), vget_lane_f32(m, 1)));
+    block_scalar(x + i, n - i, thold, r);
+}
+#endif
+
+void audio_stats::merge(const audio_stats & o) {
+    n += o.n;
+    n_active += o.n_active;
+    sum_sq += o.sum_sq;
+    sum_abs += o.sum_abs;
+    peak = std::max(peak, o.peak);
+}
+
+float audio_stats::rms() const {
+    return n ? (float) std::sqrt(sum_sq / (double) n) : 0.0f;
+}
+
+audio_stats audio_stats_compute(const float * pcm, size_t n, float abs_thold, simd_isa isa) {
+    audio_stats r;
+    r.n = n;
+    for (size_t i = 0; i < n; i += k_block) {
+        const size_t m = std::min(k_block, n - i);
+        block_sums b;
+        switch (isa) {
+#if defined(AI_SUBTITLER_SIMD_X86)
+            case simd_isa::avx: block_avx(pcm + i, m, abs_thold, b); break;
+            case simd_isa::sse: block_sse(pcm + i, m, abs_thold, b); break;
+#endif
+#if defined(AI_SUBTITLER_SIMD_NEON)
+            case simd_isa::neon: block_neon(pcm + i, m, abs_thold, b); break;
+#endif
+            default: block_scalar(pcm + i, m, abs_thold, b); break;
+        }
+        r.n_active += (size_t) b.n_active;
+        r.sum_sq += b.sum_sq;
+        r.sum_abs += b.sum_abs;
+        r.peak = std::max(r.peak, b.peak);
+    }
+    return r;
+}
+
+audio_window_stats audio_window_stats_compute(const float * pcm, size_t n, size_t n_last, simd_isa isa) {
+    audio_window_stats w;
+    n_last = std::min(n_last, n);
+    w.last = audio_stats_compute(pcm + (n - n_last), n_last, k_audio_activity_thold, isa);
+    w.all = audio_stats_compute(pcm, n - n_last, k_audio_activity_thold, isa);
+    w.all.merge(w.last);
+    w.first = n ? pcm[0] : 0.0f;
+    return w;
+}
+
+audio_stats audio_stats_compute(const audio_view & v) {
+    audio_stats r = audio_stats_compute(v.p0, v.n0);
+    r.merge(audio_stats_compute(v.p1, v.n1));
+    return r;
+}
+
+bool audio_vad_simple(const audio_window_stats & w, float vad_thold, float freq_thold, int sample_rate) {
+    const size_t n_samples = w.all.n;
+    const size_t n_samples_last = w.last.n;
+    if (n_samples_last == 0 || n_samples_last >= n_samples) {
+        return false;
+    }
+
+    // whisper.cpp's high_pass_filter() reads data[i - 1] after overwriting it with the previous output,
+    // so y[i] = alpha * (y[i-1] + x[i] - y[i-1]) = alpha * x[i] for i >= 1, and y[0] = x[0].
+    // Reproduce that exactly so the flush decisions do not change.
+    float alpha = 1.0f;
+    if (freq_thold > 0.0f) {
+        const float rc = 1.0f / (2.0f * 3.14159265358979323846 * freq_thold);
+        const float dt = 1.0f / (float) sample_rate;
+        alpha = dt / (rc + dt);
+    }
+
+    const double first_abs = std::fabs((double) w.first);
+    const double energy_all = (first_abs + (double) alpha * (w.all.sum_abs - first_abs)) / (double) n_samples;
+    const double energy_last = (double) alpha * w.last.sum_abs / (double) n_samples_last;
+
+    return !(energy_last > (double) vad_thold * energy_all);
+}
+
+float audio_activity_fraction(const std::vector<float> & pcm, float abs_thold) {
+    if (pcm.empty()) return 0.0f;
+    size_t n_active = 0;
+    for (float v : pcm) {
+        if (std::fabs(v) > abs_thold) {
+            ++n_active;
+        }
+    }
+    return (float) n_active / (float) pcm.size();
+}
+
+float audio_rms(const std::vector<float> & pcm) {
+    if (pcm.empty()) return 0.0f;
+    double sumsq = 0.0;
+    for (float v : pcm) {
+        sumsq += (double) v * (double) v;
+    }
+    return (float) std::sqrt(sumsq / (double) pcm.size());
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "audio_view.h"
+#include "simd.h"
+
+#include <cstddef>
+#include <vector>
+
+// Samples louder than this count as "active" (near-silence suppression heuristics).
+constexpr float k_audio_activity_thold = 0.01f;
+
+// Summary of a run of samples. Summaries of adjacent runs merge (sums in double, so merging is
+// exact up to rounding), which lets the capture ring keep them per chunk.
+struct audio_stats {
+    size_t n = 0;
+    size_t n_active = 0; // |x| > activity threshold
+    double sum_sq = 0.0;
+    double sum_abs = 0.0;
+    float peak = 0.0f;   // max |x|
+
+    void merge(const audio_stats & o);
+
+    float activity_fraction() const { return n ? (float) n_active / (float) n : 0.0f; }
+    float rms() const;
+};
+
+// Activity count, sum of squares, sum of magnitudes and peak in one vectorized pass.
+audio_stats audio_stats_compute(const float * pcm, size_t n, float abs_thold = k_audio_activity_thold, simd_isa isa = simd_best_isa());
+
+// Everything the per-tick window analysis needs: the whole window, its newest `n_last` samples
+// (vad_simple's "last_ms" tail) and its first sample.
+struct audio_window_stats {
+    audio_stats all;
+    audio_stats last;
+    float first = 0.0f;
+};
+
+audio_window_stats audio_window_stats_compute(const float * pcm, size_t n, size_t n_last, simd_isa isa = simd_best_isa());
+
+// Same over both spans of a view.
+audio_stats audio_stats_compute(const audio_view & v);
+
+// Same decision as whisper.cpp's vad_simple() (true = the trailing part is relatively quiet),
+// computed from the stats instead of another high-pass + energy pass over a copy.
+bool audio_vad_simple(const audio_window_stats & w, float vad_thold, float freq_thold, int sample_rate);
+
+// Original scalar helpers, kept as the reference for --bench-audio-stats.
+float audio_activity_fraction(const std::vector<float> & pcm, float abs_thold);
+float audio_rms(const std::vector<float> & pcm);
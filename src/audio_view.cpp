@@ -0,0 +1,66 @@
+#include "audio_view.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+static std::atomic<uint64_t> g_copies{ 0 };
+static std::atomic<uint64_t> g_copy_bytes{ 0 };
+
+audio_copy_stats audio_copy_totals() {
+    audio_copy_stats s;
+    s.copies = g_copies.load(std::memory_order_relaxed);
+    s.bytes = g_copy_bytes.load(std::memory_order_relaxed);
+    return s;
+}
+
+void audio_copy_record(size_t n_samples) {
+    if (n_samples == 0) {
+        return;
+    }
+    g_copies.fetch_add(1, std::memory_order_relaxed);
+    g_copy_bytes.fetch_add((uint64_t) n_samples * sizeof(float), std::memory_order_relaxed);
+}
+
+audio_view audio_view::of(const float * data, size_t n, uint64_t seq) {
+    audio_view v;
+    v.p0 = data;
+    v.n0 = data ? n : 0;
+    v.seq = seq;
+    return v;
+}
+
+audio_view audio_view::sub(size_t offset, size_t n) const {
+    audio_view v;
+    offset = std::min(offset, size());
+    n = std::min(n, size() - offset);
+    v.seq = seq + offset;
+
+    if (offset < n0) {
+        v.p0 = p0 + offset;
+        v.n0 = std::min(n, n0 - offset);
+        if (n > v.n0) {
+            v.p1 = p1;
+            v.n1 = n - v.n0;
+        }
+    } else if (n > 0) {
+        v.p0 = p1 + (offset - n0);
+        v.n0 = n;
+    }
+    return v;
+}
+
+const float * audio_view::linearize(std::vector<float> & scratch) const {
+    if (contiguous()) {
+        return p0;
+    }
+    copy_to(scratch);
+    return scratch.data();
+}
+
+void audio_view::copy_to(std::vector<float> & out) const {
+    out.resize(size());
+    if (n0) std::memcpy(out.data(), p0, n0 * sizeof(float));
+    if (n1) std::memcpy(out.data() + n0, p1, n1 * sizeof(float));
+    audio_copy_record(size());
+}
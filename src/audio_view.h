@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Read-only view of consecutive mono samples: up to two contiguous spans (a ring buffer may wrap)
+// plus the absolute index of the first sample (its sequence number). It does not own the memory.
+struct audio_view {
+    const float * p0 = nullptr;
+    size_t n0 = 0;
+    const float * p1 = nullptr;
+    size_t n1 = 0;
+    uint64_t seq = 0;
+
+    static audio_view of(const float * data, size_t n, uint64_t seq = 0);
+
+    size_t size() const { return n0 + n1; }
+    bool empty() const { return n0 + n1 == 0; }
+    bool contiguous() const { return n1 == 0; }
+    float operator[](size_t i) const { return i < n0 ? p0[i] : p1[i - n0]; }
+
+    // Sub-ranges (clamped to the view).
+    audio_view sub(size_t offset, size_t n) const;
+    audio_view head(size_t n) const { return sub(0, n); }
+    audio_view tail(size_t n) const { return sub(size() > n ? size() - n : 0, n); }
+
+    // Contiguous samples: the view's own memory when it does not wrap, otherwise a copy in `scratch`.
+    const float * linearize(std::vector<float> & scratch) const;
+    // Always copies.
+    void copy_to(std::vector<float> & out) const;
+};
+
+// Process-wide count of sample copies on the capture -> VAD/Whisper path (ring reads, linearize, copy_to).
+struct audio_copy_stats {
+    uint64_t copies = 0;
+    uint64_t bytes = 0;
+};
+
+audio_copy_stats audio_copy_totals();
+void audio_copy_record(size_t n_samples);
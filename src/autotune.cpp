@@ -0,0 +1,288 @@
+#include "autotune.h"
+
+#include "ggml-backend.h"
+#include "whisper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+#if defined(_WIN32)
+#    include <windows.h>
+#elif defined(__APPLE__)
+#    include <sys/sysctl.h>
+#endif
+
+static constexpr double k_pi = 3.14159265358979323846;
+
+// Runs within this much of the fastest count as a tie: the fewer threads win, leaving cores to the game / OBS.
+static constexpr double k_tie_frac = 0.03;
+
+std::string autotune_cpu_name() {
+    std::string name;
+#if defined(_WIN32)
+    char buf[256] = {};
+    DWORD size = sizeof(buf);
+    if (RegGetValueA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", "ProcessorNameString",
+                     RRF_RT_REG_SZ, nullptr, buf, &size) == ERROR_SUCCESS) {
+        name = buf;
+    }
+#elif defined(__APPLE__)
+    char buf[256] = {};
+    size_t size = sizeof(buf);
+    if (sysctlbyname("machdep.cpu.brand_string", buf, &size, nullptr, 0) == 0) {
+        name = buf;
+    }
+#else
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (name.empty() && std::getline(cpuinfo, line)) {
+        // x86: "model name"; some ARM kernels only give "Hardware" or "Model".
+        for (const char * field : { "model name", "Hardware", "Model" }) {
+            if (line.rfind(field, 0) == 0 && line.find(':') != std::string::npos) {
+                name = line.substr(line.find(':') + 1);
+                break;
+            }
+        }
+    }
+#endif
+    const size_t b = name.find_first_not_of(" \t");
+    const size_t e = name.find_last_not_of(" \t\r\n");
+    name = b == std::string::npos ? std::string("unknown CPU") : name.substr(b, e - b + 1);
+    return name + " / " + std::to_string(std::max(1u, std::thread::hardware_concurrency())) + " threads";
+}
+
+static std::string file_identity(const std::string & path) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    const fs::path abs = fs::absolute(path, ec);
+    const uintmax_t size = fs::file_size(path, ec);
+    const auto mtime = fs::last_write_time(path, ec);
+    std::ostringstream ss;
+    ss << (ec ? fs::path(path) : abs).string() << ':' << (ec ? 0 : size) << ':' << (ec ? 0 : (long long) mtime.time_since_epoch().count());
+    return ss.str();
+}
+
+std::string autotune_key(const autotune_request & req) {
+    std::string key = autotune_cpu_name() + " | " + file_identity(req.model);
+    if (!req.vad_model.empty() && !req.vad_threads.empty()) {
+        key += " | " + file_identity(req.vad_model);
+    }
+    key += req.try_gpu ? " | gpu" : " | cpu";
+    key += req.try_flash_attn ? "+fa" : "";
+    // The largest thread count tried (a --threads or --cpu-budget limit changes it).
+    if (!req.threads.empty()) {
+        key += " | t" + std::to_string(req.threads.back());
+    }
+    // Tabs separate the key from the values in the cache file.
+    std::replace(key.begin(), key.end(), '\t', ' ');
+    return key;
+}
+
+std::vector<int32_t> autotune_thread_candidates(int32_t max_threads) {
+    max_threads = std::max<int32_t>(1, max_threads);
+    std::vector<int32_t> out;
+    for (int32_t t = 1; t < max_threads; t *= 2) {
+        out.push_back(t);
+    }
+    // With SMT, one thread per physical core is often faster than one per logical core.
+    if (max_threads >= 4) {
+        out.push_back(max_threads / 2);
+    }
+    out.push_back(max_threads);
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+bool autotune_cache_load(const std::string & path, const std::string & key, autotune_result & out) {
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t tab = line.find('\t');
+        if (tab == std::string::npos || line.compare(0, tab, key) != 0 || tab != key.size()) {
+            continue;
+        }
+        autotune_result r;
+        int use_gpu = 0;
+        int flash_attn = 0;
+        if (std::sscanf(line.c_str() + tab + 1, "%d %d %d %d %lf %lf", &r.threads, &use_gpu, &flash_attn, &r.vad_threads,
+                        &r.whisper_ms, &r.vad_ms) == 6 && r.threads > 0) {
+            r.use_gpu = use_gpu != 0;
+            r.flash_attn = flash_attn != 0;
+            out = r;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool autotune_cache_store(const std::string & path, const std::string & key, const autotune_result & r) {
+    // Keep the other keys (other models, other machines sharing the folder).
+    std::vector<std::string> lines;
+    {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            const size_t tab = line.find('\t');
+            if (!line.empty() && !(tab == key.size() && line.compare(0, tab, key) == 0)) {
+                lines.push_back(line);
+            }
+        }
+    }
+    char values[128];
+    std::snprintf(values, sizeof(values), "%d %d %d %d %.1f %.2f", r.threads, r.use_gpu ? 1 : 0, r.flash_attn ? 1 : 0,
+        r.vad_threads, r.whisper_ms, r.vad_ms);
+    lines.push_back(key + "\t" + values);
+
+    std::ofstream out(path, std::ios::trunc);
+    for (const std::string & line : lines) {
+        out << line << '\n';
+    }
+    return (bool) out;
+}
+
+// 5 seconds of a voiced-speech-like signal: a 140 Hz glottal pulse train through three formants, syllable-rate AM.
+static std::vector<float> make_sample() {
+    const int rate = WHISPER_SAMPLE_RATE;
+    std::vector<float> pcm((size_t) rate * 5);
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        const double t = (double) i / rate;
+        const double f0 = 140.0 * (1.0 + 0.05 * std::sin(2.0 * k_pi * 0.7 * t));
+        double v = 0.0;
+        for (const double formant : { 700.0, 1200.0, 2600.0 }) {
+            const int h = std::max(1, (int) std::lround(formant / f0));
+            v += std::sin(2.0 * k_pi * f0 * h * t) / h;
+        }
+        const double am = 0.5 + 0.5 * std::sin(2.0 * k_pi * 4.0 * t);
+        pcm[i] = (float) (0.1 * am * v);
+    }
+    return pcm;
+}
+
+static double ms_between(const std::chrono::steady_clock::time_point & a, const std::chrono::steady_clock::time_point & b) {
+    return 1e-3 * (double) std::chrono::duration_cast<std::chrono::microseconds>(b - a).count();
+}
+
+// One block's worth of work: mel, the encoder over the padded 30s window, and a few decoder steps.
+static bool time_whisper_pass(whisper_context * ctx, const std::vector<float> & pcm, int n_threads, double & ms) {
+    constexpr int k_decode_steps = 8;
+    const auto t0 = std::chrono::steady_clock::now();
+    if (whisper_pcm_to_mel(ctx, pcm.data(), (int) pcm.size(), n_threads) != 0 || whisper_encode(ctx, 0, n_threads) != 0) {
+        return false;
+    }
+    const whisper_token sot = whisper_token_sot(ctx);
+    for (int i = 0; i < k_decode_steps; ++i) {
+        if (whisper_decode(ctx, &sot, 1, i, n_threads) != 0) {
+            return false;
+        }
+    }
+    ms = ms_between(t0, std::chrono::steady_clock::now());
+    return true;
+}
+
+// Best of a few runs after a warm-up (the first run pays for buffer allocation).
+static bool time_whisper(whisper_context * ctx, const std::vector<float> & pcm, int n_threads, double & best_ms) {
+    double ms = 0.0;
+    if (!time_whisper_pass(ctx, pcm, n_threads, ms)) {
+        return false;
+    }
+    best_ms = INFINITY;
+    for (int i = 0; i < 3; ++i) {
+        if (!time_whisper_pass(ctx, pcm, n_threads, ms)) {
+            return false;
+        }
+        best_ms = std::min(best_ms, ms);
+    }
+    return true;
+}
+
+static bool has_gpu_device() {
+    for (size_t i = 0; i < ggml_backend_dev_count(); ++i) {
+        if (ggml_backend_dev_type(ggml_backend_dev_get(i)) == GGML_BACKEND_DEVICE_TYPE_GPU) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool autotune_run(const autotune_request & req, autotune_result & out, FILE * log) {
+    const std::vector<float> pcm = make_sample();
+    std::vector<bool> gpu_options = { false };
+    if (req.try_gpu && has_gpu_device()) {
+        gpu_options.push_back(true);
+    }
+    std::vector<bool> fa_options = { false };
+    if (req.try_flash_attn) {
+        fa_options.push_back(true);
+    }
+
+    bool found = false;
+    for (const bool gpu : gpu_options) {
+        for (const bool fa : fa_options) {
+            whisper_context_params cparams = whisper_context_default_params();
+            cparams.use_gpu = gpu;
+            cparams.flash_attn = fa;
+            whisper_context * ctx = whisper_init_from_file_with_params(req.model.c_str(), cparams);
+            if (!ctx) {
+                if (log) std::fprintf(log, "Autotune: cannot load %s (gpu=%d flash_attn=%d)\n", req.model.c_str(), gpu ? 1 : 0, fa ? 1 : 0);
+                continue;
+            }
+            for (const int32_t n_threads : req.threads) {
+                double ms = 0.0;
+                if (!time_whisper(ctx, pcm, n_threads, ms)) {
+                    continue;
+                }
+                if (log) std::fprintf(log, "Autotune: whisper gpu=%d flash_attn=%d threads=%d: %.1fms\n", gpu ? 1 : 0, fa ? 1 : 0, n_threads, ms);
+                // Candidates come in increasing thread counts: a later one must be clearly faster to win.
+                if (!found || ms < out.whisper_ms * (1.0 - k_tie_frac)) {
+                    found = true;
+                    out.threads = n_threads;
+                    out.use_gpu = gpu;
+                    out.flash_attn = fa;
+                    out.whisper_ms = ms;
+                }
+            }
+            whisper_free(ctx);
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    out.vad_threads = 0;
+    if (req.vad_model.empty()) {
+        return true;
+    }
+    // Silero over a 2s window, as one voice gate check sees it.
+    const int n_window = std::min<int>((int) pcm.size(), 2 * WHISPER_SAMPLE_RATE);
+    for (const int32_t n_threads : req.vad_threads) {
+        whisper_vad_context_params vcp = whisper_vad_default_context_params();
+        vcp.n_threads = n_threads;
+        vcp.use_gpu = false;
+        vcp.gpu_device = 0;
+        whisper_vad_context * vctx = whisper_vad_init_from_file_with_params(req.vad_model.c_str(), vcp);
+        if (!vctx) {
+            continue;
+        }
+        whisper_vad_detect_speech(vctx, pcm.data(), n_window);
+        double best_ms = INFINITY;
+        for (int i = 0; i < 5; ++i) {
+            const auto t0 = std::chrono::steady_clock::now();
+            whisper_vad_detect_speech(vctx, pcm.data(), n_window);
+            best_ms = std::min(best_ms, ms_between(t0, std::chrono::steady_clock::now()));
+        }
+        whisper_vad_free(vctx);
+        if (log) std::fprintf(log, "Autotune: silero threads=%d: %.2fms\n", n_threads, best_ms);
+        if (out.vad_threads == 0 || best_ms < out.vad_ms * (1.0 - k_tie_frac)) {
+            out.vad_threads = n_threads;
+            out.vad_ms = best_ms;
+        }
+    }
+    return true;
+}
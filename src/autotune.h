@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// --autotune: times a short built-in sample with the Whisper model at several thread counts and backend options, and
+// Silero at several thread counts, and keeps the fastest of each. Results are cached per CPU and model file, so later
+// startups apply them without timing anything.
+
+struct autotune_request {
+    std::string model;
+    std::string vad_model;            // empty = no VAD tuning
+    std::vector<int32_t> threads;     // Whisper thread counts to try
+    std::vector<int32_t> vad_threads; // Silero thread counts to try (empty = no VAD tuning)
+    bool try_gpu = false;             // also time with the GPU backend (when there is one)
+    bool try_flash_attn = true;       // also time with flash attention
+};
+
+struct autotune_result {
+    int32_t threads = 0;
+    bool use_gpu = false;
+    bool flash_attn = false;
+    int32_t vad_threads = 0; // 0 = not tuned
+    double whisper_ms = 0.0; // time of the sample with the picked settings
+    double vad_ms = 0.0;
+};
+
+// "CPU model name / N threads", as the cache key sees the machine.
+std::string autotune_cpu_name();
+
+// Cache key: the CPU, the model files (path, size, modification time) and what the request may try.
+std::string autotune_key(const autotune_request & req);
+
+// Candidate thread counts up to `max_threads`: powers of two, the physical-core guess (half) and the maximum.
+std::vector<int32_t> autotune_thread_candidates(int32_t max_threads);
+
+// Cache file: one "<key>\t<threads> <use_gpu> <flash_attn> <vad_threads> <whisper_ms> <vad_ms>" line per key.
+bool autotune_cache_load(const std::string & path, const std::string & key, autotune_result & out);
+bool autotune_cache_store(const std::string & path, const std::string & key, const autotune_result & r);
+
+// Times every combination (progress to `log`, may be null). False when the model cannot be loaded at all.
+bool autotune_run(const autotune_request & req, autotune_result & out, FILE * log);
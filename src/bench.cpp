@@ -0,0 +1,706 @@
+#include "bench.h"
+
+#include "audio_stats.h"
+#include "capture_source.h"
+#include "cpu_time.h"
+#include "log_mel.h"
+#include "resampler.h"
+#include "voice_gate.h"
+
+#include "common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+static constexpr double k_pi = 3.14159265358979323846;
+
+// Interleaved stereo test signal: in-band speech-range tones plus out-of-band tones that must be rejected.
+static std::vector<float> make_test_signal(int rate, int channels, int seconds, bool in_band, bool out_of_band) {
+    const size_t n_frames = (size_t) rate * (size_t) seconds;
+    std::vector<float> pcm(n_frames * (size_t) channels);
+
+    const double in_hz[] = { 220.0, 1000.0, 3100.0, 5500.0 };
+    const double out_hz[] = { 12000.0, 19000.0 };
+
+    for (size_t i = 0; i < n_frames; ++i) {
+        const double t = (double) i / (double) rate;
+        for (int c = 0; c < channels; ++c) {
+            double v = 0.0;
+            if (in_band) {
+                for (double f : in_hz) {
+                    v += 0.15 * std::sin(2.0 * k_pi * f * t + 0.3 * c);
+                }
+            }
+            if (out_of_band) {
+                for (double f : out_hz) {
+                    v += 0.10 * std::sin(2.0 * k_pi * f * t + 0.7 * c);
+                }
+            }
+            pcm[i * (size_t) channels + (size_t) c] = (float) v;
+        }
+    }
+    return pcm;
+}
+
+// Streaming run in SDL-callback-sized chunks; returns CPU seconds.
+static double run_stream(const std::vector<float> & pcm, int rate, int channels, int out_rate, simd_isa isa, std::vector<float> & out) {
+    polyphase_resampler rs(rate, out_rate, 32, isa);
+    const size_t chunk = (size_t) rate / 100; // 10ms
+    const size_t n_frames = pcm.size() / (size_t) channels;
+
+    std::vector<float> mono(chunk);
+    out.clear();
+    out.reserve(n_frames * (size_t) out_rate / (size_t) rate + 16);
+
+    const double t0 = thread_cpu_seconds();
+    for (size_t i = 0; i < n_frames; i += chunk) {
+        const size_t n = std::min(chunk, n_frames - i);
+        downmix_to_mono(pcm.data() + i * (size_t) channels, n, channels, mono.data(), isa);
+        rs.process(mono.data(), n, out);
+    }
+    return thread_cpu_seconds() - t0;
+}
+
+// Direct (non-polyphase) evaluation of the band-limited signal at the resampler's output instants,
+// with a much longer, higher-attenuation kernel in double precision.
+static std::vector<double> reference_resample(const std::vector<float> & mono, const polyphase_resampler & rs, size_t k_begin, size_t k_end) {
+    const double fc = rs.cutoff_hz() / (double) rs.in_rate();
+    const double half_width = 512.0;
+    const double beta = 14.0;
+    const double step = (double) rs.down() / (double) rs.up();
+
+    std::vector<double> out;
+    out.reserve(k_end - k_begin);
+    for (size_t k = k_begin; k < k_end; ++k) {
+        const double t = (double) k * step - rs.delay_in();
+        const long n0 = std::max<long>(0, (long) std::ceil(t - half_width));
+        const long n1 = std::min<long>((long) mono.size() - 1, (long) std::floor(t + half_width));
+        double acc = 0.0;
+        for (long n = n0; n <= n1; ++n) {
+            const double tau = t - (double) n;
+            const double x = 2.0 * fc * tau;
+            const double s = std::fabs(x) < 1e-12 ? 1.0 : std::sin(k_pi * x) / (k_pi * x);
+            acc += (double) mono[(size_t) n] * 2.0 * fc * s * resampler_kaiser(tau, half_width, beta);
+        }
+        out.push_back(acc);
+    }
+    return out;
+}
+
+static double db(double ratio) {
+    return 10.0 * std::log10(std::max(ratio, 1e-30));
+}
+
+int run_bench_resampler(int seconds) {
+    const int out_rate = 16000;
+    const int channels = 2;
+    seconds = std::max(1, seconds);
+
+    simd_isa isa_buf[4];
+    int n_isas = 0;
+    simd_available_isas(isa_buf, n_isas);
+    const std::vector<simd_isa> isas(isa_buf, isa_buf + n_isas);
+
+    std::fprintf(stderr, "Resampler benchmark: %ds of %d-channel audio per rate, 10ms chunks, best ISA: %s\n",
+                 seconds, channels, simd_isa_name(simd_best_isa()));
+
+    bool ok = true;
+
+    for (const int rate : { 48000, 44100 }) {
+        const polyphase_resampler probe(rate, out_rate);
+        std::fprintf(stderr, "\n%d Hz x%d -> %d Hz mono (L/M = %d/%d, %d taps/phase, cutoff %.0f Hz, delay %.1f samples)\n",
+                     rate, channels, out_rate, probe.up(), probe.down(), probe.taps_per_phase(), probe.cutoff_hz(), probe.delay_in());
+
+        // Speed
+        const std::vector<float> pcm = make_test_signal(rate, channels, seconds, true, true);
+        std::vector<float> out_scalar;
+        for (const simd_isa isa : isas) {
+            std::vector<float> out;
+            const double cpu_s = run_stream(pcm, rate, channels, out_rate, isa, out);
+            const double us_per_s = 1e6 * cpu_s / (double) seconds;
+            std::fprintf(stderr, "  %-8s CPU %8.1f us per second of audio (%.0fx real time)\n",
+                         simd_isa_name(isa), us_per_s, cpu_s > 0.0 ? (double) seconds / cpu_s : 0.0);
+
+            if (isa == simd_isa::scalar) {
+                out_scalar = out;
+            } else {
+                // SIMD paths only reassociate the sums.
+                double max_diff = 0.0;
+                for (size_t i = 0; i < std::min(out.size(), out_scalar.size()); ++i) {
+                    max_diff = std::max(max_diff, (double) std::fabs(out[i] - out_scalar[i]));
+                }
+                if (out.size() != out_scalar.size() || max_diff > 1e-5) {
+                    std::fprintf(stderr, "  FAIL: %s output differs from scalar (n=%zu vs %zu, max diff %.2e)\n",
+                                 simd_isa_name(isa), out.size(), out_scalar.size(), max_diff);
+                    ok = false;
+                }
+            }
+        }
+
+        // Accuracy against the reference, on a 2s in-band signal (skip the filter warm-up at the start).
+        {
+            const std::vector<float> tones = make_test_signal(rate, 1, 2, true, false);
+            std::vector<float> out;
+            run_stream(tones, rate, 1, out_rate, simd_best_isa(), out);
+
+            const size_t k_begin = (size_t) out_rate / 10;
+            const size_t k_end = std::min(out.size(), (size_t) out_rate * 19 / 10);
+            const std::vector<double> ref = reference_resample(tones, probe, k_begin, k_end);
+
+            double sig = 0.0;
+            double err = 0.0;
+            double max_err = 0.0;
+            for (size_t k = k_begin; k < k_end; ++k) {
+                const double d = (double) out[k] - ref[k - k_begin];
+                sig += ref[k - k_begin] * ref[k - k_begin];
+                err += d * d;
+                max_err = std::max(max_err, std::fabs(d));
+            }
+            const double snr = db(sig / std::max(err, 1e-30));
+            const bool pass = snr >= 70.0;
+            std::fprintf(stderr, "  accuracy vs reference: SNR %.1f dB, max error %.2e %s\n", snr, max_err, pass ? "(ok)" : "(FAIL, want >= 70 dB)");
+            ok = ok && pass;
+        }
+
+        // Alias rejection: only out-of-band tones in, (almost) nothing should come out.
+        {
+            const std::vector<float> alias = make_test_signal(rate, 1, 2, false, true);
+            std::vector<float> out;
+            run_stream(alias, rate, 1, out_rate, simd_best_isa(), out);
+
+            double e_in = 0.0;
+            for (float v : alias) e_in += (double) v * v;
+            e_in /= (double) alias.size();
+
+            double e_out = 0.0;
+            const size_t k_begin = (size_t) out_rate / 10;
+            for (size_t k = k_begin; k < out.size(); ++k) e_out += (double) out[k] * out[k];
+            e_out /= (double) std::max<size_t>(1, out.size() - k_begin);
+
+            const double rej = db(e_out / std::max(e_in, 1e-30));
+            const bool pass = rej <= -70.0;
+            std::fprintf(stderr, "  alias rejection (12 kHz + 19 kHz): %.1f dB %s\n", rej, pass ? "(ok)" : "(FAIL, want <= -70 dB)");
+            ok = ok && pass;
+        }
+    }
+
+    std::fprintf(stderr, "\n%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+//
+// --bench-audio-stats
+//
+
+// Speech-like test audio: noise bursts with a slowly varying envelope, gaps near the activity threshold.
+static std::vector<float> make_envelope_noise(std::mt19937 & rng, size_t n, float level) {
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    std::vector<float> pcm(n);
+    float env = level * u(rng);
+    for (size_t i = 0; i < n; ++i) {
+        if (i % 800 == 0) {
+            env = u(rng) < 0.3f ? level * 0.02f * u(rng) : level * u(rng);
+        }
+        pcm[i] = std::max(-1.0f, std::min(1.0f, env * noise(rng)));
+    }
+    return pcm;
+}
+
+static bool close_rel(double a, double b, double tol) {
+    return std::fabs(a - b) <= tol * std::max({ 1e-12, std::fabs(a), std::fabs(b) });
+}
+
+static bool stats_match(const audio_stats & a, const audio_stats & b) {
+    return a.n == b.n && a.n_active == b.n_active && a.peak == b.peak &&
+           close_rel(a.sum_sq, b.sum_sq, 1e-5) && close_rel(a.sum_abs, b.sum_abs, 1e-5);
+}
+
+template <typename F>
+static double ns_per_call(int iters, F && f) {
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i) {
+        f();
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / (double) iters;
+}
+
+int run_bench_audio_stats() {
+    const int sample_rate = 16000;
+    const float vad_thold = 0.60f;
+    const float freq_thold = 100.0f;
+
+    simd_isa isa_buf[4];
+    int n_isas = 0;
+    simd_available_isas(isa_buf, n_isas);
+
+    std::mt19937 rng(1234);
+    bool ok = true;
+
+    std::fprintf(stderr, "Audio stats benchmark (best ISA: %s)\n\n", simd_isa_name(simd_best_isa()));
+
+    // 1) Fused kernel vs audio_activity_fraction()/audio_rms() and a scalar peak, every ISA.
+    {
+        const size_t lengths[] = { 0, 1, 7, 8, 9, 255, 1000, 1025, 32000, 96000, 480000 };
+        const float levels[] = { 0.0f, 0.005f, 0.02f, 0.3f, 1.5f };
+        int cases = 0;
+        int failures = 0;
+        for (size_t n : lengths) {
+            for (float level : levels) {
+                const std::vector<float> pcm = make_envelope_noise(rng, n, level);
+                const float ref_frac = audio_activity_fraction(pcm, k_audio_activity_thold);
+                const float ref_rms = audio_rms(pcm);
+                float ref_peak = 0.0f;
+                for (float v : pcm) ref_peak = std::max(ref_peak, std::fabs(v));
+
+                for (int k = 0; k < n_isas; ++k) {
+                    const audio_stats st = audio_stats_compute(pcm.data(), pcm.size(), k_audio_activity_thold, isa_buf[k]);
+                    ++cases;
+                    if (st.activity_fraction() != ref_frac || st.peak != ref_peak || !close_rel(st.rms(), ref_rms, 1e-5)) {
+                        ++failures;
+                        std::fprintf(stderr, "  FAIL %s n=%zu level=%.3f: frac %.6f/%.6f rms %.7f/%.7f peak %.6f/%.6f\n",
+                                     simd_isa_name(isa_buf[k]), n, level, st.activity_fraction(), ref_frac, st.rms(), ref_rms, st.peak, ref_peak);
+                    }
+                }
+            }
+        }
+        std::fprintf(stderr, "fused kernel vs scalar helpers: %d/%d cases match\n", cases - failures, cases);
+        ok = ok && failures == 0;
+    }
+
+    // 2) audio_vad_simple() vs whisper.cpp's vad_simple() on the same windows.
+    {
+        const int window_ms = 2000;
+        const int last_ms = 1000;
+        const size_t n_last = (size_t) sample_rate * last_ms / 1000;
+        int agree = 0;
+        int near_threshold = 0;
+        int disagree = 0;
+        for (int t = 0; t < 2000; ++t) {
+            std::vector<float> pcm = make_envelope_noise(rng, (size_t) sample_rate * window_ms / 1000, 0.5f);
+            const audio_window_stats w = audio_window_stats_compute(pcm.data(), pcm.size(), n_last);
+            const bool fused = audio_vad_simple(w, vad_thold, freq_thold, sample_rate);
+            const bool ref = ::vad_simple(pcm, sample_rate, last_ms, vad_thold, freq_thold, false);
+            if (fused == ref) {
+                ++agree;
+                continue;
+            }
+            // Float summation order differs from vad_simple(); only a tie at the threshold may flip.
+            const double ratio = w.last.sum_abs / (double) w.last.n / (vad_thold * w.all.sum_abs / (double) w.all.n);
+            if (std::fabs(ratio - 1.0) < 1e-4) {
+                ++near_threshold;
+            } else {
+                ++disagree;
+            }
+        }
+        std::fprintf(stderr, "audio_vad_simple vs vad_simple: %d agree, %d within 1e-4 of the threshold, %d disagree\n",
+                     agree, near_threshold, disagree);
+        ok = ok && disagree == 0;
+    }
+
+    // 3) Incremental ring stats vs a direct pass over the same samples; views vs copies.
+    {
+        capture_ring ring;
+        ring.init((size_t) sample_rate * 5, (size_t) sample_rate);
+        std::uniform_int_distribution<int> chunk(1, 1200);
+        std::uniform_int_distribution<int> want(0, sample_rate * 6);
+        std::vector<float> win;
+        std::vector<float> copy;
+        int queries = 0;
+        int failures = 0;
+        int view_failures = 0;
+        for (int step = 0; step < 4000; ++step) {
+            const std::vector<float> pcm = make_envelope_noise(rng, (size_t) (step % 97 == 0 ? sample_rate * 7 : chunk(rng)), 0.2f);
+            ring.push(pcm.data(), pcm.size());
+            if (step % 211 == 0) {
+                ring.clear();
+            }
+            if (step % 3 == 0) {
+                audio_window_stats inc;
+                const size_t n_last = (size_t) want(rng) / 2;
+                const size_t n = (size_t) want(rng);
+                const audio_view v = ring.view(n, n_last, inc);
+                const float * pcm = v.linearize(win);
+                const audio_window_stats ref = audio_window_stats_compute(pcm, v.size(), n_last);
+                ++queries;
+                if (!stats_match(inc.all, ref.all) || !stats_match(inc.last, ref.last) || inc.first != ref.first) {
+                    ++failures;
+                }
+                ring.get(n, copy);
+                if (copy.size() != v.size() || !std::equal(copy.begin(), copy.end(), pcm) ||
+                    !stats_match(audio_stats_compute(v), ref.all)) {
+                    ++view_failures;
+                }
+
+                // A view outlives up to the headroom of further capture, and is reported stale after that.
+                const std::vector<float> more = make_envelope_noise(rng, (size_t) chunk(rng) * 2, 0.2f);
+                ring.push(more.data(), more.size());
+                const bool valid = ring.still_valid(v);
+                const bool expect_valid = v.empty() || v.size() + more.size() <= ring.capacity() + (size_t) sample_rate;
+                if (valid != expect_valid || (valid && !std::equal(copy.begin(), copy.end(), v.linearize(win)))) {
+                    ++view_failures;
+                }
+            }
+        }
+        std::fprintf(stderr, "incremental ring stats vs direct pass: %d/%d windows match\n", queries - failures, queries);
+        std::fprintf(stderr, "ring views vs copies (contents, stats, staleness): %d/%d match\n", queries - view_failures, queries);
+        ok = ok && failures == 0 && view_failures == 0;
+    }
+
+    // 4) Per-tick cost: what the main loop used to do vs one fused pass vs the ring summaries.
+    {
+        const size_t n_win = (size_t) sample_rate * 2;  // --vad-window-ms 2000
+        const size_t n_last = (size_t) sample_rate * 1; // --vad-last-ms 1000
+        const size_t n_block = (size_t) sample_rate * 6;
+        const std::vector<float> win = make_envelope_noise(rng, n_win, 0.3f);
+        const std::vector<float> block = make_envelope_noise(rng, n_block, 0.3f);
+        std::vector<float> tmp;
+        volatile float sink = 0.0f;
+
+        const double ns_legacy = ns_per_call(200, [&]() {
+            tmp = win; // vad_simple() filters in place
+            sink = sink + (::vad_simple(tmp, sample_rate, 1000, vad_thold, freq_thold, false) ? 1.0f : 0.0f);
+            sink = sink + audio_activity_fraction(block, k_audio_activity_thold) + audio_rms(block);
+            sink = sink + audio_activity_fraction(win, k_audio_activity_thold) + audio_rms(win);
+        });
+        std::fprintf(stderr, "\nper tick (2s window + 6s block):\n");
+        std::fprintf(stderr, "  separate scalar passes (vad_simple + activity/rms x2): %9.0f ns\n", ns_legacy);
+
+        for (int k = 0; k < n_isas; ++k) {
+            const simd_isa isa = isa_buf[k];
+            const double ns = ns_per_call(200, [&]() {
+                const audio_window_stats w = audio_window_stats_compute(win.data(), win.size(), n_last, isa);
+                const audio_stats b = audio_stats_compute(block.data(), block.size(), k_audio_activity_thold, isa);
+                sink = sink + (audio_vad_simple(w, vad_thold, freq_thold, sample_rate) ? 1.0f : 0.0f) + b.rms() + w.all.rms();
+            });
+            std::fprintf(stderr, "  fused %-8s                                         %9.0f ns (%.1fx)\n", simd_isa_name(isa), ns, ns > 0.0 ? ns_legacy / ns : 0.0);
+        }
+
+        capture_ring ring;
+        ring.init((size_t) sample_rate * 30);
+        for (size_t i = 0; i + 320 <= block.size(); i += 320) {
+            ring.push(block.data() + i, 320);
+        }
+        std::vector<float> out;
+        const double ns_get = ns_per_call(200, [&]() { ring.get(n_win, out); sink = sink + out[0]; });
+        const double ns_view = ns_per_call(200, [&]() { sink = sink + ring.view(n_win)[0]; });
+        const double ns_view_stats = ns_per_call(200, [&]() {
+            audio_window_stats w;
+            sink = sink + ring.view(n_win, n_last, w)[0] + w.all.rms();
+        });
+        std::fprintf(stderr, "  %-55s%9.0f ns\n", "ring window copy (get):", ns_get);
+        std::fprintf(stderr, "  %-55s%9.0f ns\n", "ring window view:", ns_view);
+        std::fprintf(stderr, "  %-55s%9.0f ns\n", "ring view + window stats from chunk summaries:", ns_view_stats);
+
+        const std::vector<float> second = make_envelope_noise(rng, (size_t) sample_rate, 0.3f);
+        const double ns_push = ns_per_call(50, [&]() {
+            for (size_t i = 0; i < second.size(); i += 320) ring.push(second.data() + i, 320);
+        });
+        std::fprintf(stderr, "  capture-side summary upkeep + copy: %.0f ns per second of audio\n", ns_push);
+        (void) sink;
+    }
+
+    std::fprintf(stderr, "\n%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+//
+// --bench-log-mel
+//
+
+int run_bench_log_mel() {
+    const int sample_rate = 16000;
+    std::mt19937 rng(4321);
+    bool ok = true;
+
+    std::fprintf(stderr, "Log-mel benchmark (n_fft %d, hop %d)\n\n", log_mel::k_n_fft, log_mel::k_hop);
+
+    for (const int n_mel : { 80, 128 }) {
+        auto mel = std::make_shared<const log_mel>(n_mel, sample_rate);
+        std::fprintf(stderr, "%d mel bands\n", n_mel);
+
+        // 1) FFT power spectrum vs a double-precision DFT.
+        {
+            const std::vector<float> pcm = make_envelope_noise(rng, (size_t) sample_rate, 0.3f);
+            log_mel::scratch s;
+            std::vector<float> out((size_t) n_mel);
+            double max_err = 0.0;
+            for (size_t off = 0; off + log_mel::k_n_fft <= pcm.size(); off += 3210) {
+                mel->frame(pcm.data() + off, s, out.data());
+                double peak = 0.0;
+                std::vector<double> ref(log_mel::k_n_bins);
+                for (int k = 0; k < log_mel::k_n_bins; ++k) {
+                    double re = 0.0;
+                    double im = 0.0;
+                    for (int t = 0; t < log_mel::k_n_fft; ++t) {
+                        const double w = 0.5 * (1.0 - std::cos(2.0 * k_pi * t / log_mel::k_n_fft));
+                        const double x = w * pcm[off + (size_t) t];
+                        re += x * std::cos(2.0 * k_pi * k * t / log_mel::k_n_fft);
+                        im -= x * std::sin(2.0 * k_pi * k * t / log_mel::k_n_fft);
+                    }
+                    ref[k] = re * re + im * im;
+                    peak = std::max(peak, ref[k]);
+                }
+                for (int k = 0; k < log_mel::k_n_bins; ++k) {
+                    max_err = std::max(max_err, std::fabs(ref[k] - (double) s.power[k]) / std::max(peak, 1e-12));
+                }
+            }
+            const bool pass = max_err < 1e-5;
+            std::fprintf(stderr, "  FFT power vs double DFT: max error %.2e of the frame peak %s\n", max_err, pass ? "(ok)" : "(FAIL, want < 1e-5)");
+            ok = ok && pass;
+        }
+
+        // 2) Frames streamed in capture-sized pieces vs the whole block at once: identical mels. This checks the
+        //    streaming only; whisper has no API that returns its own mel to compare with.
+        const std::vector<float> pcm = make_envelope_noise(rng, (size_t) sample_rate * 20, 0.3f);
+        const uint64_t base = 123457;
+        log_mel_stream stream(mel, pcm.size() / log_mel::k_hop);
+        {
+            std::uniform_int_distribution<int> tick(160, 4800);
+            stream.restart(base);
+            size_t pos = 0;
+            while (pos < pcm.size()) {
+                pos = std::min(pcm.size(), pos + (size_t) tick(rng));
+                const uint64_t from = std::max(base, stream.needed_from());
+                stream.feed(audio_view::of(pcm.data() + (from - base), pos - (size_t) (from - base), from));
+            }
+
+            std::uniform_int_distribution<size_t> at(0, pcm.size() - (size_t) sample_rate);
+            int mismatches = 0;
+            const int blocks = 40;
+            for (int b = 0; b < blocks; ++b) {
+                size_t begin = at(rng);
+                begin -= (size_t) ((base + begin) % log_mel::k_hop);
+                const size_t end = std::min(pcm.size(), begin + (size_t) sample_rate / 2 + at(rng) / 2);
+                const audio_view v = audio_view::of(pcm.data() + begin, end - begin, base + begin);
+                const std::shared_ptr<const log_mel_frames> pre = stream.frames_for(v);
+                std::vector<float> a;
+                std::vector<float> c;
+                int org_a = 0;
+                int org_c = 0;
+                const int len_a = mel->build(v, pre.get(), a, org_a);
+                const int len_c = mel->build(v, nullptr, c, org_c);
+                if (!pre || len_a != len_c || org_a != org_c || a != c) {
+                    ++mismatches;
+                }
+            }
+            std::fprintf(stderr, "  streamed frames vs whole-block mel: %d/%d blocks identical\n", blocks - mismatches, blocks);
+            ok = ok && mismatches == 0;
+        }
+
+        // 3) Mel work left at flush time, per utterance length.
+        {
+            const double us_per_frame = 1e6 * stream.cpu_s() / (double) std::max<uint64_t>(1, stream.frames_computed());
+            std::fprintf(stderr, "  during speech: %.1f us per frame (%.2f ms per second of audio)\n", us_per_frame, 1e-3 * us_per_frame * 100.0);
+            // Blocks start on the frame grid, as the live loop cuts them.
+            const size_t first = (size_t) ((log_mel::k_hop - base % log_mel::k_hop) % log_mel::k_hop);
+            for (const int seconds : { 2, 5, 10, 15 }) {
+                const audio_view v = audio_view::of(pcm.data() + first, (size_t) sample_rate * (size_t) seconds, base + first);
+                const std::shared_ptr<const log_mel_frames> pre = stream.frames_for(v);
+                std::vector<float> out;
+                int org = 0;
+                const int iters = 20;
+                double t0 = thread_cpu_seconds();
+                for (int i = 0; i < iters; ++i) mel->build(v, nullptr, out, org);
+                const double full_ms = 1e3 * (thread_cpu_seconds() - t0) / iters;
+                t0 = thread_cpu_seconds();
+                for (int i = 0; i < iters; ++i) mel->build(v, pre.get(), out, org);
+                const double edge_ms = 1e3 * (thread_cpu_seconds() - t0) / iters;
+                std::fprintf(stderr, "  %2ds utterance: mel at flush %6.2f ms -> %5.2f ms with streamed frames (%.2f ms saved)\n",
+                             seconds, full_ms, edge_ms, full_ms - edge_ms);
+            }
+        }
+        std::fprintf(stderr, "\n");
+    }
+
+    std::fprintf(stderr, "%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+// Ten minutes of synthetic Silero output, one probability per 512-sample frame: utterances of 0.3-8s with short
+// pauses inside, silences of 0.2-4s with the odd noise blip.
+static std::vector<float> make_session_probs(std::mt19937 & rng, int sample_rate, int frame_samples, int seconds) {
+    const size_t n = (size_t) sample_rate * (size_t) seconds / (size_t) frame_samples;
+    const double frame_s = (double) frame_samples / (double) sample_rate;
+    std::uniform_real_distribution<double> speech_s(0.3, 8.0);
+    std::uniform_real_distribution<double> silence_s(0.2, 4.0);
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    std::vector<float> probs;
+    probs.reserve(n);
+    bool speech = false;
+    while (probs.size() < n) {
+        const size_t len = (size_t) ((speech ? speech_s(rng) : silence_s(rng)) / frame_s) + 1;
+        for (size_t i = 0; i < len && probs.size() < n; ++i) {
+            float p = speech ? 0.70f + 0.29f * u(rng) : 0.02f + 0.10f * u(rng);
+            if (speech && u(rng) < 0.04f) p = 0.05f; // between words
+            if (!speech && u(rng) < 0.01f) p = 0.80f; // click
+            probs.push_back(p);
+        }
+        speech = !speech;
+    }
+    return probs;
+}
+
+static bool same_decision(const voice_gate_recording::step & st, const voice_gate_decision & d) {
+    const bool has = d.ev != utterance_timeline::event::none || d.block != voice_gate_block::none;
+    if (has != st.has_decision) {
+        return false;
+    }
+    return !has || (st.ev == voice_gate_event_name(d.ev) && st.block == voice_gate_block_name(d.block) &&
+                    st.begin == d.begin && st.end == d.end && st.too_short == d.too_short);
+}
+
+// One pass over the recording; returns the mismatches (printing the first few when `report`).
+static int replay_recording(const voice_gate_recording & rec, bool report, uint64_t counts[6]) {
+    voice_gate gate(rec.params);
+    int mismatches = 0;
+    for (const voice_gate_recording::step & st : rec.steps) {
+        if (st.accept) {
+            gate.accept_probe(st.check.now);
+            continue;
+        }
+        voice_gate_check c = st.check;
+        c.probs = st.probs.data();
+        const voice_gate_decision d = gate.check(c);
+        if (counts) {
+            counts[(int) d.ev]++;
+        }
+        if (!same_decision(st, d)) {
+            if (report && mismatches < 5) {
+                std::fprintf(stderr, "  mismatch at now=%llu: recorded %s/%s %llu..%llu, replayed %s/%s %llu..%llu\n",
+                             (unsigned long long) c.now,
+                             st.has_decision ? st.ev.c_str() : "none", st.has_decision ? st.block.c_str() : "none",
+                             (unsigned long long) st.begin, (unsigned long long) st.end,
+                             voice_gate_event_name(d.ev), voice_gate_block_name(d.block),
+                             (unsigned long long) d.begin, (unsigned long long) d.end);
+            }
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+int run_bench_voice_gate(const voice_gate_params & p, int32_t window_ms, int32_t check_ms, const std::string & replay_path) {
+    voice_gate_recording rec;
+    std::string err;
+
+    if (replay_path.empty()) {
+        // Record a synthetic session through the recorder, then read it back like a file from a live run.
+        const int rate = p.timeline.sample_rate;
+        const int fs = std::max(1, p.frame_samples);
+        const int seconds = 600;
+        std::mt19937 rng(2024);
+        const std::vector<float> session = make_session_probs(rng, rate, fs, seconds);
+        FILE * f = std::tmpfile();
+        if (!f) {
+            std::fprintf(stderr, "error: cannot create a temporary file\n");
+            return 1;
+        }
+        voice_gate_recorder recorder;
+        recorder.attach(f, p);
+        voice_gate gate(p);
+        const uint64_t win = (uint64_t) rate * (uint64_t) std::max(1, window_ms) / 1000;
+        const uint64_t step = (uint64_t) rate * (uint64_t) std::max(1, check_ms) / 1000;
+        std::vector<float> probs;
+        for (uint64_t now = step; now <= session.size() * (uint64_t) fs; now += step) {
+            voice_gate_check c;
+            c.now = now;
+            c.seq = now > win ? now - win : 0;
+            c.n_samples = (size_t) (now - c.seq);
+            // Silero scores the window from its first sample, so its frames straddle the session's.
+            probs.resize((c.n_samples + (size_t) fs - 1) / (size_t) fs);
+            for (size_t i = 0; i < probs.size(); ++i) {
+                probs[i] = session[std::min(session.size() - 1, (size_t) ((c.seq + i * (size_t) fs + (size_t) fs / 2) / (uint64_t) fs))];
+            }
+            c.probs = probs.data();
+            c.n_probs = (int) probs.size();
+            c.allow_probe = true;
+            c.allow_speculation = true;
+            recorder.check(c, gate.check(c));
+        }
+        recorder.close();
+        std::rewind(f);
+        const bool loaded = voice_gate_load(f, rec, err);
+        std::fclose(f);
+        if (!loaded) {
+            std::fprintf(stderr, "FAIL: synthetic recording does not read back: %s\n", err.c_str());
+            return 1;
+        }
+        std::fprintf(stderr, "Voice gate benchmark: %ds synthetic session, %dms window every %dms\n\n", seconds, window_ms, check_ms);
+    } else {
+        if (!voice_gate_load(replay_path, rec, err)) {
+            std::fprintf(stderr, "error: %s: %s\n", replay_path.c_str(), err.c_str());
+            return 2;
+        }
+        std::fprintf(stderr, "Voice gate replay: %s\n\n", replay_path.c_str());
+    }
+
+    size_t n_checks = 0;
+    size_t n_probs = 0;
+    uint64_t audio_samples = 0;
+    for (const voice_gate_recording::step & st : rec.steps) {
+        if (!st.accept) {
+            ++n_checks;
+            n_probs += st.probs.size();
+            audio_samples = std::max<uint64_t>(audio_samples, st.check.now);
+        }
+    }
+    if (n_checks == 0) {
+        std::fprintf(stderr, "error: the recording has no checks\n");
+        return 2;
+    }
+    const double audio_s = (double) audio_samples / (double) std::max(1, rec.params.timeline.sample_rate);
+
+    // 1) Parity: the gate decides exactly what it decided when the stream was recorded.
+    uint64_t counts[6] = {};
+    const int mismatches = replay_recording(rec, /*report*/ true, counts);
+    std::fprintf(stderr, "  %zu checks (%.0fs of audio, %.1f frames per window): voice_start=%llu flush=%llu chunk=%llu drop_short=%llu\n",
+                 n_checks, audio_s, (double) n_probs / (double) n_checks,
+                 (unsigned long long) counts[(int) utterance_timeline::event::voice_start],
+                 (unsigned long long) counts[(int) utterance_timeline::event::flush],
+                 (unsigned long long) counts[(int) utterance_timeline::event::chunk],
+                 (unsigned long long) counts[(int) utterance_timeline::event::drop_short]);
+    std::fprintf(stderr, "  replayed decisions vs recorded: %zu/%zu identical\n", n_checks - (size_t) mismatches, n_checks);
+
+    // 2) Speed: Silero segmentation alone, then the whole gate (segmentation + timeline).
+    std::vector<vad_span> spans;
+    size_t n_spans = 0;
+    int seg_passes = 0;
+    const double t_seg = thread_cpu_seconds();
+    do {
+        for (const voice_gate_recording::step & st : rec.steps) {
+            if (st.accept) continue;
+            voice_gate_check c = st.check;
+            c.probs = st.probs.data();
+            voice_gate_spans(rec.params, c, spans);
+            n_spans += spans.size();
+        }
+        ++seg_passes;
+    } while (thread_cpu_seconds() - t_seg < 0.3);
+    const double seg_s = thread_cpu_seconds() - t_seg;
+
+    int gate_passes = 0;
+    const double t_gate = thread_cpu_seconds();
+    do {
+        replay_recording(rec, /*report*/ false, nullptr);
+        ++gate_passes;
+    } while (thread_cpu_seconds() - t_gate < 0.3);
+    const double gate_s = thread_cpu_seconds() - t_gate;
+
+    const double seg_us = 1e6 * seg_s / ((double) n_checks * seg_passes);
+    const double gate_us = 1e6 * gate_s / ((double) n_checks * gate_passes);
+    std::fprintf(stderr, "  segmentation: %.2f us per check (%zu spans)\n", seg_us, n_spans / (size_t) seg_passes);
+    std::fprintf(stderr, "  whole gate:   %.2f us per check, %.0f decisions/s (%.0fx real time at this cadence)\n",
+                 gate_us, gate_us > 0.0 ? 1e6 / gate_us : 0.0, gate_s > 0.0 ? audio_s * gate_passes / gate_s : 0.0);
+
+    const bool ok = mismatches == 0;
+    std::fprintf(stderr, "\n%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "voice_gate.h"
+
+#include <cstdint>
+#include <string>
+
+// Self-contained benchmarks / accuracy checks exposed as CLI modes (no mic, no Whisper, no Streamer.bot).
+// Each returns a process exit code: 0 when all checks pass.
+
+// --bench-resampler: downmix + polyphase resampling cost per second of audio, per instruction set,
+// and accuracy against a double-precision windowed-sinc reference.
+int run_bench_resampler(int seconds);
+
+// --bench-audio-stats: fused stats kernel vs the original scalar helpers and vad_simple() (equivalence),
+// ring-buffer incremental window stats vs a direct pass, and the per-tick cost of each.
+int run_bench_audio_stats();
+
+// --bench-log-mel: FFT accuracy, streamed log-mel frames vs the whole-block computation (identical), and the mel
+// work left at flush time with and without frames computed during speech.
+int run_bench_log_mel();
+
+// --bench-voice-gate / --replay-voice-gate: replays a recorded Silero probability stream (or a synthetic one,
+// recorded and read back first) through the voice gate, checks every decision matches the recorded one, and times
+// the checks (segmentation alone and the whole gate).
+int run_bench_voice_gate(const voice_gate_params & p, int32_t window_ms, int32_t check_ms, const std::string & replay_path);
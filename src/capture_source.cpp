@@ -0,0 +1,576 @@
+#include "capture_source.h"
+#include "resampler.h"
+
+#include "common-sdl.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+#if defined(_WIN32)
+#    include <fcntl.h>
+#    include <io.h>
+#endif
+
+//
+// capture_source
+//
+
+capture_source::capture_source(int len_ms)
+    : m_len_ms(std::max(1, len_ms))
+    , m_ring(std::make_shared<capture_ring>()) {
+}
+
+void capture_source::init_ring(int sample_rate) {
+    m_sample_rate = std::max(1, sample_rate);
+    m_ring->init(samples_for_ms(m_len_ms), samples_for_ms(k_view_headroom_ms));
+}
+
+size_t capture_source::samples_for_ms(int ms) const {
+    return (size_t) m_sample_rate * (size_t) std::max(0, ms) / 1000;
+}
+
+bool capture_source::clear() {
+    m_ring->clear();
+    return true;
+}
+
+void capture_source::get(int ms, std::vector<float> & audio) {
+    m_ring->get(ms > 0 ? samples_for_ms(ms) : m_ring->capacity(), audio);
+}
+
+audio_view capture_source::view(int ms) {
+    return m_ring->view(ms > 0 ? samples_for_ms(ms) : m_ring->capacity());
+}
+
+audio_view capture_source::view(int ms, size_t n_last, audio_window_stats & stats) {
+    return m_ring->view(ms > 0 ? samples_for_ms(ms) : m_ring->capacity(), n_last, stats);
+}
+
+audio_view capture_source::view_range(uint64_t begin, uint64_t end) {
+    return m_ring->view_range(begin, end);
+}
+
+bool capture_source::still_valid(const audio_view & v) const {
+    return m_ring->still_valid(v);
+}
+
+audio_stats capture_source::peek_stats(int ms) const {
+    audio_stats stats;
+    m_ring->peek(samples_for_ms(ms), stats);
+    return stats;
+}
+
+capture_stats capture_source::stats() const {
+    return m_ring->stats();
+}
+
+//
+// capture_ring
+//
+
+void capture_ring::init(size_t capacity, size_t headroom) {
+    std::lock_guard<std::mutex> lock(m_mu);
+    m_limit = std::max<size_t>(1, capacity);
+    m_audio.assign(m_limit + headroom, 0.0f);
+    m_chunk_stats.assign(m_audio.size() / k_stats_chunk + 2, audio_stats{});
+    m_pos = 0;
+    m_len = 0;
+    m_unread = 0;
+    m_written = 0;
+}
+
+void capture_ring::push(const float * samples, size_t n) {
+    if (n == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mu);
+    const size_t cap = m_audio.size();
+    m_stats.samples_in += n;
+
+    // Overrun: audio the pipeline has not looked at yet fell out of the readable window.
+    const size_t unread_before = m_unread;
+    m_unread += n;
+    if (m_unread > m_limit) {
+        if (unread_before <= m_limit) {
+            m_stats.overruns++;
+        }
+        m_stats.samples_lost += m_unread - std::max(unread_before, m_limit);
+    }
+
+    if (n > cap) {
+        samples += n - cap;
+        m_written += n - cap;
+        m_pos = (size_t) (m_written % cap);
+        n = cap;
+    }
+
+    if (m_pos + n > cap) {
+        const size_t n0 = cap - m_pos;
+        std::memcpy(&m_audio[m_pos], samples, n0 * sizeof(float));
+        std::memcpy(&m_audio[0], samples + n0, (n - n0) * sizeof(float));
+    } else {
+        std::memcpy(&m_audio[m_pos], samples, n * sizeof(float));
+    }
+
+    // Fold the new samples into their chunk summaries (a chunk's summary restarts at its first sample).
+    const uint64_t begin = m_written;
+    const uint64_t end = m_written + n;
+    for (uint64_t a = begin; a < end;) {
+        const uint64_t chunk = a / k_stats_chunk;
+        const uint64_t b = std::min(end, (chunk + 1) * k_stats_chunk);
+        audio_stats & cs = m_chunk_stats[(size_t) (chunk % m_chunk_stats.size())];
+        if (a == chunk * k_stats_chunk) {
+            cs = audio_stats{};
+        }
+        cs.merge(audio_stats_compute(samples + (a - begin), (size_t) (b - a)));
+        a = b;
+    }
+
+    m_written = end;
+    m_pos = (m_pos + n) % cap;
+    m_len = std::min(m_len + n, m_limit);
+}
+
+void capture_ring::clear() {
+    std::lock_guard<std::mutex> lock(m_mu);
+    // Keep m_pos/m_written: the chunk summaries are indexed by absolute position.
+    m_len = 0;
+    m_unread = 0;
+}
+
+audio_view capture_ring::view_locked(size_t n) const {
+    audio_view v;
+    n = std::min(n, m_len);
+    v.seq = m_written - n;
+    if (n == 0) {
+        return v;
+    }
+
+    const size_t cap = m_audio.size();
+    const size_t s0 = (m_pos + cap - n) % cap;
+    v.p0 = &m_audio[s0];
+    if (s0 + n > cap) {
+        v.n0 = cap - s0;
+        v.p1 = &m_audio[0];
+        v.n1 = n - v.n0;
+    } else {
+        v.n0 = n;
+    }
+    return v;
+}
+
+audio_stats capture_ring::range_stats_locked(uint64_t begin, uint64_t end) const {
+    audio_stats r;
+    if (begin >= end) {
+        return r;
+    }
+
+    const size_t cap = m_audio.size();
+    auto from_samples = [&](uint64_t a, uint64_t b) {
+        while (a < b) {
+            const size_t idx = (size_t) (a % cap);
+            const size_t m = (size_t) std::min<uint64_t>(b - a, cap - idx);
+            r.merge(audio_stats_compute(&m_audio[idx], m));
+            a += m;
+        }
+    };
+
+    // Whole chunks come from the summaries; the newest chunk's summary covers exactly what has been
+    // written so far, so it counts as whole when the range ends at the write position.
+    const uint64_t c0 = (begin + k_stats_chunk - 1) / k_stats_chunk;
+    const uint64_t c1 = end == m_written ? (end + k_stats_chunk - 1) / k_stats_chunk : end / k_stats_chunk;
+    if (c0 >= c1) {
+        from_samples(begin, end);
+        return r;
+    }
+
+    // Partial chunks at either edge straight from the samples (their summaries include audio outside the range).
+    from_samples(begin, c0 * k_stats_chunk);
+    for (uint64_t chunk = c0; chunk < c1; ++chunk) {
+        r.merge(m_chunk_stats[(size_t) (chunk % m_chunk_stats.size())]);
+    }
+    from_samples(std::min(end, c1 * k_stats_chunk), end);
+    return r;
+}
+
+void capture_ring::get(size_t n, std::vector<float> & out) {
+    std::lock_guard<std::mutex> lock(m_mu);
+    m_unread = 0;
+    view_locked(n).copy_to(out);
+}
+
+audio_view capture_ring::view(size_t n) {
+    std::lock_guard<std::mutex> lock(m_mu);
+    m_unread = 0;
+    return view_locked(n);
+}
+
+audio_view capture_ring::view(size_t n, size_t n_last, audio_window_stats & stats) {
+    std::lock_guard<std::mutex> lock(m_mu);
+    m_unread = 0;
+
+    const audio_view v = view_locked(n);
+    n = v.size();
+    n_last = std::min(n_last, n);
+
+    stats = audio_window_stats{};
+    stats.last = range_stats_locked(m_written - n_last, m_written);
+    stats.all = range_stats_locked(m_written - n, m_written - n_last);
+    stats.all.merge(stats.last);
+    stats.first = n ? v[0] : 0.0f;
+    return v;
+}
+
+audio_view capture_ring::view_range(uint64_t begin, uint64_t end) {
+    std::lock_guard<std::mutex> lock(m_mu);
+    m_unread = 0;
+
+    const uint64_t oldest = m_written - m_len;
+    begin = std::min(std::max(begin, oldest), m_written);
+    end = std::min(std::max(end, begin), m_written);
+    return view_locked((size_t) (m_written - begin)).head((size_t) (end - begin));
+}
+
+bool capture_ring::still_valid(const audio_view & v) const {
+    std::lock_guard<std::mutex> lock(m_mu);
+    // Sample `seq` is overwritten once the producer has written a whole ring past it.
+    return v.empty() || m_written <= v.seq + m_audio.size();
+}
+
+void capture_ring::peek(size_t n, audio_stats & stats) const {
+    std::lock_guard<std::mutex> lock(m_mu);
+    n = std::min(n, m_len);
+    stats = range_stats_locked(m_written - n, m_written);
+}
+
+capture_stats capture_ring::stats() const {
+    std::lock_guard<std::mutex> lock(m_mu);
+    return m_stats;
+}
+
+//
+// sdl_capture_source
+//
+
+static void sdl_capture_callback(void * userdata, Uint8 * stream, int len) {
+    sdl_capture_source * self = (sdl_capture_source *) userdata;
+    self->on_audio((const float *) stream, len);
+}
+
+sdl_capture_source::sdl_capture_source(int len_ms)
+    : capture_source(len_ms) {
+}
+
+sdl_capture_source::~sdl_capture_source() {
+    if (m_dev) {
+        SDL_CloseAudioDevice(m_dev);
+    }
+}
+
+bool sdl_capture_source::init(int device_index, int sample_rate, bool sdl_resample) {
+    m_device_index = device_index;
+    m_sdl_resample = sdl_resample;
+
+    SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO);
+    if (SDL_Init(SDL_INIT_AUDIO) < 0) {
+        std::fprintf(stderr, "%s: couldn't initialize SDL: %s\n", __func__, SDL_GetError());
+        return false;
+    }
+
+    // Ask for the device's own rate and channel count so SDL does not resample for us.
+    SDL_AudioSpec native;
+    SDL_zero(native);
+    if (sdl_resample) {
+        SDL_SetHintWithPriority(SDL_HINT_AUDIO_RESAMPLING_MODE, "medium", SDL_HINT_OVERRIDE);
+        native.freq = sample_rate;
+        native.channels = 1;
+    }
+#if SDL_VERSION_ATLEAST(2, 0, 16)
+    if (device_index >= 0 && !sdl_resample) {
+        if (SDL_GetAudioDeviceSpec(device_index, SDL_TRUE, &native) != 0) {
+            SDL_zero(native);
+        }
+    }
+#endif
+#if SDL_VERSION_ATLEAST(2, 24, 0)
+    if (device_index < 0 && !sdl_resample) {
+        char * name = nullptr;
+        if (SDL_GetDefaultAudioInfo(&name, &native, SDL_TRUE) != 0) {
+            SDL_zero(native);
+        }
+        SDL_free(name);
+    }
+#endif
+
+    SDL_AudioSpec desired;
+    SDL_AudioSpec obtained;
+    SDL_zero(desired);
+    SDL_zero(obtained);
+
+    desired.freq = native.freq > 0 ? native.freq : 48000;
+    desired.format = AUDIO_F32SYS;
+    desired.channels = native.channels > 0 ? native.channels : 2;
+    desired.samples = 1024;
+    desired.callback = sdl_capture_callback;
+    desired.userdata = this;
+
+    // Sample format conversion is cheap; rate and channel count are whatever the device prefers.
+    const char * name = device_index >= 0 ? SDL_GetAudioDeviceName(device_index, SDL_TRUE) : nullptr;
+    m_dev = SDL_OpenAudioDevice(name, SDL_TRUE, &desired, &obtained,
+                                sdl_resample ? 0 : SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_CHANNELS_CHANGE);
+    if (!m_dev) {
+        std::fprintf(stderr, "%s: couldn't open an audio device for capture: %s\n", __func__, SDL_GetError());
+        return false;
+    }
+
+    m_native_rate = obtained.freq;
+    m_native_channels = std::max(1, (int) obtained.channels);
+    m_mono.reserve(obtained.samples);
+    init_ring(sample_rate);
+
+    if (m_native_rate == sample_rate) {
+        std::fprintf(stderr, "%s: opened capture device %d at %d Hz x%d (%s)\n",
+                     __func__, device_index, m_native_rate, m_native_channels,
+                     sdl_resample ? "SDL resampler" : "no resampling needed");
+        return true;
+    }
+
+    m_resampler.reset(new polyphase_resampler(m_native_rate, sample_rate));
+    m_resampled.reserve((size_t) obtained.samples * (size_t) sample_rate / (size_t) std::max(1, m_native_rate) + 16);
+
+    std::fprintf(stderr, "%s: opened capture device %d at %d Hz x%d (resampling to %d Hz mono, %d taps/phase, %s)\n",
+                 __func__, device_index, m_native_rate, m_native_channels, sample_rate,
+                 m_resampler->taps_per_phase(), simd_isa_name(m_resampler->isa()));
+    return true;
+}
+
+void sdl_capture_source::on_audio(const float * frames, int len_bytes) {
+    const size_t n_frames = (size_t) len_bytes / (sizeof(float) * (size_t) m_native_channels);
+    if (n_frames == 0) {
+        return;
+    }
+
+    // Runs on the SDL audio thread: after the first callbacks the buffers no longer grow.
+    const float * mono = frames;
+    if (m_native_channels > 1) {
+        m_mono.resize(n_frames);
+        downmix_to_mono(frames, n_frames, m_native_channels, m_mono.data(), simd_best_isa());
+        mono = m_mono.data();
+    }
+
+    if (!m_resampler) {
+        m_ring->push(mono, n_frames);
+        return;
+    }
+    m_resampled.clear();
+    m_resampler->process(mono, n_frames, m_resampled);
+    m_ring->push(m_resampled.data(), m_resampled.size());
+}
+
+bool sdl_capture_source::resume() {
+    if (!m_dev) {
+        return false;
+    }
+    SDL_PauseAudioDevice(m_dev, 0);
+    return true;
+}
+
+bool sdl_capture_source::pause() {
+    if (!m_dev) {
+        return false;
+    }
+    SDL_PauseAudioDevice(m_dev, 1);
+    return true;
+}
+
+bool sdl_capture_source::poll() {
+    return sdl_poll_events();
+}
+
+std::string sdl_capture_source::describe() const {
+    std::string s = "SDL capture device " + std::to_string(m_device_index);
+    if (m_resampler) {
+        s += " (" + std::to_string(m_native_rate) + " Hz x" + std::to_string(m_native_channels) + " -> " +
+             std::to_string(m_sample_rate) + " Hz mono, polyphase " + simd_isa_name(m_resampler->isa()) + ")";
+    } else if (m_sdl_resample) {
+        s += " (SDL resampler)";
+    } else {
+        s += " (" + std::to_string(m_native_rate) + " Hz x" + std::to_string(m_native_channels) + ", no resampling)";
+    }
+    return s;
+}
+
+//
+// pcm_stream_capture_source
+//
+
+struct pcm_stream_capture_source::stream_state {
+    pcm_stream_config cfg;
+    FILE * file = nullptr;
+
+    std::atomic<bool> running{ false };
+    std::atomic<bool> paused{ true };
+    std::atomic<bool> finished{ false };
+
+    std::shared_ptr<capture_ring> ring;
+
+    ~stream_state() {
+        if (file && file != stdin) {
+            std::fclose(file);
+        }
+    }
+
+    void push(const float * samples, size_t n) {
+        if (paused) {
+            return;
+        }
+        ring->push(samples, n);
+    }
+
+    void reader_loop() {
+        // 20ms reads keep the added latency negligible for live producers.
+        const size_t chunk_samples = (size_t) std::max(1, cfg.sample_rate / 50);
+        const size_t bytes_per_sample = cfg.format == pcm_sample_format::s16 ? 2 : 4;
+
+        std::vector<unsigned char> raw(chunk_samples * bytes_per_sample);
+        std::vector<float> pcm(chunk_samples);
+        size_t raw_have = 0;
+
+        const auto t_start = std::chrono::steady_clock::now();
+        uint64_t n_read = 0;
+
+        auto pace = [&]() {
+            const auto t_due = t_start + std::chrono::microseconds((int64_t) (1e6 * (double) n_read / (double) cfg.sample_rate));
+            std::this_thread::sleep_until(t_due);
+        };
+
+        while (running) {
+            const size_t got = std::fread(raw.data() + raw_have, 1, raw.size() - raw_have, file);
+            if (got == 0) {
+                break;
+            }
+            raw_have += got;
+
+            const size_t n = raw_have / bytes_per_sample;
+            if (cfg.format == pcm_sample_format::s16) {
+                for (size_t i = 0; i < n; ++i) {
+                    const int16_t v = (int16_t) ((uint16_t) raw[2 * i] | ((uint16_t) raw[2 * i + 1] << 8));
+                    pcm[i] = (float) v / 32768.0f;
+                }
+            } else {
+                std::memcpy(pcm.data(), raw.data(), n * sizeof(float));
+            }
+
+            // Keep any partial trailing sample for the next read.
+            const size_t used = n * bytes_per_sample;
+            if (used < raw_have) {
+                std::memmove(raw.data(), raw.data() + used, raw_have - used);
+            }
+            raw_have -= used;
+
+            n_read += n;
+            if (cfg.realtime) {
+                pace();
+            }
+            push(pcm.data(), n);
+        }
+
+        // End of input: feed (always paced) silence so the gate can observe the end of speech.
+        if (running && cfg.eof_tail_ms > 0) {
+            std::fill(pcm.begin(), pcm.end(), 0.0f);
+            if (!cfg.realtime) {
+                // Restart the pacing clock from now; the input itself may have arrived faster than real time.
+                n_read = 0;
+            }
+            const auto t_tail = std::chrono::steady_clock::now();
+            const uint64_t tail = (uint64_t) cfg.eof_tail_ms * (uint64_t) cfg.sample_rate / 1000;
+            uint64_t fed = 0;
+            while (running && fed < tail) {
+                const size_t n = (size_t) std::min<uint64_t>(chunk_samples, tail - fed);
+                fed += n;
+                const uint64_t due = cfg.realtime ? n_read + fed : fed;
+                const auto t0 = cfg.realtime ? t_start : t_tail;
+                std::this_thread::sleep_until(t0 + std::chrono::microseconds((int64_t) (1e6 * (double) due / (double) cfg.sample_rate)));
+                push(pcm.data(), n);
+            }
+        }
+
+        finished = true;
+    }
+};
+
+pcm_stream_capture_source::pcm_stream_capture_source(int len_ms)
+    : capture_source(len_ms)
+    , m_state(std::make_shared<stream_state>()) {
+    m_state->ring = m_ring;
+}
+
+pcm_stream_capture_source::~pcm_stream_capture_source() {
+    m_state->running = false;
+    if (!m_thread.joinable()) {
+        return;
+    }
+    if (m_state->finished) {
+        m_thread.join();
+    } else {
+        // The reader may be blocked in fread() on stdin or a pipe with no portable way to interrupt it.
+        // It holds its own reference to the state, so detaching is safe; we only get here on shutdown.
+        m_thread.detach();
+    }
+}
+
+bool pcm_stream_capture_source::init(const pcm_stream_config & cfg, std::string & err) {
+    stream_state & st = *m_state;
+
+    st.cfg = cfg;
+    st.cfg.sample_rate = std::max(1, st.cfg.sample_rate);
+
+    if (st.cfg.path == "-") {
+#if defined(_WIN32)
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        st.file = stdin;
+    } else {
+        // Named pipes (POSIX FIFOs, \\.\pipe\name on Windows) open like regular files.
+        st.file = std::fopen(st.cfg.path.c_str(), "rb");
+        if (!st.file) {
+            err = "failed to open input: " + st.cfg.path;
+            return false;
+        }
+    }
+
+    init_ring(st.cfg.sample_rate);
+    return true;
+}
+
+bool pcm_stream_capture_source::resume() {
+    m_state->paused = false;
+    // Start reading on first resume so nothing the producer sends is discarded while paused.
+    if (!m_thread.joinable() && m_state->file) {
+        m_state->running = true;
+        std::shared_ptr<stream_state> state = m_state;
+        m_thread = std::thread([state]() { state->reader_loop(); });
+    }
+    return true;
+}
+
+bool pcm_stream_capture_source::pause() {
+    m_state->paused = true;
+    return true;
+}
+
+bool pcm_stream_capture_source::poll() {
+    return !m_state->finished;
+}
+
+std::string pcm_stream_capture_source::describe() const {
+    const pcm_stream_config & cfg = m_state->cfg;
+    std::string s = (cfg.path == "-") ? std::string("stdin") : cfg.path;
+    s += cfg.format == pcm_sample_format::s16 ? " (s16le" : " (f32le";
+    s += ", " + std::to_string(cfg.sample_rate) + " Hz mono";
+    s += cfg.realtime ? ", real-time paced)" : ")";
+    return s;
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio_stats.h"
+
+class polyphase_resampler;
+
+struct capture_stats {
+    uint64_t samples_in = 0;   // samples delivered by the producer
+    uint64_t overruns = 0;     // times unread audio was overwritten before get() saw it
+    uint64_t samples_lost = 0; // samples overwritten before the pipeline read them
+};
+
+// Bounded ring of the most recent mono samples, shared by the capture sources.
+// push() runs on the producer thread (SDL callback, reader thread); the rest on the pipeline thread.
+class capture_ring {
+public:
+    // The newest `capacity` samples are readable; `headroom` more are kept so views stay valid.
+    void init(size_t capacity, size_t headroom = 0);
+
+    void push(const float * samples, size_t n);
+    void clear();
+    // Copy of the newest min(n, available) samples; marks everything as read.
+    void get(size_t n, std::vector<float> & out);
+    // The same samples in place; marks everything as read.
+    audio_view view(size_t n);
+    // Same, plus window stats assembled from the per-chunk summaries kept by push().
+    audio_view view(size_t n, size_t n_last, audio_window_stats & stats);
+    // Absolute samples [begin, end), clamped to what is still readable; marks everything as read.
+    audio_view view_range(uint64_t begin, uint64_t end);
+    // True while none of the view's samples have been overwritten.
+    bool still_valid(const audio_view & v) const;
+    // Stats of the newest min(n, available) samples only; does not mark anything as read.
+    void peek(size_t n, audio_stats & stats) const;
+
+    size_t capacity() const { return m_limit; }
+    capture_stats stats() const;
+
+private:
+    // Summaries are kept per fixed chunk of the absolute sample index, so a window query only
+    // touches samples in its partial first chunk.
+    static constexpr size_t k_stats_chunk = 256;
+
+    audio_view view_locked(size_t n) const;
+    audio_stats range_stats_locked(uint64_t begin, uint64_t end) const;
+
+    mutable std::mutex m_mu;
+    std::vector<float> m_audio; // m_limit + headroom samples
+    size_t m_limit = 0;         // readable samples
+    size_t m_pos = 0;           // == m_written % m_audio.size()
+    size_t m_len = 0;
+    size_t m_unread = 0;        // samples written since the last get()/clear()
+    uint64_t m_written = 0;     // absolute index of the next sample
+    std::vector<audio_stats> m_chunk_stats; // indexed by (absolute index / k_stats_chunk) % size
+    capture_stats m_stats;
+};
+
+// Source of mono float PCM for the live pipeline.
+// Every source keeps the most recent `len_ms` of audio in a bounded ring buffer; get() copies the
+// newest `ms` of it (same contract as audio_async) and view() hands out the same samples in place.
+// Subclasses feed the ring from their producer thread and only implement device control.
+class capture_source {
+public:
+    virtual ~capture_source() = default;
+
+    virtual bool resume() = 0;
+    virtual bool pause() = 0;
+
+    // Pump platform events. Returns false once the source is finished (window closed, input ended).
+    virtual bool poll() = 0;
+
+    virtual std::string describe() const = 0;
+
+    bool clear();
+    void get(int ms, std::vector<float> & audio);
+
+    // Zero-copy snapshot of the newest `ms` (<= 0: everything); marks everything as read like get().
+    // The producer keeps writing behind it, so a view stays readable for at least k_view_headroom_ms
+    // of further capture; still_valid() tells whether that held.
+    audio_view view(int ms);
+    // view() plus stats of the window and of its newest `n_last` samples, from the per-chunk summaries.
+    audio_view view(int ms, size_t n_last, audio_window_stats & stats);
+    // Absolute samples [begin, end) of the view timeline (audio_view::seq), clamped to what is still readable.
+    audio_view view_range(uint64_t begin, uint64_t end);
+    bool still_valid(const audio_view & v) const;
+
+    // Stats of the newest `ms` without copying or marking anything as read.
+    audio_stats peek_stats(int ms) const;
+
+    capture_stats stats() const;
+    int sample_rate() const { return m_sample_rate; }
+
+    // Capture kept beyond `len_ms` so views survive while the pipeline works on them.
+    static constexpr int k_view_headroom_ms = 10000;
+
+protected:
+    explicit capture_source(int len_ms);
+
+    // Allocates the ring for `len_ms` at `sample_rate` (plus the view headroom).
+    void init_ring(int sample_rate);
+    size_t samples_for_ms(int ms) const;
+
+    int m_len_ms = 0;
+    int m_sample_rate = 0;
+    // Shared so a producer thread that outlives its source (blocked reader) never writes into freed memory.
+    std::shared_ptr<capture_ring> m_ring;
+};
+
+// Microphone capture through SDL2.
+// By default the device is opened at its native rate and channel count; the callback downmixes and
+// resamples to `sample_rate` with our polyphase resampler. `sdl_resample` instead asks SDL for
+// `sample_rate` mono directly and SDL converts.
+class sdl_capture_source : public capture_source {
+public:
+    explicit sdl_capture_source(int len_ms);
+    ~sdl_capture_source() override;
+
+    bool init(int device_index, int sample_rate, bool sdl_resample = false);
+
+    bool resume() override;
+    bool pause() override;
+    bool poll() override;
+    std::string describe() const override;
+
+    // Called from the SDL audio thread with `len_bytes` of interleaved float frames.
+    void on_audio(const float * frames, int len_bytes);
+
+private:
+    int m_device_index = -1;
+    bool m_sdl_resample = false;
+
+    uint32_t m_dev = 0; // SDL_AudioDeviceID
+    int m_native_rate = 0;
+    int m_native_channels = 0;
+    std::unique_ptr<polyphase_resampler> m_resampler; // null when SDL delivers `sample_rate` already
+    std::vector<float> m_mono;
+    std::vector<float> m_resampled;
+};
+
+enum class pcm_sample_format {
+    s16, // signed 16-bit little-endian (ffmpeg -f s16le)
+    f32, // 32-bit float little-endian (ffmpeg -f f32le)
+};
+
+struct pcm_stream_config {
+    std::string path;  // "-" reads stdin; anything else is opened as a file or named pipe
+    pcm_sample_format format = pcm_sample_format::s16;
+    int sample_rate = 16000;
+    bool realtime = false; // pace reads at 1x (needed for files; live producers are already paced)
+    int eof_tail_ms = 0;   // silence fed after end of input so a trailing utterance can still flush
+};
+
+// Headless capture: raw mono PCM from stdin, a named pipe or a file, read on a background thread.
+class pcm_stream_capture_source : public capture_source {
+public:
+    explicit pcm_stream_capture_source(int len_ms);
+    ~pcm_stream_capture_source() override;
+
+    bool init(const pcm_stream_config & cfg, std::string & err);
+
+    bool resume() override;
+    bool pause() override;
+    bool poll() override;
+    std::string describe() const override;
+
+private:
+    struct stream_state;
+
+    // Shared with the reader thread so it can outlive us if it is stuck in a blocking read.
+    std::shared_ptr<stream_state> m_state;
+    std::thread m_thread;
+};
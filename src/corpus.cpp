@@ -0,0 +1,138 @@
+#include "corpus.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+bool corpus_list(const std::string & src, std::vector<std::string> & files) {
+    files.clear();
+    std::error_code ec;
+    if (fs::is_directory(src, ec)) {
+        for (fs::recursive_directory_iterator it(src, ec), end; !ec && it != end; it.increment(ec)) {
+            if (!it->is_regular_file(ec)) {
+                continue;
+            }
+            std::string ext = it->path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char) std::tolower(c); });
+            if (ext == ".wav" || ext == ".mp3" || ext == ".flac" || ext == ".ogg") {
+                files.push_back(it->path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        return !ec;
+    }
+    std::ifstream manifest(src);
+    if (!manifest) {
+        return false;
+    }
+    const fs::path base = fs::path(src).parent_path();
+    std::string line;
+    while (std::getline(manifest, line)) {
+        const size_t b = line.find_first_not_of(" \t\r");
+        const size_t e = line.find_last_not_of(" \t\r");
+        const std::string path = b == std::string::npos ? std::string() : line.substr(b, e - b + 1);
+        if (path.empty() || path[0] == '#') {
+            continue;
+        }
+        const fs::path f(path);
+        files.push_back(f.is_absolute() ? f.string() : (base / f).string());
+    }
+    return true;
+}
+
+bool corpus_reference(const std::string & audio_path, std::string & text) {
+    std::ifstream in(fs::path(audio_path).replace_extension(".txt"));
+    if (!in) {
+        return false;
+    }
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    text = ss.str();
+    return true;
+}
+
+std::vector<std::string> corpus_words(const std::string & text) {
+    std::vector<std::string> words;
+    std::string cur;
+    for (const char ch : text) {
+        const unsigned char c = (unsigned char) ch;
+        if (std::isalnum(c) || c == '\'' || c >= 0x80) {
+            cur.push_back((char) std::tolower(c));
+        } else if (!cur.empty()) {
+            words.push_back(cur);
+            cur.clear();
+        }
+    }
+    if (!cur.empty()) {
+        words.push_back(cur);
+    }
+    return words;
+}
+
+word_error_counts & word_error_counts::operator+=(const word_error_counts & o) {
+    substitutions += o.substitutions;
+    deletions += o.deletions;
+    insertions += o.insertions;
+    ref_words += o.ref_words;
+    return *this;
+}
+
+word_error_counts corpus_word_errors(const std::string & reference, const std::string & hypothesis) {
+    const std::vector<std::string> r = corpus_words(reference);
+    const std::vector<std::string> h = corpus_words(hypothesis);
+    // Edit distance over words, keeping the operation counts of one cheapest alignment.
+    struct cell {
+        size_t cost;
+        size_t sub;
+        size_t del;
+        size_t ins;
+    };
+    std::vector<cell> prev(h.size() + 1);
+    std::vector<cell> cur(h.size() + 1);
+    for (size_t j = 0; j <= h.size(); ++j) {
+        prev[j] = { j, 0, 0, j };
+    }
+    for (size_t i = 1; i <= r.size(); ++i) {
+        cur[0] = { i, 0, i, 0 };
+        for (size_t j = 1; j <= h.size(); ++j) {
+            cell best = prev[j - 1];
+            if (r[i - 1] != h[j - 1]) {
+                best.cost++;
+                best.sub++;
+            }
+            if (prev[j].cost + 1 < best.cost) {
+                best = prev[j];
+                best.cost++;
+                best.del++;
+            }
+            if (cur[j - 1].cost + 1 < best.cost) {
+                best = cur[j - 1];
+                best.cost++;
+                best.ins++;
+            }
+            cur[j] = best;
+        }
+        std::swap(prev, cur);
+    }
+    word_error_counts out;
+    out.substitutions = prev[h.size()].sub;
+    out.deletions = prev[h.size()].del;
+    out.insertions = prev[h.size()].ins;
+    out.ref_words = r.size();
+    return out;
+}
+
+double corpus_quantile(std::vector<double> v, double q) {
+    if (v.empty()) {
+        return 0.0;
+    }
+    const size_t k = (size_t) std::lround(std::min(1.0, std::max(0.0, q)) * (double) (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + (std::ptrdiff_t) k, v.end());
+    return v[k];
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Labeled recordings for the offline test modes: a directory or a manifest of audio files, each with an optional
+// reference transcript next to it (clip.wav -> clip.txt).
+
+// The .wav/.mp3/.flac/.ogg files under a directory (recursive, sorted), or the paths a manifest lists
+// (one per line, relative ones from the manifest's directory; '#' starts a comment). False when unreadable.
+bool corpus_list(const std::string & src, std::vector<std::string> & files);
+
+// Reference transcript of a recording: the whole sidecar .txt. False when there is none.
+bool corpus_reference(const std::string & audio_path, std::string & text);
+
+// Words for scoring: ASCII lowercased, punctuation dropped (apostrophes kept), non-ASCII bytes kept as letters.
+std::vector<std::string> corpus_words(const std::string & text);
+
+struct word_error_counts {
+    size_t substitutions = 0;
+    size_t deletions = 0;
+    size_t insertions = 0;
+    size_t ref_words = 0;
+
+    size_t errors() const { return substitutions + deletions + insertions; }
+    double rate() const { return ref_words > 0 ? (double) errors() / (double) ref_words : (errors() > 0 ? 1.0 : 0.0); }
+    word_error_counts & operator+=(const word_error_counts & o);
+};
+
+// Word-level edit distance of a hypothesis against a reference (the WER numerator and denominator).
+word_error_counts corpus_word_errors(const std::string & reference, const std::string & hypothesis);
+
+// Value at quantile q in [0, 1] of unsorted samples (0 when empty).
+double corpus_quantile(std::vector<double> v, double q);
@@ -0,0 +1,85 @@
+#include "cpu_affinity.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#if defined(_WIN32)
+#    include <windows.h>
+#elif defined(__linux__)
+#    include <pthread.h>
+#    include <sched.h>
+#    include <sys/resource.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+bool parse_cpu_list(const std::string & s, std::vector<int> & cpus) {
+    cpus.clear();
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        const size_t comma = std::min(s.find(',', pos), s.size());
+        const std::string item = s.substr(pos, comma - pos);
+        int lo = 0;
+        int hi = 0;
+        char tail = 0;
+        if (std::sscanf(item.c_str(), "%d-%d%c", &lo, &hi, &tail) == 2) {
+            if (lo < 0 || hi < lo || hi > 1023) {
+                return false;
+            }
+        } else if (std::sscanf(item.c_str(), "%d%c", &lo, &tail) == 1 && lo >= 0 && lo <= 1023) {
+            hi = lo;
+        } else {
+            return false;
+        }
+        for (int c = lo; c <= hi; ++c) {
+            cpus.push_back(c);
+        }
+        pos = comma + 1;
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return !cpus.empty();
+}
+
+bool pin_current_thread(const std::vector<int> & cpus) {
+    if (cpus.empty()) {
+        return false;
+    }
+#if defined(_WIN32)
+    // One processor group (64 logical CPUs) is all SetThreadAffinityMask reaches.
+    DWORD_PTR mask = 0;
+    for (const int c : cpus) {
+        if (c < (int) (8 * sizeof(DWORD_PTR))) {
+            mask |= (DWORD_PTR) 1 << c;
+        }
+    }
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int c : cpus) {
+        if (c < CPU_SETSIZE) {
+            CPU_SET(c, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+bool set_current_thread_priority(thread_priority p) {
+#if defined(_WIN32)
+    const int prio = p == thread_priority::high ? THREAD_PRIORITY_ABOVE_NORMAL
+                   : p == thread_priority::low  ? THREAD_PRIORITY_BELOW_NORMAL
+                                                : THREAD_PRIORITY_NORMAL;
+    return SetThreadPriority(GetCurrentThread(), prio) != 0;
+#elif defined(__linux__)
+    // Linux keeps a nice value per thread.
+    const int nice = p == thread_priority::high ? -5 : p == thread_priority::low ? 5 : 0;
+    return setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), nice) == 0;
+#else
+    (void) p;
+    return false;
+#endif
+}
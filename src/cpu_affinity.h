@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Pinning and priority of the pipeline's own threads (--cpu-budget, --affinity-*).
+
+enum class thread_priority {
+    low,
+    normal,
+    high,
+};
+
+// "0-3,6,8-9" -> 0 1 2 3 6 8 9 (sorted, no duplicates). False on a malformed list.
+bool parse_cpu_list(const std::string & s, std::vector<int> & cpus);
+
+// Pins the calling thread to `cpus`. On Linux the threads it starts afterwards (ggml's compute threads, SDL's audio
+// thread) inherit the mask; on Windows only the calling thread is pinned. False when the OS refuses or has no API.
+bool pin_current_thread(const std::vector<int> & cpus);
+
+// Scheduling priority of the calling thread. Raising it needs CAP_SYS_NICE (or an RLIMIT_NICE allowance) on Linux.
+bool set_current_thread_priority(thread_priority p);
@@ -0,0 +1,106 @@
+#include "cpu_time.h"
+
+#include <chrono>
+
+#if defined(_WIN32)
+#    include <windows.h>
+#    include <psapi.h>
+#else
+#    include <sys/resource.h>
+#    include <time.h>
+#    include <unistd.h>
+#    include <cstdio>
+#endif
+
+#if defined(_WIN32)
+static double filetime_seconds(const FILETIME & ft) {
+    ULARGE_INTEGER v;
+    v.LowPart = ft.dwLowDateTime;
+    v.HighPart = ft.dwHighDateTime;
+    return (double) v.QuadPart * 1e-7; // 100ns units
+}
+#endif
+
+double process_cpu_seconds() {
+#if defined(_WIN32)
+    FILETIME t_create, t_exit, t_kernel, t_user;
+    if (!GetProcessTimes(GetCurrentProcess(), &t_create, &t_exit, &t_kernel, &t_user)) {
+        return 0.0;
+    }
+    return filetime_seconds(t_kernel) + filetime_seconds(t_user);
+#else
+    rusage ru{};
+    if (getrusage(RUSAGE_SELF, &ru) != 0) {
+        return 0.0;
+    }
+    return (double) ru.ru_utime.tv_sec + 1e-6 * (double) ru.ru_utime.tv_usec +
+           (double) ru.ru_stime.tv_sec + 1e-6 * (double) ru.ru_stime.tv_usec;
+#endif
+}
+
+double thread_cpu_seconds() {
+#if defined(_WIN32)
+    FILETIME t_create, t_exit, t_kernel, t_user;
+    if (!GetThreadTimes(GetCurrentThread(), &t_create, &t_exit, &t_kernel, &t_user)) {
+        return 0.0;
+    }
+    return filetime_seconds(t_kernel) + filetime_seconds(t_user);
+#else
+    timespec ts{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0.0;
+    }
+    return (double) ts.tv_sec + 1e-9 * (double) ts.tv_nsec;
+#endif
+}
+
+size_t process_rss_bytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return 0;
+    }
+    return (size_t) pmc.WorkingSetSize;
+#elif defined(__linux__)
+    // statm: total and resident pages.
+    FILE * f = std::fopen("/proc/self/statm", "r");
+    if (!f) {
+        return 0;
+    }
+    unsigned long long total = 0;
+    unsigned long long resident = 0;
+    const int n = std::fscanf(f, "%llu %llu", &total, &resident);
+    std::fclose(f);
+    return n == 2 ? (size_t) (resident * (unsigned long long) sysconf(_SC_PAGESIZE)) : 0;
+#else
+    // No current figure elsewhere: the peak so far (bytes on macOS, KiB on the BSDs).
+    rusage ru{};
+    if (getrusage(RUSAGE_SELF, &ru) != 0) {
+        return 0;
+    }
+#    if defined(__APPLE__)
+    return (size_t) ru.ru_maxrss;
+#    else
+    return (size_t) ru.ru_maxrss * 1024;
+#    endif
+#endif
+}
+
+static double wall_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+cpu_phase_meter::cpu_phase_meter()
+    : m_cpu_last(process_cpu_seconds())
+    , m_wall_last(wall_seconds()) {
+}
+
+void cpu_phase_meter::mark(bool active) {
+    const double cpu = process_cpu_seconds();
+    const double wall = wall_seconds();
+    phase & p = active ? m_active : m_idle;
+    p.cpu_s += cpu - m_cpu_last;
+    p.wall_s += wall - m_wall_last;
+    m_cpu_last = cpu;
+    m_wall_last = wall;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+// CPU time consumed so far, in seconds (user + kernel).
+double process_cpu_seconds();
+double thread_cpu_seconds();
+
+// Resident memory of the process right now, in bytes (0 when unknown).
+size_t process_rss_bytes();
+
+// Splits process CPU time and wall time between the idle and active phases of a loop.
+class cpu_phase_meter {
+public:
+    cpu_phase_meter();
+
+    // Attribute the time since the previous mark to the active or the idle phase.
+    void mark(bool active);
+
+    struct phase {
+        double cpu_s = 0.0;
+        double wall_s = 0.0;
+        // Average cores busy during the phase.
+        double load() const { return wall_s > 0.0 ? cpu_s / wall_s : 0.0; }
+    };
+    const phase & idle() const { return m_idle; }
+    const phase & active() const { return m_active; }
+
+private:
+    double m_cpu_last = 0.0;
+    double m_wall_last = 0.0;
+    phase m_idle;
+    phase m_active;
+};
@@ -0,0 +1,189 @@
+#include "crypto_util.h"
+
+#include <cstdint>
+#include <cstring>
+
+static inline uint32_t rotl32(const uint32_t x, const int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t rotr32(const uint32_t x, const int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t load_be32(const unsigned char * p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+static inline void store_be32(unsigned char * p, const uint32_t v) {
+    p[0] = (unsigned char) (v >> 24);
+    p[1] = (unsigned char) (v >> 16);
+    p[2] = (unsigned char) (v >> 8);
+    p[3] = (unsigned char) v;
+}
+
+// Both SHA-1 and SHA-256 use the same Merkle-Damgard padding: 0x80, zeros, 64-bit big-endian bit length.
+static std::string md_pad(const std::string & data) {
+    std::string msg = data;
+    const uint64_t bit_len = (uint64_t) data.size() * 8u;
+    msg.push_back((char) 0x80);
+    while (msg.size() % 64 != 56) {
+        msg.push_back('\0');
+    }
+    for (int i = 7; i >= 0; --i) {
+        msg.push_back((char) ((bit_len >> (i * 8)) & 0xff));
+    }
+    return msg;
+}
+
+std::string crypto_sha1(const std::string & data) {
+    uint32_t h[5] = { 0x67452301u, 0xefcdab89u, 0x98badcfeu, 0x10325476u, 0xc3d2e1f0u };
+
+    const std::string msg = md_pad(data);
+    const unsigned char * p = (const unsigned char *) msg.data();
+
+    for (size_t off = 0; off < msg.size(); off += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = load_be32(p + off + 4 * i);
+        }
+        for (int i = 16; i < 80; ++i) {
+            w[i] = rotl32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f;
+            uint32_t k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999u;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1u;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdcu;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6u;
+            }
+            const uint32_t t = rotl32(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl32(b, 30);
+            b = a;
+            a = t;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    std::string out(20, '\0');
+    for (int i = 0; i < 5; ++i) {
+        store_be32((unsigned char *) &out[4 * i], h[i]);
+    }
+    return out;
+}
+
+std::string crypto_sha256(const std::string & data) {
+    static const uint32_t k[64] = {
+        0x428a2f98u, 0x71374491u, 0xb5c0fbcfu, 0xe9b5dba5u, 0x3956c25bu, 0x59f111f1u, 0x923f82a4u, 0xab1c5ed5u,
+        0xd807aa98u, 0x12835b01u, 0x243185beu, 0x550c7dc3u, 0x72be5d74u, 0x80deb1feu, 0x9bdc06a7u, 0xc19bf174u,
+        0xe49b69c1u, 0xefbe4786u, 0x0fc19dc6u, 0x240ca1ccu, 0x2de92c6fu, 0x4a7484aau, 0x5cb0a9dcu, 0x76f988dau,
+        0x983e5152u, 0xa831c66du, 0xb00327c8u, 0xbf597fc7u, 0xc6e00bf3u, 0xd5a79147u, 0x06ca6351u, 0x14292967u,
+        0x27b70a85u, 0x2e1b2138u, 0x4d2c6dfcu, 0x53380d13u, 0x650a7354u, 0x766a0abbu, 0x81c2c92eu, 0x92722c85u,
+        0xa2bfe8a1u, 0xa81a664bu, 0xc24b8b70u, 0xc76c51a3u, 0xd192e819u, 0xd6990624u, 0xf40e3585u, 0x106aa070u,
+        0x19a4c116u, 0x1e376c08u, 0x2748774cu, 0x34b0bcb5u, 0x391c0cb3u, 0x4ed8aa4au, 0x5b9cca4fu, 0x682e6ff3u,
+        0x748f82eeu, 0x78a5636fu, 0x84c87814u, 0x8cc70208u, 0x90befffau, 0xa4506cebu, 0xbef9a3f7u, 0xc67178f2u,
+    };
+
+    uint32_t h[8] = {
+        0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au, 0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u,
+    };
+
+    const std::string msg = md_pad(data);
+    const unsigned char * p = (const unsigned char *) msg.data();
+
+    for (size_t off = 0; off < msg.size(); off += 64) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = load_be32(p + off + 4 * i);
+        }
+        for (int i = 16; i < 64; ++i) {
+            const uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+        for (int i = 0; i < 64; ++i) {
+            const uint32_t s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+            const uint32_t ch = (e & f) ^ (~e & g);
+            const uint32_t t1 = hh + s1 + ch + k[i] + w[i];
+            const uint32_t s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+            const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            const uint32_t t2 = s0 + maj;
+            hh = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+        h[5] += f;
+        h[6] += g;
+        h[7] += hh;
+    }
+
+    std::string out(32, '\0');
+    for (int i = 0; i < 8; ++i) {
+        store_be32((unsigned char *) &out[4 * i], h[i]);
+    }
+    return out;
+}
+
+std::string crypto_base64_encode(const std::string & bytes) {
+    static const char k_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string out;
+    out.reserve(((bytes.size() + 2) / 3) * 4);
+
+    const unsigned char * p = (const unsigned char *) bytes.data();
+    size_t i = 0;
+    for (; i + 3 <= bytes.size(); i += 3) {
+        const uint32_t v = ((uint32_t) p[i] << 16) | ((uint32_t) p[i + 1] << 8) | (uint32_t) p[i + 2];
+        out.push_back(k_alphabet[(v >> 18) & 0x3f]);
+        out.push_back(k_alphabet[(v >> 12) & 0x3f]);
+        out.push_back(k_alphabet[(v >> 6) & 0x3f]);
+        out.push_back(k_alphabet[v & 0x3f]);
+    }
+
+    const size_t rem = bytes.size() - i;
+    if (rem == 1) {
+        const uint32_t v = (uint32_t) p[i] << 16;
+        out.push_back(k_alphabet[(v >> 18) & 0x3f]);
+        out.push_back(k_alphabet[(v >> 12) & 0x3f]);
+        out += "==";
+    } else if (rem == 2) {
+        const uint32_t v = ((uint32_t) p[i] << 16) | ((uint32_t) p[i + 1] << 8);
+        out.push_back(k_alphabet[(v >> 18) & 0x3f]);
+        out.push_back(k_alphabet[(v >> 12) & 0x3f]);
+        out.push_back(k_alphabet[(v >> 6) & 0x3f]);
+        out.push_back('=');
+    }
+
+    return out;
+}
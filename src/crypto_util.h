@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+// Small portable hashing/encoding helpers.
+// Used where no OS crypto API is available (POSIX WebSocket client, mock Streamer.bot server).
+// Digests are returned as raw bytes.
+
+std::string crypto_sha1(const std::string & data);
+std::string crypto_sha256(const std::string & data);
+std::string crypto_base64_encode(const std::string & bytes);
@@ -0,0 +1,56 @@
+#include "energy_gate.h"
+
+#include <algorithm>
+#include <cmath>
+
+float level_dbfs(float rms) {
+    return rms > 1e-5f ? 20.0f * std::log10(rms) : -100.0f;
+}
+
+energy_gate::energy_gate(const energy_gate_params & p)
+    : m_p(p) {
+    m_p.base_check_ms = std::max<int32_t>(1, m_p.base_check_ms);
+    m_p.idle_check_ms = std::max(m_p.base_check_ms, m_p.idle_check_ms);
+    m_interval_ms = m_p.base_check_ms;
+}
+
+bool energy_gate::is_quiet(float level_db) const {
+    if (!enabled() || !m_have_floor) {
+        return false;
+    }
+    return level_db <= m_floor_db + m_p.margin_db;
+}
+
+void energy_gate::on_check(int64_t t_ms, float level_db, bool active) {
+    m_counters.checks++;
+
+    const int64_t dt_ms = m_t_last_ms < 0 ? 0 : std::max<int64_t>(0, t_ms - m_t_last_ms);
+    m_t_last_ms = t_ms;
+
+    if (!active) {
+        // Min-follower: drop to quieter levels at once, rise slowly towards a louder background.
+        if (!m_have_floor || level_db < m_floor_db) {
+            m_floor_db = level_db;
+            m_have_floor = true;
+        } else {
+            m_floor_db = std::min(level_db, m_floor_db + m_p.floor_rise_db_per_s * (float) dt_ms / 1000.0f);
+        }
+        m_floor_db = std::min(m_floor_db, m_p.floor_ceiling_db);
+    }
+
+    if (active || !enabled()) {
+        m_t_last_active_ms = t_ms;
+        m_interval_ms = m_p.base_check_ms;
+    } else if (t_ms - m_t_last_active_ms >= m_p.idle_after_ms) {
+        m_interval_ms = std::min(m_p.idle_check_ms, std::max(m_interval_ms + 1, m_interval_ms * 3 / 2));
+    }
+}
+
+bool energy_gate::wake_on_rise(float level_db) {
+    if (!enabled() || !stretched() || is_quiet(level_db)) {
+        return false;
+    }
+    m_counters.wakeups++;
+    m_interval_ms = m_p.base_check_ms;
+    return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+struct energy_gate_params {
+    float margin_db = 6.0f;           // skip the neural VAD when the level is within this of the noise floor (<= 0 disables)
+    float floor_ceiling_db = -35.0f;  // the floor never adapts above this, so loud rooms always get the neural VAD
+    float floor_rise_db_per_s = 1.0f; // how fast the floor follows a louder background (it drops immediately)
+    int32_t base_check_ms = 150;      // normal check cadence (--vad-check-ms)
+    int32_t idle_check_ms = 1000;     // longest check interval while idle
+    int32_t idle_after_ms = 5000;     // quiet this long before the interval starts stretching
+};
+
+// Cheap noise-floor tracker in front of Silero, plus the adaptive check cadence.
+// Levels are RMS in dBFS of the newest audio.
+class energy_gate {
+public:
+    explicit energy_gate(const energy_gate_params & p);
+
+    bool enabled() const { return m_p.margin_db > 0.0f; }
+
+    // True when the level is close enough to the noise floor that the neural VAD can be skipped.
+    bool is_quiet(float level_db) const;
+
+    // Record the outcome of a check at `t_ms`: `active` = voice detected, or audio well above the floor.
+    // Non-speech levels also update the noise floor.
+    void on_check(int64_t t_ms, float level_db, bool active);
+
+    // Between checks: true (and back to the fast cadence) when the level rose above the floor while idle.
+    bool wake_on_rise(float level_db);
+
+    int32_t check_interval_ms() const { return m_interval_ms; }
+    bool stretched() const { return m_interval_ms > m_p.base_check_ms; }
+    float floor_db() const { return m_floor_db; }
+
+    struct counters {
+        uint64_t checks = 0;
+        uint64_t skipped = 0; // checks answered by the energy gate alone
+        uint64_t wakeups = 0;
+    };
+    const counters & stats() const { return m_counters; }
+    void count_skip() { m_counters.skipped++; }
+
+private:
+    energy_gate_params m_p;
+    bool m_have_floor = false;
+    float m_floor_db = -100.0f;
+    int64_t m_t_last_ms = -1;
+    int64_t m_t_last_active_ms = 0;
+    int32_t m_interval_ms = 0;
+    counters m_counters;
+};
+
+// RMS -> dBFS, floored at -100.
+float level_dbfs(float rms);
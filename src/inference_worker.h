@@ -0,0 +1,295 @@
+#pragma once
+
+#include "audio_stats.h"
+#include "log_mel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// One block for Whisper, cut by the pipeline thread.
+struct inference_job {
+    uint64_t id = 0;          // assigned by submit()
+    audio_view view;          // samples, read in place from the capture ring
+    audio_stats stats;        // of `view`
+    audio_stats window_stats; // of the VAD window at cut time (diagnostics)
+    int64_t voiced_ms = -1;   // speech in the block per the voice gate (-1 = unknown: the whole block)
+    uint64_t utterance = 0;   // voice-gate utterance the block belongs to (0 = simple VAD)
+    bool chunk = false;       // the utterance goes on: its next block gets this one's text as context
+    bool probe = false;       // provisional decode: emit only if the text ends a sentence
+    bool speculative = false; // decode ahead of the endpoint and hold the result instead of emitting it
+    uint64_t reuse = 0;       // id of a speculative job over the same samples whose held result can stand in for decoding
+    std::shared_ptr<const log_mel_frames> mel; // log-mel frames computed during speech (null = whisper computes the mel)
+};
+
+enum class inference_outcome {
+    pending,   // queued or running
+    emitted,   // text was printed / sent
+    filtered,  // decoded but filtered out (empty, garbage, duplicate)
+    rejected,  // probe whose text does not end a sentence
+    held,      // speculative: decoded, waiting for a job that reuses it
+    aborted,   // cancelled while running
+    dropped,   // never decoded (cancelled while queued, stale audio, queue full)
+    failed,    // whisper_full() error
+    timed_out, // compute deadline passed (on the fallback decode too, if there was one)
+};
+
+struct inference_worker_stats {
+    uint64_t jobs = 0;
+    uint64_t emitted = 0;
+    uint64_t aborted = 0;
+    uint64_t dropped = 0;
+    size_t max_queue = 0;
+    uint64_t batches = 0;      // runs of run_batch
+    uint64_t batched_jobs = 0; // jobs those runs decoded together
+};
+
+// Runs Whisper jobs in submission order on its own thread, so the voice gate keeps running during inference.
+// `run` decodes one job and must poll `abort` (whisper's abort_callback) to make cancel() effective.
+class inference_worker {
+public:
+    using run_fn = std::function<inference_outcome(const inference_job &, const std::atomic<bool> & abort)>;
+    // Decodes several queued jobs in one pass; returns one outcome per job, in order.
+    using run_batch_fn = std::function<std::vector<inference_outcome>(const std::vector<inference_job> &, const std::atomic<bool> & abort)>;
+    using batchable_fn = std::function<bool(const inference_job &)>;
+    // Runs once on the worker thread before the first job (pinning, priority).
+    using start_fn = std::function<void()>;
+    // Runs on the worker thread while the queue is empty (housekeeping that must not race a decode).
+    using idle_fn = std::function<void()>;
+
+    explicit inference_worker(run_fn run, size_t max_queue = 8, start_fn on_start = {})
+        : m_run(std::move(run))
+        , m_on_start(std::move(on_start))
+        , m_max_queue(std::max<size_t>(1, max_queue))
+        , m_thread([this]() { this->loop(); }) {
+    }
+
+    ~inference_worker() {
+        stop_and_join(/*drain*/false);
+    }
+
+    inference_worker(const inference_worker &) = delete;
+    inference_worker & operator=(const inference_worker &) = delete;
+
+    // Under backlog, hand up to `max_jobs` consecutive queued jobs that `batchable` accepts (and `max_samples` of
+    // audio in total) to `run_batch` instead of running them one by one. Call before the first submit().
+    void set_batching(size_t max_jobs, size_t max_samples, batchable_fn batchable, run_batch_fn run_batch) {
+        std::lock_guard<std::mutex> lock(m_mu);
+        m_batch_max = max_jobs;
+        m_batch_max_samples = max_samples;
+        m_batchable = std::move(batchable);
+        m_run_batch = std::move(run_batch);
+    }
+
+    // Call `idle` every `period` the worker spends waiting for a job.
+    void set_idle(std::chrono::milliseconds period, idle_fn idle) {
+        {
+            std::lock_guard<std::mutex> lock(m_mu);
+            m_idle_period = period;
+            m_idle = std::move(idle);
+        }
+        m_cv.notify_one();
+    }
+
+    // Returns the job id (0 when the queue is full and the job was dropped).
+    uint64_t submit(inference_job job) {
+        uint64_t id = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mu);
+            id = ++m_next_id;
+            job.id = id;
+            if (m_stop || m_q.size() >= m_max_queue) {
+                m_stats.dropped++;
+                record_locked(id, inference_outcome::dropped);
+                return 0;
+            }
+            m_q.push_back(std::move(job));
+            m_stats.max_queue = std::max(m_stats.max_queue, m_q.size());
+            record_locked(id, inference_outcome::pending);
+        }
+        m_cv.notify_one();
+        return id;
+    }
+
+    // Drops a queued job or aborts it while it runs (with the rest of its batch). No-op once it finished.
+    void cancel(uint64_t id) {
+        std::lock_guard<std::mutex> lock(m_mu);
+        for (auto it = m_q.begin(); it != m_q.end(); ++it) {
+            if (it->id == id) {
+                m_q.erase(it);
+                m_stats.dropped++;
+                record_locked(id, inference_outcome::dropped);
+                return;
+            }
+        }
+        if (std::find(m_running.begin(), m_running.end(), id) != m_running.end()) {
+            m_abort = true;
+        }
+    }
+
+    inference_outcome outcome(uint64_t id) const {
+        std::lock_guard<std::mutex> lock(m_mu);
+        for (const auto & r : m_recent) {
+            if (r.first == id) {
+                return r.second;
+            }
+        }
+        return inference_outcome::dropped;
+    }
+
+    // True while a job is queued or running.
+    bool busy() const {
+        std::lock_guard<std::mutex> lock(m_mu);
+        return !m_running.empty() || !m_q.empty();
+    }
+
+    // Jobs waiting behind the running one.
+    size_t queued() const {
+        std::lock_guard<std::mutex> lock(m_mu);
+        return m_q.size();
+    }
+
+    void stop_and_join(bool drain) {
+        {
+            std::lock_guard<std::mutex> lock(m_mu);
+            if (m_stopped) {
+                return;
+            }
+            m_stop = true;
+            if (!drain) {
+                m_stats.dropped += m_q.size();
+                m_q.clear();
+                if (!m_running.empty()) {
+                    m_abort = true;
+                }
+            }
+        }
+        m_cv.notify_one();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        std::lock_guard<std::mutex> lock(m_mu);
+        m_stopped = true;
+    }
+
+    inference_worker_stats stats() const {
+        std::lock_guard<std::mutex> lock(m_mu);
+        return m_stats;
+    }
+
+private:
+    // Outcomes of the most recent jobs, for outcome().
+    static constexpr size_t k_recent = 64;
+
+    void record_locked(uint64_t id, inference_outcome o) {
+        for (auto & r : m_recent) {
+            if (r.first == id) {
+                r.second = o;
+                return;
+            }
+        }
+        m_recent.emplace_back(id, o);
+        if (m_recent.size() > k_recent) {
+            m_recent.pop_front();
+        }
+    }
+
+    void loop() {
+        if (m_on_start) {
+            m_on_start();
+        }
+        while (true) {
+            std::vector<inference_job> jobs;
+            {
+                std::unique_lock<std::mutex> lock(m_mu);
+                while (!m_stop && m_q.empty()) {
+                    if (!m_idle) {
+                        m_cv.wait(lock);
+                    } else if (m_cv.wait_for(lock, m_idle_period) == std::cv_status::timeout && !m_stop && m_q.empty()) {
+                        const idle_fn idle = m_idle;
+                        lock.unlock();
+                        idle();
+                        lock.lock();
+                    }
+                }
+                if (m_q.empty()) {
+                    break;
+                }
+                jobs.push_back(std::move(m_q.front()));
+                m_q.pop_front();
+                // A backlog of short jobs: take the ones right behind this one along.
+                if (m_batch_max > 1 && m_run_batch && m_batchable(jobs.front())) {
+                    size_t n_samples = jobs.front().view.size();
+                    while (!m_q.empty() && jobs.size() < m_batch_max && m_batchable(m_q.front()) &&
+                           n_samples + m_q.front().view.size() <= m_batch_max_samples) {
+                        n_samples += m_q.front().view.size();
+                        jobs.push_back(std::move(m_q.front()));
+                        m_q.pop_front();
+                    }
+                }
+                m_running.clear();
+                for (const auto & j : jobs) {
+                    m_running.push_back(j.id);
+                }
+                m_abort = false;
+            }
+
+            std::vector<inference_outcome> outcomes;
+            if (jobs.size() == 1) {
+                outcomes.push_back(m_run(jobs.front(), m_abort));
+            } else {
+                outcomes = m_run_batch(jobs, m_abort);
+                outcomes.resize(jobs.size(), inference_outcome::failed);
+            }
+
+            std::lock_guard<std::mutex> lock(m_mu);
+            m_running.clear();
+            if (jobs.size() > 1) {
+                m_stats.batches++;
+                m_stats.batched_jobs += jobs.size();
+            }
+            for (size_t i = 0; i < jobs.size(); ++i) {
+                inference_outcome o = outcomes[i];
+                if (m_abort && o != inference_outcome::emitted) {
+                    o = inference_outcome::aborted;
+                }
+                m_stats.jobs++;
+                if (o == inference_outcome::emitted) m_stats.emitted++;
+                if (o == inference_outcome::aborted) m_stats.aborted++;
+                if (o == inference_outcome::dropped) m_stats.dropped++;
+                record_locked(jobs[i].id, o);
+            }
+        }
+    }
+
+    run_fn m_run;
+    start_fn m_on_start;
+    size_t m_max_queue = 8;
+    size_t m_batch_max = 0;
+    size_t m_batch_max_samples = 0;
+    batchable_fn m_batchable;
+    run_batch_fn m_run_batch;
+    std::chrono::milliseconds m_idle_period{ 1000 };
+    idle_fn m_idle;
+
+    mutable std::mutex m_mu;
+    std::condition_variable m_cv;
+    std::deque<inference_job> m_q;
+    std::deque<std::pair<uint64_t, inference_outcome>> m_recent;
+    uint64_t m_next_id = 0;
+    std::vector<uint64_t> m_running; // ids of the job (or batch) being decoded
+    std::atomic<bool> m_abort{ false };
+    inference_worker_stats m_stats;
+    bool m_stop = false;
+    bool m_stopped = false;
+    std::thread m_thread;
+};
@@ -0,0 +1,266 @@
+#include "log_mel.h"
+
+#include "cpu_time.h"
+
+#include <algorithm>
+#include <cmath>
+
+static constexpr double k_pi = 3.14159265358979323846;
+
+// Slaney mel scale (librosa's default): linear below 1 kHz, logarithmic above.
+static double hz_to_mel(double hz) {
+    const double f_sp = 200.0 / 3.0;
+    const double logstep = std::log(6.4) / 27.0;
+    return hz < 1000.0 ? hz / f_sp : 1000.0 / f_sp + std::log(hz / 1000.0) / logstep;
+}
+
+static double mel_to_hz(double mel) {
+    const double f_sp = 200.0 / 3.0;
+    const double logstep = std::log(6.4) / 27.0;
+    const double min_log_mel = 1000.0 / f_sp;
+    return mel < min_log_mel ? f_sp * mel : 1000.0 * std::exp(logstep * (mel - min_log_mel));
+}
+
+log_mel::log_mel(int n_mel, int sample_rate)
+    : m_n_mel(std::max(1, n_mel)) {
+    m_hann.resize(k_n_fft);
+    m_cos.resize(k_n_fft);
+    m_sin.resize(k_n_fft);
+    for (int i = 0; i < k_n_fft; ++i) {
+        const double theta = 2.0 * k_pi * (double) i / (double) k_n_fft;
+        m_hann[i] = (float) (0.5 * (1.0 - std::cos(theta))); // periodic
+        m_cos[i] = (float) std::cos(theta);
+        m_sin[i] = (float) std::sin(theta);
+    }
+
+    // librosa.filters.mel(sr, n_fft, n_mels): triangles on the mel scale from 0 Hz to Nyquist, area-normalized.
+    std::vector<double> mel_f((size_t) m_n_mel + 2);
+    const double mel_max = hz_to_mel(0.5 * (double) sample_rate);
+    for (size_t i = 0; i < mel_f.size(); ++i) {
+        mel_f[i] = mel_to_hz(mel_max * (double) i / (double) (mel_f.size() - 1));
+    }
+    m_band_lo.resize((size_t) m_n_mel);
+    m_band_w.resize((size_t) m_n_mel);
+    for (int j = 0; j < m_n_mel; ++j) {
+        const double enorm = 2.0 / (mel_f[j + 2] - mel_f[j]);
+        int lo = -1;
+        std::vector<float> w;
+        for (int k = 0; k < k_n_bins; ++k) {
+            const double f = (double) k * (double) sample_rate / (double) k_n_fft;
+            const double lower = (f - mel_f[j]) / (mel_f[j + 1] - mel_f[j]);
+            const double upper = (mel_f[j + 2] - f) / (mel_f[j + 2] - mel_f[j + 1]);
+            const double v = std::max(0.0, std::min(lower, upper)) * enorm;
+            if (v > 0.0) {
+                if (lo < 0) lo = k;
+                w.resize((size_t) (k - lo + 1), 0.0f);
+                w.back() = (float) v;
+            }
+        }
+        m_band_lo[j] = std::max(0, lo);
+        m_band_w[j] = std::move(w);
+    }
+}
+
+// Plain DFT for the odd-length leaves of fft(); `out` holds interleaved re/im.
+void log_mel::dft(const float * in, int n, float * out) const {
+    const int step = k_n_fft / n;
+    for (int k = 0; k < n; ++k) {
+        float re = 0.0f;
+        float im = 0.0f;
+        // Twiddle index k * t * step, modulo the table size.
+        const int inc = k * step;
+        int idx = 0;
+        for (int t = 0; t < n; ++t) {
+            re += in[t] * m_cos[idx];
+            im -= in[t] * m_sin[idx];
+            idx += inc;
+            if (idx >= k_n_fft) idx -= k_n_fft;
+        }
+        out[2 * k + 0] = re;
+        out[2 * k + 1] = im;
+    }
+}
+
+// Radix-2 split down to odd lengths (400 -> 200 -> 100 -> 50 -> 25), as in whisper.cpp. `tmp` needs 6 * n floats.
+void log_mel::fft(const float * in, int n, float * out, float * tmp) const {
+    if (n % 2 == 1) {
+        dft(in, n, out);
+        return;
+    }
+    const int half = n / 2;
+    float * even = tmp;
+    float * odd = tmp + half;
+    for (int i = 0; i < half; ++i) {
+        even[i] = in[2 * i + 0];
+        odd[i] = in[2 * i + 1];
+    }
+    float * even_fft = tmp + n;
+    float * odd_fft = tmp + 2 * n;
+    fft(even, half, even_fft, tmp + 3 * n);
+    fft(odd, half, odd_fft, tmp + 3 * n);
+
+    const int step = k_n_fft / n;
+    for (int k = 0; k < half; ++k) {
+        const float c = m_cos[k * step];
+        const float s = m_sin[k * step];
+        const float re_o = odd_fft[2 * k + 0];
+        const float im_o = odd_fft[2 * k + 1];
+        // odd * e^(-2 pi i k / n)
+        const float tr = c * re_o + s * im_o;
+        const float ti = c * im_o - s * re_o;
+        out[2 * k + 0] = even_fft[2 * k + 0] + tr;
+        out[2 * k + 1] = even_fft[2 * k + 1] + ti;
+        out[2 * (k + half) + 0] = even_fft[2 * k + 0] - tr;
+        out[2 * (k + half) + 1] = even_fft[2 * k + 1] - ti;
+    }
+}
+
+void log_mel::frame(const float * x, scratch & s, float * out) const {
+    s.window.resize(k_n_fft);
+    s.fft.resize(2 * k_n_fft + 6 * k_n_fft);
+    s.power.resize(k_n_bins);
+    for (int i = 0; i < k_n_fft; ++i) {
+        s.window[i] = m_hann[i] * x[i];
+    }
+    float * spec = s.fft.data();
+    fft(s.window.data(), k_n_fft, spec, spec + 2 * k_n_fft);
+    for (int k = 0; k < k_n_bins; ++k) {
+        s.power[k] = spec[2 * k] * spec[2 * k] + spec[2 * k + 1] * spec[2 * k + 1];
+    }
+    for (int j = 0; j < m_n_mel; ++j) {
+        const std::vector<float> & w = m_band_w[j];
+        const float * p = s.power.data() + m_band_lo[j];
+        double sum = 0.0;
+        for (size_t k = 0; k < w.size(); ++k) {
+            sum += (double) p[k] * (double) w[k];
+        }
+        out[j] = (float) std::log10(std::max(sum, 1e-10));
+    }
+}
+
+int log_mel::build(const audio_view & v, const log_mel_frames * pre, std::vector<float> & out, int & n_len_org,
+                   log_mel_build_stats * stats) const {
+    const int64_t n = (int64_t) v.size();
+    const int half = k_n_fft / 2;
+    // Same lengths as whisper's log_mel_spectrogram(): 30s of zeros after the samples, 200 reflected before. Whisper
+    // computes the frames up to `half` samples past the end (its zero padding is in their windows); the rest are
+    // silence.
+    const int n_len = (int) ((n + (int64_t) k_pad_frames * k_hop) / k_hop);
+    const int n_comp = (int) std::min<int64_t>((n + half) / k_hop + 1, n_len);
+    n_len_org = (int) std::max<int64_t>(1, 1 + (n + half - k_n_fft) / k_hop);
+
+    const bool use_pre = pre && pre->n_mel == m_n_mel && pre->size() > 0 && v.seq % k_hop == pre->seq0 % k_hop;
+
+    std::vector<float> raw((size_t) n_comp * (size_t) m_n_mel);
+    scratch s;
+    std::vector<float> x(k_n_fft);
+    for (int i = 0; i < n_comp; ++i) {
+        const int64_t c = (int64_t) i * k_hop;
+        float * dst = raw.data() + (size_t) i * (size_t) m_n_mel;
+        if (use_pre && c >= half && c + half <= n) {
+            const uint64_t abs_c = v.seq + (uint64_t) c;
+            if (abs_c >= pre->seq0) {
+                const size_t k = (size_t) ((abs_c - pre->seq0) / k_hop);
+                if (k < pre->size()) {
+                    std::copy_n(pre->data.data() + k * (size_t) m_n_mel, m_n_mel, dst);
+                    if (stats) stats->reused++;
+                    continue;
+                }
+            }
+        }
+        for (int t = 0; t < k_n_fft; ++t) {
+            const int64_t j = c - half + t;
+            const int64_t r = j < 0 ? -j : j; // reflect at the start
+            x[t] = r < n ? v[(size_t) r] : 0.0f;
+        }
+        frame(x.data(), s, dst);
+        if (stats) stats->computed++;
+    }
+
+    // Padding frames are all-zero windows: log10(1e-10).
+    double mmax = n_comp < n_len ? -10.0 : -1e20;
+    for (float r : raw) {
+        mmax = std::max(mmax, (double) r);
+    }
+    mmax -= 8.0;
+
+    out.resize((size_t) n_len * (size_t) m_n_mel);
+    const float pad = (float) ((std::max(-10.0, mmax) + 4.0) / 4.0);
+    for (int j = 0; j < m_n_mel; ++j) {
+        float * row = out.data() + (size_t) j * (size_t) n_len;
+        for (int i = 0; i < n_comp; ++i) {
+            const double r = std::max((double) raw[(size_t) i * (size_t) m_n_mel + (size_t) j], mmax);
+            row[i] = (float) ((r + 4.0) / 4.0);
+        }
+        std::fill(row + n_comp, row + n_len, pad);
+    }
+    return n_len;
+}
+
+log_mel_stream::log_mel_stream(std::shared_ptr<const log_mel> mel, size_t max_frames)
+    : m_mel(std::move(mel))
+    , m_max_frames(std::max<size_t>(1, max_frames)) {
+}
+
+void log_mel_stream::restart(uint64_t seq) {
+    const uint64_t first = seq + log_mel::k_n_fft / 2;
+    m_next_center = (first + log_mel::k_hop - 1) / log_mel::k_hop * log_mel::k_hop;
+    m_seq0 = m_next_center;
+    m_data.clear();
+}
+
+void log_mel_stream::feed(const audio_view & v) {
+    if (v.empty()) {
+        return;
+    }
+    if (v.seq > needed_from()) {
+        restart(v.seq);
+    }
+    const int n_mel = m_mel->n_mel();
+    const uint64_t end = v.seq + v.size();
+    const double t0 = thread_cpu_seconds();
+    m_pcm.resize(log_mel::k_n_fft);
+    size_t n_new = 0;
+    while (m_next_center + log_mel::k_n_fft / 2 <= end) {
+        const audio_view w = v.sub((size_t) (needed_from() - v.seq), log_mel::k_n_fft);
+        std::copy_n(w.p0, w.n0, m_pcm.data());
+        std::copy_n(w.p1, w.n1, m_pcm.data() + w.n0);
+        m_data.resize(m_data.size() + (size_t) n_mel);
+        m_mel->frame(m_pcm.data(), m_scratch, m_data.data() + m_data.size() - (size_t) n_mel);
+        m_next_center += log_mel::k_hop;
+        ++n_new;
+    }
+    // Past the cap, drop the oldest quarter at once rather than shifting on every frame.
+    const size_t n_frames = m_data.size() / (size_t) n_mel;
+    if (n_frames > m_max_frames + m_max_frames / 4) {
+        const size_t drop = n_frames - m_max_frames;
+        m_data.erase(m_data.begin(), m_data.begin() + (std::ptrdiff_t) (drop * (size_t) n_mel));
+        m_seq0 += (uint64_t) drop * log_mel::k_hop;
+    }
+    m_frames_computed += n_new;
+    m_cpu_s += thread_cpu_seconds() - t0;
+}
+
+std::shared_ptr<const log_mel_frames> log_mel_stream::frames_for(const audio_view & v) const {
+    const int n_mel = m_mel->n_mel();
+    const uint64_t half = log_mel::k_n_fft / 2;
+    if (v.size() < log_mel::k_n_fft || v.seq % log_mel::k_hop != m_seq0 % log_mel::k_hop || m_data.empty()) {
+        return nullptr;
+    }
+    // Centers whose window is inside v, clamped to what is stored.
+    const uint64_t lo = std::max(m_seq0, v.seq + half);
+    const uint64_t hi = std::min(m_next_center, v.seq + v.size() - half + 1);
+    if (lo >= hi) {
+        return nullptr;
+    }
+    const size_t k0 = (size_t) ((lo - m_seq0 + log_mel::k_hop - 1) / log_mel::k_hop);
+    const size_t k1 = (size_t) ((hi - m_seq0 + log_mel::k_hop - 1) / log_mel::k_hop);
+    if (k0 >= k1) {
+        return nullptr;
+    }
+    auto f = std::make_shared<log_mel_frames>();
+    f->n_mel = n_mel;
+    f->seq0 = m_seq0 + (uint64_t) k0 * log_mel::k_hop;
+    f->data.assign(m_data.begin() + (std::ptrdiff_t) (k0 * (size_t) n_mel), m_data.begin() + (std::ptrdiff_t) (k1 * (size_t) n_mel));
+    return f;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "audio_view.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Raw log10 mel frames (before Whisper's clamp and normalization) of a stretch of the sample timeline.
+// Frame k is centered on absolute sample seq0 + k * log_mel::k_hop, and its whole window was real audio.
+struct log_mel_frames {
+    int n_mel = 0;
+    uint64_t seq0 = 0;
+    std::vector<float> data; // frame-major: n_mel values per frame
+
+    size_t size() const { return n_mel > 0 ? data.size() / (size_t) n_mel : 0; }
+};
+
+struct log_mel_build_stats {
+    size_t reused = 0;   // frames taken from log_mel_frames
+    size_t computed = 0; // frames computed by build() (block edges, and everything without frames)
+};
+
+// Whisper's log-mel front end: 25ms periodic-Hann frames every 10ms, a 400-point FFT, Slaney-style mel filters
+// (librosa's, as stored in the ggml model files), log10, then clamped to 8 below the block maximum and scaled.
+// The tables are immutable after construction, so one instance can serve several threads.
+class log_mel {
+public:
+    static constexpr int k_n_fft = 400;
+    static constexpr int k_hop = 160;
+    static constexpr int k_n_bins = k_n_fft / 2 + 1;
+    static constexpr int k_pad_frames = 3000; // whisper appends 30s of silence to every block
+
+    explicit log_mel(int n_mel = 80, int sample_rate = 16000);
+
+    int n_mel() const { return m_n_mel; }
+
+    // Per-thread buffers for frame().
+    struct scratch {
+        std::vector<float> window;
+        std::vector<float> fft;
+        std::vector<float> power;
+    };
+
+    // Raw log10 mel of the k_n_fft samples at `x` into `out` (n_mel values).
+    void frame(const float * x, scratch & s, float * out) const;
+
+    // The mel of the block `v` with whisper's framing, padding and normalization, in whisper_set_mel() layout (n_mel rows of n_len frames, 30s of padding
+    // included). Frames whose window lies inside `v` come from `pre` when it has them on the same grid; the rest,
+    // including the reflect-padded start and zero-padded end, are computed here. Returns n_len; `n_len_org` gets the
+    // frame count of the audio itself (whisper_full()'s seek end when it computes the mel).
+    int build(const audio_view & v, const log_mel_frames * pre, std::vector<float> & out, int & n_len_org,
+              log_mel_build_stats * stats = nullptr) const;
+
+private:
+    void fft(const float * in, int n, float * out, float * tmp) const;
+    void dft(const float * in, int n, float * out) const;
+
+    int m_n_mel = 80;
+    std::vector<float> m_hann;
+    std::vector<float> m_cos;
+    std::vector<float> m_sin;
+    // Mel filters, stored sparse: band j weighs bins [m_band_lo[j], m_band_lo[j] + m_band_w[j].size()).
+    std::vector<int> m_band_lo;
+    std::vector<std::vector<float>> m_band_w;
+};
+
+// Log-mel frames computed on the pipeline thread while an utterance is still being spoken, so a block's mel is
+// mostly ready when it is cut. Frames sit on a fixed grid (centers at multiples of log_mel::k_hop).
+class log_mel_stream {
+public:
+    log_mel_stream(std::shared_ptr<const log_mel> mel, size_t max_frames);
+
+    // Forget all frames; the next one is the first whose window starts at or after `seq`.
+    void restart(uint64_t seq);
+    // First sample the next frame needs: feed() views should start here.
+    uint64_t needed_from() const { return m_next_center - log_mel::k_n_fft / 2; }
+    // Computes every frame whose window is inside `v`. A view starting past needed_from() restarts the stream there.
+    void feed(const audio_view & v);
+
+    // Copy of the stored frames whose windows lie inside `v` (null when there are none, or `v` is off the grid).
+    std::shared_ptr<const log_mel_frames> frames_for(const audio_view & v) const;
+
+    uint64_t frames_computed() const { return m_frames_computed; }
+    double cpu_s() const { return m_cpu_s; }
+
+private:
+    std::shared_ptr<const log_mel> m_mel;
+    log_mel::scratch m_scratch;
+    std::vector<float> m_pcm;
+    size_t m_max_frames = 0;
+    uint64_t m_seq0 = 0;        // center of the first stored frame
+    uint64_t m_next_center = log_mel::k_n_fft / 2;
+    std::vector<float> m_data;  // frame-major
+    uint64_t m_frames_computed = 0;
+    double m_cpu_s = 0.0;
+};
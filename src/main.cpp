@@ -1,4 +1,21 @@
+#include "audio_stats.h"
+#include "autotune.h"
+#include "bench.h"
+#include "capture_source.h"
+#include "corpus.h"
+#include "cpu_affinity.h"
+#include "cpu_time.h"
+#include "energy_gate.h"
+#include "inference_worker.h"
+#include "log_mel.h"
+#include "model_file.h"
+#include "model_quantize.h"
+#include "model_router.h"
+#include "streamerbot_sender.h"
 #include "streamerbot_ws_client.h"
+#include "utterance_timeline.h"
+#include "vad_sweep.h"
+#include "voice_gate.h"
 
 #include "common-sdl.h"
 #include "common.h"
@@ -8,6 +25,7 @@
 #include "whisper.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cctype>
 #include <cstdint>
@@ -17,7 +35,10 @@
 #include <cstdlib>
 #include <cstring>
 #include <deque>
+#include <filesystem>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -29,20 +50,61 @@
 #    include <unistd.h>
 #endif
 
+// How a block is decoded.
+enum class decode_policy {
+    whisper,  // greedy, with whisper's own temperature fallback re-decoding weak segments
+    adaptive, // greedy without temperature fallback; beam search only when the greedy text looks weak and time allows
+    beam,     // always beam search
+};
+
 struct app_params {
     // whisper
     std::string model;
     // Default to English, with an automatic fallback to French if detection strongly suggests it.
     std::string language = "en";
     int32_t threads = std::max(1, (int32_t) std::thread::hardware_concurrency() - 1);
+    bool threads_explicit = false; // --threads given: --autotune keeps it
+    int32_t vad_threads = 0;       // Silero (0 = same as threads)
     bool translate = false;
     bool use_gpu = true;
     bool flash_attn = true;
+    model_load_options model_load;                 // --model-load read|mmap, --model-prefault, --model-huge-pages
+    std::string quantize;                          // q8_0|q5_1|q5_0|q4_1|q4_0: load a cached quantized copy of the model
+    std::vector<model_route> model_map;            // --model-map LANG=PATH,...: per-language models, loaded on first use
+    std::string lid_model;                         // multilingual model for the language-detect pass (default: --model)
+    int32_t model_idle_s = 300;                    // unload a --model-map model after this long unused (0 = never)
+    bool autotune = false;                         // fastest threads / backend options for this CPU and model (cached)
+    bool autotune_refresh = false;                 // time again even when cached
+    std::string autotune_cache = "models/autotune.txt";
+    // CPU budget for the pipeline's compute, split between Silero and Whisper, and per-stage pinning
+    int32_t cpu_budget = 0;           // 0 = no budget: --threads / --vad-threads as given
+    std::vector<int> affinity_gate;    // capture + voice gate thread (Silero's compute threads follow on Linux)
+    std::vector<int> affinity_whisper; // inference worker (whisper's compute threads follow on Linux)
 
     // speed/accuracy preset
     bool fast = false;
     int32_t max_tokens = 0;
 
+    // token budget per block
+    float tokens_per_second = 8.0f; // of voiced audio (0 = only --max-tokens)
+    bool loop_stop = true;          // end a segment once the decoder repeats an n-gram
+
+    // compute deadline per block
+    float decode_deadline_x = 1.0f;        // times the block duration (0 = no deadline)
+    int32_t decode_deadline_min_ms = 3000; // floor for short blocks
+    bool decode_fallback = true;           // on timeout: retry cheaper (true) or drop the block (false)
+    std::string fallback_model;            // optional smaller model for the retry
+
+    // decoding policy
+    decode_policy policy = decode_policy::adaptive;
+    int32_t beam_size = 5;
+    float beam_logprob_thold = -1.0f; // re-decode when the average token log-prob is below this
+    float beam_entropy_thold = 2.4f;  // ... or the entropy of the last 32 tokens is below this (repetitive text)
+
+    // micro-batching under backlog (voice gate only)
+    int32_t batch_max = 4;         // short queued utterances decoded in one pass (1 = off)
+    int32_t batch_short_ms = 3000; // longest utterance that joins a batch
+
     // VAD streaming
     int32_t length_ms = 30000;  // audio window captured on silence
     int32_t vad_check_ms = 2000;   // how often we evaluate VAD and decide to flush
@@ -55,6 +117,26 @@ struct app_params {
     bool list_devices = false;
     int32_t device_index = -1;
     std::string device_name_substring;
+    bool sdl_resampler = false; // let SDL convert to 16 kHz mono instead of capturing at the native rate
+
+    // headless audio input (instead of the SDL microphone)
+    std::string input_path;        // "-" = stdin, otherwise a file or named pipe
+    bool input_is_file = false;    // file: vs pipe:/stdin (controls the default pacing)
+    pcm_sample_format input_format = pcm_sample_format::s16;
+    int32_t input_realtime = -1;   // -1 = auto (on for files, off for stdin/pipes)
+
+    // benchmarks
+    bool bench_resampler = false;
+    bool bench_audio_stats = false;
+    bool bench_log_mel = false;
+    bool bench_voice_gate = false;
+    std::string replay_voice_gate; // recording to replay through the gate (parity + speed)
+    bool bench_models = false;
+    bool bench_model_load = false;
+    std::string models_dir = "models";
+    std::string bench_corpus;        // clips (directory or manifest), reference text in sidecar .txt files
+    std::vector<double> bench_threads; // empty = powers of two up to the core count
+    int32_t bench_target_ms = 2000;    // p90 decode latency per clip the recommendation must meet
 
     // streamer.bot
     streamerbot_ws_config bot;
@@ -71,10 +153,40 @@ struct app_params {
     bool trace_voice_gate = false;
     bool trace_voice_gate_status = false;
     std::string test_voice_gate_file;
+    std::string test_voice_gate_batch; // directory of recordings, or a manifest listing them
+    int32_t test_jobs = 0;             // files scanned at once (0 = one per core)
+    std::string record_voice_gate; // Silero probabilities + gate decisions of each check, for --replay-voice-gate
+    // --sweep: the gate over a grid of settings, from one Silero pass over a recording (empty list = current value)
+    std::string sweep_file;
+    std::string sweep_labels;
+    std::vector<double> sweep_stop_ms;
+    std::vector<double> sweep_min_voice_ms;
+    std::vector<double> sweep_thold;
+    std::vector<double> sweep_check_ms;
+    // --regress: a labeled corpus through the gate, the decoder and the filters, checked against a baseline
+    std::string regress_corpus;
+    std::string regress_baseline;
+    std::string regress_save_baseline;
     std::string vad_model;
     int32_t voice_stop_ms = 3000;
     int32_t min_voice_ms = 600;
     float vad_voice_threshold = 0.60f;
+
+    // end-of-utterance detection (voice gate only)
+    endpoint_mode endpoint = endpoint_mode::fixed;
+    int32_t endpoint_min_ms = 500; // adaptive: shortest silence that can end an utterance
+    bool endpoint_probe = false;   // adaptive: provisional decode, flush early on sentence-final punctuation
+    int32_t max_utterance_ms = 15000; // longer speech is transcribed in chunks cut at its pauses (0 = off)
+    bool speculative = false;          // start decoding after a short silence; use the result if the endpoint confirms
+    int32_t speculative_ms = 400;
+    bool incremental_mel = true;       // compute the log-mel spectrogram while speech goes on, not at flush time
+
+    // energy pre-gate / adaptive cadence (voice gate only)
+    float energy_gate_db = 6.0f;      // skip Silero when the level is within this of the noise floor (0 = off)
+    int32_t vad_check_idle_ms = 1000; // check interval reached after a while of dead air
+
+    // diagnostics
+    int32_t cpu_report_ms = 0; // periodic idle/active CPU report (0 = only at exit)
 };
 
 static void print_voice_gate_trace(FILE * f, const char * tag, const int64_t t_ms, const int64_t voice_ms, const int32_t block_ms) {
@@ -92,6 +204,65 @@ static int64_t ms_since(const std::chrono::high_resolution_clock::time_point & t
     return (int64_t) std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
 }
 
+// Silero over a window: its frame probabilities go to the voice gate (none when detection fails).
+static void vad_window_probs(whisper_vad_context * vctx, const float * pcm, const audio_view & window, voice_gate_check & c) {
+    c.seq = window.seq;
+    c.n_samples = window.size();
+    c.probs = nullptr;
+    c.n_probs = 0;
+    if (window.empty() || !whisper_vad_detect_speech(vctx, pcm, (int) window.size())) {
+        return;
+    }
+    c.probs = whisper_vad_probs(vctx);
+    c.n_probs = whisper_vad_n_probs(vctx);
+}
+
+static voice_gate_params make_voice_gate_params(const app_params & params) {
+    voice_gate_params vgp;
+    utterance_timeline_params & vtp = vgp.timeline;
+    vtp.sample_rate = WHISPER_SAMPLE_RATE;
+    vtp.voice_stop_ms = params.voice_stop_ms;
+    vtp.min_voice_ms = params.min_voice_ms;
+    vtp.max_block_ms = params.length_ms;
+    vtp.endpoint = params.endpoint;
+    vtp.endpoint_min_ms = params.endpoint_min_ms;
+    vtp.endpoint_probe = params.endpoint_probe;
+    vtp.max_utterance_ms = params.max_utterance_ms;
+    vtp.speculate_ms = params.speculative ? params.speculative_ms : 0;
+    // Filter out brief noise and glitches.
+    vgp.threshold = params.vad_voice_threshold;
+    vgp.min_speech_ms = 250;
+    vgp.min_silence_ms = 200;
+    vgp.max_speech_s = 30.0f;
+    vgp.speech_pad_ms = 100;
+    return vgp;
+}
+
+static void print_endpoint_trace(FILE * f, const char * reason, const voice_gate_decision & d) {
+    if (!f) return;
+    std::fprintf(f, "[VG] ENDPOINT delay=%lldms required=%dms voice=%lldms sharp_drop=%d reason=%s\n",
+        (long long) d.silent_ms,
+        d.required_silence_ms,
+        (long long) d.voice_ms,
+        d.sharp_drop ? 1 : 0,
+        reason);
+    std::fflush(f);
+}
+
+static void print_endpoint_stats(FILE * f, const char * tag, const endpoint_stats & es) {
+    if (!f || es.delays_ms.empty()) return;
+    std::fprintf(f, "%s endpoint delay: n=%zu p10=%dms p50=%dms p90=%dms max=%dms (silence=%llu probe=%llu)\n",
+        tag,
+        es.delays_ms.size(),
+        es.quantile(0.10),
+        es.quantile(0.50),
+        es.quantile(0.90),
+        es.quantile(1.0),
+        (unsigned long long) es.by_silence,
+        (unsigned long long) es.by_probe);
+    std::fflush(f);
+}
+
 static void print_voice_gate_status(FILE * f,
                                    const int64_t t_ms,
                                    const bool in_voice,
@@ -115,6 +286,153 @@ static void print_voice_gate_status(FILE * f,
     std::fflush(f);
 }
 
+static void print_cpu_phases(FILE * f, const char * tag, const cpu_phase_meter & meter, const energy_gate * gate) {
+    if (!f) return;
+    const cpu_phase_meter::phase & idle = meter.idle();
+    const cpu_phase_meter::phase & active = meter.active();
+    std::fprintf(f, "%s idle: %.1fs wall, %.1fs CPU (%.1f%% of a core) | active: %.1fs wall, %.1fs CPU (%.1f%% of a core)\n",
+        tag,
+        idle.wall_s, idle.cpu_s, 100.0 * idle.load(),
+        active.wall_s, active.cpu_s, 100.0 * active.load());
+    if (gate) {
+        const energy_gate::counters & c = gate->stats();
+        std::fprintf(f, "%s energy gate: checks=%llu silero_skipped=%llu (%.0f%%) wakeups=%llu floor=%.1fdBFS interval=%dms\n",
+            tag,
+            (unsigned long long) c.checks,
+            (unsigned long long) c.skipped,
+            c.checks ? 100.0 * (double) c.skipped / (double) c.checks : 0.0,
+            (unsigned long long) c.wakeups,
+            gate->floor_db(),
+            gate->check_interval_ms());
+    }
+    std::fflush(f);
+}
+
+static void print_inference_stats(FILE * f, const char * tag, const inference_worker_stats & ws, uint64_t chunks) {
+    if (!f || ws.jobs == 0) return;
+    std::fprintf(f, "%s inference: blocks=%llu emitted=%llu aborted=%llu dropped=%llu max_queue=%zu long-speech chunks=%llu\n",
+        tag,
+        (unsigned long long) ws.jobs,
+        (unsigned long long) ws.emitted,
+        (unsigned long long) ws.aborted,
+        (unsigned long long) ws.dropped,
+        ws.max_queue,
+        (unsigned long long) chunks);
+    std::fflush(f);
+}
+
+// Sample copies on the capture -> VAD/Whisper path between two snapshots of the totals.
+static void print_copy_stats(FILE * f, const char * tag, const audio_copy_stats & now, const audio_copy_stats & prev, double seconds) {
+    if (!f) return;
+    const double copies = (double) (now.copies - prev.copies);
+    const double kib = (double) (now.bytes - prev.bytes) / 1024.0;
+    const double s = std::max(1e-3, seconds);
+    std::fprintf(f, "%s audio copies: %.0f (%.2f/s), %.1f KiB moved (%.1f KiB/s)\n", tag, copies, copies / s, kib, kib / s);
+    std::fflush(f);
+}
+
+// Outcome of one --test-voice-gate scan.
+struct voice_gate_test_result {
+    int64_t duration_ms = 0;
+    int flushes = 0;
+    int chunks = 0;
+    int drop_short = 0;
+    int too_short = 0;
+    endpoint_stats endpoints;
+};
+
+// Steps the voice gate through a file as the live loop would, with Silero scoring each window. Events go to `out`
+// (null = quiet), each check to `recorder` (optional).
+static void scan_voice_gate_test(const app_params & params, whisper_vad_context * vctx, const std::vector<float> & pcm,
+                                 FILE * out, voice_gate_recorder * recorder, voice_gate_test_result & r) {
+    const int64_t total_samples = (int64_t) pcm.size();
+    const int64_t total_ms = (int64_t) ((1000.0 * (double) total_samples) / (double) WHISPER_SAMPLE_RATE);
+    r = voice_gate_test_result{};
+    r.duration_ms = total_ms;
+
+    // No Whisper model here, so --endpoint-probe has nothing to decode with; the rest of the endpointing applies.
+    voice_gate_params vgp = make_voice_gate_params(params);
+    vgp.timeline.endpoint_probe = false;
+    voice_gate gate(vgp);
+    const utterance_timeline & vtl = gate.timeline();
+
+    auto print_range = [out](const utterance_timeline & tl, const voice_gate_decision & d) {
+        if (out) std::fprintf(out, "[VG] FLUSH_RANGE %lldms..%lldms\n", (long long) tl.samples_to_ms(d.begin), (long long) tl.samples_to_ms(d.end));
+    };
+
+    auto eval_at_ms = [&](const int64_t t_ms) {
+        // Past the end of the file the clock keeps running over (virtual) silence.
+        const uint64_t now = (uint64_t) ((t_ms * WHISPER_SAMPLE_RATE) / 1000);
+        const int64_t end_sample = std::min<int64_t>(total_samples, (int64_t) now);
+        const int64_t win_samples = (int64_t) ((int64_t) params.vad_window_ms * WHISPER_SAMPLE_RATE) / 1000;
+        const int64_t start_sample = std::max<int64_t>(0, end_sample - win_samples);
+
+        // Silero reads the window in place.
+        const audio_view window = audio_view::of(pcm.data() + start_sample, (size_t) std::max<int64_t>(0, end_sample - start_sample), (uint64_t) start_sample);
+
+        voice_gate_check c;
+        vad_window_probs(vctx, window.p0, window, c);
+        c.now = now;
+        // A speculative decode would finish at once here; only the ranges are reported.
+        c.allow_speculation = true;
+        const voice_gate_decision d = gate.check(c);
+        if (recorder) recorder->check(c, d);
+
+        switch (d.ev) {
+            case utterance_timeline::event::voice_start:
+                print_voice_gate_trace(out, "VOICE_START", vtl.samples_to_ms(vtl.speech_begin()), -1, -1);
+                break;
+            case utterance_timeline::event::voice_end:
+                print_voice_gate_trace(out, "VOICE_END", vtl.samples_to_ms(vtl.speech_end()), -1, -1);
+                break;
+            case utterance_timeline::event::drop_short:
+                r.drop_short++;
+                print_voice_gate_trace(out, "DROP_SHORT", t_ms, d.voice_ms, 0);
+                break;
+            default:
+                break;
+        }
+        switch (d.block) {
+            case voice_gate_block::flush:
+                r.flushes++;
+                print_endpoint_trace(out, "silence", d);
+                print_voice_gate_trace(out, "FLUSH", t_ms, d.voice_ms, (int32_t) vtl.samples_to_ms(d.end - d.begin));
+                print_range(vtl, d);
+                break;
+            case voice_gate_block::chunk:
+                print_voice_gate_trace(out, "CHUNK", t_ms, d.voice_ms, (int32_t) vtl.samples_to_ms(d.end - d.begin));
+                print_range(vtl, d);
+                break;
+            case voice_gate_block::speculate:
+                print_voice_gate_trace(out, "SPECULATE", t_ms, d.voice_ms, (int32_t) vtl.samples_to_ms(d.end - d.begin));
+                print_range(vtl, d);
+                break;
+            default:
+                break;
+        }
+        if (d.too_short) {
+            r.too_short++;
+            if (out) std::fprintf(out, "[VG] DROP_TOO_SHORT pcm_n=%llu (need >= %.0f)\n",
+                (unsigned long long) (d.end - d.begin),
+                (double) vtl.ms_to_samples(vgp.min_block_ms));
+        }
+    };
+
+    // Main scan over the file
+    const int64_t step_ms = std::max<int32_t>(50, params.vad_check_ms);
+    for (int64_t t_ms = 0; t_ms <= total_ms; t_ms += step_ms) {
+        eval_at_ms(t_ms);
+    }
+
+    // Ensure any trailing utterance flushes by simulating extra silence.
+    for (int64_t t_ms = total_ms + step_ms; t_ms <= total_ms + params.voice_stop_ms + step_ms; t_ms += step_ms) {
+        eval_at_ms(t_ms);
+    }
+
+    r.chunks = (int) vtl.chunks();
+    r.endpoints = vtl.endpoints();
+}
+
 static int run_test_voice_gate_on_file(const app_params & params) {
     if (params.test_voice_gate_file.empty()) {
         std::fprintf(stderr, "error: --test-voice-gate requires a file path\n");
@@ -149,14 +467,6 @@ static int run_test_voice_gate_on_file(const app_params & params) {
         return 3;
     }
 
-    whisper_vad_params vadp = whisper_vad_default_params();
-    vadp.threshold = params.vad_voice_threshold;
-    vadp.min_speech_duration_ms = 250;
-    vadp.min_silence_duration_ms = 200;
-    vadp.max_speech_duration_s = 30.0f;
-    vadp.speech_pad_ms = 100;
-    vadp.samples_overlap = 0.0f;
-
     const int64_t total_samples = (int64_t) pcm.size();
     const int64_t total_ms = (int64_t) ((1000.0 * (double) total_samples) / (double) WHISPER_SAMPLE_RATE);
 
@@ -172,81 +482,244 @@ static int run_test_voice_gate_on_file(const app_params & params) {
         params.vad_window_ms,
         params.length_ms);
 
-    bool in_voice = false;
-    bool silence_started = false;
-    int64_t t_voice_start_ms = 0;
-    int64_t t_last_voice_ms = 0;
-    int flushes = 0;
+    // Same settings as the scan's gate, so the recording replays as is.
+    voice_gate_params vgp = make_voice_gate_params(params);
+    vgp.timeline.endpoint_probe = false;
+    voice_gate_recorder recorder;
+    if (!params.record_voice_gate.empty() && !recorder.open(params.record_voice_gate, vgp)) {
+        std::fprintf(stderr, "error: cannot write --record-voice-gate file: %s\n", params.record_voice_gate.c_str());
+        whisper_vad_free(vctx);
+        return 2;
+    }
 
-    auto eval_at_ms = [&](const int64_t t_ms) {
-        const int64_t end_sample = std::min<int64_t>(total_samples, (t_ms * WHISPER_SAMPLE_RATE) / 1000);
-        const int64_t win_samples = (int64_t) ((int64_t) params.vad_window_ms * WHISPER_SAMPLE_RATE) / 1000;
-        const int64_t start_sample = std::max<int64_t>(0, end_sample - win_samples);
+    voice_gate_test_result r;
+    scan_voice_gate_test(params, vctx, pcm, stdout, &recorder, r);
 
-        std::vector<float> window;
-        if (end_sample > start_sample) {
-            window.insert(window.end(), pcm.begin() + (size_t) start_sample, pcm.begin() + (size_t) end_sample);
-        }
+    whisper_vad_free(vctx);
+    std::fprintf(stderr, "\nVoice gate OFFLINE test complete: flushes=%d chunks=%d\n", r.flushes, r.chunks);
+    print_endpoint_stats(stderr, "Voice gate:", r.endpoints);
+    return 0;
+}
 
-        bool voice_present = false;
-        if (!window.empty()) {
-            whisper_vad_segments * segs = whisper_vad_segments_from_samples(vctx, vadp, window.data(), (int) window.size());
-            voice_present = segs && whisper_vad_segments_n_segments(segs) > 0;
-            if (segs) whisper_vad_free_segments(segs);
-        }
+// --test-voice-gate-batch: the offline test over a library of recordings, several files at once, each worker with
+// its own Silero context. One summary row per file (stdout, in list order), totals on stderr.
+static int run_test_voice_gate_batch(const app_params & params) {
+    if (params.vad_model.empty()) {
+        std::fprintf(stderr, "error: --test-voice-gate-batch requires a VAD model. Expected ./models/ggml-silero-v6.2.0.bin\n");
+        std::fprintf(stderr, "Hint: run .\\download-vad.cmd\n");
+        return 1;
+    }
+    std::vector<std::string> files;
+    if (!corpus_list(params.test_voice_gate_batch, files)) {
+        std::fprintf(stderr, "error: cannot read --test-voice-gate-batch %s\n", params.test_voice_gate_batch.c_str());
+        return 2;
+    }
+    if (files.empty()) {
+        std::fprintf(stderr, "error: no recordings in %s\n", params.test_voice_gate_batch.c_str());
+        return 2;
+    }
 
-        if (voice_present) {
-            if (!in_voice) {
-                in_voice = true;
-                silence_started = false;
-                t_voice_start_ms = t_ms;
-                print_voice_gate_trace(stdout, "VOICE_START", t_ms, -1, -1);
-            }
-            t_last_voice_ms = t_ms;
-            return;
-        }
+    const int hw = std::max(1, (int) std::thread::hardware_concurrency());
+    const int n_jobs = std::min<int>((int) files.size(), params.test_jobs > 0 ? params.test_jobs : hw);
+    std::fprintf(stderr, "\nVoice gate OFFLINE batch: %zu recordings, %d at once\n", files.size(), n_jobs);
+    std::fprintf(stderr, "- vad_model: %s\n", params.vad_model.c_str());
+    std::fprintf(stderr, "- stop=%dms min=%dms thold=%.2f check=%dms window=%dms length=%dms\n\n",
+        params.voice_stop_ms, params.min_voice_ms, params.vad_voice_threshold, params.vad_check_ms, params.vad_window_ms, params.length_ms);
 
-        if (!in_voice) {
+    struct file_result {
+        bool ok = false;
+        std::string error;
+        voice_gate_test_result r;
+        int64_t wall_ms = 0;
+    };
+    std::vector<file_result> results(files.size());
+    std::atomic<size_t> next{ 0 };
+    std::atomic<size_t> done{ 0 };
+    std::atomic<bool> init_failed{ false };
+    std::mutex progress_mu;
+
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    auto work = [&]() {
+        whisper_vad_context_params vcp = whisper_vad_default_context_params();
+        vcp.n_threads = std::max(1, params.threads / n_jobs);
+        vcp.use_gpu = false;
+        vcp.gpu_device = 0;
+        whisper_vad_context * vctx = whisper_vad_init_from_file_with_params(params.vad_model.c_str(), vcp);
+        if (!vctx) {
+            init_failed = true;
             return;
         }
-
-        if (!silence_started) {
-            silence_started = true;
-            print_voice_gate_trace(stdout, "VOICE_END", t_ms, -1, -1);
+        for (size_t i = next++; i < files.size(); i = next++) {
+            file_result & fr = results[i];
+            const auto t_file = std::chrono::high_resolution_clock::now();
+            std::vector<float> pcm;
+            std::vector<std::vector<float>> pcm_stereo;
+            if (!read_audio_data(files[i], pcm, pcm_stereo, /*stereo*/false) || pcm.empty()) {
+                fr.error = "unreadable or empty";
+            } else {
+                scan_voice_gate_test(params, vctx, pcm, nullptr, nullptr, fr.r);
+                fr.ok = true;
+            }
+            fr.wall_ms = ms_since(t_file, std::chrono::high_resolution_clock::now());
+            std::lock_guard<std::mutex> lock(progress_mu);
+            std::fprintf(stderr, "[%zu/%zu] %s%s\n", ++done, files.size(), files[i].c_str(), fr.ok ? "" : " (FAILED)");
         }
+        whisper_vad_free(vctx);
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < n_jobs; ++t) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (std::thread & t : pool) {
+        t.join();
+    }
+    const int64_t wall_ms = ms_since(t0, std::chrono::high_resolution_clock::now());
+    if (init_failed && done == 0) {
+        std::fprintf(stderr, "error: failed to init VAD model: %s\n", params.vad_model.c_str());
+        return 3;
+    }
 
-        const int64_t silent_ms = t_ms - t_last_voice_ms;
-        if (silent_ms < params.voice_stop_ms) {
-            return;
+    std::fprintf(stdout, "file\tduration_ms\tflushes\tchunks\tdrop_short\ttoo_short\tdelay_p50_ms\tdelay_p90_ms\tscan_ms\n");
+    voice_gate_test_result total;
+    int failed = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        const file_result & fr = results[i];
+        if (!fr.ok) {
+            ++failed;
+            std::fprintf(stdout, "%s\tERROR: %s\n", files[i].c_str(), fr.error.empty() ? "not scanned" : fr.error.c_str());
+            continue;
         }
+        const voice_gate_test_result & r = fr.r;
+        std::fprintf(stdout, "%s\t%lld\t%d\t%d\t%d\t%d\t%d\t%d\t%lld\n",
+            files[i].c_str(), (long long) r.duration_ms, r.flushes, r.chunks, r.drop_short, r.too_short,
+            r.endpoints.quantile(0.50), r.endpoints.quantile(0.90), (long long) fr.wall_ms);
+        total.duration_ms += r.duration_ms;
+        total.flushes += r.flushes;
+        total.chunks += r.chunks;
+        total.drop_short += r.drop_short;
+        total.too_short += r.too_short;
+        total.endpoints.delays_ms.insert(total.endpoints.delays_ms.end(), r.endpoints.delays_ms.begin(), r.endpoints.delays_ms.end());
+        total.endpoints.by_silence += r.endpoints.by_silence;
+        total.endpoints.by_probe += r.endpoints.by_probe;
+    }
+    std::fflush(stdout);
 
-        const int64_t voice_ms = t_last_voice_ms - t_voice_start_ms;
-        if (voice_ms >= params.min_voice_ms) {
-            int32_t block_ms = (int32_t) std::min<int64_t>((int64_t) params.length_ms, t_ms - t_voice_start_ms);
-            block_ms = std::max<int32_t>(0, block_ms);
-            ++flushes;
-            print_voice_gate_trace(stdout, "FLUSH", t_ms, voice_ms, block_ms);
-        } else {
-            print_voice_gate_trace(stdout, "DROP_SHORT", t_ms, voice_ms, 0);
-        }
+    std::fprintf(stderr, "\nVoice gate OFFLINE batch complete: files=%zu failed=%d audio=%.1fs flushes=%d chunks=%d drop_short=%d too_short=%d\n",
+        files.size(), failed, 1e-3 * (double) total.duration_ms, total.flushes, total.chunks, total.drop_short, total.too_short);
+    std::fprintf(stderr, "Voice gate: wall %.1fs (%.0fx real time)\n",
+        1e-3 * (double) wall_ms, wall_ms > 0 ? (double) total.duration_ms / (double) wall_ms : 0.0);
+    print_endpoint_stats(stderr, "Voice gate:", total.endpoints);
+    return failed == 0 ? 0 : 1;
+}
 
-        in_voice = false;
-        silence_started = false;
-    };
+// --sweep: Silero runs once over the whole file; every grid point replays the gate on those probabilities.
+// The probabilities differ slightly from the live windows' (Silero's state carries across the file instead of
+// restarting per window), so a sweep ranks settings; --test-voice-gate confirms the pick.
+static int run_vad_sweep(const app_params & params) {
+    if (params.vad_model.empty()) {
+        std::fprintf(stderr, "error: --sweep requires a VAD model. Expected ./models/ggml-silero-v6.2.0.bin\n");
+        std::fprintf(stderr, "Hint: run .\\download-vad.cmd\n");
+        return 1;
+    }
 
-    // Main scan over the file
-    const int64_t step_ms = std::max<int32_t>(50, params.vad_check_ms);
-    for (int64_t t_ms = 0; t_ms <= total_ms; t_ms += step_ms) {
-        eval_at_ms(t_ms);
+    std::vector<float> pcm;
+    std::vector<std::vector<float>> pcm_stereo;
+    if (!read_audio_data(params.sweep_file, pcm, pcm_stereo, /*stereo*/false) || pcm.empty()) {
+        std::fprintf(stderr, "error: failed to read audio file: %s\n", params.sweep_file.c_str());
+        return 2;
     }
 
-    // Ensure any trailing utterance flushes by simulating extra silence.
-    for (int64_t t_ms = total_ms + step_ms; t_ms <= total_ms + params.voice_stop_ms + step_ms; t_ms += step_ms) {
-        eval_at_ms(t_ms);
+    vad_sweep_input in;
+    in.base = make_voice_gate_params(params);
+    in.window_ms = params.vad_window_ms;
+    in.n_samples = pcm.size();
+    if (!params.sweep_labels.empty()) {
+        std::string err;
+        if (!vad_sweep_load_labels(params.sweep_labels, WHISPER_SAMPLE_RATE, in.labels, err)) {
+            std::fprintf(stderr, "error: --sweep-labels %s: %s\n", params.sweep_labels.c_str(), err.c_str());
+            return 2;
+        }
     }
 
+    whisper_vad_context_params vcp = whisper_vad_default_context_params();
+    vcp.n_threads = std::max(1, params.threads);
+    vcp.use_gpu = false;
+    vcp.gpu_device = 0;
+    whisper_vad_context * vctx = whisper_vad_init_from_file_with_params(params.vad_model.c_str(), vcp);
+    if (!vctx) {
+        std::fprintf(stderr, "error: failed to init VAD model: %s\n", params.vad_model.c_str());
+        return 3;
+    }
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    if (!whisper_vad_detect_speech(vctx, pcm.data(), (int) pcm.size())) {
+        std::fprintf(stderr, "error: Silero failed on %s\n", params.sweep_file.c_str());
+        whisper_vad_free(vctx);
+        return 3;
+    }
+    const std::vector<float> probs(whisper_vad_probs(vctx), whisper_vad_probs(vctx) + whisper_vad_n_probs(vctx));
     whisper_vad_free(vctx);
-    std::fprintf(stderr, "\nVoice gate OFFLINE test complete: flushes=%d\n", flushes);
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    in.probs = probs.data();
+    in.n_probs = probs.size();
+
+    auto or_current = [](const std::vector<double> & v, double cur) { return v.empty() ? std::vector<double>{ cur } : v; };
+    std::vector<vad_sweep_point> grid;
+    for (double stop : or_current(params.sweep_stop_ms, params.voice_stop_ms)) {
+        for (double min_voice : or_current(params.sweep_min_voice_ms, params.min_voice_ms)) {
+            for (double thold : or_current(params.sweep_thold, params.vad_voice_threshold)) {
+                for (double check : or_current(params.sweep_check_ms, params.vad_check_ms)) {
+                    vad_sweep_point pt;
+                    pt.voice_stop_ms = (int32_t) std::lround(stop);
+                    pt.min_voice_ms = (int32_t) std::lround(min_voice);
+                    pt.threshold = (float) thold;
+                    pt.check_ms = (int32_t) std::lround(check);
+                    grid.push_back(pt);
+                }
+            }
+        }
+    }
+
+    const int n_threads = std::max(1, (int) std::thread::hardware_concurrency());
+    const std::vector<vad_sweep_result> results = vad_sweep_run(in, grid, n_threads);
+    const auto t2 = std::chrono::high_resolution_clock::now();
+
+    const double audio_s = (double) pcm.size() / WHISPER_SAMPLE_RATE;
+    std::fprintf(stderr, "\nVoice gate sweep: %s (%.1fs), %zu settings on %d threads\n",
+        params.sweep_file.c_str(), audio_s, grid.size(), std::min<int>(n_threads, (int) grid.size()));
+    std::fprintf(stderr, "- Silero pass: %lldms, replays: %lldms\n", (long long) ms_since(t0, t1), (long long) ms_since(t1, t2));
+    if (!in.labels.empty()) {
+        std::fprintf(stderr, "- reference: %s (%zu speech spans)\n", params.sweep_labels.c_str(), in.labels.size());
+    }
+    std::fprintf(stderr, "\n");
+
+    const bool labeled = !in.labels.empty();
+    std::fprintf(stdout, "stop_ms\tmin_voice_ms\tthold\tcheck_ms\tflushes\tchunks\tdrop_short\ttoo_short\tdelay_p50_ms\tdelay_p90_ms%s\n",
+        labeled ? "\tprecision\trecall" : "");
+    size_t best = 0;
+    double best_f1 = -1.0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const vad_sweep_result & r = results[i];
+        std::fprintf(stdout, "%d\t%d\t%.2f\t%d\t%d\t%d\t%d\t%d\t%d\t%d",
+            r.point.voice_stop_ms, r.point.min_voice_ms, r.point.threshold, r.point.check_ms,
+            r.flushes, r.chunks, r.drop_short, r.too_short, r.delay_p50_ms, r.delay_p90_ms);
+        if (labeled) {
+            std::fprintf(stdout, "\t%.3f\t%.3f", r.precision, r.recall);
+            const double f1 = r.precision + r.recall > 0.0 ? 2.0 * r.precision * r.recall / (r.precision + r.recall) : 0.0;
+            // Ties go to the shorter endpoint delay.
+            if (f1 > best_f1 || (f1 == best_f1 && r.delay_p50_ms < results[best].delay_p50_ms)) {
+                best_f1 = f1;
+                best = i;
+            }
+        }
+        std::fprintf(stdout, "\n");
+    }
+    std::fflush(stdout);
+    if (labeled) {
+        const vad_sweep_point & b = results[best].point;
+        std::fprintf(stderr, "\nBest F1 %.3f: --voice-stop-ms %d --min-voice-ms %d --vad-voice-thold %.2f --vad-check-ms %d\n",
+            best_f1, b.voice_stop_ms, b.min_voice_ms, b.threshold, b.check_ms);
+    }
     return 0;
 }
 
@@ -274,6 +747,30 @@ static std::string trim_and_collapse_ws(const std::string & s) {
     return out;
 }
 
+// True when the text ends with sentence-final punctuation (ignoring closing quotes/brackets).
+static bool ends_with_sentence_punct(const std::string & s) {
+    size_t n = s.size();
+    while (n > 0 && (s[n - 1] == '"' || s[n - 1] == '\'' || s[n - 1] == ')' || s[n - 1] == ']' || s[n - 1] == ' ')) {
+        --n;
+    }
+    if (n == 0) {
+        return false;
+    }
+    const char c = s[n - 1];
+    if (c == '.' || c == '?' || c == '!') {
+        // "..." is Whisper trailing off mid-sentence, not an ending.
+        return !(n >= 3 && s.compare(n - 3, 3, "...") == 0);
+    }
+    // CJK full stop, question and exclamation marks (UTF-8).
+    static const char * const k_wide[] = { "\xE3\x80\x82", "\xEF\xBC\x9F", "\xEF\xBC\x81" };
+    for (const char * w : k_wide) {
+        if (n >= 3 && s.compare(n - 3, 3, w) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static std::string wrap_text_wordwise_cols(const std::string & s, const size_t cols) {
     if (cols == 0 || s.size() <= cols) {
         return s;
@@ -321,12 +818,6 @@ static std::string wrap_text_wordwise_cols(const std::string & s, const size_t c
     return out;
 }
 
-static double clamp_double(const double v, const double lo, const double hi) {
-    if (v < lo) return lo;
-    if (v > hi) return hi;
-    return v;
-}
-
 struct whisper_log_filter_cfg {
     bool suppress_all = false;
     bool suppress_vad = false;
@@ -346,141 +837,6 @@ static void whisper_log_filter_cb(ggml_log_level /*level*/, const char * text, v
     std::fputs(text, stderr);
 }
 
-struct streamerbot_send_item {
-    std::string text;
-    size_t raw_len = 0; // original transcript length (including spaces), excluding any wrapping newlines
-};
-
-class streamerbot_sender {
-public:
-    explicit streamerbot_sender(streamerbot_ws_config cfg)
-        : m_cfg(std::move(cfg))
-        , m_thread([this]() { this->run(); }) {
-    }
-
-    ~streamerbot_sender() {
-        stop_and_join(/*drain*/true);
-    }
-
-    streamerbot_sender(const streamerbot_sender &) = delete;
-    streamerbot_sender & operator=(const streamerbot_sender &) = delete;
-
-    void enqueue(streamerbot_send_item item) {
-        {
-            std::lock_guard<std::mutex> lock(m_mu);
-            if (m_stop) {
-                return;
-            }
-            m_q.push_back(std::move(item));
-        }
-        m_cv.notify_one();
-    }
-
-    void stop_and_join(const bool drain) {
-        {
-            std::lock_guard<std::mutex> lock(m_mu);
-            if (m_stopped) {
-                // Already joined.
-                return;
-            }
-            m_stop = true;
-            if (!drain) {
-                m_q.clear();
-            }
-        }
-        m_cv.notify_one();
-        if (m_thread.joinable()) {
-            m_thread.join();
-        }
-        {
-            std::lock_guard<std::mutex> lock(m_mu);
-            m_stopped = true;
-        }
-    }
-
-private:
-    static std::chrono::milliseconds compute_delay_ms(const size_t raw_len, const size_t backlog_remaining) {
-        // Length-based reading delay, clamped to [2s, 4s].
-        // When the queue is backing up, speed up slightly (but never below 2s).
-        constexpr double k_min_s = 2.0;
-        constexpr double k_max_s = 4.0;
-        constexpr double k_base_chars_per_s = 16.0;
-        constexpr size_t k_soft_backlog = 5;
-
-        double speedup = 1.0;
-        if (backlog_remaining > k_soft_backlog) {
-            // +25% chars/s per extra queued message, capped.
-            const double extra = 0.25 * (double) (backlog_remaining - k_soft_backlog);
-            speedup = 1.0 + std::min(2.0, extra); // cap at 3x
-        }
-
-        const double cps = k_base_chars_per_s * speedup;
-        const double delay_s = clamp_double((double) raw_len / cps, k_min_s, k_max_s);
-        const int ms = (int) std::llround(delay_s * 1000.0);
-        return std::chrono::milliseconds(std::max(0, ms));
-    }
-
-    void run() {
-        streamerbot_ws_client bot;
-
-        while (true) {
-            streamerbot_send_item item;
-            size_t backlog_remaining = 0;
-
-            {
-                std::unique_lock<std::mutex> lock(m_mu);
-                m_cv.wait(lock, [&]() { return m_stop || !m_q.empty(); });
-
-                if (m_q.empty()) {
-                    if (m_stop) {
-                        break;
-                    }
-                    continue;
-                }
-
-                item = std::move(m_q.front());
-                m_q.pop_front();
-                backlog_remaining = m_q.size();
-            }
-
-            // Best-effort send (same behavior as the main loop used to have).
-            {
-                std::string err;
-                if (!bot.connect_and_handshake(m_cfg, err)) {
-                    std::fprintf(stderr, "Streamer.bot connect failed (%s).\n", err.c_str());
-                } else {
-                    if (!bot.do_action_text(m_cfg, item.text, err)) {
-                        std::fprintf(stderr, "DoAction failed (%s).\n", err.c_str());
-                    }
-                }
-                bot.close();
-            }
-
-            // If stopping, drain quickly (no additional delay).
-            {
-                std::lock_guard<std::mutex> lock(m_mu);
-                if (m_stop) {
-                    if (m_q.empty()) {
-                        break;
-                    }
-                    continue;
-                }
-            }
-
-            std::this_thread::sleep_for(compute_delay_ms(item.raw_len, backlog_remaining));
-        }
-    }
-
-private:
-    streamerbot_ws_config m_cfg;
-    std::mutex m_mu;
-    std::condition_variable m_cv;
-    std::deque<streamerbot_send_item> m_q;
-    bool m_stop = false;
-    bool m_stopped = false;
-    std::thread m_thread;
-};
-
 static std::vector<std::string> split_words_lower_ascii(const std::string & s) {
     std::vector<std::string> out;
     std::string cur;
@@ -533,24 +889,55 @@ static bool is_suffix_repeat_by_words(const std::string & prev, const std::strin
     return ends_with_words(w_prev, w_cur);
 }
 
-static float audio_activity_fraction(const std::vector<float> & pcm, float abs_thold) {
-    if (pcm.empty()) return 0.0f;
-    size_t n_active = 0;
-    for (float v : pcm) {
-        if (std::fabs(v) > abs_thold) {
-            ++n_active;
+// Keeps one copy of a phrase the decoder repeated 3+ times in a row ("I'm going to, I'm going to, I'm going to,").
+// Used on text cut short by the repetition-loop stop, which still holds the first few repeats.
+static std::string collapse_repeated_phrases(const std::string & s) {
+    std::vector<std::string> words;
+    std::vector<std::string> keys;
+    size_t pos = 0;
+    while (pos < s.size()) {
+        const size_t end = s.find(' ', pos);
+        const std::string w = s.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        if (!w.empty()) {
+            words.push_back(w);
+            std::string key;
+            for (const std::string & part : split_words_lower_ascii(w)) {
+                key += part;
+            }
+            keys.push_back(key.empty() ? w : key);
         }
+        if (end == std::string::npos) break;
+        pos = end + 1;
     }
-    return (float) n_active / (float) pcm.size();
-}
 
-static float audio_rms(const std::vector<float> & pcm) {
-    if (pcm.empty()) return 0.0f;
-    double sumsq = 0.0;
-    for (float v : pcm) {
-        sumsq += (double) v * (double) v;
+    std::string out;
+    size_t i = 0;
+    while (i < words.size()) {
+        size_t n_keep = 1;
+        size_t n_skip = 1;
+        for (size_t n = 1; n <= 8; ++n) {
+            size_t repeats = 1;
+            while (i + n * (repeats + 1) <= words.size()) {
+                bool same = true;
+                for (size_t k = 0; k < n && same; ++k) {
+                    same = keys[i + k] == keys[i + n * repeats + k];
+                }
+                if (!same) break;
+                ++repeats;
+            }
+            if (repeats >= 3) {
+                n_keep = n;
+                n_skip = n * repeats;
+                break;
+            }
+        }
+        for (size_t k = 0; k < n_keep; ++k) {
+            if (!out.empty()) out += ' ';
+            out += words[i + k];
+        }
+        i += n_skip;
     }
-    return (float) std::sqrt(sumsq / (double) pcm.size());
+    return out;
 }
 
 static bool is_exact_you(const std::string & s) {
@@ -604,7 +991,26 @@ static void print_usage(const char * exe) {
     std::fprintf(stderr, "  --threads N               Threads (default: cores-1)\n");
     std::fprintf(stderr, "  --translate               Translate to English\n");
     std::fprintf(stderr, "  --no-gpu                  Disable GPU inference\n");
-    std::fprintf(stderr, "  --no-flash-attn           Disable flash-attn\n\n");
+    std::fprintf(stderr, "  --no-flash-attn           Disable flash-attn\n");
+    std::fprintf(stderr, "  --model-load read|mmap    Read the model with buffered reads or map it (default: read)\n");
+    std::fprintf(stderr, "  --model-prefault          mmap: read the whole file ahead at open\n");
+    std::fprintf(stderr, "  --model-huge-pages        mmap: ask for transparent huge pages on the mapping (Linux)\n");
+    std::fprintf(stderr, "  --quantize TYPE           Quantize the models (--model, --fallback-model, --lid-model, --model-map) to\n");
+    std::fprintf(stderr, "                            q8_0|q5_1|q5_0|q4_1|q4_0 on first load;\n");
+    std::fprintf(stderr, "                            cached next to the model, keyed by its content hash (default: off)\n");
+    std::fprintf(stderr, "  --model-map LANG=PATH,... Decode utterances detected as LANG on their own model, e.g. en=models/ggml-base.en.bin;\n");
+    std::fprintf(stderr, "                            loaded on first use; other languages stay on --model\n");
+    std::fprintf(stderr, "  --lid-model <path>        Small multilingual model for the language-detect pass (default: --model)\n");
+    std::fprintf(stderr, "  --model-idle-s N          Unload a --model-map model after N seconds unused (default: 300; 0 = keep)\n");
+    std::fprintf(stderr, "  --vad-threads N           Threads for Silero VAD (default: same as --threads)\n");
+    std::fprintf(stderr, "  --autotune                Use the fastest threads/GPU/flash-attn for this CPU and model: timed once, then cached\n");
+    std::fprintf(stderr, "                            (explicit --threads, --vad-threads, --no-gpu, --no-flash-attn are kept)\n");
+    std::fprintf(stderr, "  --autotune-refresh        Time again even if a cached result exists\n");
+    std::fprintf(stderr, "  --autotune-cache <file>   Where results are cached (default: models/autotune.txt)\n");
+    std::fprintf(stderr, "  --cpu-budget N            Cores for transcription, split between Silero and Whisper; raises the capture/gate\n");
+    std::fprintf(stderr, "                            thread's priority (or lowers the decoder's) (default: 0 = no budget)\n");
+    std::fprintf(stderr, "  --affinity-gate LIST      Pin capture and the voice gate (with Silero) to these CPUs, e.g. 6-7\n");
+    std::fprintf(stderr, "  --affinity-whisper LIST   Pin the Whisper worker to these CPUs, e.g. 0-5\n\n");
 
     std::fprintf(stderr, "Presets:\n");
     std::fprintf(stderr, "  --fast                    Faster, less accurate (shorter blocks, no extra language-detect pass, more aggressive decoding)\n\n");
@@ -616,6 +1022,12 @@ static void print_usage(const char * exe) {
     std::fprintf(stderr, "  --device-index N          Capture device index (SDL2)\n");
     std::fprintf(stderr, "  --device-name <substring> Capture device name substring (preferred)\n");
     std::fprintf(stderr, "                           If neither is provided, the app will list devices and prompt (interactive shells only)\n");
+    std::fprintf(stderr, "  --sdl-resampler           Let SDL resample the mic to 16 kHz mono (default: capture at the device rate, own resampler)\n");
+    std::fprintf(stderr, "  --input <spec>            Audio input instead of the microphone: sdl (default), stdin (or -), file:<path>, pipe:<path>\n");
+    std::fprintf(stderr, "                           Raw mono 16 kHz PCM, e.g. ffmpeg -i <in> -f s16le -ac 1 -ar 16000 - | %s --input stdin\n", exe);
+    std::fprintf(stderr, "  --input-format <s16|f32>  Raw PCM sample format for --input (default: s16, little-endian)\n");
+    std::fprintf(stderr, "  --input-realtime          Pace raw input at 1x (default: on for file:, off for stdin/pipe:)\n");
+    std::fprintf(stderr, "  --no-input-realtime       Read raw input as fast as it arrives\n");
     std::fprintf(stderr, "  --length-ms N             Window length for VAD blocks (default: 30000; fast preset: 6000)\n");
     std::fprintf(stderr, "  --vad-check-ms N          How often to evaluate VAD (default: 2000; fast preset: 150)\n");
     std::fprintf(stderr, "  --vad-window-ms N         Window size used for VAD evaluation (default: 2000; fast preset: 1500)\n");
@@ -630,10 +1042,37 @@ static void print_usage(const char * exe) {
     std::fprintf(stderr, "  --vad-model <path>        Path to Silero VAD model (default: ./models/ggml-silero-v6.2.0.bin if present)\n");
     std::fprintf(stderr, "  --voice-stop-ms N         How long voice must be absent before flushing (default: 3000)\n");
     std::fprintf(stderr, "  --min-voice-ms N          Minimum voice duration required to send to Whisper (default: 600)\n");
-    std::fprintf(stderr, "  --vad-voice-thold X       Silero VAD probability threshold (default: 0.60)\n\n");
+    std::fprintf(stderr, "  --vad-voice-thold X       Silero VAD probability threshold (default: 0.60)\n");
+    std::fprintf(stderr, "  --endpoint MODE           End of utterance: fixed (wait --voice-stop-ms) or adaptive (shorter after long speech\n");
+    std::fprintf(stderr, "                            and sharp drops in speech probability) (default: fixed)\n");
+    std::fprintf(stderr, "  --endpoint-min-ms N       Adaptive: shortest silence that can end an utterance (default: 500)\n");
+    std::fprintf(stderr, "  --endpoint-probe          Adaptive: after --endpoint-min-ms, decode once and flush early if the text ends a sentence\n");
+    std::fprintf(stderr, "  --speculative-decode      Start decoding after --speculative-ms of silence; abort if speech resumes, emit the\n");
+    std::fprintf(stderr, "                            result as soon as the end of utterance is confirmed\n");
+    std::fprintf(stderr, "  --speculative-ms N        Silence before a speculative decode starts (default: 400; implies --speculative-decode)\n");
+    std::fprintf(stderr, "  --no-incremental-mel      Let whisper compute the log-mel spectrogram at flush time instead of during speech\n");
+    std::fprintf(stderr, "  --max-utterance-ms N      Transcribe longer speech in chunks cut at its best pause, without waiting for it to end\n");
+    std::fprintf(stderr, "                            (default: 15000; fast preset: 8000; 0 = off, keep only the newest --length-ms)\n");
+    std::fprintf(stderr, "  --energy-gate-db X        Skip Silero while the level is within X dB of the tracked noise floor (default: 6; 0 = off)\n");
+    std::fprintf(stderr, "  --vad-check-idle-ms N     Check interval after a while of dead air; snaps back on the first energy rise (default: 1000)\n\n");
 
     std::fprintf(stderr, "Decoding:\n");
-    std::fprintf(stderr, "  --max-tokens N            Max tokens per block (0 = no limit; fast preset: 48)\n\n");
+    std::fprintf(stderr, "  --max-tokens N            Max tokens per block (0 = no limit; fast preset: 48)\n");
+    std::fprintf(stderr, "  --tokens-per-second X     Token budget per block: X per second of speech, plus 8 (default: 8; 0 = --max-tokens only)\n");
+    std::fprintf(stderr, "  --no-loop-stop            Let the decoder run on when it starts repeating a phrase\n");
+    std::fprintf(stderr, "  --decode-deadline-x X     Abort a decode after X times the block duration (default: 1.0; 0 = no deadline)\n");
+    std::fprintf(stderr, "  --decode-deadline-min-ms N  Shortest deadline, for short blocks (default: 3000)\n");
+    std::fprintf(stderr, "  --decode-fallback <single|drop>  On timeout: retry once with one segment and a token cap in half the\n");
+    std::fprintf(stderr, "                            budget, or drop the block (default: single)\n");
+    std::fprintf(stderr, "  --fallback-model <path>   Smaller ggml model for the timeout retry (default: the main model)\n");
+    std::fprintf(stderr, "  --decode-policy <whisper|adaptive|beam>  whisper: greedy with whisper's temperature fallback;\n");
+    std::fprintf(stderr, "                            adaptive: greedy, re-decoded with beam search when the text looks weak and\n");
+    std::fprintf(stderr, "                            the deadline leaves room; beam: always beam search (default: adaptive)\n");
+    std::fprintf(stderr, "  --beam-size N             Beams for beam search (default: 5)\n");
+    std::fprintf(stderr, "  --beam-logprob-thold X    adaptive: re-decode below this average token log-prob (default: -1.0)\n");
+    std::fprintf(stderr, "  --beam-entropy-thold X    adaptive: re-decode below this entropy of the last 32 tokens (default: 2.4)\n");
+    std::fprintf(stderr, "  --batch-max N             When utterances queue up, decode up to N short ones in one pass (default: 4; 1 = off)\n");
+    std::fprintf(stderr, "  --batch-short-ms N        Longest utterance that joins such a batch (default: 3000)\n\n");
 
     std::fprintf(stderr, "Streamer.bot:\n");
     std::fprintf(stderr, "  --ws-url ws://127.0.0.1:8080/   WebSocket URL\n");
@@ -646,23 +1085,41 @@ static void print_usage(const char * exe) {
     std::fprintf(stderr, "  --debug-thankyou           Print debug info whenever output is exactly \"Thank you.\" (you can use this to tune filters)\n\n");
     std::fprintf(stderr, "  --debug-voice-gate         Debug-only: continuously print DETECT VOICE / DOES NOT DETECT VOICE (no Whisper, no Streamer.bot)\n\n");
     std::fprintf(stderr, "  --test-voice-gate <file>   Offline test: run voice gating on an audio file and print VOICE_* events (no mic, no Whisper)\n\n");
+    std::fprintf(stderr, "  --test-voice-gate-batch <dir|list>  --test-voice-gate over every recording in a directory (recursive) or listed\n");
+    std::fprintf(stderr, "                             in a manifest (one path per line), several at once; per-file and total summary\n");
+    std::fprintf(stderr, "  --test-jobs N              Recordings scanned at once by --test-voice-gate-batch (default: one per core)\n\n");
+    std::fprintf(stderr, "  --record-voice-gate <file> Record each voice gate check (Silero probabilities and decision), live or with --test-voice-gate\n\n");
+    std::fprintf(stderr, "  --sweep <file>             Score an audio file with Silero once, replay the voice gate for a grid of settings, and exit\n");
+    std::fprintf(stderr, "  --sweep-stop-ms LIST       --voice-stop-ms values, e.g. 1000,2000 or 500:3000:250 (default: the current value)\n");
+    std::fprintf(stderr, "  --sweep-min-voice-ms LIST  --min-voice-ms values\n");
+    std::fprintf(stderr, "  --sweep-thold LIST         --vad-voice-thold values\n");
+    std::fprintf(stderr, "  --sweep-check-ms LIST      --vad-check-ms values\n");
+    std::fprintf(stderr, "  --sweep-labels <file>      Reference speech spans (\"start end\" seconds per line, e.g. an Audacity label export): adds precision/recall\n\n");
+    std::fprintf(stderr, "  --regress <dir|list>       Run labeled clips through the voice gate, decoder and filters offline; report WER,\n");
+    std::fprintf(stderr, "                             hallucinations (clips with an empty clip.txt), duplicate captions and latency, and exit\n");
+    std::fprintf(stderr, "  --regress-baseline <file>  Fail (exit 1) when a metric is worse than this baseline by more than its tolerance\n");
+    std::fprintf(stderr, "  --regress-save-baseline <file>  Write this run's metrics as a baseline\n\n");
+    std::fprintf(stderr, "  --cpu-report-ms N          Print idle vs active CPU usage and audio copies every N ms (default: 0 = only at exit)\n\n");
+    std::fprintf(stderr, "  --bench-resampler          Benchmark the capture downmix/resampler (CPU per second of audio, accuracy) and exit\n\n");
+    std::fprintf(stderr, "  --bench-audio-stats        Check the fused audio-stats kernel against the scalar helpers/vad_simple, time it, and exit\n\n");
+    std::fprintf(stderr, "  --bench-log-mel            Check streamed log-mel frames against the whole-block mel, time the flush-time work, and exit\n\n");
+    std::fprintf(stderr, "  --bench-voice-gate         Time the voice gate on a synthetic probability stream, check record/replay parity, and exit\n\n");
+    std::fprintf(stderr, "  --replay-voice-gate <file> Replay a --record-voice-gate recording: check every decision matches, time it, and exit\n\n");
+    std::fprintf(stderr, "  --bench-models             Decode a corpus with every models/ggml-*.bin, flash-attn off/on, at several thread counts;\n");
+    std::fprintf(stderr, "                             report load time, RSS, RTF, latency and WER, recommend a configuration, and exit\n");
+    std::fprintf(stderr, "  --bench-corpus <dir|list>  Clips for --bench-models (reference text in clip.txt next to clip.wav adds WER)\n");
+    std::fprintf(stderr, "  --models-dir <dir>         Where --bench-models looks for models (default: models)\n");
+    std::fprintf(stderr, "  --bench-threads LIST       Thread counts, e.g. 2,4,8 (default: powers of two up to the core count)\n");
+    std::fprintf(stderr, "  --bench-target-ms N        p90 decode latency per clip the recommendation must meet (default: 2000)\n\n");
+    std::fprintf(stderr, "  --bench-model-load         Load --model with plain reads, mmap and mmap+prefault (twice each); report load time and RSS, and exit\n\n");
 
     std::fprintf(stderr, "Output filtering:\n");
     std::fprintf(stderr, "  --dedup-similarity X       Skip very similar repeats (default: 0.90; fast preset: 0.80)\n\n");
 }
 
-static std::string pick_language_en_fallback_fr(whisper_context * ctx, const std::vector<float> & pcm, int n_threads) {
-    // Only try to disambiguate between English and French.
-    // Returns "en" unless French is clearly more likely.
-    if (!ctx || pcm.empty()) {
-        return "en";
-    }
-
-    const int rc_mel = whisper_pcm_to_mel(ctx, pcm.data(), (int) pcm.size(), n_threads);
-    if (rc_mel != 0) {
-        return "en";
-    }
-
+// Only try to disambiguate between English and French, on the mel already set in the context
+// (whisper_pcm_to_mel() or whisper_set_mel()). Returns "en" unless French is clearly more likely.
+static std::string pick_language_en_fallback_fr_mel(whisper_context * ctx, int n_threads) {
     std::vector<float> lang_probs(whisper_lang_max_id() + 1, 0.0f);
     const int detected_id = whisper_lang_auto_detect(ctx, 0, n_threads, lang_probs.data());
     (void) detected_id;
@@ -680,14 +1137,1778 @@ static std::string pick_language_en_fallback_fr(whisper_context * ctx, const std
     return "en";
 }
 
-static bool parse_args(int argc, char ** argv, app_params & p) {
-    for (int i = 1; i < argc; ++i) {
-        const std::string arg = argv[i];
+static std::string pick_language_en_fallback_fr(whisper_context * ctx, const float * pcm, size_t n_samples, int n_threads) {
+    if (!ctx || !pcm || n_samples == 0) {
+        return "en";
+    }
 
-        // Convenience: allow a leading positional mic index for Windows shortcuts.
-        // Example: ai-subtitler-streamerbot.exe 0 --fast
-        if (!arg.empty() && arg[0] != '-' && is_nonneg_int_str(arg)) {
-            if (p.device_index < 0 && p.device_name_substring.empty()) {
+    const int rc_mel = whisper_pcm_to_mel(ctx, pcm, (int) n_samples, n_threads);
+    if (rc_mel != 0) {
+        return "en";
+    }
+    return pick_language_en_fallback_fr_mel(ctx, n_threads);
+}
+
+// --model-map with --language auto: the most likely language, so the utterance can go to that language's model.
+// "auto" when detection fails (whisper then detects in the decode).
+static std::string pick_language_mel(whisper_context * ctx, int n_threads) {
+    const int id = whisper_lang_auto_detect(ctx, 0, n_threads, nullptr);
+    return id >= 0 ? std::string(whisper_lang_str(id)) : std::string("auto");
+}
+
+static std::string pick_language(whisper_context * ctx, const float * pcm, size_t n_samples, int n_threads) {
+    if (!ctx || !pcm || n_samples == 0 || whisper_pcm_to_mel(ctx, pcm, (int) n_samples, n_threads) != 0) {
+        return "auto";
+    }
+    return pick_language_mel(ctx, n_threads);
+}
+
+// Text and per-segment details of one whisper_full() run.
+struct decoded_block {
+    std::string text;
+    int n_segments = 0;
+    float max_no_speech_prob = 0.0f;
+    // confidence, over the text tokens (no special or timestamp tokens)
+    int n_text_tokens = 0;
+    float avg_logprob = 0.0f;
+    float tail_entropy = 0.0f; // of the token ids among the last 32; low = the text repeats itself
+    // --debug-thankyou only
+    std::vector<float> seg_ns;
+    std::vector<int> seg_tok;
+    std::vector<int64_t> seg_t0;
+    std::vector<int64_t> seg_t1;
+};
+
+// Speculative decodes (--speculative-decode): how many ran, how many a flush or probe used, and the discarded work.
+struct speculation_stats {
+    uint64_t started = 0;
+    uint64_t used = 0;
+    uint64_t wasted = 0;
+    double wasted_ms = 0.0;
+};
+
+static void print_speculation_stats(FILE * f, const char * tag, const speculation_stats & sp) {
+    if (!f) return;
+    std::fprintf(f, "%s speculative decode: started=%llu used=%llu wasted=%llu (%.1fs of inference discarded)\n",
+        tag,
+        (unsigned long long) sp.started,
+        (unsigned long long) sp.used,
+        (unsigned long long) sp.wasted,
+        1e-3 * sp.wasted_ms);
+    std::fflush(f);
+}
+
+// Decoder steps (logits-filter calls, i.e. tokens over all decoders) and what the repetition-loop stop saved.
+struct decoder_stats {
+    uint64_t steps = 0;
+    uint64_t loop_stops = 0;
+    uint64_t steps_saved = 0; // tokens each stopped segment could still have taken
+    // Greedy passes: encoder start -> first token, and the time of each decoder step (scheduling jitter shows in the tail).
+    std::vector<double> encode_ms;
+    std::vector<double> step_ms;
+};
+
+static void print_decoder_stats(FILE * f, const char * tag, const decoder_stats & ds) {
+    if (!f || ds.steps == 0) return;
+    std::fprintf(f, "%s decoder: steps=%llu loop_stops=%llu steps_saved<=%llu\n",
+        tag,
+        (unsigned long long) ds.steps,
+        (unsigned long long) ds.loop_stops,
+        (unsigned long long) ds.steps_saved);
+    std::fflush(f);
+}
+
+static void print_compute_timing(FILE * f, const char * tag, const decoder_stats & ds) {
+    if (!f || ds.encode_ms.empty()) return;
+    const double enc50 = corpus_quantile(ds.encode_ms, 0.50);
+    const double enc99 = corpus_quantile(ds.encode_ms, 0.99);
+    const double step50 = corpus_quantile(ds.step_ms, 0.50);
+    const double step99 = corpus_quantile(ds.step_ms, 0.99);
+    std::fprintf(f, "%s compute timing: encode p50=%.1fms p99=%.1fms (x%.2f, n=%zu) decode step p50=%.2fms p90=%.2fms p99=%.2fms (x%.2f, n=%zu)\n",
+        tag,
+        enc50, enc99, enc50 > 0.0 ? enc99 / enc50 : 0.0, ds.encode_ms.size(),
+        step50, corpus_quantile(ds.step_ms, 0.90), step99, step50 > 0.0 ? step99 / step50 : 0.0, ds.step_ms.size());
+    std::fflush(f);
+}
+
+// Decodes that missed their compute deadline, and what became of them.
+struct deadline_stats {
+    uint64_t timeouts = 0;
+    uint64_t recovered = 0; // the fallback decode finished in time
+    uint64_t dropped = 0;
+};
+
+static void print_deadline_stats(FILE * f, const char * tag, const deadline_stats & ds) {
+    if (!f || ds.timeouts == 0) return;
+    std::fprintf(f, "%s decode deadline: timeouts=%llu recovered=%llu dropped=%llu\n",
+        tag,
+        (unsigned long long) ds.timeouts,
+        (unsigned long long) ds.recovered,
+        (unsigned long long) ds.dropped);
+    std::fflush(f);
+}
+
+// --decode-policy: which decodes ran. Under adaptive, every block gets a greedy pass and weak ones a beam re-decode.
+struct policy_stats {
+    uint64_t greedy = 0;
+    uint64_t beam = 0;             // beam search as the first pass (--decode-policy beam)
+    uint64_t redecodes = 0;        // beam re-decodes after a weak greedy pass
+    uint64_t weak_logprob = 0;     // ... triggered by the average log-prob
+    uint64_t weak_entropy = 0;     // ... triggered by repetitive text
+    uint64_t redecode_kept = 0;    // the beam text scored better and replaced the greedy text
+    uint64_t skipped_budget = 0;   // weak, but the deadline left no room for beam search
+    uint64_t skipped_backlog = 0;  // weak, but other blocks were waiting
+};
+
+static void print_policy_stats(FILE * f, const char * tag, const app_params & params, const policy_stats & ps) {
+    if (!f || ps.greedy + ps.beam == 0) return;
+    if (params.policy != decode_policy::adaptive) {
+        std::fprintf(f, "%s decode policy %s: greedy=%llu beam=%llu\n",
+            tag,
+            params.policy == decode_policy::beam ? "beam" : "whisper",
+            (unsigned long long) ps.greedy,
+            (unsigned long long) ps.beam);
+    } else {
+        std::fprintf(f, "%s decode policy adaptive: greedy=%llu beam_redecodes=%llu (logprob=%llu entropy=%llu kept=%llu) skipped: budget=%llu backlog=%llu\n",
+            tag,
+            (unsigned long long) ps.greedy,
+            (unsigned long long) ps.redecodes,
+            (unsigned long long) ps.weak_logprob,
+            (unsigned long long) ps.weak_entropy,
+            (unsigned long long) ps.redecode_kept,
+            (unsigned long long) ps.skipped_budget,
+            (unsigned long long) ps.skipped_backlog);
+    }
+    std::fflush(f);
+}
+
+// Incremental log-mel (--no-incremental-mel turns it off): frames computed on the pipeline thread during speech,
+// and what was left for the worker to compute when the block was decoded.
+struct mel_stats {
+    uint64_t blocks = 0;
+    uint64_t reused = 0;   // frames precomputed during speech
+    uint64_t computed = 0; // frames computed at decode time (block edges, blocks without precomputed frames)
+    double build_s = 0.0;  // CPU seconds the worker spent assembling block mels
+};
+
+static void print_mel_stats(FILE * f, const char * tag, const mel_stats & ms, const log_mel_stream & stream) {
+    if (!f || ms.blocks == 0) return;
+    const double frame_us = stream.frames_computed() ? 1e6 * stream.cpu_s() / (double) stream.frames_computed() : 0.0;
+    std::fprintf(f, "%s log-mel: blocks=%llu frames precomputed=%llu at decode=%llu; decode-time mel %.2fms/block, "
+                    "%.2fms/block moved off the flush path (%.1fus/frame during speech)\n",
+        tag,
+        (unsigned long long) ms.blocks,
+        (unsigned long long) ms.reused,
+        (unsigned long long) ms.computed,
+        1e3 * ms.build_s / (double) ms.blocks,
+        1e-3 * frame_us * (double) ms.reused / (double) ms.blocks,
+        frame_us);
+    std::fflush(f);
+}
+
+// Micro-batches (--batch-max): short queued utterances decoded in one whisper_full() each.
+struct batch_stats {
+    uint64_t batches = 0;
+    uint64_t jobs = 0;
+    uint64_t fallbacks = 0; // batches that failed or timed out and were decoded one by one
+};
+
+static void print_batch_stats(FILE * f, const char * tag, const batch_stats & bs) {
+    if (!f || (bs.batches == 0 && bs.fallbacks == 0)) return;
+    std::fprintf(f, "%s micro-batching: batches=%llu utterances=%llu encoder passes saved=%llu fallbacks=%llu\n",
+        tag,
+        (unsigned long long) bs.batches,
+        (unsigned long long) bs.jobs,
+        (unsigned long long) (bs.jobs - bs.batches),
+        (unsigned long long) bs.fallbacks);
+    std::fflush(f);
+}
+
+// Whisper side of the pipeline. Only the inference worker's thread touches it (and the whisper context).
+struct transcribe_state {
+    const app_params * params = nullptr;
+    whisper_context * ctx = nullptr;
+    whisper_context * fallback_ctx = nullptr; // --fallback-model (optional)
+    whisper_context * lid_ctx = nullptr;      // --lid-model (null = the language-detect pass runs on ctx)
+    model_router * router = nullptr;          // --model-map (optional)
+    const capture_source * audio = nullptr;    // null: the samples are not in a ring (--regress)
+    streamerbot_sender * bot_sender = nullptr;
+    std::vector<std::string> * captions = nullptr; // set: collect the captions here instead of printing / sending them
+    const inference_worker * worker = nullptr; // for its backlog: no beam re-decode while blocks wait
+    const log_mel * mel = nullptr;             // incremental log-mel front end (null = whisper computes the mel)
+    bool trace = false; // --trace-voice-gate
+
+    // Whisper needs contiguous samples: these only hold a copy when a view wraps around the ring.
+    std::vector<float> pcm_block;
+    std::vector<float> pcm_lang;
+    std::vector<float> pcm_batch; // the utterances of a micro-batch, back to back
+    // Mel of the job being decoded, kept for its re-decodes.
+    uint64_t mel_job = 0;
+    std::vector<float> mel_block;
+    int mel_n_len = 0;
+    int mel_n_len_org = 0;
+    std::string last_sent;
+    std::string last_language; // picked for the previous block (the fallback decode skips detection)
+    int iter = 0;
+
+    // Text of the previous chunk of a still-running utterance: the next chunk's prompt.
+    uint64_t carry_utterance = 0;
+    std::string carry_text;
+
+    // Result of the last speculative decode, until a job over the same samples uses it or another job replaces it.
+    uint64_t held_id = 0;
+    bool held_used = false;
+    double held_ms = 0.0;
+    decoded_block held;
+
+    speculation_stats spec;
+    deadline_stats deadline;
+    decoder_stats decoder;
+    policy_stats policy;
+    mel_stats mel_st;
+    batch_stats batch;
+};
+
+// abort_callback state of one whisper_full() attempt: the worker's cancel flag and the compute deadline.
+struct decode_guard {
+    const std::atomic<bool> * cancel = nullptr;
+    bool has_deadline = false;
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<bool> timed_out{ false };
+
+    // logits filter: repetition-loop stop and decoder-step accounting
+    bool loop_stop = false;
+    int32_t token_limit = 0; // tokens a segment may still take without the stop
+    whisper_token eot = 0;
+    int n_vocab = 0;
+    std::atomic<uint64_t> steps{ 0 };
+    std::atomic<uint64_t> loop_stops{ 0 };
+    std::atomic<uint64_t> steps_saved{ 0 };
+
+    // compute timing (greedy passes): encoder start -> first sampled token, and the gap between decoder steps
+    bool time_steps = false;
+    bool encoding = false;
+    bool stepped = false;
+    std::chrono::steady_clock::time_point t_encode;
+    std::chrono::steady_clock::time_point t_step;
+    std::vector<double> encode_ms;
+    std::vector<double> step_ms;
+};
+
+// True when the newest tokens are one n-gram repeated back to back: at least 3 times, and over at least 12 tokens
+// for short n-grams ("I'm going to, I'm going to, I'm going to," or the same word over and over).
+static bool ends_in_repetition_loop(const whisper_token_data * tokens, int n_tokens) {
+    for (int n = 1; n <= 8; ++n) {
+        const int repeats = std::max(3, (12 + n - 1) / n);
+        if (n * repeats > n_tokens) {
+            break;
+        }
+        const whisper_token_data * tail = tokens + (n_tokens - n * repeats);
+        bool loop = true;
+        for (int i = n; i < n * repeats && loop; ++i) {
+            loop = tail[i].id == tail[i % n].id;
+        }
+        if (loop) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Marks the start of the encoder pass, for the encode / decode-step timing.
+static bool decode_encoder_begin(whisper_context * /*ctx*/, whisper_state * /*state*/, void * user_data) {
+    decode_guard * g = static_cast<decode_guard *>(user_data);
+    if (g->time_steps) {
+        g->encoding = true;
+        g->stepped = false;
+        g->t_encode = std::chrono::steady_clock::now();
+    }
+    return true;
+}
+
+// Once the decoder loops, only end-of-text is left possible, so the segment ends on the next step.
+static void decode_filter_logits(whisper_context * /*ctx*/, whisper_state * /*state*/, const whisper_token_data * tokens, int n_tokens,
+                                 float * logits, void * user_data) {
+    decode_guard * g = static_cast<decode_guard *>(user_data);
+    g->steps++;
+    if (g->time_steps) {
+        const auto now = std::chrono::steady_clock::now();
+        if (g->encoding) {
+            g->encode_ms.push_back(1e-3 * (double) std::chrono::duration_cast<std::chrono::microseconds>(now - g->t_encode).count());
+            g->encoding = false;
+        } else if (g->stepped) {
+            g->step_ms.push_back(1e-3 * (double) std::chrono::duration_cast<std::chrono::microseconds>(now - g->t_step).count());
+        }
+        g->stepped = true;
+        g->t_step = now;
+    }
+    if (!g->loop_stop || !ends_in_repetition_loop(tokens, n_tokens)) {
+        return;
+    }
+    for (int i = 0; i < g->n_vocab; ++i) {
+        if (i != g->eot) {
+            logits[i] = -INFINITY;
+        }
+    }
+    g->loop_stops++;
+    g->steps_saved += (uint64_t) std::max(0, g->token_limit - n_tokens);
+}
+
+static bool decode_should_abort(void * user_data) {
+    decode_guard * g = static_cast<decode_guard *>(user_data);
+    if (g->cancel->load()) {
+        return true;
+    }
+    if (g->has_deadline && std::chrono::steady_clock::now() >= g->deadline) {
+        g->timed_out = true;
+        return true;
+    }
+    return false;
+}
+
+// whisper.cpp's own per-segment token limit when max_tokens is 0 (half the text context).
+static constexpr int32_t k_whisper_segment_tokens = 224;
+
+// Token budget of a block: --tokens-per-second of its speech (the voice gate's voiced time, else its duration)
+// plus a few for punctuation and very short blocks, capped by --max-tokens. 0 = no limit.
+static int32_t block_token_budget(const app_params & params, const inference_job & job) {
+    int32_t budget = params.max_tokens;
+    if (params.tokens_per_second > 0.0f) {
+        const int64_t voiced_ms = job.voiced_ms >= 0 ? job.voiced_ms : (int64_t) (job.view.size() * 1000 / WHISPER_SAMPLE_RATE);
+        const int32_t b = 8 + (int32_t) std::lround(params.tokens_per_second * 1e-3 * (double) voiced_ms);
+        budget = budget > 0 ? std::min(budget, b) : b;
+    }
+    return budget;
+}
+
+// Entropy (nats) of the token ids among the last 32, as whisper.cpp measures repetitive output in place of
+// the reference implementation's gzip compression ratio. Fewer tokens than that are not judged (returns +inf).
+static float token_tail_entropy(const std::vector<whisper_token> & ids) {
+    constexpr size_t k_tail = 32;
+    if (ids.size() < k_tail) {
+        return INFINITY;
+    }
+    std::vector<whisper_token> tail(ids.end() - k_tail, ids.end());
+    std::sort(tail.begin(), tail.end());
+    double entropy = 0.0;
+    for (size_t i = 0; i < tail.size();) {
+        size_t j = i;
+        while (j < tail.size() && tail[j] == tail[i]) ++j;
+        const double p = (double) (j - i) / (double) k_tail;
+        entropy -= p * std::log(p);
+        i = j;
+    }
+    return (float) entropy;
+}
+
+// Assembles the job's mel from the frames computed during speech, once per job (its re-decodes reuse it).
+static void prepare_block_mel(transcribe_state & st, const inference_job & job) {
+    if (st.mel_job == job.id) {
+        return;
+    }
+    const double t0 = thread_cpu_seconds();
+    log_mel_build_stats bs;
+    st.mel_n_len = st.mel->build(job.view, job.mel.get(), st.mel_block, st.mel_n_len_org, &bs);
+    st.mel_job = job.id;
+    st.mel_st.blocks++;
+    st.mel_st.reused += bs.reused;
+    st.mel_st.computed += bs.computed;
+    st.mel_st.build_s += thread_cpu_seconds() - t0;
+}
+
+// Which whisper_full() run of a block this is.
+enum class decode_pass {
+    first,    // greedy, or beam search under --decode-policy beam
+    beam,     // --decode-policy adaptive: beam re-decode of a weak greedy pass, in the language that pass used
+    fallback, // the cheap retry after a missed deadline
+};
+
+// Runs Whisper over the job's samples. On failure `fail` says why (aborted, dropped or failed).
+// The fallback pass is the cheap retry after a missed deadline: one segment, a token cap, no temperature retries,
+// no language-detect pass, and the --fallback-model when there is one. Other passes run on --model-map's model for
+// the block's language, if it has one.
+static bool decode_block(transcribe_state & st, const inference_job & job, decode_guard & guard, decode_pass pass,
+                         decoded_block & out, inference_outcome & fail) {
+    const app_params & params = *st.params;
+    const bool fallback = pass == decode_pass::fallback;
+    const bool beam = pass == decode_pass::beam || (pass == decode_pass::first && params.policy == decode_policy::beam);
+    whisper_context * ctx = st.ctx;
+    const audio_view & block_view = job.view;
+    const std::atomic<bool> & abort = *guard.cancel;
+
+    // The block waited in the queue while capture kept writing.
+    if (st.audio && !st.audio->still_valid(block_view)) {
+        std::fprintf(stderr, "warning: block was overwritten before inference (more than %ds of capture queued); dropping it\n",
+            capture_source::k_view_headroom_ms / 1000);
+        fail = inference_outcome::dropped;
+        return false;
+    }
+
+    // With frames precomputed during speech, whisper gets the mel instead of the samples (if the model's mel matches).
+    auto mel_fits = [&](whisper_context * c) {
+        if (!st.mel || !job.mel || whisper_model_n_mels(c) != st.mel->n_mel()) {
+            return false;
+        }
+        prepare_block_mel(st, job);
+        return true;
+    };
+    const float * block_pcm = nullptr;
+    auto samples = [&]() {
+        if (!block_pcm) {
+            block_pcm = block_view.linearize(st.pcm_block);
+        }
+        return block_pcm;
+    };
+
+    // Language selection, before the model: with --model-map the language picks it.
+    // - If user asked for auto, whisper detects the language in the decode; with --model-map a detection pass here
+    //   picks the language (and so the model) first.
+    // - If language is English (default) AND the detecting model is multilingual, auto-fallback to French when French is clearly more likely.
+    // Detection runs on --lid-model when there is one ("auto" left means: detect in the decode).
+    whisper_context * lid_ctx = st.lid_ctx ? st.lid_ctx : st.ctx;
+    std::string effective_language = params.language;
+    if (params.language != "auto" || st.router) {
+        if (pass != decode_pass::first) {
+            // No separate detection pass on a re-decode: keep the last language that was picked.
+            effective_language = st.last_language.empty() ? params.language : st.last_language;
+        } else if ((params.language == "en" || params.language == "auto") && whisper_is_multilingual(lid_ctx)) {
+            const bool any = params.language == "auto";
+            const auto pick = [&](const float * pcm, size_t n) {
+                return any ? pick_language(lid_ctx, pcm, n, params.threads) : pick_language_en_fallback_fr(lid_ctx, pcm, n, params.threads);
+            };
+            if (params.fast) {
+                // Keep fast mode snappy: detect from a short tail instead of the full block.
+                const int32_t tail_ms = std::min<int32_t>(1500, std::max<int32_t>(500, params.length_ms));
+                const size_t tail_samples = (size_t) (tail_ms * WHISPER_SAMPLE_RATE / 1000);
+                const audio_view tail = block_view.tail(tail_samples);
+                effective_language = pick(tail.linearize(st.pcm_lang), tail.size());
+            } else if (mel_fits(lid_ctx)) {
+                whisper_set_mel(lid_ctx, st.mel_block.data(), st.mel_n_len, st.mel->n_mel());
+                effective_language = any ? pick_language_mel(lid_ctx, params.threads) : pick_language_en_fallback_fr_mel(lid_ctx, params.threads);
+            } else {
+                effective_language = pick(samples(), block_view.size());
+            }
+        }
+        if (pass == decode_pass::first) {
+            st.last_language = effective_language;
+        }
+    }
+    if (fallback && st.fallback_ctx) {
+        ctx = st.fallback_ctx;
+    } else if (st.router && effective_language != "auto") {
+        if (whisper_context * routed = st.router->get(effective_language)) {
+            ctx = routed;
+        }
+    }
+    if (effective_language != "auto" && !whisper_is_multilingual(ctx)) {
+        effective_language = "en";
+    }
+    const bool use_mel = mel_fits(ctx);
+
+    whisper_full_params wparams = whisper_full_default_params(beam ? WHISPER_SAMPLING_BEAM_SEARCH : WHISPER_SAMPLING_GREEDY);
+    wparams.print_progress = false;
+    wparams.print_realtime = false;
+    wparams.print_special = false;
+    wparams.print_timestamps = false;
+    wparams.no_timestamps = params.fast ? true : false;
+    wparams.suppress_blank = true;
+    wparams.suppress_nst = params.fast ? true : false;
+    wparams.translate = params.translate;
+    wparams.single_segment = params.fast ? true : false;
+    wparams.max_tokens = block_token_budget(params, job);
+    wparams.no_context = params.fast ? true : false;
+    if (params.fast) {
+        // Greedy decoding: minimize extra sampling work.
+        wparams.greedy.best_of = 1;
+    }
+    if (beam) {
+        wparams.beam_search.beam_size = params.beam_size;
+    }
+    if (params.policy != decode_policy::whisper) {
+        // The policy picks the re-decode itself: no hidden temperature retries.
+        wparams.temperature_inc = 0.0f;
+    }
+    // A chunk of a long utterance continues the previous chunk's sentence.
+    if (!fallback && job.utterance != 0 && job.utterance == st.carry_utterance && !st.carry_text.empty()) {
+        wparams.initial_prompt = st.carry_text.c_str();
+    }
+    if (fallback) {
+        const int32_t cap = 8 + 4 * (int32_t) (block_view.size() / WHISPER_SAMPLE_RATE);
+        wparams.single_segment = true;
+        wparams.no_context = true;
+        wparams.max_tokens = wparams.max_tokens > 0 ? std::min(wparams.max_tokens, cap) : cap;
+        wparams.greedy.best_of = 1;
+        wparams.temperature_inc = 0.0f;
+    }
+    wparams.abort_callback = decode_should_abort;
+    wparams.abort_callback_user_data = &guard;
+    guard.time_steps = !beam;
+    wparams.encoder_begin_callback = decode_encoder_begin;
+    wparams.encoder_begin_callback_user_data = &guard;
+    guard.loop_stop = params.loop_stop;
+    guard.token_limit = wparams.max_tokens > 0 ? wparams.max_tokens : k_whisper_segment_tokens;
+    guard.eot = whisper_token_eot(ctx);
+    guard.n_vocab = whisper_n_vocab(ctx);
+    wparams.logits_filter_callback = decode_filter_logits;
+    wparams.logits_filter_callback_user_data = &guard;
+    // detect_language would stop after the detection; "auto" detects the language and decodes in the same pass.
+    wparams.detect_language = false;
+    wparams.language = effective_language.c_str();
+    wparams.n_threads = params.threads;
+    wparams.audio_ctx = 0;
+
+    int rc = 0;
+    if (use_mel) {
+        // No samples: whisper_full() keeps the mel set here and stops at the audio's own frames, not the padding.
+        wparams.duration_ms = 10 * st.mel_n_len_org;
+        rc = whisper_set_mel(ctx, st.mel_block.data(), st.mel_n_len, st.mel->n_mel());
+        if (rc == 0) {
+            rc = whisper_full(ctx, wparams, nullptr, 0);
+        }
+    } else {
+        rc = whisper_full(ctx, wparams, samples(), (int) block_view.size());
+    }
+    st.decoder.steps += guard.steps;
+    st.decoder.loop_stops += guard.loop_stops;
+    st.decoder.steps_saved += guard.steps_saved;
+    st.decoder.encode_ms.insert(st.decoder.encode_ms.end(), guard.encode_ms.begin(), guard.encode_ms.end());
+    st.decoder.step_ms.insert(st.decoder.step_ms.end(), guard.step_ms.begin(), guard.step_ms.end());
+    if (abort) {
+        fail = inference_outcome::aborted;
+        return false;
+    }
+    if (guard.timed_out) {
+        fail = inference_outcome::timed_out;
+        return false;
+    }
+    if (rc != 0) {
+        std::fprintf(stderr, "whisper_full failed\n");
+        fail = inference_outcome::failed;
+        return false;
+    }
+    // Whisper read the samples in place; if capture lapped the ring meanwhile, the text may be garbage.
+    if (st.audio && !st.audio->still_valid(block_view)) {
+        std::fprintf(stderr, "warning: block was overwritten during inference (more than %ds of capture); dropping it\n",
+            capture_source::k_view_headroom_ms / 1000);
+        fail = inference_outcome::dropped;
+        return false;
+    }
+
+    out = decoded_block{};
+    out.n_segments = whisper_full_n_segments(ctx);
+    const whisper_token eot = whisper_token_eot(ctx);
+    double sum_logprob = 0.0;
+    std::vector<whisper_token> tail_ids;
+    if (params.debug_thankyou) {
+        out.seg_ns.reserve(out.n_segments);
+        out.seg_tok.reserve(out.n_segments);
+        out.seg_t0.reserve(out.n_segments);
+        out.seg_t1.reserve(out.n_segments);
+    }
+    for (int i = 0; i < out.n_segments; ++i) {
+        const float ns = whisper_full_get_segment_no_speech_prob(ctx, i);
+        out.max_no_speech_prob = std::max(out.max_no_speech_prob, ns);
+        if (params.debug_thankyou) {
+            out.seg_ns.push_back(ns);
+            out.seg_tok.push_back(whisper_full_n_tokens(ctx, i));
+            out.seg_t0.push_back(whisper_full_get_segment_t0(ctx, i));
+            out.seg_t1.push_back(whisper_full_get_segment_t1(ctx, i));
+        }
+        const char * seg = whisper_full_get_segment_text(ctx, i);
+        if (seg) out.text += seg;
+
+        const int n_tokens = whisper_full_n_tokens(ctx, i);
+        for (int j = 0; j < n_tokens; ++j) {
+            const whisper_token_data td = whisper_full_get_token_data(ctx, i, j);
+            if (td.id >= eot) {
+                continue;
+            }
+            out.n_text_tokens++;
+            sum_logprob += td.plog;
+            tail_ids.push_back(td.id);
+        }
+    }
+    if (out.n_text_tokens > 0) {
+        out.avg_logprob = (float) (sum_logprob / out.n_text_tokens);
+    }
+    out.tail_entropy = token_tail_entropy(tail_ids);
+
+    out.text = trim_and_collapse_ws(out.text);
+    if (guard.loop_stops > 0) {
+        out.text = collapse_repeated_phrases(out.text);
+    }
+    return true;
+}
+
+// Rough cost of a beam search pass relative to the greedy pass over the same block.
+static constexpr double k_beam_cost_x = 2.5;
+
+// --decode-policy adaptive: re-decodes a weak greedy result with beam search when the block's deadline has room
+// for it and no other block is waiting. The beam text replaces the greedy text only if it scores better; a beam
+// pass that times out, fails or finds its samples overwritten leaves the greedy text (decoded while they were intact).
+// Returns false only when the job was aborted meanwhile.
+static bool redecode_if_weak(transcribe_state & st, const inference_job & job, const decode_guard & first,
+                             std::chrono::steady_clock::time_point t_start, decoded_block & out, inference_outcome & fail) {
+    const app_params & params = *st.params;
+    const bool weak_logprob = out.n_text_tokens > 0 && out.avg_logprob < params.beam_logprob_thold;
+    const bool weak_entropy = out.tail_entropy < params.beam_entropy_thold;
+    if (!weak_logprob && !weak_entropy) {
+        return true;
+    }
+    if (st.worker && st.worker->queued() > 0) {
+        st.policy.skipped_backlog++;
+        return true;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (first.has_deadline) {
+        const double greedy_ms = std::chrono::duration<double, std::milli>(now - t_start).count();
+        const double left_ms = std::chrono::duration<double, std::milli>(first.deadline - now).count();
+        if (left_ms < k_beam_cost_x * greedy_ms) {
+            st.policy.skipped_budget++;
+            return true;
+        }
+    }
+
+    st.policy.redecodes++;
+    if (weak_logprob) st.policy.weak_logprob++;
+    if (weak_entropy) st.policy.weak_entropy++;
+
+    decode_guard guard;
+    guard.cancel = first.cancel;
+    guard.has_deadline = first.has_deadline;
+    guard.deadline = first.deadline;
+    decoded_block beam;
+    inference_outcome beam_fail = inference_outcome::pending;
+    if (!decode_block(st, job, guard, decode_pass::beam, beam, beam_fail)) {
+        if (beam_fail == inference_outcome::aborted) {
+            fail = beam_fail;
+            return false;
+        }
+        return true;
+    }
+    // Repetitive greedy text loses to anything that is not; otherwise the higher average log-prob wins.
+    bool better = beam.n_text_tokens > 0 && beam.avg_logprob > out.avg_logprob;
+    if (weak_entropy && beam.tail_entropy >= params.beam_entropy_thold) {
+        better = true;
+    }
+    if (better) {
+        st.policy.redecode_kept++;
+        out = std::move(beam);
+    }
+    return true;
+}
+
+// Compute budget for a block: --decode-deadline-x times its duration, at least --decode-deadline-min-ms (0 = none).
+static int64_t decode_budget_ms(const app_params & params, size_t n_samples) {
+    if (params.decode_deadline_x <= 0.0f) {
+        return 0;
+    }
+    const double audio_ms = 1000.0 * (double) n_samples / (double) WHISPER_SAMPLE_RATE;
+    return std::max<int64_t>(params.decode_deadline_min_ms, (int64_t) std::lround(params.decode_deadline_x * audio_ms));
+}
+
+// decode_block() under the block's compute deadline. A timeout gets one cheaper retry with half the budget
+// (--decode-fallback single) or drops the block (--decode-fallback drop), so a block costs at most 1.5x its budget.
+static bool decode_with_deadline(transcribe_state & st, const inference_job & job, const std::atomic<bool> & abort,
+                                 decoded_block & out, inference_outcome & fail) {
+    const app_params & params = *st.params;
+    const int64_t budget_ms = decode_budget_ms(params, job.view.size());
+    const double block_s = (double) job.view.size() / (double) WHISPER_SAMPLE_RATE;
+
+    const auto t_start = std::chrono::steady_clock::now();
+    decode_guard guard;
+    guard.cancel = &abort;
+    guard.has_deadline = budget_ms > 0;
+    guard.deadline = t_start + std::chrono::milliseconds(budget_ms);
+    if (decode_block(st, job, guard, decode_pass::first, out, fail)) {
+        if (params.policy == decode_policy::beam) {
+            st.policy.beam++;
+        } else {
+            st.policy.greedy++;
+        }
+        if (params.policy == decode_policy::adaptive) {
+            return redecode_if_weak(st, job, guard, t_start, out, fail);
+        }
+        return true;
+    }
+    if (fail != inference_outcome::timed_out) {
+        return false;
+    }
+
+    st.deadline.timeouts++;
+    if (!params.decode_fallback) {
+        st.deadline.dropped++;
+        std::fprintf(stderr, "warning: decode of a %.1fs block passed its %lldms deadline; dropping it (--decode-fallback drop)\n",
+            block_s, (long long) budget_ms);
+        return false;
+    }
+
+    std::fprintf(stderr, "warning: decode of a %.1fs block passed its %lldms deadline; retrying with one segment and a token cap%s\n",
+        block_s, (long long) budget_ms, st.fallback_ctx ? " on the fallback model" : "");
+    decode_guard retry;
+    retry.cancel = &abort;
+    retry.has_deadline = true;
+    retry.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max<int64_t>(1, budget_ms / 2));
+    if (decode_block(st, job, retry, decode_pass::fallback, out, fail)) {
+        st.deadline.recovered++;
+        return true;
+    }
+    if (fail == inference_outcome::timed_out) {
+        st.deadline.dropped++;
+        std::fprintf(stderr, "warning: fallback decode of the %.1fs block also timed out; dropping it\n", block_s);
+    }
+    return false;
+}
+
+// Filters and emits one decoded block.
+static inference_outcome emit_block(transcribe_state & st, const inference_job & job, const decoded_block & d) {
+    const app_params & params = *st.params;
+    const std::string & text = d.text;
+    const int n_segments = d.n_segments;
+    const float max_no_speech_prob = d.max_no_speech_prob;
+
+    if (job.utterance != 0 && !job.probe) {
+        st.carry_utterance = job.chunk ? job.utterance : 0;
+        st.carry_text = job.chunk ? text : std::string();
+    }
+
+    if (job.probe && !ends_with_sentence_punct(text)) {
+        if (st.trace) {
+            std::fprintf(stderr, "[VG] PROBE_REJECT text_len=%zu\n", text.size());
+            std::fflush(stderr);
+        }
+        return inference_outcome::rejected;
+    }
+
+    if (text.empty()) {
+        return inference_outcome::filtered;
+    }
+
+    // whisper.cpp can emit this special token when the audio block is effectively silence.
+    // Don't send it to Streamer.bot.
+    if (text == "[BLANK_AUDIO]") {
+        return inference_outcome::filtered;
+    }
+
+    const float block_frac = job.stats.activity_fraction();
+    const float block_rms  = job.stats.rms();
+    const float vad_frac   = job.window_stats.activity_fraction();
+    const float vad_rms    = job.window_stats.rms();
+
+    const bool is_thanks = is_exact_thank_you(text);
+    const bool is_you = is_exact_you(text);
+    const bool is_garbage = is_short_garbage_like(text);
+    const bool suppress_thanks = params.fast && is_thanks && max_no_speech_prob >= 0.80f;
+
+    // Suppress common near-silence end-of-utterance garbage.
+    // Keep this conservative: only when Whisper itself says it's probably no-speech.
+    // If the confidence is extremely high, allow suppression even with some background noise.
+    const bool suppress_silence_garbage =
+        (is_you || is_garbage) &&
+        (
+            (max_no_speech_prob >= 0.95f) ||
+            (max_no_speech_prob >= 0.85f && block_frac < 0.02f)
+        );
+
+    if (params.debug_thankyou && is_thanks) {
+        std::fprintf(stderr,
+            "[DBG thankyou] suppress=%d max_no_speech=%.2f block: frac=%.3f rms=%.6f vad: frac=%.3f rms=%.6f segs=%d\n",
+            suppress_thanks ? 1 : 0,
+            max_no_speech_prob,
+            block_frac,
+            block_rms,
+            vad_frac,
+            vad_rms,
+            n_segments);
+        for (int i = 0; i < n_segments; ++i) {
+            // whisper segment times are in 10ms units
+            const long long t0_ms = (long long) (d.seg_t0[i] * 10);
+            const long long t1_ms = (long long) (d.seg_t1[i] * 10);
+            std::fprintf(stderr,
+                "  [DBG thankyou] seg=%d ns=%.2f tok=%d t=%lld-%lld(ms)\n",
+                i,
+                d.seg_ns[i],
+                d.seg_tok[i],
+                t0_ms,
+                t1_ms);
+        }
+    }
+
+    // Tiny models can hallucinate short polite phrases after an utterance or during near-silence.
+    // Only suppress this in fast mode AND only when whisper itself says it's likely no-speech.
+    if (suppress_thanks) {
+        return inference_outcome::filtered;
+    }
+
+    if (suppress_silence_garbage) {
+        return inference_outcome::filtered;
+    }
+
+    // De-dupe: skip very similar repeats (common with sliding windows).
+    if (!st.last_sent.empty()) {
+        // Strong de-dupe for the common suffix-repeat artifact:
+        //   "hello this is a test" -> "this is a test" -> "is a test" -> ...
+        if (is_suffix_repeat_by_words(st.last_sent, text)) {
+            return inference_outcome::filtered;
+        }
+        const float sim = ::similarity(st.last_sent, text);
+        if (sim >= params.dedup_similarity) {
+            return inference_outcome::filtered;
+        }
+    }
+
+    const size_t k_wrap_cols = 30;
+    const std::string text_wrapped = (text.size() > k_wrap_cols) ? wrap_text_wordwise_cols(text, k_wrap_cols) : text;
+
+    if (st.captions) {
+        st.captions->push_back(text);
+    } else {
+        std::printf("[%d] %s\n", st.iter++, text_wrapped.c_str());
+        std::fflush(stdout);
+
+        // Enqueue for Streamer.bot sending (length-based throttling handled by worker thread).
+        st.bot_sender->enqueue(streamerbot_send_item{ text_wrapped, text.size() });
+    }
+
+    st.last_sent = text;
+    return inference_outcome::emitted;
+}
+
+// Counts a held speculative result nothing used as wasted work, and forgets it.
+static void discard_held(transcribe_state & st) {
+    if (st.held_id != 0 && !st.held_used) {
+        st.spec.wasted++;
+        st.spec.wasted_ms += st.held_ms;
+    }
+    st.held_id = 0;
+    st.held_used = false;
+}
+
+// One worker job: decode (or take the held speculative result), then filter and emit.
+static inference_outcome transcribe_block(transcribe_state & st, const inference_job & job, const std::atomic<bool> & abort) {
+    if (job.reuse != 0 && job.reuse == st.held_id) {
+        if (!st.held_used) {
+            st.held_used = true;
+            st.spec.used++;
+        }
+        return emit_block(st, job, st.held);
+    }
+    discard_held(st);
+
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    decoded_block d;
+    inference_outcome fail = inference_outcome::failed;
+    const bool ok = decode_with_deadline(st, job, abort, d, fail);
+    if (!job.speculative) {
+        return ok ? emit_block(st, job, d) : fail;
+    }
+
+    st.spec.started++;
+    const double ms = 1e-3 * (double) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - t0).count();
+    if (!ok) {
+        // Speech resumed (or the block went stale) before the result could be used.
+        st.spec.wasted++;
+        st.spec.wasted_ms += ms;
+        return fail;
+    }
+    st.held_id = job.id;
+    st.held_used = false;
+    st.held_ms = ms;
+    st.held = std::move(d);
+    return inference_outcome::held;
+}
+
+// Silence between the utterances of a micro-batch: long enough that Whisper ends a segment there.
+static constexpr int32_t k_batch_gap_ms = 1000;
+
+// Decode steps a micro-batch budgets per utterance on top of its text: the timestamps opening and closing its segment.
+static constexpr int32_t k_batch_timestamp_tokens = 2;
+
+// A job is batched with the ones queued behind it only if it is a plain short flush: no probe, speculative or
+// reused decode, and no piece of chunked speech (those need the previous chunk's text as their prompt).
+static bool batchable_job(const transcribe_state & st, const inference_job & job) {
+    const app_params & params = *st.params;
+    if (job.probe || job.speculative || job.chunk || job.reuse != 0) {
+        return false;
+    }
+    if (job.utterance != 0 && job.utterance == st.carry_utterance) {
+        return false;
+    }
+    return job.view.size() <= (size_t) params.batch_short_ms * WHISPER_SAMPLE_RATE / 1000;
+}
+
+// Several short queued utterances in one whisper_full(): their samples back to back with k_batch_gap_ms of
+// silence in between, so they share one encoder pass. Each segment goes back to the utterance its timestamps fall
+// in; a segment that spans a gap is split by its token timestamps. Every utterance is then filtered and emitted
+// on its own, in queue order. A failed or timed-out batch is decoded one utterance at a time instead.
+static std::vector<inference_outcome> transcribe_batch(transcribe_state & st, const std::vector<inference_job> & jobs,
+                                                       const std::atomic<bool> & abort) {
+    const app_params & params = *st.params;
+    whisper_context * ctx = st.ctx;
+    // On the model of the last block's language (--model-map), like the language itself below.
+    if (st.router && !st.last_language.empty()) {
+        if (whisper_context * routed = st.router->get(st.last_language)) {
+            ctx = routed;
+        }
+    }
+    std::vector<inference_outcome> outcomes(jobs.size(), inference_outcome::dropped);
+    discard_held(st);
+
+    // Copy the samples out of the ring, and check none was overwritten while they waited or while copying.
+    struct batch_span {
+        size_t job = 0;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+    std::vector<batch_span> spans;
+    std::vector<float> & pcm = st.pcm_batch;
+    pcm.clear();
+    const size_t gap = (size_t) k_batch_gap_ms * WHISPER_SAMPLE_RATE / 1000;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const audio_view & v = jobs[i].view;
+        const size_t begin = pcm.size();
+        pcm.insert(pcm.end(), v.p0, v.p0 + v.n0);
+        pcm.insert(pcm.end(), v.p1, v.p1 + v.n1);
+        audio_copy_record(v.size());
+        if (st.audio && !st.audio->still_valid(v)) {
+            std::fprintf(stderr, "warning: block was overwritten before inference (more than %ds of capture queued); dropping it\n",
+                capture_source::k_view_headroom_ms / 1000);
+            pcm.resize(begin);
+            continue;
+        }
+        spans.push_back(batch_span{ i, begin, pcm.size() });
+        pcm.insert(pcm.end(), gap, 0.0f);
+    }
+    if (spans.size() <= 1) {
+        for (const batch_span & sp : spans) {
+            outcomes[sp.job] = transcribe_block(st, jobs[sp.job], abort);
+        }
+        return outcomes;
+    }
+
+    // The batch gets the sum of its utterances' token budgets and compute deadlines (no cap if one has none).
+    // max_tokens bounds the decode steps of the whole window pass, so each utterance also brings the timestamp
+    // tokens around its text.
+    int32_t max_tokens = 0;
+    bool capped = true;
+    int64_t budget_ms = 0;
+    for (const batch_span & sp : spans) {
+        const int32_t b = block_token_budget(params, jobs[sp.job]);
+        capped = capped && b > 0;
+        max_tokens += b + k_batch_timestamp_tokens;
+        budget_ms += decode_budget_ms(params, jobs[sp.job].view.size());
+    }
+    if (!capped) {
+        max_tokens = 0;
+    }
+
+    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    wparams.print_progress = false;
+    wparams.print_realtime = false;
+    wparams.print_special = false;
+    wparams.print_timestamps = false;
+    // Timestamps are what splits the text back up, even in --fast mode.
+    wparams.no_timestamps = false;
+    wparams.single_segment = false;
+    wparams.token_timestamps = true;
+    wparams.no_context = true;
+    wparams.suppress_blank = true;
+    wparams.suppress_nst = params.fast ? true : false;
+    wparams.translate = params.translate;
+    wparams.max_tokens = max_tokens;
+    if (params.fast) {
+        wparams.greedy.best_of = 1;
+    }
+    if (params.policy != decode_policy::whisper) {
+        wparams.temperature_inc = 0.0f;
+    }
+    // No separate language pass: a backlog is no time for it. Keep the language of the last block.
+    // With nothing to keep, "auto" has whisper detect it in the decode pass (detect_language would stop there).
+    std::string language = params.language;
+    wparams.detect_language = false;
+    if (params.language != "auto" || (st.router && !st.last_language.empty() && st.last_language != "auto")) {
+        if (!st.last_language.empty()) {
+            language = st.last_language;
+        }
+        if (!whisper_is_multilingual(ctx)) {
+            language = "en";
+        }
+    }
+    wparams.language = language.c_str();
+    wparams.n_threads = params.threads;
+    wparams.audio_ctx = 0;
+
+    decode_guard guard;
+    guard.cancel = &abort;
+    guard.has_deadline = budget_ms > 0;
+    guard.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budget_ms);
+    guard.loop_stop = params.loop_stop;
+    guard.token_limit = wparams.max_tokens > 0 ? wparams.max_tokens : k_whisper_segment_tokens;
+    guard.eot = whisper_token_eot(ctx);
+    guard.n_vocab = whisper_n_vocab(ctx);
+    wparams.abort_callback = decode_should_abort;
+    wparams.abort_callback_user_data = &guard;
+    guard.time_steps = true;
+    wparams.encoder_begin_callback = decode_encoder_begin;
+    wparams.encoder_begin_callback_user_data = &guard;
+    wparams.logits_filter_callback = decode_filter_logits;
+    wparams.logits_filter_callback_user_data = &guard;
+
+    const int rc = whisper_full(ctx, wparams, pcm.data(), (int) pcm.size());
+    st.decoder.steps += guard.steps;
+    st.decoder.loop_stops += guard.loop_stops;
+    st.decoder.steps_saved += guard.steps_saved;
+    st.decoder.encode_ms.insert(st.decoder.encode_ms.end(), guard.encode_ms.begin(), guard.encode_ms.end());
+    st.decoder.step_ms.insert(st.decoder.step_ms.end(), guard.step_ms.begin(), guard.step_ms.end());
+    if (abort) {
+        for (const batch_span & sp : spans) {
+            outcomes[sp.job] = inference_outcome::aborted;
+        }
+        return outcomes;
+    }
+    if (rc != 0 || guard.timed_out) {
+        std::fprintf(stderr, "warning: batched decode of %zu utterances %s; decoding them one by one\n",
+            spans.size(), rc != 0 ? "failed" : "passed its deadline");
+        st.batch.fallbacks++;
+        for (const batch_span & sp : spans) {
+            outcomes[sp.job] = transcribe_block(st, jobs[sp.job], abort);
+        }
+        return outcomes;
+    }
+    st.batch.batches++;
+    st.batch.jobs += spans.size();
+
+    // Utterance k owns the batch from halfway through the gap before it to halfway through the gap after it.
+    auto owner = [&](int64_t t_cs) -> size_t {
+        const int64_t at = t_cs * WHISPER_SAMPLE_RATE / 100;
+        size_t k = 0;
+        while (k + 1 < spans.size() && at >= (int64_t) (spans[k + 1].begin - gap / 2)) {
+            ++k;
+        }
+        return k;
+    };
+    std::vector<decoded_block> out(spans.size());
+    const whisper_token eot = whisper_token_eot(ctx);
+    auto add_segment = [&](size_t k, int i, int64_t t0, int64_t t1) {
+        decoded_block & d = out[k];
+        const float ns = whisper_full_get_segment_no_speech_prob(ctx, i);
+        d.n_segments++;
+        d.max_no_speech_prob = std::max(d.max_no_speech_prob, ns);
+        if (params.debug_thankyou) {
+            const int64_t base_cs = (int64_t) spans[k].begin * 100 / WHISPER_SAMPLE_RATE;
+            d.seg_ns.push_back(ns);
+            d.seg_tok.push_back(whisper_full_n_tokens(ctx, i));
+            d.seg_t0.push_back(t0 - base_cs);
+            d.seg_t1.push_back(t1 - base_cs);
+        }
+    };
+    const int n_segments = whisper_full_n_segments(ctx);
+    for (int i = 0; i < n_segments; ++i) {
+        const int64_t t0 = whisper_full_get_segment_t0(ctx, i);
+        const int64_t t1 = whisper_full_get_segment_t1(ctx, i);
+        const size_t k0 = owner(t0);
+        const size_t k1 = owner(std::max(t0, t1 - 1));
+        if (k0 == k1) {
+            const char * seg = whisper_full_get_segment_text(ctx, i);
+            if (seg) out[k0].text += seg;
+            add_segment(k0, i, t0, t1);
+            continue;
+        }
+        // The segment runs across a gap: hand out its tokens one by one.
+        std::vector<bool> touched(spans.size(), false);
+        const int n_tokens = whisper_full_n_tokens(ctx, i);
+        for (int j = 0; j < n_tokens; ++j) {
+            const whisper_token_data td = whisper_full_get_token_data(ctx, i, j);
+            if (td.id >= eot) {
+                continue;
+            }
+            const size_t k = td.t0 >= 0 && td.t1 >= td.t0 ? owner((td.t0 + td.t1) / 2) : k0;
+            const char * tok = whisper_full_get_token_text(ctx, i, j);
+            if (tok) out[k].text += tok;
+            if (!touched[k]) {
+                touched[k] = true;
+                add_segment(k, i, t0, t1);
+            }
+        }
+    }
+
+    for (size_t k = 0; k < spans.size(); ++k) {
+        decoded_block & d = out[k];
+        d.text = trim_and_collapse_ws(d.text);
+        if (guard.loop_stops > 0) {
+            d.text = collapse_repeated_phrases(d.text);
+        }
+        outcomes[spans[k].job] = emit_block(st, jobs[spans[k].job], d);
+    }
+    return outcomes;
+}
+
+// One clip of the --bench-models corpus, decoded as a single block.
+struct bench_clip {
+    std::string path;
+    std::vector<float> pcm;
+    bool has_reference = false;
+    std::string reference;
+};
+
+// Greedy first pass over a whole clip, with the live decoder's settings but no policy re-decodes, deadline or
+// en/fr fallback detection. False when whisper_full() fails.
+static bool bench_decode_clip(whisper_context * ctx, const app_params & params, int n_threads, const std::vector<float> & pcm, std::string & text) {
+    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    wparams.print_progress = false;
+    wparams.print_realtime = false;
+    wparams.print_special = false;
+    wparams.print_timestamps = false;
+    wparams.no_timestamps = params.fast ? true : false;
+    wparams.suppress_blank = true;
+    wparams.suppress_nst = params.fast ? true : false;
+    wparams.translate = params.translate;
+    wparams.single_segment = params.fast ? true : false;
+    wparams.max_tokens = params.max_tokens;
+    // Clips are unrelated: no prompt carried from one to the next.
+    wparams.no_context = true;
+    wparams.greedy.best_of = 1;
+    if (params.policy != decode_policy::whisper) {
+        wparams.temperature_inc = 0.0f;
+    }
+    // "auto" detects the language in the decode pass; detect_language would return before decoding.
+    wparams.detect_language = false;
+    if (params.language == "auto") {
+        wparams.language = "auto";
+    } else {
+        wparams.language = whisper_is_multilingual(ctx) ? params.language.c_str() : "en";
+    }
+    wparams.n_threads = n_threads;
+    wparams.audio_ctx = 0;
+    if (whisper_full(ctx, wparams, pcm.data(), (int) pcm.size()) != 0) {
+        return false;
+    }
+    text.clear();
+    const int n_segments = whisper_full_n_segments(ctx);
+    for (int i = 0; i < n_segments; ++i) {
+        text += whisper_full_get_segment_text(ctx, i);
+    }
+    text = trim_and_collapse_ws(text);
+    return true;
+}
+
+// --bench-models: every ggml-*.bin in the models directory against a corpus of clips, flash attention off and on,
+// at each thread count. One row per configuration (stdout), then the pick for --bench-target-ms (stderr).
+static int run_bench_models(const app_params & params) {
+    namespace fs = std::filesystem;
+    if (params.bench_corpus.empty()) {
+        std::fprintf(stderr, "error: --bench-models requires --bench-corpus <dir|manifest>\n");
+        return 1;
+    }
+
+    struct bench_model {
+        std::string path;
+        uintmax_t bytes = 0;
+    };
+    std::vector<bench_model> models;
+    std::error_code ec;
+    for (fs::directory_iterator it(params.models_dir, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        if (it->is_regular_file(ec) && name.rfind("ggml-", 0) == 0 && it->path().extension() == ".bin" &&
+            name.find("silero") == std::string::npos) {
+            models.push_back({ it->path().string(), it->file_size(ec) });
+        }
+    }
+    std::sort(models.begin(), models.end(), [](const bench_model & a, const bench_model & b) { return a.path < b.path; });
+    if (models.empty()) {
+        std::fprintf(stderr, "error: no ggml-*.bin Whisper models in %s\n", params.models_dir.c_str());
+        return 2;
+    }
+
+    std::vector<std::string> files;
+    if (!corpus_list(params.bench_corpus, files)) {
+        std::fprintf(stderr, "error: cannot read --bench-corpus %s\n", params.bench_corpus.c_str());
+        return 2;
+    }
+    std::vector<bench_clip> clips;
+    uint64_t audio_samples = 0;
+    size_t n_referenced = 0;
+    for (const std::string & path : files) {
+        bench_clip c;
+        c.path = path;
+        std::vector<std::vector<float>> pcm_stereo;
+        if (!read_audio_data(path, c.pcm, pcm_stereo, /*stereo*/false) || c.pcm.empty()) {
+            std::fprintf(stderr, "warning: skipping unreadable or empty clip: %s\n", path.c_str());
+            continue;
+        }
+        c.has_reference = corpus_reference(path, c.reference);
+        n_referenced += c.has_reference ? 1 : 0;
+        audio_samples += c.pcm.size();
+        clips.push_back(std::move(c));
+    }
+    if (clips.empty()) {
+        std::fprintf(stderr, "error: no clips in %s\n", params.bench_corpus.c_str());
+        return 2;
+    }
+    const double audio_ms = 1000.0 * (double) audio_samples / (double) WHISPER_SAMPLE_RATE;
+
+    std::vector<int> thread_counts;
+    for (double t : params.bench_threads) {
+        thread_counts.push_back(std::max(1, (int) t));
+    }
+    if (thread_counts.empty()) {
+        const int hw = std::max(1, (int) std::thread::hardware_concurrency());
+        for (int t = 1; t < hw; t *= 2) {
+            thread_counts.push_back(t);
+        }
+        thread_counts.push_back(hw);
+    }
+
+    std::fprintf(stderr, "\nModel bench: %zu models x flash-attn off/on x %zu thread counts\n", models.size(), thread_counts.size());
+    std::fprintf(stderr, "- corpus: %s (%zu clips, %.1fs, %zu with reference text)\n", params.bench_corpus.c_str(), clips.size(), 1e-3 * audio_ms, n_referenced);
+    std::fprintf(stderr, "- language=%s gpu=%s target p90 <= %dms\n\n", params.language.c_str(), params.use_gpu ? "on" : "off", params.bench_target_ms);
+
+    struct config_result {
+        const bench_model * model = nullptr;
+        bool flash_attn = false;
+        int threads = 0;
+        int64_t load_ms = 0;
+        size_t rss_bytes = 0; // peak resident memory sampled while the model was loaded
+        double decode_ms = 0.0;
+        double p50_ms = 0.0;
+        double p90_ms = 0.0;
+        double max_ms = 0.0;
+        int failed = 0;
+        word_error_counts wer;
+    };
+    std::vector<config_result> results;
+
+    std::fprintf(stdout, "model\tsize_mib\tflash_attn\tthreads\tload_ms\trss_mib\trtf\tp50_ms\tp90_ms\tmax_ms\tfailed\twer\n");
+    for (const bench_model & m : models) {
+        for (const bool fa : { false, true }) {
+            whisper_context_params cparams = whisper_context_default_params();
+            cparams.use_gpu = params.use_gpu;
+            cparams.flash_attn = fa;
+            model_load_report load;
+            whisper_context * ctx = model_file_init(m.path, cparams, params.model_load, &load);
+            const int64_t load_ms = (int64_t) load.load_ms;
+            if (!ctx) {
+                std::fprintf(stderr, "warning: failed to load %s (flash-attn %s)\n", m.path.c_str(), fa ? "on" : "off");
+                continue;
+            }
+            size_t rss = process_rss_bytes();
+            // Warm-up: the first decode after a load pays for buffer allocation and backend setup.
+            std::string text;
+            bench_decode_clip(ctx, params, thread_counts.back(), clips.front().pcm, text);
+
+            for (const int n_threads : thread_counts) {
+                config_result r;
+                r.model = &m;
+                r.flash_attn = fa;
+                r.threads = n_threads;
+                r.load_ms = load_ms;
+                std::vector<double> latencies;
+                for (const bench_clip & c : clips) {
+                    const auto t0 = std::chrono::high_resolution_clock::now();
+                    const bool ok = bench_decode_clip(ctx, params, n_threads, c.pcm, text);
+                    const double ms = 1e-3 * (double) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - t0).count();
+                    rss = std::max(rss, process_rss_bytes());
+                    r.decode_ms += ms;
+                    latencies.push_back(ms);
+                    if (!ok) {
+                        r.failed++;
+                        text.clear();
+                    }
+                    if (c.has_reference) {
+                        r.wer += corpus_word_errors(c.reference, text);
+                    }
+                }
+                r.p50_ms = corpus_quantile(latencies, 0.50);
+                r.p90_ms = corpus_quantile(latencies, 0.90);
+                r.max_ms = corpus_quantile(latencies, 1.0);
+                r.rss_bytes = rss;
+                results.push_back(r);
+
+                char wer[32] = "-";
+                if (n_referenced > 0) {
+                    std::snprintf(wer, sizeof(wer), "%.2f%%", 100.0 * r.wer.rate());
+                }
+                std::fprintf(stdout, "%s\t%.0f\t%s\t%d\t%lld\t%.0f\t%.3f\t%.0f\t%.0f\t%.0f\t%d\t%s\n",
+                    m.path.c_str(), (double) m.bytes / (1024.0 * 1024.0), fa ? "on" : "off", n_threads, (long long) load_ms,
+                    (double) r.rss_bytes / (1024.0 * 1024.0), r.decode_ms / audio_ms, r.p50_ms, r.p90_ms, r.max_ms, r.failed, wer);
+                std::fflush(stdout);
+            }
+            whisper_free(ctx);
+        }
+    }
+    if (results.empty()) {
+        std::fprintf(stderr, "error: no model could be loaded\n");
+        return 3;
+    }
+
+    // Meets the target: p90 latency within it, faster than real time, nothing failed. Among those, the lowest WER
+    // (with reference text) or the largest model (without); ties go to the lower p90.
+    const config_result * best = nullptr;
+    for (const config_result & r : results) {
+        if (r.failed > 0 || r.p90_ms > (double) params.bench_target_ms || r.decode_ms >= audio_ms) {
+            continue;
+        }
+        if (!best) {
+            best = &r;
+            continue;
+        }
+        const bool better = n_referenced > 0
+            ? (r.wer.errors() != best->wer.errors() ? r.wer.errors() < best->wer.errors() : r.p90_ms < best->p90_ms)
+            : (r.model->bytes != best->model->bytes ? r.model->bytes > best->model->bytes : r.p90_ms < best->p90_ms);
+        if (better) {
+            best = &r;
+        }
+    }
+    if (!best) {
+        const config_result * fastest = &results.front();
+        for (const config_result & r : results) {
+            if (r.p90_ms < fastest->p90_ms) {
+                fastest = &r;
+            }
+        }
+        std::fprintf(stderr, "\nModel bench: no configuration meets p90 <= %dms; fastest is %s (%d threads, flash-attn %s) at p90 %.0fms\n",
+            params.bench_target_ms, fastest->model->path.c_str(), fastest->threads, fastest->flash_attn ? "on" : "off", fastest->p90_ms);
+        return 1;
+    }
+    std::fprintf(stderr, "\nModel bench: recommended for p90 <= %dms: p90 %.0fms, RTF %.3f", params.bench_target_ms, best->p90_ms, best->decode_ms / audio_ms);
+    if (n_referenced > 0) {
+        std::fprintf(stderr, ", WER %.2f%%", 100.0 * best->wer.rate());
+    }
+    std::fprintf(stderr, ", %.0f MiB resident\n  --model %s --threads %d%s\n",
+        (double) best->rss_bytes / (1024.0 * 1024.0), best->model->path.c_str(), best->threads, best->flash_attn ? "" : " --no-flash-attn");
+    return 0;
+}
+
+// One clip of the --regress corpus. A clip whose reference text is empty holds no speech (silence, noise, music):
+// any caption on it is a hallucination.
+struct regress_clip_result {
+    bool ok = false;
+    std::string error;
+    bool has_reference = false;
+    bool noise_only = false;
+    int64_t duration_ms = 0;
+    std::vector<std::string> captions;
+    std::vector<double> latencies_ms; // per caption: end of speech (or the chunk cut) -> text ready
+    int duplicates = 0;
+    word_error_counts wer;
+};
+
+// A caption that repeats the one before it: mostly the same words, or all of its words inside the other's.
+static bool is_duplicate_caption(const std::string & prev, const std::string & cur) {
+    const std::vector<std::string> a = corpus_words(prev);
+    const std::vector<std::string> b = corpus_words(cur);
+    if (a.empty() || b.empty()) {
+        return false;
+    }
+    const std::vector<std::string> & longer = a.size() >= b.size() ? a : b;
+    const std::vector<std::string> & shorter = a.size() >= b.size() ? b : a;
+    if (std::search(longer.begin(), longer.end(), shorter.begin(), shorter.end()) != longer.end()) {
+        return true;
+    }
+    return corpus_word_errors(prev, cur).rate() <= 0.25;
+}
+
+// Steps the voice gate through a clip as --test-voice-gate does and decodes every block it cuts, one at a time, with
+// the live decoder (token budget, deadline, decode policy) and output filters (garbage, thank-you, de-dupe).
+static void regress_clip(const app_params & params, whisper_context * ctx, whisper_context * lid_ctx, model_router * router,
+                         whisper_vad_context * vctx, const std::vector<float> & pcm, regress_clip_result & r) {
+    transcribe_state st;
+    st.params = &params;
+    st.ctx = ctx;
+    st.lid_ctx = lid_ctx;
+    st.router = router;
+    st.captions = &r.captions;
+
+    voice_gate gate(make_voice_gate_params(params));
+    const utterance_timeline & vtl = gate.timeline();
+    const std::atomic<bool> no_abort{ false };
+
+    const uint64_t total_samples = pcm.size();
+    const int64_t total_ms = (int64_t) (total_samples * 1000 / WHISPER_SAMPLE_RATE);
+    const uint64_t win_samples = (uint64_t) params.vad_window_ms * WHISPER_SAMPLE_RATE / 1000;
+    const int64_t step_ms = std::max<int32_t>(50, params.vad_check_ms);
+    r.duration_ms = total_ms;
+
+    uint64_t utterance_id = 0;
+    uint64_t job_id = 0;
+    // The file, then enough virtual silence for a trailing utterance to flush.
+    for (int64_t t_ms = 0; t_ms <= total_ms + params.voice_stop_ms + step_ms; t_ms += step_ms) {
+        const uint64_t now = (uint64_t) t_ms * WHISPER_SAMPLE_RATE / 1000;
+        const uint64_t end = std::min(total_samples, now);
+        const uint64_t begin = end > win_samples ? end - win_samples : 0;
+        const audio_view window = audio_view::of(pcm.data() + begin, (size_t) (end - begin), begin);
+
+        voice_gate_check c;
+        vad_window_probs(vctx, window.p0, window, c);
+        c.now = now;
+        // Decodes finish before the next check here, so a probe can always start; speculation would change nothing
+        // but the timing.
+        c.allow_probe = true;
+        const voice_gate_decision d = gate.check(c);
+        if (d.ev == utterance_timeline::event::voice_start) {
+            ++utterance_id;
+        }
+        if (d.block == voice_gate_block::none || d.too_short || d.begin >= total_samples) {
+            continue;
+        }
+
+        inference_job job;
+        job.id = ++job_id;
+        job.view = audio_view::of(pcm.data() + d.begin, (size_t) (std::min(total_samples, d.end) - d.begin), d.begin);
+        job.stats = audio_stats_compute(job.view);
+        job.window_stats = audio_stats_compute(window);
+        job.voiced_ms = d.voiced_ms;
+        job.utterance = utterance_id;
+        job.chunk = d.block == voice_gate_block::chunk;
+        job.probe = d.block == voice_gate_block::probe;
+
+        const size_t n_before = r.captions.size();
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        const inference_outcome o = transcribe_block(st, job, no_abort);
+        const double decode_ms = 1e-3 * (double) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - t0).count();
+        if (job.probe && (o == inference_outcome::emitted || o == inference_outcome::filtered)) {
+            gate.accept_probe(now);
+        }
+        if (r.captions.size() > n_before) {
+            // Audio time the gate waited after the speech (or after the pause a chunk was cut at), plus the decode.
+            const double wait_ms = job.chunk ? (double) vtl.samples_to_ms(now - d.end) : (double) std::max<int64_t>(0, d.silent_ms);
+            r.latencies_ms.push_back(wait_ms + decode_ms);
+        }
+    }
+
+    for (size_t i = 1; i < r.captions.size(); ++i) {
+        r.duplicates += is_duplicate_caption(r.captions[i - 1], r.captions[i]) ? 1 : 0;
+    }
+}
+
+// --regress metrics, in the order of the baseline file. Each one is "lower is better".
+struct regress_metric {
+    const char * name;
+    double value;
+    bool measured; // false: the corpus has nothing to measure it on
+};
+
+// Baseline file: "<metric> <value> <tolerance>" per line ('#' starts a comment). A run fails when a metric exceeds
+// value + tolerance.
+struct regress_baseline_entry {
+    double value = 0.0;
+    double tolerance = 0.0;
+};
+
+static bool load_regress_baseline(const std::string & path, std::map<std::string, regress_baseline_entry> & out, std::string & err) {
+    out.clear();
+    FILE * f = std::fopen(path.c_str(), "r");
+    if (!f) {
+        err = "cannot open " + path;
+        return false;
+    }
+    char line[256];
+    int line_no = 0;
+    bool ok = true;
+    while (std::fgets(line, sizeof(line), f)) {
+        ++line_no;
+        char name[64];
+        regress_baseline_entry e;
+        const int n = std::sscanf(line, " %63s %lf %lf", name, &e.value, &e.tolerance);
+        if (n <= 0 || name[0] == '#') {
+            continue;
+        }
+        if (n != 3 || e.tolerance < 0.0) {
+            err = "line " + std::to_string(line_no) + ": expected \"metric value tolerance\"";
+            ok = false;
+            break;
+        }
+        out[name] = e;
+    }
+    std::fclose(f);
+    return ok;
+}
+
+static bool save_regress_baseline(const std::string & path, const std::vector<regress_metric> & metrics) {
+    FILE * f = std::fopen(path.c_str(), "w");
+    if (!f) {
+        return false;
+    }
+    std::fprintf(f, "# --regress baseline: metric value tolerance (a run fails when a metric exceeds value + tolerance)\n");
+    for (const regress_metric & m : metrics) {
+        if (!m.measured) {
+            continue;
+        }
+        // Rates may move by a couple of points; latencies by 15% (they depend on the machine).
+        const bool is_ms = std::strstr(m.name, "_ms") != nullptr;
+        const double tolerance = is_ms ? std::max(100.0, 0.15 * m.value) : (std::strcmp(m.name, "wer") == 0 ? 0.01 : 0.02);
+        std::fprintf(f, "%s %.6g %.6g\n", m.name, m.value, tolerance);
+    }
+    return std::fclose(f) == 0;
+}
+
+// --regress: the labeled corpus through the voice gate, the decoder and the output filters, offline and faster than
+// real time. Per-clip rows on stdout; WER, hallucination rate, duplicate-caption rate and latency on stderr, checked
+// against --regress-baseline.
+static int run_regress(const app_params & params) {
+    if (params.vad_model.empty()) {
+        std::fprintf(stderr, "error: --regress requires a VAD model. Expected ./models/ggml-silero-v6.2.0.bin\n");
+        std::fprintf(stderr, "Hint: run .\\download-vad.cmd\n");
+        return 1;
+    }
+    if (params.model.empty()) {
+        std::fprintf(stderr, "error: --regress requires --model (or a model under ./models)\n");
+        return 1;
+    }
+    std::map<std::string, regress_baseline_entry> baseline;
+    if (!params.regress_baseline.empty()) {
+        std::string err;
+        if (!load_regress_baseline(params.regress_baseline, baseline, err)) {
+            std::fprintf(stderr, "error: --regress-baseline %s: %s\n", params.regress_baseline.c_str(), err.c_str());
+            return 2;
+        }
+    }
+    std::vector<std::string> files;
+    if (!corpus_list(params.regress_corpus, files)) {
+        std::fprintf(stderr, "error: cannot read --regress %s\n", params.regress_corpus.c_str());
+        return 2;
+    }
+    if (files.empty()) {
+        std::fprintf(stderr, "error: no recordings in %s\n", params.regress_corpus.c_str());
+        return 2;
+    }
+
+    whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = params.use_gpu;
+    cparams.flash_attn = params.flash_attn;
+    whisper_context * ctx = model_file_init(params.model, cparams, params.model_load);
+    if (!ctx) {
+        std::fprintf(stderr, "error: failed to load model: %s\n", params.model.c_str());
+        return 3;
+    }
+    app_params rp = params;
+    if (!whisper_is_multilingual(ctx)) {
+        rp.language = "en";
+        rp.translate = false;
+    }
+    whisper_vad_context_params vcp = whisper_vad_default_context_params();
+    vcp.n_threads = params.vad_threads > 0 ? params.vad_threads : std::max(1, params.threads);
+    vcp.use_gpu = false;
+    vcp.gpu_device = 0;
+    whisper_vad_context * vctx = whisper_vad_init_from_file_with_params(params.vad_model.c_str(), vcp);
+    if (!vctx) {
+        std::fprintf(stderr, "error: failed to init VAD model: %s\n", params.vad_model.c_str());
+        whisper_free(ctx);
+        return 3;
+    }
+    // Utterances are routed as they would be live; the --model-map models stay loaded for the run.
+    whisper_context * lid_ctx = params.lid_model.empty() ? nullptr : model_file_init(params.lid_model, cparams, params.model_load);
+    if (lid_ctx && !whisper_is_multilingual(lid_ctx)) {
+        whisper_free(lid_ctx);
+        lid_ctx = nullptr;
+    }
+    std::unique_ptr<model_router> router;
+    if (!params.model_map.empty()) {
+        router = std::make_unique<model_router>(params.model_map, cparams, params.model_load, /*idle_ms*/ 0);
+    }
+
+    std::fprintf(stderr, "\nRegression run: %zu clips\n", files.size());
+    std::fprintf(stderr, "- model: %s threads=%d language=%s%s\n", params.model.c_str(), params.threads, rp.language.c_str(), params.fast ? " (fast)" : "");
+    std::fprintf(stderr, "- stop=%dms min=%dms thold=%.2f check=%dms window=%dms dedup=%.2f\n\n",
+        params.voice_stop_ms, params.min_voice_ms, params.vad_voice_threshold, params.vad_check_ms, params.vad_window_ms, params.dedup_similarity);
+
+    std::fprintf(stdout, "file\tkind\tduration_ms\tcaptions\tduplicates\twer\tlatency_p50_ms\tlatency_p90_ms\n");
+    word_error_counts wer;
+    std::vector<double> latencies;
+    int failed = 0;
+    int speech_clips = 0;
+    int noise_clips = 0;
+    int hallucinated = 0;
+    size_t captions = 0;
+    int duplicates = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        regress_clip_result r;
+        std::string reference;
+        r.has_reference = corpus_reference(files[i], reference);
+        r.noise_only = r.has_reference && corpus_words(reference).empty();
+
+        std::vector<float> pcm;
+        std::vector<std::vector<float>> pcm_stereo;
+        if (!read_audio_data(files[i], pcm, pcm_stereo, /*stereo*/false) || pcm.empty()) {
+            ++failed;
+            std::fprintf(stdout, "%s\tERROR: unreadable or empty\n", files[i].c_str());
+            continue;
+        }
+        regress_clip(rp, ctx, lid_ctx, router.get(), vctx, pcm, r);
+        std::fprintf(stderr, "[%zu/%zu] %s: %zu captions\n", i + 1, files.size(), files[i].c_str(), r.captions.size());
+        if (params.trace_voice_gate) {
+            for (const std::string & c : r.captions) {
+                std::fprintf(stderr, "  > %s\n", c.c_str());
+            }
+        }
+
+        char clip_wer[32] = "-";
+        if (r.noise_only) {
+            ++noise_clips;
+            hallucinated += r.captions.empty() ? 0 : 1;
+        } else if (r.has_reference) {
+            std::string hyp;
+            for (const std::string & c : r.captions) {
+                hyp += (hyp.empty() ? "" : " ") + c;
+            }
+            r.wer = corpus_word_errors(reference, hyp);
+            wer += r.wer;
+            ++speech_clips;
+            std::snprintf(clip_wer, sizeof(clip_wer), "%.4f", r.wer.rate());
+        }
+        captions += r.captions.size();
+        duplicates += r.duplicates;
+        latencies.insert(latencies.end(), r.latencies_ms.begin(), r.latencies_ms.end());
+        std::fprintf(stdout, "%s\t%s\t%lld\t%zu\t%d\t%s\t%.0f\t%.0f\n",
+            files[i].c_str(), r.noise_only ? "noise" : (r.has_reference ? "speech" : "unlabeled"), (long long) r.duration_ms,
+            r.captions.size(), r.duplicates, clip_wer, corpus_quantile(r.latencies_ms, 0.50), corpus_quantile(r.latencies_ms, 0.90));
+        std::fflush(stdout);
+    }
+    whisper_vad_free(vctx);
+    if (lid_ctx) whisper_free(lid_ctx);
+    whisper_free(ctx);
+
+    const std::vector<regress_metric> metrics = {
+        { "wer", wer.rate(), speech_clips > 0 },
+        { "hallucination_rate", noise_clips > 0 ? (double) hallucinated / (double) noise_clips : 0.0, noise_clips > 0 },
+        { "duplicate_rate", captions > 0 ? (double) duplicates / (double) captions : 0.0, captions > 0 },
+        { "latency_p50_ms", corpus_quantile(latencies, 0.50), !latencies.empty() },
+        { "latency_p90_ms", corpus_quantile(latencies, 0.90), !latencies.empty() },
+        { "latency_p99_ms", corpus_quantile(latencies, 0.99), !latencies.empty() },
+    };
+
+    std::fprintf(stderr, "\nRegression run complete: clips=%zu failed=%d speech=%d noise=%d captions=%zu\n",
+        files.size(), failed, speech_clips, noise_clips, captions);
+    std::fprintf(stderr, "- wer: %.2f%% (%zu sub, %zu del, %zu ins / %zu words)\n",
+        100.0 * wer.rate(), wer.substitutions, wer.deletions, wer.insertions, wer.ref_words);
+    std::fprintf(stderr, "- hallucinations: %d of %d noise-only clips\n", hallucinated, noise_clips);
+    std::fprintf(stderr, "- duplicate captions: %d of %zu\n", duplicates, captions);
+    std::fprintf(stderr, "- latency (speech end -> caption): p50=%.0fms p90=%.0fms p99=%.0fms\n",
+        metrics[3].value, metrics[4].value, metrics[5].value);
+    if (router) {
+        print_model_router_stats(stderr, "-", *router);
+    }
+
+    int regressions = 0;
+    if (!baseline.empty()) {
+        std::fprintf(stderr, "\nAgainst %s:\n", params.regress_baseline.c_str());
+        for (const regress_metric & m : metrics) {
+            const auto it = baseline.find(m.name);
+            if (it == baseline.end()) {
+                continue;
+            }
+            if (!m.measured) {
+                std::fprintf(stderr, "  %-20s not measured (nothing in the corpus for it)\n", m.name);
+                continue;
+            }
+            const bool regressed = m.value > it->second.value + it->second.tolerance;
+            regressions += regressed ? 1 : 0;
+            std::fprintf(stderr, "  %-20s %.4g (baseline %.4g +%.4g) %s\n", m.name, m.value, it->second.value, it->second.tolerance,
+                regressed ? "REGRESSED" : "ok");
+        }
+    }
+    if (!params.regress_save_baseline.empty()) {
+        if (!save_regress_baseline(params.regress_save_baseline, metrics)) {
+            std::fprintf(stderr, "error: cannot write --regress-save-baseline %s\n", params.regress_save_baseline.c_str());
+            return 2;
+        }
+        std::fprintf(stderr, "\nBaseline written to %s\n", params.regress_save_baseline.c_str());
+    }
+    if (regressions > 0) {
+        std::fprintf(stderr, "\nRegression run: %d metric(s) regressed\n", regressions);
+        return 1;
+    }
+    return failed == 0 ? 0 : 2;
+}
+
+// --bench-model-load: the model loaded with plain reads, mapped, and mapped with prefault, two rounds each. The first
+// load may read the file from disk; later ones come from the page cache. Whisper copies the tensors into its own
+// buffers either way, so resident memory after the load is about the same: the mapping changes how the file is read.
+static int run_bench_model_load(const app_params & params) {
+    if (params.model.empty()) {
+        std::fprintf(stderr, "error: --bench-model-load requires --model (or a model under ./models)\n");
+        return 1;
+    }
+    struct variant {
+        const char * name;
+        model_load_options opt;
+    };
+    std::vector<variant> variants(3);
+    variants[0].name = "read";
+    variants[1].name = "mmap";
+    variants[1].opt.mode = model_load_mode::mmap;
+    variants[2].name = "mmap+prefault";
+    variants[2].opt.mode = model_load_mode::mmap;
+    variants[2].opt.prefault = true;
+    for (variant & v : variants) {
+        v.opt.huge_pages = params.model_load.huge_pages;
+    }
+
+    whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = params.use_gpu;
+    cparams.flash_attn = params.flash_attn;
+
+    std::fprintf(stderr, "\nModel load bench: %s\n\n", params.model.c_str());
+    std::fprintf(stdout, "round\tmode\tload_ms\tfile_mib\trss_delta_mib\trss_mib\n");
+    std::vector<double> best_ms(variants.size(), 0.0);
+    for (int round = 1; round <= 2; ++round) {
+        for (size_t i = 0; i < variants.size(); ++i) {
+            model_load_report rep;
+            whisper_context * ctx = model_file_init(params.model, cparams, variants[i].opt, &rep);
+            if (!ctx) {
+                std::fprintf(stderr, "error: failed to load %s (%s)\n", params.model.c_str(), variants[i].name);
+                return 3;
+            }
+            std::fprintf(stdout, "%d\t%s\t%.1f\t%.0f\t%+.0f\t%.0f\n", round, variants[i].name, rep.load_ms,
+                (double) rep.file_bytes / (1024.0 * 1024.0), ((double) rep.rss_after - (double) rep.rss_before) / (1024.0 * 1024.0),
+                (double) rep.rss_after / (1024.0 * 1024.0));
+            std::fflush(stdout);
+            whisper_free(ctx);
+            if (round == 2) {
+                best_ms[i] = rep.load_ms;
+            }
+        }
+    }
+    std::fprintf(stderr, "\nModel load bench (file cached): read %.0fms, mmap %.0fms, mmap+prefault %.0fms\n", best_ms[0], best_ms[1], best_ms[2]);
+    return 0;
+}
+
+// "1000,2000" or "500:3000:250" (lo:hi:step, hi included), or a mix of both.
+static bool parse_value_list(const std::string & s, std::vector<double> & out) {
+    out.clear();
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        const size_t comma = std::min(s.find(',', pos), s.size());
+        const std::string item = s.substr(pos, comma - pos);
+        double lo = 0.0;
+        double hi = 0.0;
+        double step = 0.0;
+        char tail = 0;
+        if (std::sscanf(item.c_str(), "%lf:%lf:%lf%c", &lo, &hi, &step, &tail) == 3) {
+            if (step <= 0.0 || hi < lo || (hi - lo) / step > 1000.0) {
+                return false;
+            }
+            for (double v = lo; v <= hi + 1e-9 * std::max(1.0, std::fabs(hi)); v += step) {
+                out.push_back(v);
+            }
+        } else if (std::sscanf(item.c_str(), "%lf%c", &lo, &tail) == 1) {
+            out.push_back(lo);
+        } else {
+            return false;
+        }
+        pos = comma + 1;
+    }
+    return !out.empty();
+}
+
+static bool parse_args(int argc, char ** argv, app_params & p) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        // Convenience: allow a leading positional mic index for Windows shortcuts.
+        // Example: ai-subtitler-streamerbot.exe 0 --fast
+        if (!arg.empty() && arg[0] != '-' && is_nonneg_int_str(arg)) {
+            if (p.device_index < 0 && p.device_name_substring.empty()) {
                 p.device_index = std::stoi(arg);
                 continue;
             }
@@ -710,6 +2931,51 @@ static bool parse_args(int argc, char ** argv, app_params & p) {
             p.language = require_value("--language");
         } else if (arg == "--threads") {
             p.threads = std::stoi(require_value("--threads"));
+            p.threads_explicit = true;
+        } else if (arg == "--vad-threads") {
+            p.vad_threads = std::stoi(require_value("--vad-threads"));
+        } else if (arg == "--autotune") {
+            p.autotune = true;
+        } else if (arg == "--autotune-refresh") {
+            p.autotune = true;
+            p.autotune_refresh = true;
+        } else if (arg == "--autotune-cache") {
+            p.autotune_cache = require_value("--autotune-cache");
+        } else if (arg == "--model-load") {
+            if (!parse_model_load_mode(require_value("--model-load"), p.model_load.mode)) {
+                std::fprintf(stderr, "error: --model-load expects read or mmap\n");
+                return false;
+            }
+        } else if (arg == "--model-prefault") {
+            p.model_load.prefault = true;
+        } else if (arg == "--model-huge-pages") {
+            p.model_load.huge_pages = true;
+        } else if (arg == "--quantize") {
+            p.quantize = require_value("--quantize");
+            ggml_type type;
+            if (!parse_model_quant_type(p.quantize, type)) {
+                std::fprintf(stderr, "error: --quantize expects q8_0, q5_1, q5_0, q4_1 or q4_0\n");
+                return false;
+            }
+        } else if (arg == "--model-map") {
+            std::string err;
+            if (!parse_model_map(require_value("--model-map"), p.model_map, err)) {
+                std::fprintf(stderr, "error: --model-map: %s\n", err.c_str());
+                return false;
+            }
+        } else if (arg == "--lid-model") {
+            p.lid_model = require_value("--lid-model");
+        } else if (arg == "--model-idle-s") {
+            p.model_idle_s = std::stoi(require_value("--model-idle-s"));
+        } else if (arg == "--bench-model-load") {
+            p.bench_model_load = true;
+        } else if (arg == "--cpu-budget") {
+            p.cpu_budget = std::stoi(require_value("--cpu-budget"));
+        } else if (arg == "--affinity-gate" || arg == "--affinity-whisper") {
+            if (!parse_cpu_list(require_value(arg.c_str()), arg == "--affinity-gate" ? p.affinity_gate : p.affinity_whisper)) {
+                std::fprintf(stderr, "error: %s expects a CPU list such as 0-3,6\n", arg.c_str());
+                return false;
+            }
         } else if (arg == "--translate") {
             p.translate = true;
         } else if (arg == "--no-gpu") {
@@ -730,6 +2996,8 @@ static bool parse_args(int argc, char ** argv, app_params & p) {
             p.max_tokens = 48;
             // More aggressive de-dupe to avoid repeated overlap spam.
             p.dedup_similarity = 0.80f;
+            // Captions of long monologues in shorter pieces.
+            p.max_utterance_ms = 8000;
             p.threads = std::max(1, (int32_t) std::thread::hardware_concurrency());
         } else if (arg == "--list-devices") {
             p.list_devices = true;
@@ -763,6 +3031,49 @@ static bool parse_args(int argc, char ** argv, app_params & p) {
             p.device_index = std::stoi(require_value("--device-index"));
         } else if (arg == "--device-name") {
             p.device_name_substring = require_value("--device-name");
+        } else if (arg == "--input") {
+            const std::string v = require_value("--input");
+            if (v == "sdl") {
+                p.input_path.clear();
+            } else if (v == "-" || v == "stdin") {
+                p.input_path = "-";
+                p.input_is_file = false;
+            } else if (v.rfind("file:", 0) == 0 && v.size() > 5) {
+                p.input_path = v.substr(5);
+                p.input_is_file = true;
+            } else if (v.rfind("pipe:", 0) == 0 && v.size() > 5) {
+                p.input_path = v.substr(5);
+                p.input_is_file = false;
+            } else {
+                std::fprintf(stderr, "error: --input must be sdl, stdin, file:<path> or pipe:<path>\n");
+                return false;
+            }
+        } else if (arg == "--input-format") {
+            const std::string v = require_value("--input-format");
+            if (v == "s16" || v == "s16le") {
+                p.input_format = pcm_sample_format::s16;
+            } else if (v == "f32" || v == "f32le") {
+                p.input_format = pcm_sample_format::f32;
+            } else {
+                std::fprintf(stderr, "error: --input-format must be s16 or f32\n");
+                return false;
+            }
+        } else if (arg == "--sdl-resampler") {
+            p.sdl_resampler = true;
+        } else if (arg == "--bench-resampler") {
+            p.bench_resampler = true;
+        } else if (arg == "--bench-audio-stats") {
+            p.bench_audio_stats = true;
+        } else if (arg == "--bench-log-mel") {
+            p.bench_log_mel = true;
+        } else if (arg == "--bench-voice-gate") {
+            p.bench_voice_gate = true;
+        } else if (arg == "--replay-voice-gate") {
+            p.replay_voice_gate = require_value("--replay-voice-gate");
+        } else if (arg == "--input-realtime") {
+            p.input_realtime = 1;
+        } else if (arg == "--no-input-realtime") {
+            p.input_realtime = 0;
         } else if (arg == "--length-ms") {
             p.length_ms = std::stoi(require_value("--length-ms"));
         } else if (arg == "--vad-check-ms") {
@@ -777,6 +3088,48 @@ static bool parse_args(int argc, char ** argv, app_params & p) {
             p.freq_thold = std::stof(require_value("--freq-thold"));
         } else if (arg == "--max-tokens") {
             p.max_tokens = std::stoi(require_value("--max-tokens"));
+        } else if (arg == "--tokens-per-second") {
+            p.tokens_per_second = std::stof(require_value("--tokens-per-second"));
+        } else if (arg == "--no-loop-stop") {
+            p.loop_stop = false;
+        } else if (arg == "--decode-deadline-x") {
+            p.decode_deadline_x = std::stof(require_value("--decode-deadline-x"));
+        } else if (arg == "--decode-deadline-min-ms") {
+            p.decode_deadline_min_ms = std::stoi(require_value("--decode-deadline-min-ms"));
+        } else if (arg == "--decode-fallback") {
+            const std::string v = require_value("--decode-fallback");
+            if (v == "single") {
+                p.decode_fallback = true;
+            } else if (v == "drop") {
+                p.decode_fallback = false;
+            } else {
+                std::fprintf(stderr, "error: --decode-fallback must be single or drop\n");
+                return false;
+            }
+        } else if (arg == "--fallback-model") {
+            p.fallback_model = require_value("--fallback-model");
+        } else if (arg == "--decode-policy") {
+            const std::string v = require_value("--decode-policy");
+            if (v == "whisper") {
+                p.policy = decode_policy::whisper;
+            } else if (v == "adaptive") {
+                p.policy = decode_policy::adaptive;
+            } else if (v == "beam") {
+                p.policy = decode_policy::beam;
+            } else {
+                std::fprintf(stderr, "error: --decode-policy must be whisper, adaptive or beam\n");
+                return false;
+            }
+        } else if (arg == "--beam-size") {
+            p.beam_size = std::stoi(require_value("--beam-size"));
+        } else if (arg == "--beam-logprob-thold") {
+            p.beam_logprob_thold = std::stof(require_value("--beam-logprob-thold"));
+        } else if (arg == "--beam-entropy-thold") {
+            p.beam_entropy_thold = std::stof(require_value("--beam-entropy-thold"));
+        } else if (arg == "--batch-max") {
+            p.batch_max = std::stoi(require_value("--batch-max"));
+        } else if (arg == "--batch-short-ms") {
+            p.batch_short_ms = std::stoi(require_value("--batch-short-ms"));
         } else if (arg == "--ws-url") {
             p.bot.url = require_value("--ws-url");
         } else if (arg == "--ws-password") {
@@ -799,6 +3152,44 @@ static bool parse_args(int argc, char ** argv, app_params & p) {
             p.voice_gate = false;
         } else if (arg == "--test-voice-gate") {
             p.test_voice_gate_file = require_value("--test-voice-gate");
+        } else if (arg == "--test-voice-gate-batch") {
+            p.test_voice_gate_batch = require_value("--test-voice-gate-batch");
+        } else if (arg == "--test-jobs") {
+            p.test_jobs = std::stoi(require_value("--test-jobs"));
+        } else if (arg == "--record-voice-gate") {
+            p.record_voice_gate = require_value("--record-voice-gate");
+        } else if (arg == "--sweep") {
+            p.sweep_file = require_value("--sweep");
+        } else if (arg == "--sweep-labels") {
+            p.sweep_labels = require_value("--sweep-labels");
+        } else if (arg == "--sweep-stop-ms" || arg == "--sweep-min-voice-ms" || arg == "--sweep-thold" || arg == "--sweep-check-ms") {
+            std::vector<double> & list = arg == "--sweep-stop-ms" ? p.sweep_stop_ms
+                : arg == "--sweep-min-voice-ms" ? p.sweep_min_voice_ms
+                : arg == "--sweep-thold" ? p.sweep_thold
+                : p.sweep_check_ms;
+            if (!parse_value_list(require_value(arg.c_str()), list)) {
+                std::fprintf(stderr, "error: %s expects comma-separated values or lo:hi:step ranges\n", arg.c_str());
+                return false;
+            }
+        } else if (arg == "--regress") {
+            p.regress_corpus = require_value("--regress");
+        } else if (arg == "--regress-baseline") {
+            p.regress_baseline = require_value("--regress-baseline");
+        } else if (arg == "--regress-save-baseline") {
+            p.regress_save_baseline = require_value("--regress-save-baseline");
+        } else if (arg == "--bench-models") {
+            p.bench_models = true;
+        } else if (arg == "--models-dir") {
+            p.models_dir = require_value("--models-dir");
+        } else if (arg == "--bench-corpus") {
+            p.bench_corpus = require_value("--bench-corpus");
+        } else if (arg == "--bench-threads") {
+            if (!parse_value_list(require_value("--bench-threads"), p.bench_threads)) {
+                std::fprintf(stderr, "error: --bench-threads expects comma-separated values or lo:hi:step ranges\n");
+                return false;
+            }
+        } else if (arg == "--bench-target-ms") {
+            p.bench_target_ms = std::stoi(require_value("--bench-target-ms"));
         } else if (arg == "--vad-model") {
             p.vad_model = require_value("--vad-model");
         } else if (arg == "--voice-stop-ms") {
@@ -807,6 +3198,35 @@ static bool parse_args(int argc, char ** argv, app_params & p) {
             p.min_voice_ms = std::stoi(require_value("--min-voice-ms"));
         } else if (arg == "--vad-voice-thold") {
             p.vad_voice_threshold = std::stof(require_value("--vad-voice-thold"));
+        } else if (arg == "--endpoint") {
+            const std::string v = require_value("--endpoint");
+            if (v == "fixed") {
+                p.endpoint = endpoint_mode::fixed;
+            } else if (v == "adaptive") {
+                p.endpoint = endpoint_mode::adaptive;
+            } else {
+                std::fprintf(stderr, "error: --endpoint must be fixed or adaptive\n");
+                return false;
+            }
+        } else if (arg == "--endpoint-min-ms") {
+            p.endpoint_min_ms = std::stoi(require_value("--endpoint-min-ms"));
+        } else if (arg == "--endpoint-probe") {
+            p.endpoint_probe = true;
+        } else if (arg == "--speculative-decode") {
+            p.speculative = true;
+        } else if (arg == "--speculative-ms") {
+            p.speculative = true;
+            p.speculative_ms = std::stoi(require_value("--speculative-ms"));
+        } else if (arg == "--no-incremental-mel") {
+            p.incremental_mel = false;
+        } else if (arg == "--max-utterance-ms") {
+            p.max_utterance_ms = std::stoi(require_value("--max-utterance-ms"));
+        } else if (arg == "--energy-gate-db") {
+            p.energy_gate_db = std::stof(require_value("--energy-gate-db"));
+        } else if (arg == "--vad-check-idle-ms") {
+            p.vad_check_idle_ms = std::stoi(require_value("--vad-check-idle-ms"));
+        } else if (arg == "--cpu-report-ms") {
+            p.cpu_report_ms = std::stoi(require_value("--cpu-report-ms"));
         } else if (arg == "--dedup-similarity") {
             p.dedup_similarity = std::stof(require_value("--dedup-similarity"));
         } else {
@@ -853,6 +3273,79 @@ static std::string pick_default_model_path() {
     return {};
 }
 
+// --quantize: swap --model (and --fallback-model, --lid-model, the --model-map models) for their quantized copies, converting on the first run.
+// A model that cannot be converted is loaded as it is.
+static void apply_quantize(app_params & params) {
+    ggml_type type;
+    if (params.quantize.empty() || !parse_model_quant_type(params.quantize, type)) {
+        return;
+    }
+    std::vector<std::string *> models = { &params.model, &params.fallback_model, &params.lid_model };
+    for (model_route & r : params.model_map) {
+        models.push_back(&r.path);
+    }
+    for (std::string * model : models) {
+        if (model->empty()) {
+            continue;
+        }
+        model_quantize_report rep;
+        std::string err;
+        if (!model_quantize_cached(*model, type, params.threads, rep, err)) {
+            std::fprintf(stderr, "warning: cannot quantize %s to %s: %s; loading it as it is\n", model->c_str(), params.quantize.c_str(), err.c_str());
+            continue;
+        }
+        if (rep.converted) {
+            std::fprintf(stderr, "Quantize: %s -> %s (%d tensors, %.0f -> %.0f MiB) in %.1fs\n", model->c_str(), rep.path.c_str(), rep.n_quantized,
+                         (double) rep.source_bytes / (1024.0 * 1024.0), (double) rep.bytes / (1024.0 * 1024.0), rep.convert_ms / 1000.0);
+        } else if (rep.cached) {
+            std::fprintf(stderr, "Quantize: %s -> %s (cached, hash checked in %.0fms)\n", model->c_str(), rep.path.c_str(), rep.hash_ms);
+        } else {
+            std::fprintf(stderr, "Quantize: %s is already quantized; loading it as it is\n", model->c_str());
+        }
+        *model = rep.path;
+    }
+}
+
+// --autotune: the cached settings for this CPU and model, or a timing run whose result is cached for next time.
+// What the command line fixed (--threads, --vad-threads, --no-gpu, --no-flash-attn) is not tuned.
+static void apply_autotune(app_params & params) {
+    // Within a --cpu-budget, Silero keeps at least one of the cores.
+    const int32_t hw = params.cpu_budget > 0 ? std::max<int32_t>(1, params.cpu_budget - 1) : std::max(1, (int32_t) std::thread::hardware_concurrency());
+    autotune_request req;
+    req.model = params.model;
+    req.threads = params.threads_explicit ? std::vector<int32_t>{ params.threads } : autotune_thread_candidates(hw);
+    if (params.voice_gate && !params.vad_model.empty() && params.vad_threads == 0) {
+        req.vad_model = params.vad_model;
+        // Silero is small: past a few threads the sync overhead dominates.
+        req.vad_threads = autotune_thread_candidates(std::min<int32_t>(hw, 8));
+    }
+    req.try_gpu = params.use_gpu;
+    req.try_flash_attn = params.flash_attn;
+
+    const std::string key = autotune_key(req);
+    autotune_result r;
+    const bool cached = !params.autotune_refresh && autotune_cache_load(params.autotune_cache, key, r);
+    if (!cached) {
+        std::fprintf(stderr, "Autotune: timing %s on %s (once; cached in %s)\n", params.model.c_str(), autotune_cpu_name().c_str(), params.autotune_cache.c_str());
+        if (!autotune_run(req, r, stderr)) {
+            std::fprintf(stderr, "warning: autotune could not time %s; keeping the default settings\n", params.model.c_str());
+            return;
+        }
+        if (!autotune_cache_store(params.autotune_cache, key, r)) {
+            std::fprintf(stderr, "warning: cannot write autotune cache %s\n", params.autotune_cache.c_str());
+        }
+    }
+    params.threads = r.threads;
+    params.use_gpu = r.use_gpu;
+    params.flash_attn = r.flash_attn;
+    if (r.vad_threads > 0) {
+        params.vad_threads = r.vad_threads;
+    }
+    std::fprintf(stderr, "Autotune%s: threads=%d gpu=%s flash_attn=%s vad_threads=%d (sample %.0fms)\n",
+        cached ? " (cached)" : "", params.threads, params.use_gpu ? "on" : "off", params.flash_attn ? "on" : "off",
+        params.vad_threads > 0 ? params.vad_threads : params.threads, r.whisper_ms);
+}
+
 static bool sdl_list_devices_only() {
     SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO);
 
@@ -949,17 +3442,80 @@ static int sdl_find_device_index_by_substring(const std::string & needle) {
         return -1;
     }
 
-    const int n = SDL_GetNumAudioDevices(SDL_TRUE);
-    for (int i = 0; i < n; ++i) {
-        const char * name = SDL_GetAudioDeviceName(i, SDL_TRUE);
-        if (name && icontains(name, needle)) {
-            SDL_Quit();
-            return i;
+    const int n = SDL_GetNumAudioDevices(SDL_TRUE);
+    for (int i = 0; i < n; ++i) {
+        const char * name = SDL_GetAudioDeviceName(i, SDL_TRUE);
+        if (name && icontains(name, needle)) {
+            SDL_Quit();
+            return i;
+        }
+    }
+
+    SDL_Quit();
+    return -1;
+}
+
+// Clamps the parsed settings into the ranges the pipeline works with. The offline modes (--test-voice-gate, --sweep,
+// the voice gate benchmarks) run on the same values as the live pipeline.
+static void sanitize_params(app_params & params) {
+    // Sanity/clamping to avoid invalid VAD windows.
+    params.vad_check_ms = std::max<int32_t>(50, params.vad_check_ms);
+    params.vad_window_ms = std::max<int32_t>(200, params.vad_window_ms);
+    params.vad_last_ms = std::max<int32_t>(50, params.vad_last_ms);
+    // Important: whisper.cpp's vad_simple() requires vad_window_ms > vad_last_ms.
+    if (params.vad_window_ms <= params.vad_last_ms) {
+        params.vad_window_ms = params.vad_last_ms + 100;
+    }
+
+    // Decoding sanity
+    if (params.max_tokens < 0) {
+        params.max_tokens = 0;
+    }
+    params.tokens_per_second = std::max(0.0f, params.tokens_per_second);
+    params.decode_deadline_x = std::max(0.0f, params.decode_deadline_x);
+    params.decode_deadline_min_ms = std::max<int32_t>(100, params.decode_deadline_min_ms);
+    params.beam_size = std::min<int32_t>(8, std::max<int32_t>(2, params.beam_size));
+    params.batch_max = std::min<int32_t>(8, std::max<int32_t>(1, params.batch_max));
+    params.batch_short_ms = std::min<int32_t>(10000, std::max<int32_t>(500, params.batch_short_ms));
+
+    // Filtering sanity
+    if (params.dedup_similarity < 0.0f) params.dedup_similarity = 0.0f;
+    if (params.dedup_similarity > 1.0f) params.dedup_similarity = 1.0f;
+
+    // Voice gate sanity
+    params.voice_stop_ms = std::max<int32_t>(250, params.voice_stop_ms);
+    params.min_voice_ms = std::max<int32_t>(0, params.min_voice_ms);
+    if (params.vad_voice_threshold < 0.0f) params.vad_voice_threshold = 0.0f;
+    if (params.vad_voice_threshold > 1.0f) params.vad_voice_threshold = 1.0f;
+    params.endpoint_min_ms = std::min(params.voice_stop_ms, std::max<int32_t>(100, params.endpoint_min_ms));
+    if (params.endpoint_probe) {
+        params.endpoint = endpoint_mode::adaptive;
+    }
+    params.speculative_ms = std::min(params.voice_stop_ms, std::max<int32_t>(100, params.speculative_ms));
+    params.energy_gate_db = std::max(0.0f, params.energy_gate_db);
+    params.vad_check_idle_ms = std::max(params.vad_check_ms, params.vad_check_idle_ms);
+    params.cpu_report_ms = std::max<int32_t>(0, params.cpu_report_ms);
+
+    // Voice gating needs enough ring-buffer history to include both:
+    // - the full spoken segment, and
+    // - the required trailing no-voice time (voice_stop_ms)
+    // The --fast preset reduces length_ms; enforce a safer minimum when voice gate is enabled (the offline gate
+    // modes run it regardless of --no-voice-gate).
+    const bool gate_runs = params.voice_gate || params.bench_voice_gate || !params.replay_voice_gate.empty() ||
+                           !params.test_voice_gate_file.empty() || !params.test_voice_gate_batch.empty() || !params.sweep_file.empty();
+    if (gate_runs) {
+        const int32_t min_len_ms = std::max<int32_t>(20000, params.voice_stop_ms + 10000);
+        if (params.length_ms < min_len_ms) {
+            params.length_ms = min_len_ms;
         }
     }
-
-    SDL_Quit();
-    return -1;
+    // A chunk (plus the check interval it may be cut late by) must still be in the ring when it is cut.
+    if (params.max_utterance_ms > 0) {
+        params.max_utterance_ms = std::min(params.length_ms - std::max<int32_t>(2000, params.vad_check_idle_ms + 1000),
+            std::max<int32_t>(2000, params.max_utterance_ms));
+    } else {
+        params.max_utterance_ms = 0;
+    }
 }
 
 int main(int argc, char ** argv) {
@@ -972,6 +3528,36 @@ int main(int argc, char ** argv) {
     }
 
     const bool voice_gate_requested_by_default_or_cli = params.voice_gate;
+    sanitize_params(params);
+
+    if (params.bench_resampler) {
+        return run_bench_resampler(/*seconds*/ 60);
+    }
+    if (params.bench_audio_stats) {
+        return run_bench_audio_stats();
+    }
+    if (params.bench_log_mel) {
+        return run_bench_log_mel();
+    }
+    if (params.bench_voice_gate || !params.replay_voice_gate.empty()) {
+        return run_bench_voice_gate(make_voice_gate_params(params), params.vad_window_ms, params.vad_check_ms, params.replay_voice_gate);
+    }
+
+    if (params.bench_model_load) {
+        whisper_log_filter_cfg log_cfg{};
+        log_cfg.suppress_all = true;
+        whisper_log_set(whisper_log_filter_cb, &log_cfg);
+        if (params.model.empty()) {
+            params.model = pick_default_model_path();
+        }
+        return run_bench_model_load(params);
+    }
+    if (params.bench_models) {
+        whisper_log_filter_cfg log_cfg{};
+        log_cfg.suppress_all = true;
+        whisper_log_set(whisper_log_filter_cb, &log_cfg);
+        return run_bench_models(params);
+    }
 
     // Offline voice-gate test mode (no mic, no Whisper, no Streamer.bot)
     if (!params.test_voice_gate_file.empty()) {
@@ -987,6 +3573,24 @@ int main(int argc, char ** argv) {
 
         return run_test_voice_gate_on_file(params);
     }
+    if (!params.test_voice_gate_batch.empty()) {
+        whisper_log_filter_cfg log_cfg{};
+        log_cfg.suppress_all = true;
+        whisper_log_set(whisper_log_filter_cb, &log_cfg);
+        if (params.vad_model.empty()) {
+            params.vad_model = pick_default_vad_model_path();
+        }
+        return run_test_voice_gate_batch(params);
+    }
+    if (!params.sweep_file.empty()) {
+        whisper_log_filter_cfg log_cfg{};
+        log_cfg.suppress_all = true;
+        whisper_log_set(whisper_log_filter_cb, &log_cfg);
+        if (params.vad_model.empty()) {
+            params.vad_model = pick_default_vad_model_path();
+        }
+        return run_vad_sweep(params);
+    }
 
     whisper_log_filter_cfg log_cfg{};
     if (params.debug_voice_gate) {
@@ -999,39 +3603,17 @@ int main(int argc, char ** argv) {
         whisper_log_set(whisper_log_filter_cb, &log_cfg);
     }
 
-    // Sanity/clamping to avoid invalid VAD windows.
-    params.vad_check_ms = std::max<int32_t>(50, params.vad_check_ms);
-    params.vad_window_ms = std::max<int32_t>(200, params.vad_window_ms);
-    params.vad_last_ms = std::max<int32_t>(50, params.vad_last_ms);
-    // Important: whisper.cpp's vad_simple() requires vad_window_ms > vad_last_ms.
-    if (params.vad_window_ms <= params.vad_last_ms) {
-        params.vad_window_ms = params.vad_last_ms + 100;
-    }
-
-    // Decoding sanity
-    if (params.max_tokens < 0) {
-        params.max_tokens = 0;
-    }
-
-    // Filtering sanity
-    if (params.dedup_similarity < 0.0f) params.dedup_similarity = 0.0f;
-    if (params.dedup_similarity > 1.0f) params.dedup_similarity = 1.0f;
-
-    // Voice gate sanity
-    params.voice_stop_ms = std::max<int32_t>(250, params.voice_stop_ms);
-    params.min_voice_ms = std::max<int32_t>(0, params.min_voice_ms);
-    if (params.vad_voice_threshold < 0.0f) params.vad_voice_threshold = 0.0f;
-    if (params.vad_voice_threshold > 1.0f) params.vad_voice_threshold = 1.0f;
-
-    // Voice gating needs enough ring-buffer history to include both:
-    // - the full spoken segment, and
-    // - the required trailing no-voice time (voice_stop_ms)
-    // The --fast preset reduces length_ms; enforce a safer minimum when voice gate is enabled.
-    if (params.voice_gate) {
-        const int32_t min_len_ms = std::max<int32_t>(20000, params.voice_stop_ms + 10000);
-        if (params.length_ms < min_len_ms) {
-            params.length_ms = min_len_ms;
+    if (!params.regress_corpus.empty()) {
+        log_cfg.suppress_all = true;
+        whisper_log_set(whisper_log_filter_cb, &log_cfg);
+        if (params.vad_model.empty()) {
+            params.vad_model = pick_default_vad_model_path();
+        }
+        if (params.model.empty()) {
+            params.model = pick_default_model_path();
         }
+        apply_quantize(params);
+        return run_regress(params);
     }
 
     if (params.list_devices) {
@@ -1053,7 +3635,28 @@ int main(int argc, char ** argv) {
         return 1;
     }
 
-    if (!params.device_name_substring.empty()) {
+    if (!params.debug_voice_gate) {
+        // Before --autotune, which then times the quantized model.
+        apply_quantize(params);
+    }
+    if (params.autotune && !params.debug_voice_gate) {
+        // Quiet while the model is loaded for each option; the usual logging resumes after.
+        const bool suppress_all = log_cfg.suppress_all;
+        log_cfg.suppress_all = true;
+        whisper_log_set(whisper_log_filter_cb, &log_cfg);
+        apply_autotune(params);
+        log_cfg.suppress_all = suppress_all;
+    }
+    if (params.cpu_budget > 0) {
+        // Silero runs on the gate thread while Whisper decodes on the worker: the two thread counts share the budget.
+        params.cpu_budget = std::min(params.cpu_budget, std::max(1, (int32_t) std::thread::hardware_concurrency()));
+        params.vad_threads = std::min(std::max<int32_t>(1, params.vad_threads), std::max<int32_t>(1, params.cpu_budget - 1));
+        params.threads = std::min(params.threads, std::max<int32_t>(1, params.cpu_budget - params.vad_threads));
+    }
+
+    const bool use_sdl_input = params.input_path.empty();
+
+    if (use_sdl_input && !params.device_name_substring.empty()) {
         const int idx = sdl_find_device_index_by_substring(params.device_name_substring);
         if (idx < 0) {
             std::fprintf(stderr, "error: no capture device matched --device-name '%s'\n", params.device_name_substring.c_str());
@@ -1065,7 +3668,7 @@ int main(int argc, char ** argv) {
 
     // If user did not specify a device, list all devices and prompt for selection.
     // If stdin is not interactive, fall back to SDL default device (-1).
-    if (params.device_index < 0 && params.device_name_substring.empty()) {
+    if (use_sdl_input && params.device_index < 0 && params.device_name_substring.empty()) {
         const int chosen = sdl_prompt_for_device_index(/*default_index*/ 0);
         if (chosen >= 0) {
             params.device_index = chosen;
@@ -1073,12 +3676,44 @@ int main(int argc, char ** argv) {
         }
     }
 
-    // init audio capture (reuse whisper.cpp example helper)
-    audio_async audio(params.length_ms);
-    if (!audio.init(params.device_index, WHISPER_SAMPLE_RATE)) {
-        std::fprintf(stderr, "error: audio.init() failed\n");
-        return 3;
+    // Capture and the voice gate run on this thread; SDL's audio thread and the file reader are started from it.
+    if (!params.affinity_gate.empty() && !pin_current_thread(params.affinity_gate)) {
+        std::fprintf(stderr, "warning: cannot pin the capture/gate thread (--affinity-gate)\n");
+    }
+    // Only find out here whether the gate may be raised: threads inherit the priority on Linux, so it is applied once
+    // the capture, sender and Whisper threads are running.
+    const bool gate_raised = params.cpu_budget > 0 && set_current_thread_priority(thread_priority::high);
+    if (gate_raised) {
+        set_current_thread_priority(thread_priority::normal);
+    }
+
+    // init audio capture: SDL microphone (native rate + our resampler) or raw PCM from stdin/pipe/file
+    std::unique_ptr<capture_source> audio_src;
+    if (use_sdl_input) {
+        auto sdl = std::make_unique<sdl_capture_source>(params.length_ms);
+        if (!sdl->init(params.device_index, WHISPER_SAMPLE_RATE, params.sdl_resampler)) {
+            std::fprintf(stderr, "error: audio.init() failed\n");
+            return 3;
+        }
+        audio_src = std::move(sdl);
+    } else {
+        pcm_stream_config pcfg;
+        pcfg.path = params.input_path;
+        pcfg.format = params.input_format;
+        pcfg.sample_rate = WHISPER_SAMPLE_RATE;
+        pcfg.realtime = params.input_realtime < 0 ? params.input_is_file : params.input_realtime != 0;
+        // Enough trailing silence for either gate to see the end of the last utterance.
+        pcfg.eof_tail_ms = params.voice_stop_ms + 2 * params.vad_check_ms + 500;
+
+        auto pcm = std::make_unique<pcm_stream_capture_source>(params.length_ms);
+        std::string err;
+        if (!pcm->init(pcfg, err)) {
+            std::fprintf(stderr, "error: %s\n", err.c_str());
+            return 3;
+        }
+        audio_src = std::move(pcm);
     }
+    capture_source & audio = *audio_src;
     audio.resume();
 
     // init Silero VAD (used to distinguish speech vs noise/music)
@@ -1104,7 +3739,7 @@ int main(int argc, char ** argv) {
             params.voice_gate = false;
         } else {
             whisper_vad_context_params vcp = whisper_vad_default_context_params();
-            vcp.n_threads = std::max(1, params.threads);
+            vcp.n_threads = params.vad_threads > 0 ? params.vad_threads : std::max(1, params.threads);
             vcp.use_gpu = false;
             vcp.gpu_device = 0;
             vctx = whisper_vad_init_from_file_with_params(params.vad_model.c_str(), vcp);
@@ -1125,10 +3760,11 @@ int main(int argc, char ** argv) {
             std::fprintf(stderr, "Voice gate: OFF (--no-voice-gate)\n");
         } else if (params.voice_gate && vctx) {
             std::fprintf(stderr,
-                "Voice gate: ON (Silero) stop=%dms min=%dms thold=%.2f model=%s\n",
+                "Voice gate: ON (Silero) stop=%dms min=%dms thold=%.2f max_utterance=%dms model=%s\n",
                 params.voice_stop_ms,
                 params.min_voice_ms,
                 params.vad_voice_threshold,
+                params.max_utterance_ms,
                 params.vad_model.c_str());
         } else {
             std::fprintf(stderr,
@@ -1150,7 +3786,7 @@ int main(int argc, char ** argv) {
         constexpr int32_t k_debug_window_ms = 200;
 
         while (true) {
-            if (!sdl_poll_events()) {
+            if (!audio.poll()) {
                 break;
             }
 
@@ -1162,10 +3798,10 @@ int main(int argc, char ** argv) {
                 continue;
             }
 
-            audio.get(k_debug_window_ms, pcm_dbg);
+            const audio_view dbg = audio.view(k_debug_window_ms);
             bool voice = false;
-            if (vctx && !pcm_dbg.empty()) {
-                whisper_vad_segments * segs = whisper_vad_segments_from_samples(vctx, vadp_dbg, pcm_dbg.data(), (int) pcm_dbg.size());
+            if (vctx && !dbg.empty()) {
+                whisper_vad_segments * segs = whisper_vad_segments_from_samples(vctx, vadp_dbg, dbg.linearize(pcm_dbg), (int) dbg.size());
                 voice = segs && whisper_vad_segments_n_segments(segs) > 0;
                 if (segs) whisper_vad_free_segments(segs);
             }
@@ -1186,16 +3822,31 @@ int main(int argc, char ** argv) {
         std::fprintf(stderr, "error: unknown language '%s'\n", params.language.c_str());
         return 4;
     }
+    // The --model-map models load later, on the worker: catch a typo now rather than at the first utterance.
+    for (const model_route & r : params.model_map) {
+        std::error_code ec;
+        if (whisper_lang_id(r.language.c_str()) == -1) {
+            std::fprintf(stderr, "error: unknown language '%s' in --model-map\n", r.language.c_str());
+            return 4;
+        }
+        if (!std::filesystem::is_regular_file(r.path, ec)) {
+            std::fprintf(stderr, "error: --model-map model not found: %s\n", r.path.c_str());
+            return 4;
+        }
+    }
 
     whisper_context_params cparams = whisper_context_default_params();
     cparams.use_gpu = params.use_gpu;
     cparams.flash_attn = params.flash_attn;
 
-    whisper_context * ctx = whisper_init_from_file_with_params(params.model.c_str(), cparams);
+    model_load_report load;
+    whisper_context * ctx = model_file_init(params.model, cparams, params.model_load, &load);
     if (!ctx) {
         std::fprintf(stderr, "error: failed to initialize whisper context\n");
         return 5;
     }
+    std::fprintf(stderr, "Model: %s loaded in %.0fms (%s), resident %+.0f MiB\n", params.model.c_str(), load.load_ms,
+        model_load_mode_name(params.model_load.mode), ((double) load.rss_after - (double) load.rss_before) / (1024.0 * 1024.0));
 
     if (!whisper_is_multilingual(ctx)) {
         if (params.language != "en" || params.translate) {
@@ -1205,25 +3856,163 @@ int main(int argc, char ** argv) {
         }
     }
 
+    // Optional smaller model for decodes that missed their deadline.
+    whisper_context * fallback_ctx = nullptr;
+    if (!params.fallback_model.empty() && params.decode_fallback) {
+        fallback_ctx = model_file_init(params.fallback_model, cparams, params.model_load);
+        if (!fallback_ctx) {
+            std::fprintf(stderr, "warning: failed to load --fallback-model %s; timeouts retry on the main model\n", params.fallback_model.c_str());
+        }
+    }
+
+    // A small multilingual model for the language-detect pass, so routing an utterance costs less than decoding it.
+    whisper_context * lid_ctx = nullptr;
+    if (!params.lid_model.empty()) {
+        lid_ctx = model_file_init(params.lid_model, cparams, params.model_load);
+        if (!lid_ctx || !whisper_is_multilingual(lid_ctx)) {
+            std::fprintf(stderr, "warning: --lid-model %s %s; detecting the language on the main model\n", params.lid_model.c_str(),
+                lid_ctx ? "is English-only" : "failed to load");
+            if (lid_ctx) whisper_free(lid_ctx);
+            lid_ctx = nullptr;
+        }
+    }
+    // Per-language models: the worker loads each on its first utterance and frees it once idle.
+    std::unique_ptr<model_router> router;
+    if (!params.model_map.empty()) {
+        router = std::make_unique<model_router>(params.model_map, cparams, params.model_load, (int64_t) params.model_idle_s * 1000);
+        for (const model_route & r : params.model_map) {
+            std::fprintf(stderr, "Model route: %s -> %s (on first use)\n", r.language.c_str(), r.path.c_str());
+        }
+    }
+
     streamerbot_ws_client bot;
     streamerbot_sender bot_sender(params.bot);
 
-    std::vector<float> pcm_vad_window;
-    std::vector<float> pcm_block;
-    std::vector<float> pcm_lang;
-    std::string last_sent;
+    // Whisper runs on its own thread so the voice gate keeps following the audio during inference:
+    // chunks of a long utterance go out while it is still being spoken.
+    transcribe_state tst;
+    tst.params = &params;
+    tst.ctx = ctx;
+    tst.fallback_ctx = fallback_ctx;
+    tst.lid_ctx = lid_ctx;
+    tst.router = router.get();
+    tst.audio = &audio;
+    tst.bot_sender = &bot_sender;
+    tst.trace = params.trace_voice_gate;
+    // The worker (and on Linux whisper's compute threads) would inherit the gate's CPUs: give it its own, or all.
+    std::vector<int> worker_cpus = params.affinity_whisper;
+    if (worker_cpus.empty() && !params.affinity_gate.empty()) {
+        for (int c = 0; c < (int) std::max(1u, std::thread::hardware_concurrency()); ++c) {
+            worker_cpus.push_back(c);
+        }
+    }
+    // Without the rights to raise the gate above normal, lower the decoder instead: the gate still comes first.
+    const bool lower_worker = params.cpu_budget > 0 && !gate_raised;
+    inference_worker worker([&tst](const inference_job & job, const std::atomic<bool> & abort) {
+        return transcribe_block(tst, job, abort);
+    }, /*max_queue*/ 8, [worker_cpus, lower_worker]() {
+        if (!worker_cpus.empty() && !pin_current_thread(worker_cpus)) {
+            std::fprintf(stderr, "warning: cannot pin the Whisper worker (--affinity-whisper)\n");
+        }
+        if (lower_worker) {
+            set_current_thread_priority(thread_priority::low);
+        }
+    });
+    tst.worker = &worker;
+    if (gate_raised) {
+        set_current_thread_priority(thread_priority::high);
+    }
+    if (router) {
+        // Between utterances, on the worker: a model is never freed under a decode.
+        worker.set_idle(std::chrono::seconds(1), [&router]() { router->unload_idle(); });
+    }
+    if (params.batch_max > 1 && params.voice_gate && vctx) {
+        // Leave room in the 30s window for the gaps between the utterances.
+        const size_t max_samples = (size_t) (30000 - 1000 * params.batch_max) * WHISPER_SAMPLE_RATE / 1000;
+        worker.set_batching((size_t) params.batch_max, max_samples,
+            [&tst](const inference_job & job) { return batchable_job(tst, job); },
+            [&tst](const std::vector<inference_job> & jobs, const std::atomic<bool> & abort) {
+                return transcribe_batch(tst, jobs, abort);
+            });
+    }
 
-    bool in_voice = false;
-    auto t_voice_start = std::chrono::high_resolution_clock::now();
-    auto t_last_voice  = t_voice_start;
-    bool trace_silence_started = false;
+    // The VAD window and the block are views into the capture ring; this only holds a copy when the window
+    // wraps around the end of the ring.
+    std::vector<float> pcm_vad_window;
+    audio_view vad_view;
+    audio_view block_view;
+    // Stats of the VAD window come with the snapshot (capture-side chunk summaries); the block gets one fused pass.
+    audio_window_stats vad_win_stats;
+    const size_t vad_last_samples = (size_t) WHISPER_SAMPLE_RATE * (size_t) params.vad_last_ms / 1000;
+
+    // Energy pre-gate in front of Silero and the adaptive check cadence (voice gate mode only).
+    energy_gate_params egp;
+    egp.margin_db = params.energy_gate_db;
+    egp.base_check_ms = params.vad_check_ms;
+    egp.idle_check_ms = params.vad_check_idle_ms;
+    energy_gate egate(egp);
+    const bool egate_on = params.voice_gate && vctx && egate.enabled();
+
+    cpu_phase_meter cpu_meter;
+    bool tick_active = false;
+    audio_copy_stats copies_reported = audio_copy_totals();
+
+    uint64_t utterance_id = 0;
+    // Provisional decode in flight (--endpoint-probe), the sample it would end the utterance at, and its check.
+    uint64_t probe_job = 0;
+    uint64_t probe_now = 0;
+    voice_gate_decision probe_gate;
+    // Speculative decode in flight or held (--speculative-decode): its samples and the speech end it assumed.
+    uint64_t spec_job = 0;
+    uint64_t spec_begin = 0;
+    uint64_t spec_end = 0;
+    uint64_t spec_speech_end = 0;
+    // Log-mel frames of the current utterance, computed as its audio arrives (voice gate mode only).
+    std::shared_ptr<const log_mel> mel_front;
+    std::unique_ptr<log_mel_stream> mel_stream;
+    if (params.incremental_mel && params.voice_gate && vctx) {
+        mel_front = std::make_shared<log_mel>(whisper_model_n_mels(ctx), WHISPER_SAMPLE_RATE);
+        mel_stream = std::make_unique<log_mel_stream>(mel_front, (size_t) (params.length_ms + capture_source::k_view_headroom_ms) / 10);
+        tst.mel = mel_front.get();
+    }
+    voice_gate_params vgp = make_voice_gate_params(params);
+    if (mel_stream) {
+        // Blocks start on the mel frame grid so the precomputed frames line up with the block's.
+        vgp.block_align = log_mel::k_hop;
+    }
+    voice_gate gate(vgp);
+    const utterance_timeline & vtl = gate.timeline();
+    voice_gate_recorder gate_recorder;
+    if (!params.record_voice_gate.empty() && params.voice_gate && vctx) {
+        if (gate_recorder.open(params.record_voice_gate, vgp)) {
+            std::fprintf(stderr, "Voice gate: recording Silero probabilities to %s\n", params.record_voice_gate.c_str());
+        } else {
+            std::fprintf(stderr, "warning: cannot write --record-voice-gate file %s; not recording\n", params.record_voice_gate.c_str());
+        }
+    }
     const auto t_trace0 = std::chrono::high_resolution_clock::now();
     auto t_last_vg_status = t_trace0;
 
     std::fprintf(stderr, "\nAi-Subtitler started.\n");
-    std::fprintf(stderr, "- Capture device index: %d\n", params.device_index);
+    std::fprintf(stderr, "- Capture: %s\n", audio.describe().c_str());
     std::fprintf(stderr, "- VAD: length_ms=%d check_ms=%d vad_window_ms=%d vad_last_ms=%d vad_thold=%.2f freq_thold=%.1f\n",
         params.length_ms, params.vad_check_ms, params.vad_window_ms, params.vad_last_ms, params.vad_thold, params.freq_thold);
+    if (egate_on) {
+        std::fprintf(stderr, "- Energy gate: margin=%.1fdB check_ms=%d idle_check_ms=%d\n", egp.margin_db, params.vad_check_ms, params.vad_check_idle_ms);
+    }
+    if (params.cpu_budget > 0 || !params.affinity_gate.empty() || !params.affinity_whisper.empty()) {
+        auto cpu_list = [](const std::vector<int> & cpus) {
+            std::string s;
+            for (const int c : cpus) {
+                s += (s.empty() ? "" : ",") + std::to_string(c);
+            }
+            return s.empty() ? std::string("any") : s;
+        };
+        std::fprintf(stderr, "- CPU: budget=%d whisper_threads=%d vad_threads=%d gate_cpus=%s whisper_cpus=%s priority=%s\n",
+            params.cpu_budget, params.threads, params.vad_threads > 0 ? params.vad_threads : params.threads,
+            cpu_list(params.affinity_gate).c_str(), cpu_list(params.affinity_whisper).c_str(),
+            gate_raised ? "gate raised" : (lower_worker ? "decoder lowered" : "normal"));
+    }
     std::fprintf(stderr, "- Streamer.bot: %s (Action='%s', Arg='%s')\n", params.bot.url.c_str(), params.bot.action_name.c_str(), params.bot.arg_key.c_str());
     std::fprintf(stderr, "Speak normally, then pause briefly to send a block.\n\n");
 
@@ -1247,370 +4036,361 @@ int main(int argc, char ** argv) {
 
     auto t_last = std::chrono::high_resolution_clock::now();
     bool running = true;
-    int iter = 0;
+    uint64_t overruns_reported = 0;
+    auto t_last_cpu_report = t_last;
+    auto t_last_gate_trace = t_last;
 
     while (running) {
-        running = sdl_poll_events();
+        running = audio.poll();
         if (!running) break;
 
+        // Each pass counts as active when it was inside an utterance or Whisper was running.
+        cpu_meter.mark(tick_active);
+        tick_active = vtl.in_voice() || worker.busy();
+
+        // Verdict of a provisional decode: a sentence end (emitted, or dropped by the output filters) ends the utterance.
+        if (probe_job != 0) {
+            const inference_outcome o = worker.outcome(probe_job);
+            if (o != inference_outcome::pending) {
+                if ((o == inference_outcome::emitted || o == inference_outcome::filtered) && vtl.in_voice()) {
+                    if (params.trace_voice_gate) {
+                        print_endpoint_trace(stderr, "probe", probe_gate);
+                    }
+                    // Later audio starts a new utterance (the timeline ignores speech before probe_now, so the ring is not cleared).
+                    gate.accept_probe(probe_now);
+                    gate_recorder.accept_probe(probe_now);
+                }
+                probe_job = 0;
+            }
+        }
+
+        {
+            const capture_stats cst = audio.stats();
+            if (cst.overruns != overruns_reported) {
+                overruns_reported = cst.overruns;
+                std::fprintf(stderr, "warning: capture overrun #%llu (%.1fs of audio lost in total): input is arriving faster than the pipeline reads it\n",
+                    (unsigned long long) cst.overruns,
+                    (double) cst.samples_lost / (double) WHISPER_SAMPLE_RATE);
+            }
+        }
+
         const auto t_now = std::chrono::high_resolution_clock::now();
+
+        if (params.cpu_report_ms > 0 && ms_since(t_last_cpu_report, t_now) >= params.cpu_report_ms) {
+            print_cpu_phases(stderr, "[CPU]", cpu_meter, egate_on ? &egate : nullptr);
+            const audio_copy_stats copies = audio_copy_totals();
+            print_copy_stats(stderr, "[CPU]", copies, copies_reported, 1e-3 * (double) ms_since(t_last_cpu_report, t_now));
+            copies_reported = copies;
+            t_last_cpu_report = t_now;
+        }
+
         const auto t_diff = std::chrono::duration_cast<std::chrono::milliseconds>(t_now - t_last).count();
-        if (t_diff < params.vad_check_ms) {
-            const int32_t sleep_ms = std::min<int32_t>(50, std::max<int32_t>(1, params.vad_check_ms / 3));
-            std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
-            continue;
+        const int32_t check_ms = egate_on ? egate.check_interval_ms() : params.vad_check_ms;
+        if (t_diff < check_ms) {
+            // While the cadence is stretched, a cheap peek at the newest audio snaps it back on the first energy rise.
+            const bool wake = egate_on && egate.stretched() && egate.wake_on_rise(level_dbfs(audio.peek_stats(100).rms()));
+            if (!wake) {
+                const int32_t sleep_ms = std::min<int32_t>(50, std::max<int32_t>(1, params.vad_check_ms / 3));
+                std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
+                continue;
+            }
+        }
+
+        // Level of everything since the previous check, from the capture-side summaries.
+        float level_db = -100.0f;
+        if (egate_on) {
+            const int32_t recent_ms = std::min<int32_t>(params.vad_window_ms, std::max<int32_t>(200, (int32_t) t_diff));
+            level_db = level_dbfs(audio.peek_stats(recent_ms).rms());
         }
 
-        audio.get(params.vad_window_ms, pcm_vad_window);
-        if (pcm_vad_window.empty()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(25));
+        if (!(egate_on && !vtl.in_voice() && egate.is_quiet(level_db))) {
+            vad_view = audio.view(params.vad_window_ms, vad_last_samples, vad_win_stats);
+            if (vad_view.empty()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(25));
+                continue;
+            }
+        }
+
+        // Energy pre-gate: outside an utterance, audio at the noise floor cannot hold speech, so Silero is skipped.
+        if (egate_on && !vtl.in_voice() && egate.is_quiet(level_db)) {
+            egate.count_skip();
+            egate.on_check(ms_since(t_trace0, t_now), level_db, /*active*/ false);
+            if (params.trace_voice_gate && params.trace_voice_gate_status && ms_since(t_last_gate_trace, t_now) >= 1000) {
+                std::fprintf(stderr, "[VG] ENERGY_SKIP t=%lldms level=%.1fdBFS floor=%.1fdBFS interval=%dms\n",
+                    (long long) ms_since(t_trace0, t_now), level_db, egate.floor_db(), egate.check_interval_ms());
+                std::fflush(stderr);
+                t_last_gate_trace = t_now;
+            }
+            t_last = t_now;
             continue;
         }
 
+        inference_job job;
         bool have_pcm_block = false;
-        bool gated_block = false;
 
-        // Voice gate mode: only run Whisper when speech has ended for long enough.
+        // Voice gate mode: only run Whisper when speech has ended for long enough, or in chunks while it runs long.
+        // Speech start/end are Silero segment positions on the capture ring's sample timeline.
         if (params.voice_gate && vctx) {
-            bool voice_present = false;
-            int segs_n = 0;
-            whisper_vad_segments * segs = whisper_vad_segments_from_samples(vctx, vadp, pcm_vad_window.data(), (int) pcm_vad_window.size());
-            segs_n = segs ? whisper_vad_segments_n_segments(segs) : 0;
-            voice_present = segs_n > 0;
-            if (segs) whisper_vad_free_segments(segs);
+            const uint64_t now = vad_view.seq + vad_view.size();
+            voice_gate_check gc;
+            vad_window_probs(vctx, vad_view.linearize(pcm_vad_window), vad_view, gc);
+            gc.now = now;
+            gc.allow_probe = probe_job == 0;
+            gc.allow_speculation = spec_job == 0;
+            const voice_gate_decision gd = gate.check(gc);
+            gate_recorder.check(gc, gd);
+            const utterance_timeline::event ev = gd.ev;
+            const bool voice_present = gd.voice_present;
+
+            if (egate_on) {
+                egate.on_check(ms_since(t_trace0, t_now), level_db, voice_present);
+            }
+            tick_active = tick_active || voice_present;
 
             if (params.trace_voice_gate && params.trace_voice_gate_status) {
                 const auto status_diff_ms = (int64_t) std::chrono::duration_cast<std::chrono::milliseconds>(t_now - t_last_vg_status).count();
                 if (status_diff_ms >= 1000) {
-                    const int64_t silent_ms = in_voice ? (int64_t) std::chrono::duration_cast<std::chrono::milliseconds>(t_now - t_last_voice).count() : -1;
-                    const int64_t voice_ms  = in_voice ? (int64_t) std::chrono::duration_cast<std::chrono::milliseconds>(t_last_voice - t_voice_start).count() : -1;
                     print_voice_gate_status(stderr,
                         ms_since(t_trace0, t_now),
-                        in_voice,
+                        vtl.in_voice(),
                         voice_present,
-                        segs_n,
-                        silent_ms,
-                        voice_ms,
-                        audio_rms(pcm_vad_window),
-                        pcm_vad_window.size());
+                        gd.n_spans,
+                        gd.silent_ms,
+                        gd.voice_ms,
+                        vad_win_stats.all.rms(),
+                        vad_view.size());
                     t_last_vg_status = t_now;
                 }
             }
 
-            if (voice_present) {
-                if (!in_voice) {
-                    in_voice = true;
-                    t_voice_start = t_now;
-                    if (params.trace_voice_gate) {
-                        trace_silence_started = false;
-                        print_voice_gate_trace(stderr, "VOICE_START", ms_since(t_trace0, t_now), -1, -1);
-                    }
-                }
-                t_last_voice = t_now;
-                t_last = t_now;
-                continue;
+            if (ev == utterance_timeline::event::voice_start) {
+                ++utterance_id;
             }
-
-            if (in_voice) {
-                if (params.trace_voice_gate && !trace_silence_started) {
-                    trace_silence_started = true;
-                    print_voice_gate_trace(stderr, "VOICE_END", ms_since(t_trace0, t_now), -1, -1);
+            // Mel frames of the speech so far (and of the silence wait), so a flush only has the block edges left.
+            if (mel_stream && (vtl.in_voice() || ev == utterance_timeline::event::flush)) {
+                if (ev == utterance_timeline::event::voice_start) {
+                    uint64_t b = 0;
+                    uint64_t e = 0;
+                    vtl.block_range(now, b, e);
+                    mel_stream->restart(b - b % log_mel::k_hop);
                 }
-                const auto silent_ms = (int64_t) std::chrono::duration_cast<std::chrono::milliseconds>(t_now - t_last_voice).count();
-                if (silent_ms >= params.voice_stop_ms) {
-                    const auto voice_ms = (int64_t) std::chrono::duration_cast<std::chrono::milliseconds>(t_last_voice - t_voice_start).count();
-
-                    if (voice_ms >= params.min_voice_ms) {
-                        int32_t block_ms = (int32_t) std::chrono::duration_cast<std::chrono::milliseconds>(t_now - t_voice_start).count();
-                        block_ms = std::max<int32_t>(0, std::min<int32_t>(block_ms, params.length_ms));
-
-                        if (params.trace_voice_gate) {
-                            print_voice_gate_trace(stderr, "FLUSH", ms_since(t_trace0, t_now), voice_ms, block_ms);
-                        }
-
-                        audio.get(block_ms, pcm_block);
-
-                        // IMPORTANT: in voice-gate mode we intentionally wait for `voice_stop_ms` of silence.
-                        // The `block_ms` above includes that trailing silence, which can cause tiny models to hallucinate
-                        // short outputs like "Thank you" / "you" / junk glyphs on the silent tail.
-                        // We cannot fix this by shrinking block_ms (audio.get(ms) returns the most recent ms, which would
-                        // chop the *start* of speech). Instead, trim the silence from the end of the captured block.
-                        {
-                            constexpr int32_t k_keep_tail_ms = 200;
-                            const int64_t trim_ms = std::max<int64_t>(0, silent_ms - k_keep_tail_ms);
-                            const size_t trim_samples = (size_t) ((trim_ms * WHISPER_SAMPLE_RATE) / 1000);
-                            if (trim_samples > 0 && trim_samples < pcm_block.size()) {
-                                pcm_block.resize(pcm_block.size() - trim_samples);
-                            } else if (trim_samples >= pcm_block.size()) {
-                                pcm_block.clear();
-                            }
-                        }
-
-                        if (params.trace_voice_gate) {
-                            std::fprintf(stderr,
-                                "[VG] FLUSH_AUDIO silent=%lldms block_ms=%d pcm_n=%zu rms=%.4f\n",
-                                (long long) silent_ms,
-                                (int) block_ms,
-                                pcm_block.size(),
-                                audio_rms(pcm_block));
-                            std::fflush(stderr);
-                        }
-                        if (pcm_block.size() >= (size_t) (WHISPER_SAMPLE_RATE * 0.5)) {
-                            have_pcm_block = true;
-                            gated_block = true;
-                        } else {
-                            if (params.trace_voice_gate) {
-                                std::fprintf(stderr, "[VG] DROP_TOO_SHORT pcm_n=%zu (need >= %.0f)\n",
-                                    pcm_block.size(),
-                                    (double) (WHISPER_SAMPLE_RATE * 0.5));
-                                std::fflush(stderr);
-                            }
-                            audio.clear();
-                            in_voice = false;
-                            t_last = t_now;
-                            continue;
-                        }
-                    } else {
-                        // Too short: likely a click / noise burst.
-                        if (params.trace_voice_gate) {
-                            print_voice_gate_trace(stderr, "DROP_SHORT", ms_since(t_trace0, t_now), voice_ms, 0);
-                            std::fprintf(stderr, "[VG] DROP_SHORT_DETAIL silent=%lldms min_voice=%dms\n",
-                                (long long) silent_ms,
-                                params.min_voice_ms);
-                            std::fflush(stderr);
-                        }
-                        audio.clear();
-                        in_voice = false;
-                        trace_silence_started = false;
-                        t_last = t_now;
-                        continue;
-                    }
-
-                    // Reset for next utterance.
-                    audio.clear();
-                    in_voice = false;
-                    trace_silence_started = false;
-                } else {
-                    t_last = t_now;
-                    continue;
+                mel_stream->feed(audio.view_range(mel_stream->needed_from(), now));
+            }
+            if (ev == utterance_timeline::event::voice_start || ev == utterance_timeline::event::voice_end) {
+                if (params.trace_voice_gate) {
+                    print_voice_gate_trace(stderr, ev == utterance_timeline::event::voice_start ? "VOICE_START" : "VOICE_END", ms_since(t_trace0, t_now), -1, -1);
                 }
-            } else {
-                t_last = t_now;
-                continue;
             }
-        }
 
-        if (!have_pcm_block) {
-            // In whisper.cpp, vad_simple() returns true when the last part of the window is relatively silent.
-            if (!::vad_simple(pcm_vad_window, WHISPER_SAMPLE_RATE, params.vad_last_ms, params.vad_thold, params.freq_thold, false)) {
-                t_last = t_now;
-                continue;
+            // A provisional decode is void once speech resumes, and superseded by a flush or a chunk cut.
+            if (probe_job != 0 && (vtl.speech_end() > probe_now || ev == utterance_timeline::event::flush || ev == utterance_timeline::event::chunk)) {
+                worker.cancel(probe_job);
+                probe_job = 0;
             }
-
-            audio.get(params.length_ms, pcm_block);
-            if (pcm_block.size() < (size_t) (WHISPER_SAMPLE_RATE * 0.5)) {
-                t_last = t_now;
-                continue;
+            // Same for a speculative decode: if speech resumed, abort it; the utterance goes on.
+            if (spec_job != 0 && (vtl.speech_end() > spec_speech_end || ev == utterance_timeline::event::chunk)) {
+                if (params.trace_voice_gate) {
+                    std::fprintf(stderr, "[VG] SPECULATIVE_ABORT t=%lldms\n", (long long) ms_since(t_trace0, t_now));
+                    std::fflush(stderr);
+                }
+                worker.cancel(spec_job);
+                spec_job = 0;
             }
-        }
 
-        // Activity fraction is cheap and used for conservative near-silence suppression.
-        // Compute it consistently across modes so suppression decisions aren't based on a hardcoded 0.
-        const float block_frac = audio_activity_fraction(pcm_block, /*abs_thold=*/0.01f);
-        const float block_rms  = params.debug_thankyou ? audio_rms(pcm_block) : 0.0f;
-        const float vad_frac   = params.debug_thankyou ? audio_activity_fraction(pcm_vad_window, /*abs_thold=*/0.01f) : 0.0f;
-        const float vad_rms    = params.debug_thankyou ? audio_rms(pcm_vad_window) : 0.0f;
-
-        // Fast-mode guard: keyboard clicks / near-silence can trigger VAD and cause hallucinations like "thank you".
-        // If the block has very low activity, drop it and clear the buffer so we don't retrigger on the same click.
-        if (params.fast && !gated_block) {
-            if (block_frac < 0.01f) {
+            if (ev == utterance_timeline::event::drop_short) {
+                // Too short: likely a click / noise burst.
+                if (params.trace_voice_gate) {
+                    print_voice_gate_trace(stderr, "DROP_SHORT", ms_since(t_trace0, t_now), gd.voice_ms, 0);
+                    std::fprintf(stderr, "[VG] DROP_SHORT_DETAIL silent=%lldms min_voice=%dms\n",
+                        (long long) gd.silent_ms,
+                        params.min_voice_ms);
+                    std::fflush(stderr);
+                }
                 audio.clear();
                 t_last = t_now;
                 continue;
             }
 
-            // Crucial: prevent overlap-repeat spam by discarding the already-snapshotted audio.
-            // This keeps any new speech during whisper inference for the next iteration.
-            audio.clear();
-        }
-
-        whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
-        wparams.print_progress = false;
-        wparams.print_realtime = false;
-        wparams.print_special = false;
-        wparams.print_timestamps = false;
-        wparams.no_timestamps = params.fast ? true : false;
-        wparams.suppress_blank = true;
-        wparams.suppress_nst = params.fast ? true : false;
-        wparams.translate = params.translate;
-        wparams.single_segment = params.fast ? true : false;
-        wparams.max_tokens = params.max_tokens;
-        wparams.no_context = params.fast ? true : false;
-        if (params.fast) {
-            // Greedy decoding: minimize extra sampling work.
-            wparams.greedy.best_of = 1;
-        }
-        // Language selection:
-        // - If user asked for auto, enable built-in whisper language detection.
-        // - If language is English (default) AND model is multilingual, auto-fallback to French when French is clearly more likely.
-        std::string effective_language = params.language;
-        if (params.language == "auto") {
-            wparams.detect_language = true;
-            wparams.language = "auto";
-        } else {
-            wparams.detect_language = false;
-            if (params.language == "en" && whisper_is_multilingual(ctx)) {
-                if (params.fast) {
-                    // Keep fast mode snappy: detect from a short tail instead of the full block.
-                    const int32_t tail_ms = std::min<int32_t>(1500, std::max<int32_t>(500, params.length_ms));
-                    const size_t tail_samples = (size_t) (tail_ms * WHISPER_SAMPLE_RATE / 1000);
-                    pcm_lang.clear();
-                    if (pcm_block.size() > tail_samples) {
-                        pcm_lang.insert(pcm_lang.end(), pcm_block.end() - tail_samples, pcm_block.end());
-                    } else {
-                        pcm_lang = pcm_block;
-                    }
-                    effective_language = pick_language_en_fallback_fr(ctx, pcm_lang, params.threads);
-                } else {
-                    effective_language = pick_language_en_fallback_fr(ctx, pcm_block, params.threads);
+            const char * block_tag = "FLUSH";
+            switch (gd.block) {
+                case voice_gate_block::chunk:
+                    // Long speech: transcribe up to its best recent pause now and keep the utterance open.
+                    job.chunk = true;
+                    block_tag = "CHUNK";
+                    break;
+                case voice_gate_block::flush:
+                    // Exactly [speech start - preroll, speech end + tail] out of the ring, so neither the start of
+                    // speech nor the voice_stop_ms of trailing silence (which makes tiny models hallucinate short outputs
+                    // like "Thank you" / "you" / junk glyphs) depends on when this loop happened to run.
+                    break;
+                case voice_gate_block::probe:
+                    job.probe = true;
+                    probe_now = now;
+                    probe_gate = gd;
+                    block_tag = "PROBE";
+                    break;
+                case voice_gate_block::speculate:
+                    // Start on the block while the endpoint is still pending, so inference overlaps the silence wait.
+                    job.speculative = true;
+                    block_tag = "SPECULATE";
+                    break;
+                case voice_gate_block::none:
+                    t_last = t_now;
+                    continue;
+            }
+            block_view = audio.view_range(gd.begin, gd.end);
+            job.voiced_ms = gd.voiced_ms;
+            // Flush or probe over the very samples the speculative decode read: take its result.
+            if (!job.speculative && spec_job != 0) {
+                if (block_view.seq == spec_begin && block_view.seq + block_view.size() == spec_end) {
+                    job.reuse = spec_job;
+                } else if (ev == utterance_timeline::event::flush) {
+                    worker.cancel(spec_job);
                 }
             }
-            wparams.language = effective_language.c_str();
-        }
-        wparams.n_threads = params.threads;
-        wparams.audio_ctx = 0;
-
-        if (whisper_full(ctx, wparams, pcm_block.data(), pcm_block.size()) != 0) {
-            std::fprintf(stderr, "whisper_full failed\n");
-            t_last = t_now;
-            continue;
-        }
-
-        std::string text;
-        const int n_segments = whisper_full_n_segments(ctx);
-        float max_no_speech_prob = 0.0f;
-        std::vector<float> dbg_seg_ns;
-        std::vector<int> dbg_seg_tok;
-        std::vector<int64_t> dbg_seg_t0;
-        std::vector<int64_t> dbg_seg_t1;
-        if (params.debug_thankyou) {
-            dbg_seg_ns.reserve(n_segments);
-            dbg_seg_tok.reserve(n_segments);
-            dbg_seg_t0.reserve(n_segments);
-            dbg_seg_t1.reserve(n_segments);
-        }
-        for (int i = 0; i < n_segments; ++i) {
-            const float ns = whisper_full_get_segment_no_speech_prob(ctx, i);
-            max_no_speech_prob = std::max(max_no_speech_prob, ns);
-            if (params.debug_thankyou) {
-                dbg_seg_ns.push_back(ns);
-                dbg_seg_tok.push_back(whisper_full_n_tokens(ctx, i));
-                dbg_seg_t0.push_back(whisper_full_get_segment_t0(ctx, i));
-                dbg_seg_t1.push_back(whisper_full_get_segment_t1(ctx, i));
+            if (ev == utterance_timeline::event::flush) {
+                spec_job = 0;
+            }
+            job.stats = audio_stats_compute(block_view);
+            if (mel_stream) {
+                job.mel = mel_stream->frames_for(block_view);
             }
-            const char * seg = whisper_full_get_segment_text(ctx, i);
-            if (seg) text += seg;
-        }
-
-        text = trim_and_collapse_ws(text);
-        if (text.empty()) {
-            t_last = t_now;
-            continue;
-        }
-
-        // whisper.cpp can emit this special token when the audio block is effectively silence.
-        // Don't send it to Streamer.bot.
-        if (text == "[BLANK_AUDIO]") {
-            t_last = t_now;
-            continue;
-        }
-
-        const bool is_thanks = is_exact_thank_you(text);
-        const bool is_you = is_exact_you(text);
-        const bool is_garbage = is_short_garbage_like(text);
-        const bool suppress_thanks = params.fast && is_thanks && max_no_speech_prob >= 0.80f;
-
-        // Suppress common near-silence end-of-utterance garbage.
-        // Keep this conservative: only when Whisper itself says it's probably no-speech.
-        // If the confidence is extremely high, allow suppression even with some background noise.
-        const bool suppress_silence_garbage =
-            (is_you || is_garbage) &&
-            (
-                (max_no_speech_prob >= 0.95f) ||
-                (max_no_speech_prob >= 0.85f && block_frac < 0.02f)
-            );
 
-        if (params.debug_thankyou && is_thanks) {
-            std::fprintf(stderr,
-                "[DBG thankyou] suppress=%d max_no_speech=%.2f block: frac=%.3f rms=%.6f vad: frac=%.3f rms=%.6f segs=%d\n",
-                suppress_thanks ? 1 : 0,
-                max_no_speech_prob,
-                block_frac,
-                block_rms,
-                vad_frac,
-                vad_rms,
-                n_segments);
-            for (int i = 0; i < n_segments; ++i) {
-                // whisper segment times are in 10ms units
-                const long long t0_ms = (long long) (dbg_seg_t0[i] * 10);
-                const long long t1_ms = (long long) (dbg_seg_t1[i] * 10);
+            if (params.trace_voice_gate) {
+                if (ev == utterance_timeline::event::flush) {
+                    print_endpoint_trace(stderr, "silence", gd);
+                }
+                print_voice_gate_trace(stderr, block_tag, ms_since(t_trace0, t_now), gd.voice_ms, (int32_t) vtl.samples_to_ms(block_view.size()));
                 std::fprintf(stderr,
-                    "  [DBG thankyou] seg=%d ns=%.2f tok=%d t=%lld-%lld(ms)\n",
-                    i,
-                    dbg_seg_ns[i],
-                    dbg_seg_tok[i],
-                    t0_ms,
-                    t1_ms);
+                    "[VG] FLUSH_AUDIO silent=%lldms start=%llu end=%llu pcm_n=%zu rms=%.4f speculative=%s\n",
+                    (long long) gd.silent_ms,
+                    (unsigned long long) block_view.seq,
+                    (unsigned long long) (block_view.seq + block_view.size()),
+                    block_view.size(),
+                    job.stats.rms(),
+                    job.reuse != 0 ? "reused" : "no");
+                std::fflush(stderr);
             }
-        }
 
-        // Tiny models can hallucinate short polite phrases after an utterance or during near-silence.
-        // Only suppress this in fast mode AND only when whisper itself says it's likely no-speech.
-        if (suppress_thanks) {
-            t_last = t_now;
-            continue;
-        }
+            // The gate already reset for the next utterance; the ring follows.
+            if (ev == utterance_timeline::event::flush) {
+                audio.clear();
+            }
 
-        if (suppress_silence_garbage) {
-            t_last = t_now;
-            continue;
+            if (gd.too_short || gate.too_short(block_view.size())) {
+                if (params.trace_voice_gate) {
+                    std::fprintf(stderr, "[VG] DROP_TOO_SHORT pcm_n=%zu (need >= %.0f)\n",
+                        block_view.size(),
+                        (double) vtl.ms_to_samples(vgp.min_block_ms));
+                    std::fflush(stderr);
+                }
+                t_last = t_now;
+                continue;
+            }
+            have_pcm_block = true;
+            job.utterance = utterance_id;
         }
 
-        // De-dupe: skip very similar repeats (common with sliding windows).
-        if (!last_sent.empty()) {
-            // Strong de-dupe for the common suffix-repeat artifact:
-            //   "hello this is a test" -> "this is a test" -> "is a test" -> ...
-            if (is_suffix_repeat_by_words(last_sent, text)) {
+        if (!have_pcm_block) {
+            // One block at a time, as when Whisper ran on this thread: the window slides on while it decodes.
+            if (worker.busy()) {
                 t_last = t_now;
                 continue;
             }
-            const float sim = ::similarity(last_sent, text);
-            if (sim >= params.dedup_similarity) {
+
+            // In whisper.cpp, vad_simple() returns true when the last part of the window is relatively silent.
+            // audio_vad_simple() takes the same decision from the window stats instead of another pass.
+            if (!audio_vad_simple(vad_win_stats, params.vad_thold, params.freq_thold, WHISPER_SAMPLE_RATE)) {
                 t_last = t_now;
                 continue;
             }
-        }
 
-        const size_t k_wrap_cols = 30;
-        const std::string text_wrapped = (text.size() > k_wrap_cols) ? wrap_text_wordwise_cols(text, k_wrap_cols) : text;
+            block_view = audio.view(params.length_ms);
+            if (block_view.size() < (size_t) (WHISPER_SAMPLE_RATE * 0.5)) {
+                t_last = t_now;
+                continue;
+            }
+            job.stats = audio_stats_compute(block_view);
 
-        std::printf("[%d] %s\n", iter++, text_wrapped.c_str());
-        std::fflush(stdout);
+            // Fast-mode guard: keyboard clicks / near-silence can trigger VAD and cause hallucinations like "thank you".
+            // If the block has very low activity, drop it and clear the buffer so we don't retrigger on the same click.
+            if (params.fast) {
+                if (job.stats.activity_fraction() < 0.01f) {
+                    audio.clear();
+                    t_last = t_now;
+                    continue;
+                }
 
-        // Enqueue for Streamer.bot sending (length-based throttling handled by worker thread).
-        bot_sender.enqueue(streamerbot_send_item{ text_wrapped, text.size() });
+                // Crucial: prevent overlap-repeat spam by discarding the already-snapshotted audio.
+                // This keeps any new speech during whisper inference for the next iteration
+                // (clear() only hides the samples from the next snapshot; block_view still reads them).
+                audio.clear();
+            }
+        }
 
-        last_sent = text;
+        job.view = block_view;
+        job.window_stats = vad_win_stats.all;
+        tick_active = true;
+        const uint64_t id = worker.submit(job);
+        if (id == 0) {
+            std::fprintf(stderr, "warning: inference is falling behind (%s block dropped)\n", job.chunk ? "chunk" : "utterance");
+        } else if (job.probe) {
+            probe_job = id;
+        } else if (job.speculative) {
+            spec_job = id;
+            spec_begin = block_view.seq;
+            spec_end = block_view.seq + block_view.size();
+            spec_speech_end = vtl.speech_end();
+        }
 
         t_last = t_now;
     }
 
+    // Finish what was already cut (the tail of a file input, say) before stopping the sender.
+    worker.stop_and_join(/*drain*/true);
     bot_sender.stop_and_join(/*drain*/true);
+    discard_held(tst);
+
+    cpu_meter.mark(tick_active);
+    std::fprintf(stderr, "\n");
+    print_cpu_phases(stderr, "CPU:", cpu_meter, egate_on ? &egate : nullptr);
+    print_endpoint_stats(stderr, "CPU:", vtl.endpoints());
+    print_inference_stats(stderr, "CPU:", worker.stats(), vtl.chunks());
+    if (params.speculative) {
+        print_speculation_stats(stderr, "CPU:", tst.spec);
+    }
+    print_deadline_stats(stderr, "CPU:", tst.deadline);
+    print_decoder_stats(stderr, "CPU:", tst.decoder);
+    print_compute_timing(stderr, "CPU:", tst.decoder);
+    print_policy_stats(stderr, "CPU:", params, tst.policy);
+    if (mel_stream) {
+        print_mel_stats(stderr, "CPU:", tst.mel_st, *mel_stream);
+    }
+    if (params.batch_max > 1) {
+        print_batch_stats(stderr, "CPU:", tst.batch);
+    }
+    if (router) {
+        print_model_router_stats(stderr, "CPU:", *router);
+    }
+    print_copy_stats(stderr, "CPU:", audio_copy_totals(), audio_copy_stats{},
+        1e-3 * (double) ms_since(t_trace0, std::chrono::high_resolution_clock::now()));
 
     audio.pause();
+    {
+        const capture_stats cst = audio.stats();
+        if (cst.samples_in > 0) {
+            std::fprintf(stderr, "\nCapture: %s in=%.1fs overruns=%llu lost=%.1fs\n",
+                audio.describe().c_str(),
+                (double) cst.samples_in / (double) WHISPER_SAMPLE_RATE,
+                (unsigned long long) cst.overruns,
+                (double) cst.samples_lost / (double) WHISPER_SAMPLE_RATE);
+        }
+    }
     if (vctx) whisper_vad_free(vctx);
     whisper_print_timings(ctx);
+    if (fallback_ctx) whisper_free(fallback_ctx);
+    if (lid_ctx) whisper_free(lid_ctx);
+    router.reset();
     whisper_free(ctx);
     return 0;
 }
@@ -0,0 +1,192 @@
+#include "model_file.h"
+
+#include "cpu_time.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#if defined(_WIN32)
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+bool parse_model_load_mode(const std::string & s, model_load_mode & out) {
+    if (s == "read") {
+        out = model_load_mode::read;
+    } else if (s == "mmap") {
+        out = model_load_mode::mmap;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char * model_load_mode_name(model_load_mode m) {
+    return m == model_load_mode::mmap ? "mmap" : "read";
+}
+
+bool mapped_file::open(const std::string & path, const model_load_options & opt, std::string & err) {
+    close();
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        err = "cannot open " + path;
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        err = "cannot size " + path;
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void * view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        err = "cannot map " + path;
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_data = (const uint8_t *) view;
+    m_size = (size_t) size.QuadPart;
+    if (opt.prefault) {
+        // Windows 8+: looked up at run time so older SDK targets still build.
+        using prefetch_fn = BOOL(WINAPI *)(HANDLE, ULONG_PTR, PVOID, ULONG);
+        struct range {
+            PVOID address;
+            SIZE_T bytes;
+        };
+        const auto prefetch = (prefetch_fn) (void *) GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+        if (prefetch) {
+            range r{ (PVOID) m_data, (SIZE_T) m_size };
+            prefetch(GetCurrentProcess(), 1, &r, 0);
+        }
+    }
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        err = "cannot open " + path;
+        return false;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        err = "cannot size " + path;
+        return false;
+    }
+    void * p = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file referenced.
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        err = "cannot map " + path;
+        return false;
+    }
+    m_data = (const uint8_t *) p;
+    m_size = (size_t) st.st_size;
+    // Read front to back once: aggressive readahead, and the pages can go right after.
+    posix_madvise(p, m_size, POSIX_MADV_SEQUENTIAL);
+    if (opt.prefault) {
+        posix_madvise(p, m_size, POSIX_MADV_WILLNEED);
+    }
+#    if defined(MADV_HUGEPAGE)
+    if (opt.huge_pages) {
+        madvise(p, m_size, MADV_HUGEPAGE);
+    }
+#    endif
+#endif
+    return true;
+}
+
+void mapped_file::close() {
+    if (!m_data) {
+        return;
+    }
+#if defined(_WIN32)
+    UnmapViewOfFile(m_data);
+    CloseHandle((HANDLE) m_mapping);
+    CloseHandle((HANDLE) m_file);
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    munmap((void *) m_data, m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+namespace {
+
+struct mapped_reader {
+    const mapped_file * file = nullptr;
+    size_t pos = 0;
+};
+
+size_t mapped_read(void * ctx, void * output, size_t read_size) {
+    mapped_reader * r = (mapped_reader *) ctx;
+    const size_t n = std::min(read_size, r->file->size() - r->pos);
+    std::memcpy(output, r->file->data() + r->pos, n);
+    r->pos += n;
+    return n;
+}
+
+bool mapped_eof(void * ctx) {
+    const mapped_reader * r = (const mapped_reader *) ctx;
+    return r->pos >= r->file->size();
+}
+
+void mapped_close(void * /*ctx*/) {
+}
+
+} // namespace
+
+whisper_context * model_file_init(const std::string & path, const whisper_context_params & cparams,
+                                  const model_load_options & opt, model_load_report * report) {
+    model_load_report rep;
+    rep.rss_before = process_rss_bytes();
+    const auto t0 = std::chrono::steady_clock::now();
+
+    whisper_context * ctx = nullptr;
+    if (opt.mode == model_load_mode::mmap) {
+        mapped_file file;
+        std::string err;
+        if (file.open(path, opt, err)) {
+            rep.file_bytes = file.size();
+            mapped_reader reader;
+            reader.file = &file;
+            whisper_model_loader loader;
+            loader.context = &reader;
+            loader.read = mapped_read;
+            loader.eof = mapped_eof;
+            loader.close = mapped_close;
+            ctx = whisper_init_with_params(&loader, cparams);
+        } else {
+            std::fprintf(stderr, "warning: %s; loading with plain reads\n", err.c_str());
+            ctx = whisper_init_from_file_with_params(path.c_str(), cparams);
+        }
+    } else {
+        ctx = whisper_init_from_file_with_params(path.c_str(), cparams);
+    }
+
+    rep.load_ms = 1e-3 * (double) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+    rep.rss_after = process_rss_bytes();
+    if (rep.file_bytes == 0) {
+        std::error_code ec;
+        const uintmax_t n = std::filesystem::file_size(path, ec);
+        rep.file_bytes = ec ? 0 : (size_t) n;
+    }
+    if (report) {
+        *report = rep;
+    }
+    return ctx;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "whisper.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// How a Whisper model file is read at startup (--model-load).
+enum class model_load_mode {
+    read, // whisper.cpp's own buffered file reads
+    mmap, // the file mapped read-only; whisper copies the tensors straight out of the page cache
+};
+
+struct model_load_options {
+    model_load_mode mode = model_load_mode::read;
+    bool prefault = false;   // mmap: start reading the whole file ahead (MADV_WILLNEED / PrefetchVirtualMemory)
+    bool huge_pages = false; // mmap: ask for transparent huge pages on the mapping (Linux, best effort)
+};
+
+struct model_load_report {
+    double load_ms = 0.0;
+    size_t file_bytes = 0;
+    size_t rss_before = 0; // process resident memory before / after the load (the mapping is gone by then)
+    size_t rss_after = 0;
+};
+
+bool parse_model_load_mode(const std::string & s, model_load_mode & out);
+const char * model_load_mode_name(model_load_mode m);
+
+// Read-only mapping of a whole file.
+class mapped_file {
+public:
+    mapped_file() = default;
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file & operator=(const mapped_file &) = delete;
+
+    bool open(const std::string & path, const model_load_options & opt, std::string & err);
+    void close();
+
+    const uint8_t * data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const uint8_t * m_data = nullptr;
+    size_t m_size = 0;
+#if defined(_WIN32)
+    void * m_file = nullptr;
+    void * m_mapping = nullptr;
+#endif
+};
+
+// whisper_init_from_file_with_params(), or the same through a loader over a mapping of the file. Null on failure
+// (the mapping falls back to plain reads when the file cannot be mapped).
+whisper_context * model_file_init(const std::string & path, const whisper_context_params & cparams,
+                                  const model_load_options & opt, model_load_report * report = nullptr);
@@ -0,0 +1,345 @@
+#include "model_quantize.h"
+
+#include "model_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+bool parse_model_quant_type(const std::string & s, ggml_type & out) {
+    if (s == "q8_0") {
+        out = GGML_TYPE_Q8_0;
+    } else if (s == "q5_1") {
+        out = GGML_TYPE_Q5_1;
+    } else if (s == "q5_0") {
+        out = GGML_TYPE_Q5_0;
+    } else if (s == "q4_1") {
+        out = GGML_TYPE_Q4_1;
+    } else if (s == "q4_0") {
+        out = GGML_TYPE_Q4_0;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static int32_t ftype_of(ggml_type type) {
+    switch (type) {
+        case GGML_TYPE_Q8_0: return GGML_FTYPE_MOSTLY_Q8_0;
+        case GGML_TYPE_Q5_1: return GGML_FTYPE_MOSTLY_Q5_1;
+        case GGML_TYPE_Q5_0: return GGML_FTYPE_MOSTLY_Q5_0;
+        case GGML_TYPE_Q4_1: return GGML_FTYPE_MOSTLY_Q4_1;
+        case GGML_TYPE_Q4_0: return GGML_FTYPE_MOSTLY_Q4_0;
+        default: return GGML_FTYPE_UNKNOWN;
+    }
+}
+
+static double ms_since(std::chrono::steady_clock::time_point t0) {
+    return 1e-3 * (double) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static inline uint64_t load_u64(const uint8_t * p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t hash_round(uint64_t h, uint64_t w) {
+    h ^= w * 0x9e3779b97f4a7c15ull;
+    h = (h << 31) | (h >> 33);
+    return h * 0xff51afd7ed558ccdull;
+}
+
+static uint64_t hash_bytes(const uint8_t * p, size_t n) {
+    // Four independent lanes over 32-byte blocks keep the multiplies pipelined.
+    uint64_t lane[4] = { 0x243f6a8885a308d3ull, 0x13198a2e03707344ull, 0xa4093822299f31d0ull, 0x082efa98ec4e6c89ull };
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        lane[0] = hash_round(lane[0], load_u64(p + i));
+        lane[1] = hash_round(lane[1], load_u64(p + i + 8));
+        lane[2] = hash_round(lane[2], load_u64(p + i + 16));
+        lane[3] = hash_round(lane[3], load_u64(p + i + 24));
+    }
+    uint64_t h = (uint64_t) n;
+    for (uint64_t l : lane) {
+        h = hash_round(h, l);
+    }
+    for (; i < n; ++i) {
+        h = hash_round(h, p[i]);
+    }
+    // murmur3's finalizer.
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+namespace {
+
+// Bounds-checked reads over the source mapping.
+struct model_cursor {
+    const uint8_t * data = nullptr;
+    size_t size = 0;
+    size_t pos = 0;
+
+    bool take(void * out, size_t n) {
+        if (n > size - pos) {
+            return false;
+        }
+        std::memcpy(out, data + pos, n);
+        pos += n;
+        return true;
+    }
+
+    bool skip(size_t n) {
+        if (n > size - pos) {
+            return false;
+        }
+        pos += n;
+        return true;
+    }
+};
+
+// Whisper's hyperparameters, in file order (whisper_model_load()).
+struct model_hparams {
+    int32_t n_vocab;
+    int32_t n_audio_ctx;
+    int32_t n_audio_state;
+    int32_t n_audio_head;
+    int32_t n_audio_layer;
+    int32_t n_text_ctx;
+    int32_t n_text_state;
+    int32_t n_text_head;
+    int32_t n_text_layer;
+    int32_t n_mels;
+    int32_t ftype;
+};
+
+// As whisper.cpp's quantize tool: every 2-D weight but the positional embeddings.
+bool quantizable(const std::string & name, int32_t n_dims) {
+    return n_dims == 2 && name != "encoder.positional_embedding" && name != "decoder.positional_embedding";
+}
+
+void quantize_rows(ggml_type src_type, const uint8_t * src, ggml_type type, uint8_t * dst, int64_t n_rows, int64_t n_per_row,
+                   int n_threads) {
+    const size_t src_row = ggml_row_size(src_type, n_per_row);
+    const size_t dst_row = ggml_row_size(type, n_per_row);
+    const int64_t batch = 64;
+    std::atomic<int64_t> next{ 0 };
+    auto work = [&]() {
+        // The tensor data sits at any byte offset in the file: copy it out before converting.
+        std::vector<ggml_fp16_t> f16;
+        std::vector<float> f32((size_t) (batch * n_per_row));
+        for (int64_t r0 = next.fetch_add(batch); r0 < n_rows; r0 = next.fetch_add(batch)) {
+            const int64_t n = std::min(batch, n_rows - r0);
+            const size_t count = (size_t) (n * n_per_row);
+            if (src_type == GGML_TYPE_F16) {
+                f16.resize(count);
+                std::memcpy(f16.data(), src + (size_t) r0 * src_row, count * sizeof(ggml_fp16_t));
+                ggml_fp16_to_fp32_row(f16.data(), f32.data(), (int64_t) count);
+            } else {
+                std::memcpy(f32.data(), src + (size_t) r0 * src_row, count * sizeof(float));
+            }
+            ggml_quantize_chunk(type, f32.data(), dst + (size_t) r0 * dst_row, 0, n, n_per_row, nullptr);
+        }
+    };
+    const int64_t n_batches = (n_rows + batch - 1) / batch;
+    const int n = (int) std::min<int64_t>(n_batches, std::max(1, n_threads));
+    std::vector<std::thread> pool;
+    for (int t = 1; t < n; ++t) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (std::thread & t : pool) {
+        t.join();
+    }
+}
+
+} // namespace
+
+// Rewrites the model at `in` to `out`: the header with the new ftype, the mel filters and vocabulary as they are,
+// then each tensor record, its data quantized when it is a 2-D weight.
+static bool convert_model(const mapped_file & in, FILE * out, ggml_type type, int n_threads, model_quantize_report & rep,
+                          std::string & err) {
+    model_cursor c{ in.data(), in.size(), 0 };
+    uint32_t magic = 0;
+    model_hparams hp{};
+    if (!c.take(&magic, sizeof(magic)) || magic != 0x67676d6c || !c.take(&hp, sizeof(hp))) {
+        err = "not a ggml Whisper model";
+        return false;
+    }
+    const size_t hparams_end = c.pos;
+
+    int32_t n_mel = 0;
+    int32_t n_fft = 0;
+    int32_t n_vocab = 0;
+    if (!c.take(&n_mel, sizeof(n_mel)) || !c.take(&n_fft, sizeof(n_fft)) || n_mel < 0 || n_fft < 0 ||
+        !c.skip((size_t) n_mel * (size_t) n_fft * sizeof(float)) || !c.take(&n_vocab, sizeof(n_vocab)) || n_vocab < 0) {
+        err = "truncated mel filters";
+        return false;
+    }
+    for (int32_t i = 0; i < n_vocab; ++i) {
+        uint32_t len = 0;
+        if (!c.take(&len, sizeof(len)) || !c.skip(len)) {
+            err = "truncated vocabulary";
+            return false;
+        }
+    }
+
+    model_hparams out_hp = hp;
+    out_hp.ftype = GGML_QNT_VERSION * GGML_QNT_VERSION_FACTOR + ftype_of(type);
+    std::fwrite(&magic, sizeof(magic), 1, out);
+    std::fwrite(&out_hp, sizeof(out_hp), 1, out);
+    std::fwrite(in.data() + hparams_end, 1, c.pos - hparams_end, out);
+
+    std::vector<uint8_t> qbuf;
+    while (c.pos < c.size) {
+        int32_t n_dims = 0;
+        int32_t name_len = 0;
+        int32_t ttype = 0;
+        int32_t ne[4] = { 1, 1, 1, 1 };
+        if (!c.take(&n_dims, sizeof(n_dims)) || !c.take(&name_len, sizeof(name_len)) || !c.take(&ttype, sizeof(ttype)) ||
+            n_dims < 1 || n_dims > 4 || name_len < 0 || !c.take(ne, sizeof(int32_t) * (size_t) n_dims)) {
+            err = "truncated tensor header at byte " + std::to_string(c.pos);
+            return false;
+        }
+        const char * name_data = (const char *) c.data + c.pos;
+        if (!c.skip((size_t) name_len)) {
+            err = "truncated tensor name at byte " + std::to_string(c.pos);
+            return false;
+        }
+        const std::string name(name_data, (size_t) name_len);
+        if (ttype < 0 || ttype >= GGML_TYPE_COUNT || ggml_blck_size((ggml_type) ttype) == 0 || ne[0] % ggml_blck_size((ggml_type) ttype) != 0) {
+            err = "tensor " + name + ": unsupported type " + std::to_string(ttype);
+            return false;
+        }
+        const int64_t n_rows = (int64_t) ne[1] * ne[2] * ne[3];
+        const size_t bytes = ggml_row_size((ggml_type) ttype, ne[0]) * (size_t) n_rows;
+        const uint8_t * data = c.data + c.pos;
+        if (!c.skip(bytes)) {
+            err = "tensor " + name + ": truncated data";
+            return false;
+        }
+
+        const bool quantize = quantizable(name, n_dims) && (ttype == GGML_TYPE_F32 || ttype == GGML_TYPE_F16);
+        if (quantize && ne[0] % ggml_blck_size(type) != 0) {
+            err = "tensor " + name + ": rows of " + std::to_string(ne[0]) + " do not split into " + ggml_type_name(type) + " blocks";
+            return false;
+        }
+        const int32_t out_type = quantize ? (int32_t) type : ttype;
+        std::fwrite(&n_dims, sizeof(n_dims), 1, out);
+        std::fwrite(&name_len, sizeof(name_len), 1, out);
+        std::fwrite(&out_type, sizeof(out_type), 1, out);
+        std::fwrite(ne, sizeof(int32_t), (size_t) n_dims, out);
+        std::fwrite(name.data(), 1, name.size(), out);
+        if (quantize) {
+            qbuf.resize(ggml_row_size(type, ne[0]) * (size_t) n_rows);
+            quantize_rows((ggml_type) ttype, data, type, qbuf.data(), n_rows, ne[0], n_threads);
+            std::fwrite(qbuf.data(), 1, qbuf.size(), out);
+            rep.n_quantized++;
+        } else {
+            std::fwrite(data, 1, bytes, out);
+            rep.n_kept++;
+        }
+    }
+    return true;
+}
+
+static bool is_hex16(const std::string & s) {
+    return s.size() == 16 && std::all_of(s.begin(), s.end(), [](char ch) { return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'f'); });
+}
+
+bool model_quantize_cached(const std::string & source, ggml_type type, int n_threads, model_quantize_report & rep,
+                           std::string & err) {
+    namespace fs = std::filesystem;
+    rep = model_quantize_report{};
+    rep.path = source;
+
+    mapped_file in;
+    if (!in.open(source, model_load_options{}, err)) {
+        return false;
+    }
+    rep.source_bytes = in.size();
+    int32_t ftype = 0;
+    if (in.size() >= 4 + sizeof(model_hparams)) {
+        std::memcpy(&ftype, in.data() + 4 + offsetof(model_hparams, ftype), sizeof(ftype));
+    }
+    if (ftype % GGML_QNT_VERSION_FACTOR != GGML_FTYPE_ALL_F32 && ftype % GGML_QNT_VERSION_FACTOR != GGML_FTYPE_MOSTLY_F16) {
+        // Re-quantizing quantized weights only loses accuracy.
+        rep.bytes = rep.source_bytes;
+        return true;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    rep.source_hash = hash_bytes(in.data(), in.size());
+    rep.hash_ms = ms_since(t0);
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) rep.source_hash);
+    const fs::path src(source);
+    const std::string prefix = src.stem().string() + "-" + ggml_type_name(type) + "-";
+    const fs::path target = src.parent_path() / (prefix + hex + ".bin");
+    rep.path = target.string();
+
+    std::error_code ec;
+    const uintmax_t cached_bytes = fs::file_size(target, ec);
+    if (!ec && cached_bytes > 0) {
+        rep.cached = true;
+        rep.bytes = (size_t) cached_bytes;
+        return true;
+    }
+
+    // Written under a temporary name and renamed, so an interrupted run never leaves a partial model to reuse.
+    const fs::path tmp = target.string() + ".tmp";
+    FILE * out = std::fopen(tmp.string().c_str(), "wb");
+    if (!out) {
+        err = "cannot write " + tmp.string();
+        return false;
+    }
+    t0 = std::chrono::steady_clock::now();
+    bool ok = convert_model(in, out, type, n_threads, rep, err);
+    if (std::ferror(out)) {
+        ok = false;
+        err = "write error on " + tmp.string();
+    }
+    if (std::fclose(out) != 0 && ok) {
+        ok = false;
+        err = "write error on " + tmp.string();
+    }
+    if (ok) {
+        fs::rename(tmp, target, ec);
+        if (ec) {
+            ok = false;
+            err = "cannot rename " + tmp.string() + ": " + ec.message();
+        }
+    }
+    if (!ok) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    rep.convert_ms = ms_since(t0);
+    rep.converted = true;
+    rep.bytes = (size_t) fs::file_size(target, ec);
+
+    // Conversions of an earlier version of this model (same name and type, another hash).
+    const fs::path dir = src.parent_path().empty() ? fs::path(".") : src.parent_path();
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        if (name.size() == prefix.size() + 16 + 4 && name.compare(0, prefix.size(), prefix) == 0 &&
+            name.compare(name.size() - 4, 4, ".bin") == 0 && is_hex16(name.substr(prefix.size(), 16)) &&
+            it->path().filename() != target.filename()) {
+            std::error_code rm_ec;
+            fs::remove(it->path(), rm_ec);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ggml.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// --quantize: the weight types whisper.cpp's quantize tool writes for Whisper models. The k-quants are left out:
+// their 256-value blocks do not divide the 384-wide rows of tiny.
+bool parse_model_quant_type(const std::string & s, ggml_type & out);
+
+struct model_quantize_report {
+    std::string path;       // the quantized model to load (or the source, when it already was quantized)
+    bool cached = false;    // found from an earlier run, nothing converted
+    bool converted = false; // written by this call
+    uint64_t source_hash = 0;
+    double hash_ms = 0.0;
+    double convert_ms = 0.0;
+    size_t source_bytes = 0;
+    size_t bytes = 0;
+    int n_quantized = 0; // 2-D weight tensors converted
+    int n_kept = 0;      // tensors copied as they are (biases, norms, convolutions, positional embeddings)
+};
+
+// The quantized sibling of `source`: <dir>/<stem>-<type>-<content hash>.bin. Converted on first use (the way
+// whisper.cpp's quantize tool does it, on `n_threads`) and reused while the source's content is unchanged; older
+// conversions of the same model and type are removed. False (with a message in `err`) when the source cannot be
+// read or converted. A source that already is quantized is returned as is.
+bool model_quantize_cached(const std::string & source, ggml_type type, int n_threads, model_quantize_report & rep,
+                           std::string & err);
@@ -0,0 +1,129 @@
+#include "model_router.h"
+
+#include <utility>
+
+bool parse_model_map(const std::string & s, std::vector<model_route> & out, std::string & err) {
+    out.clear();
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        const size_t comma = s.find(',', pos);
+        const std::string item = s.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        pos = comma == std::string::npos ? s.size() + 1 : comma + 1;
+        if (item.empty()) {
+            continue;
+        }
+        const size_t eq = item.find('=');
+        if (eq == std::string::npos || eq == 0 || eq + 1 == item.size()) {
+            err = "expected LANG=PATH, got '" + item + "'";
+            return false;
+        }
+        model_route r;
+        r.language = item.substr(0, eq);
+        r.path = item.substr(eq + 1);
+        for (const model_route & o : out) {
+            if (o.language == r.language) {
+                err = "language '" + r.language + "' is listed twice";
+                return false;
+            }
+        }
+        out.push_back(std::move(r));
+    }
+    if (out.empty()) {
+        err = "no LANG=PATH entries";
+        return false;
+    }
+    return true;
+}
+
+model_router::model_router(std::vector<model_route> routes, const whisper_context_params & cparams,
+                           const model_load_options & opt, int64_t idle_ms)
+    : m_cparams(cparams)
+    , m_opt(opt)
+    , m_idle_ms(idle_ms) {
+    for (model_route & r : routes) {
+        entry e;
+        e.route = std::move(r);
+        m_entries.push_back(std::move(e));
+    }
+}
+
+model_router::~model_router() {
+    for (entry & e : m_entries) {
+        if (e.ctx) {
+            whisper_free(e.ctx);
+        }
+    }
+}
+
+whisper_context * model_router::get(const std::string & language) {
+    for (entry & e : m_entries) {
+        if (e.route.language != language) {
+            continue;
+        }
+        if (!e.ctx && !e.failed) {
+            model_load_report rep;
+            e.ctx = model_file_init(e.route.path, m_cparams, m_opt, &rep);
+            if (!e.ctx) {
+                std::fprintf(stderr, "warning: failed to load the --model-map model for %s (%s); decoding it on --model\n",
+                    e.route.language.c_str(), e.route.path.c_str());
+                e.failed = true;
+                return nullptr;
+            }
+            // An English-only model has no language tokens to decode anything else with.
+            if (e.route.language != "en" && !whisper_is_multilingual(e.ctx)) {
+                std::fprintf(stderr, "warning: --model-map %s=%s is English-only; decoding %s on --model\n",
+                    e.route.language.c_str(), e.route.path.c_str(), e.route.language.c_str());
+                whisper_free(e.ctx);
+                e.ctx = nullptr;
+                e.failed = true;
+                return nullptr;
+            }
+            e.stats.loads++;
+            e.stats.load_ms += rep.load_ms;
+            std::fprintf(stderr, "Model route: %s -> %s loaded in %.0fms\n", e.route.language.c_str(), e.route.path.c_str(), rep.load_ms);
+        }
+        if (e.ctx) {
+            e.last_use = std::chrono::steady_clock::now();
+            e.stats.decodes++;
+        }
+        return e.ctx;
+    }
+    return nullptr;
+}
+
+int model_router::unload_idle() {
+    if (m_idle_ms <= 0) {
+        return 0;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    int n = 0;
+    for (entry & e : m_entries) {
+        if (!e.ctx || now - e.last_use < std::chrono::milliseconds(m_idle_ms)) {
+            continue;
+        }
+        whisper_free(e.ctx);
+        e.ctx = nullptr;
+        e.stats.unloads++;
+        ++n;
+        std::fprintf(stderr, "Model route: %s -> %s unloaded after %llds idle\n", e.route.language.c_str(), e.route.path.c_str(),
+            (long long) (m_idle_ms / 1000));
+    }
+    return n;
+}
+
+void print_model_router_stats(FILE * f, const char * tag, const model_router & router) {
+    if (!f) return;
+    for (size_t i = 0; i < router.size(); ++i) {
+        const model_route_stats & s = router.stats(i);
+        std::fprintf(f, "%s model route %s -> %s: decodes=%llu loads=%llu (%.0fms) idle unloads=%llu%s\n",
+            tag,
+            router.route(i).language.c_str(),
+            router.route(i).path.c_str(),
+            (unsigned long long) s.decodes,
+            (unsigned long long) s.loads,
+            s.load_ms,
+            (unsigned long long) s.unloads,
+            router.loaded(i) ? " (loaded)" : "");
+    }
+    std::fflush(f);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "model_file.h"
+#include "whisper.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// One --model-map entry: utterances detected as `language` decode on the model at `path`.
+struct model_route {
+    std::string language;
+    std::string path;
+};
+
+// "en=models/ggml-base.en.bin,de=models/ggml-small.bin". False (with a message in `err`) on a malformed list or a
+// language listed twice.
+bool parse_model_map(const std::string & s, std::vector<model_route> & out, std::string & err);
+
+struct model_route_stats {
+    uint64_t decodes = 0; // passes routed to the model (re-decodes included)
+    uint64_t loads = 0;   // including reloads after an idle unload
+    uint64_t unloads = 0; // idle unloads
+    double load_ms = 0.0; // total
+};
+
+// The per-language models of --model-map. Each one loads on its first utterance and is freed again after
+// `idle_ms` without one (0 = kept once loaded). Not thread-safe: only the inference worker's thread uses it (and
+// the contexts it hands out).
+class model_router {
+public:
+    model_router(std::vector<model_route> routes, const whisper_context_params & cparams, const model_load_options & opt,
+                 int64_t idle_ms);
+    ~model_router();
+
+    model_router(const model_router &) = delete;
+    model_router & operator=(const model_router &) = delete;
+
+    // The model for `language`, loaded now if it is not. Null when the language has no route or its model failed
+    // to load (tried once; the caller decodes on its default model).
+    whisper_context * get(const std::string & language);
+
+    // Frees the models unused for longer than the idle timeout. Returns how many it freed.
+    int unload_idle();
+
+    size_t size() const { return m_entries.size(); }
+    const model_route & route(size_t i) const { return m_entries[i].route; }
+    const model_route_stats & stats(size_t i) const { return m_entries[i].stats; }
+    bool loaded(size_t i) const { return m_entries[i].ctx != nullptr; }
+
+private:
+    struct entry {
+        model_route route;
+        whisper_context * ctx = nullptr;
+        bool failed = false;
+        std::chrono::steady_clock::time_point last_use;
+        model_route_stats stats;
+    };
+
+    whisper_context_params m_cparams;
+    model_load_options m_opt;
+    int64_t m_idle_ms = 0;
+    std::vector<entry> m_entries;
+};
+
+void print_model_router_stats(FILE * f, const char * tag, const model_router & router);
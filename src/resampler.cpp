@@ -0,0 +1,246 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+static constexpr double k_pi = 3.14159265358979323846;
+
+//
+// dot products (n is always a multiple of 8)
+//
+
+static float dot_scalar(const float * a, const float * b, int n) {
+    float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < n; i += 4) {
+        acc[0] += a[i + 0] * b[i + 0];
+        acc[1] += a[i + 1] * b[i + 1];
+        acc[2] += a[i + 2] * b[i + 2];
+        acc[3] += a[i + 3] * b[i + 3];
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+#if defined(AI_SUBTITLER_SIMD_X86)
+static float dot_sse(const float * a, const float * b, int n) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 0x55));
+    return _mm_cvtss_f32(acc);
+}
+
+AI_SUBTITLER_TARGET_AVX
+static float dot_avx(const float * a, const float * b, int n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    if (i < n) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 0x55));
+    return _mm_cvtss_f32(s);
+}
+#endif
+
+#if defined(AI_SUBTITLER_SIMD_NEON)
+static float dot_neon(const float * a, const float * b, int n) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (int i = 0; i < n; i += 8) {
+#    if defined(__aarch64__) || defined(_M_ARM64)
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+#    else
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+#    endif
+    }
+    const float32x4_t acc = vaddq_f32(acc0, acc1);
+    const float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+#endif
+
+static float dot(simd_isa isa, const float * a, const float * b, int n) {
+    switch (isa) {
+#if defined(AI_SUBTITLER_SIMD_X86)
+        case simd_isa::avx: return dot_avx(a, b, n);
+        case simd_isa::sse: return dot_sse(a, b, n);
+#endif
+#if defined(AI_SUBTITLER_SIMD_NEON)
+        case simd_isa::neon: return dot_neon(a, b, n);
+#endif
+        default: return dot_scalar(a, b, n);
+    }
+}
+
+//
+// downmix
+//
+
+void downmix_to_mono(const float * in, size_t n_frames, int channels, float * out, simd_isa isa) {
+    if (channels <= 1) {
+        std::copy(in, in + n_frames, out);
+        return;
+    }
+
+    size_t i = 0;
+    if (channels == 2) {
+#if defined(AI_SUBTITLER_SIMD_X86)
+        if (isa != simd_isa::scalar) {
+            const __m128 half = _mm_set1_ps(0.5f);
+            for (; i + 4 <= n_frames; i += 4) {
+                const __m128 a = _mm_loadu_ps(in + 2 * i);     // L0 R0 L1 R1
+                const __m128 b = _mm_loadu_ps(in + 2 * i + 4); // L2 R2 L3 R3
+                const __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+                const __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+                _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(l, r), half));
+            }
+        }
+#elif defined(AI_SUBTITLER_SIMD_NEON)
+        if (isa != simd_isa::scalar) {
+            for (; i + 4 <= n_frames; i += 4) {
+                const float32x4x2_t lr = vld2q_f32(in + 2 * i);
+                vst1q_f32(out + i, vmulq_n_f32(vaddq_f32(lr.val[0], lr.val[1]), 0.5f));
+            }
+        }
+#else
+        (void) isa;
+#endif
+        for (; i < n_frames; ++i) {
+            out[i] = 0.5f * (in[2 * i] + in[2 * i + 1]);
+        }
+        return;
+    }
+
+    const float scale = 1.0f / (float) channels;
+    for (; i < n_frames; ++i) {
+        const float * frame = in + i * (size_t) channels;
+        float sum = 0.0f;
+        for (int c = 0; c < channels; ++c) {
+            sum += frame[c];
+        }
+        out[i] = sum * scale;
+    }
+}
+
+//
+// filter design
+//
+
+double resampler_bessel_i0(double x) {
+    // Power series; converges quickly for the beta values used by audio filters.
+    double sum = 1.0;
+    double term = 1.0;
+    const double q = 0.25 * x * x;
+    for (int k = 1; k < 64; ++k) {
+        term *= q / ((double) k * (double) k);
+        sum += term;
+        if (term < sum * 1e-17) {
+            break;
+        }
+    }
+    return sum;
+}
+
+double resampler_kaiser(double t, double half_width, double beta) {
+    const double r = t / half_width;
+    if (r <= -1.0 || r >= 1.0) {
+        return 0.0;
+    }
+    return resampler_bessel_i0(beta * std::sqrt(1.0 - r * r)) / resampler_bessel_i0(beta);
+}
+
+static double sinc(double x) {
+    if (std::fabs(x) < 1e-12) {
+        return 1.0;
+    }
+    return std::sin(k_pi * x) / (k_pi * x);
+}
+
+polyphase_resampler::polyphase_resampler(int in_rate, int out_rate, int zero_crossings, simd_isa isa)
+    : m_in_rate(std::max(1, in_rate))
+    , m_out_rate(std::max(1, out_rate))
+    , m_isa(isa) {
+    const int g = std::gcd(m_in_rate, m_out_rate);
+    m_up = m_out_rate / g;
+    m_down = m_in_rate / g;
+
+    // Kaiser beta 8 gives ~80 dB stopband; the length sets the transition width.
+    const double beta = 8.0;
+    const double atten_db = beta / 0.1102 + 8.7;
+    const double ratio = std::max(1.0, (double) m_down / (double) m_up);
+    m_taps = (int) std::ceil(2.0 * std::max(4, zero_crossings) * ratio);
+    m_taps = (m_taps + 7) / 8 * 8;
+
+    // Place the transition band just below the lower Nyquist frequency so the stopband starts at it.
+    const double nyquist = 0.5 * (double) std::min(m_in_rate, m_out_rate);
+    const double transition_hz = (atten_db - 8.0) / (14.36 * (double) m_taps) * (double) m_in_rate;
+    m_cutoff_hz = std::max(0.5 * nyquist, nyquist - 0.5 * transition_hz);
+
+    const double fc = m_cutoff_hz / (double) m_in_rate; // cycles per input sample
+    const double L = (double) m_up;
+    m_delay = 0.5 * (double) (m_taps - 1) + (L - 1.0) / (2.0 * L);
+    const double half_width = m_delay + 1.0 / L;
+
+    m_phases.assign((size_t) m_up * (size_t) m_taps, 0.0f);
+    std::vector<double> tmp((size_t) m_taps);
+    for (int p = 0; p < m_up; ++p) {
+        double sum = 0.0;
+        for (int j = 0; j < m_taps; ++j) {
+            // Tap j multiplies x[i - (taps-1) + j]; tau is the distance from the output instant.
+            const double tau = (double) p / L + (double) (m_taps - 1 - j) - m_delay;
+            tmp[j] = 2.0 * fc * sinc(2.0 * fc * tau) * resampler_kaiser(tau, half_width, beta);
+            sum += tmp[j];
+        }
+        // Unity DC gain on every phase removes the small per-phase gain ripple.
+        for (int j = 0; j < m_taps; ++j) {
+            m_phases[(size_t) p * m_taps + j] = (float) (sum != 0.0 ? tmp[j] / sum : 0.0);
+        }
+    }
+
+    reset();
+}
+
+void polyphase_resampler::reset() {
+    m_buf.assign((size_t) m_taps - 1, 0.0f);
+    m_pos = (size_t) m_taps - 1;
+    m_phase = 0;
+}
+
+void polyphase_resampler::process(const float * in, size_t n, std::vector<float> & out) {
+    if (n == 0) {
+        return;
+    }
+
+    m_buf.insert(m_buf.end(), in, in + n);
+
+    const size_t hist = (size_t) m_taps - 1;
+    while (m_pos < m_buf.size()) {
+        const float * x = m_buf.data() + (m_pos - hist);
+        const float * h = m_phases.data() + (size_t) m_phase * m_taps;
+        out.push_back(dot(m_isa, h, x, m_taps));
+
+        m_phase += m_down;
+        m_pos += (size_t) (m_phase / m_up);
+        m_phase %= m_up;
+    }
+
+    // Keep the filter history for the next call.
+    const size_t drop = m_buf.size() - hist;
+    m_buf.erase(m_buf.begin(), m_buf.begin() + (ptrdiff_t) drop);
+    m_pos -= drop;
+}
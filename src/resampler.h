@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "simd.h"
+
+// Streaming rational-ratio polyphase FIR resampler (Kaiser-windowed sinc), plus channel downmix.
+// The inner products use SSE/AVX on x86-64 and NEON on ARM (see simd.h).
+
+// Average interleaved frames of `channels` channels into mono. `out` must hold `n_frames` floats.
+void downmix_to_mono(const float * interleaved, size_t n_frames, int channels, float * out, simd_isa isa);
+
+class polyphase_resampler {
+public:
+    // `zero_crossings` is the filter half-length in output-rate sinc lobes (quality/cost knob).
+    polyphase_resampler(int in_rate, int out_rate, int zero_crossings = 32, simd_isa isa = simd_best_isa());
+
+    // Appends resampled output for `n` new input samples to `out`.
+    void process(const float * in, size_t n, std::vector<float> & out);
+    void reset();
+
+    int in_rate() const { return m_in_rate; }
+    int out_rate() const { return m_out_rate; }
+    int up() const { return m_up; }
+    int down() const { return m_down; }
+    int taps_per_phase() const { return m_taps; }
+    simd_isa isa() const { return m_isa; }
+
+    // Group delay in input samples (output sample k corresponds to input time k*down/up - delay).
+    double delay_in() const { return m_delay; }
+    // Cutoff frequency in Hz (-6 dB point of the prototype filter).
+    double cutoff_hz() const { return m_cutoff_hz; }
+
+private:
+    int m_in_rate = 0;
+    int m_out_rate = 0;
+    int m_up = 1;   // L
+    int m_down = 1; // M
+    int m_taps = 0; // taps per phase (multiple of 8)
+    double m_delay = 0.0;
+    double m_cutoff_hz = 0.0;
+    simd_isa m_isa = simd_isa::scalar;
+
+    std::vector<float> m_phases; // m_up * m_taps coefficients, each phase stored oldest-sample first
+
+    std::vector<float> m_buf; // (m_taps - 1) samples of history followed by new input
+    size_t m_pos = 0;         // index in m_buf of the newest input sample used by the next output
+    int m_phase = 0;          // (k * down) % up for the next output k
+};
+
+// Kaiser window and zeroth-order modified Bessel function (shared with the reference resampler).
+double resampler_bessel_i0(double x);
+double resampler_kaiser(double t, double half_width, double beta);
@@ -0,0 +1,53 @@
+#include "simd.h"
+
+const char * simd_isa_name(simd_isa isa) {
+    switch (isa) {
+        case simd_isa::scalar: return "scalar";
+        case simd_isa::sse:    return "SSE";
+        case simd_isa::avx:    return "AVX+FMA";
+        case simd_isa::neon:   return "NEON";
+    }
+    return "?";
+}
+
+#if defined(AI_SUBTITLER_SIMD_X86)
+static bool cpu_has_avx_fma() {
+#    if defined(_MSC_VER) && !defined(__clang__)
+    int info[4] = { 0, 0, 0, 0 };
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    if (!osxsave || !avx || !fma) {
+        return false;
+    }
+    // The OS must save the YMM registers on context switch.
+    return (_xgetbv(0) & 0x6) == 0x6;
+#    else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("fma");
+#    endif
+}
+#endif
+
+simd_isa simd_best_isa() {
+#if defined(AI_SUBTITLER_SIMD_X86)
+    static const bool has_avx = cpu_has_avx_fma();
+    return has_avx ? simd_isa::avx : simd_isa::sse;
+#elif defined(AI_SUBTITLER_SIMD_NEON)
+    return simd_isa::neon;
+#else
+    return simd_isa::scalar;
+#endif
+}
+
+void simd_available_isas(simd_isa * out, int & n_out) {
+    n_out = 0;
+    out[n_out++] = simd_isa::scalar;
+#if defined(AI_SUBTITLER_SIMD_X86)
+    out[n_out++] = simd_isa::sse;
+#endif
+    if (simd_best_isa() != simd_isa::scalar && simd_best_isa() != out[n_out - 1]) {
+        out[n_out++] = simd_best_isa();
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// Instruction-set selection shared by the hand-vectorized audio kernels (resampler, audio stats).
+// x86-64 always has SSE2; AVX+FMA is detected at runtime so release builds need no /arch flag.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#    define AI_SUBTITLER_SIMD_X86 1
+#    include <immintrin.h>
+#    if defined(_MSC_VER) && !defined(__clang__)
+#        include <intrin.h>
+// MSVC accepts AVX intrinsics in any function; availability is checked at runtime.
+#        define AI_SUBTITLER_TARGET_AVX
+#    else
+#        define AI_SUBTITLER_TARGET_AVX __attribute__((target("avx,fma")))
+#    endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#    define AI_SUBTITLER_SIMD_NEON 1
+#    include <arm_neon.h>
+#endif
+
+enum class simd_isa {
+    scalar,
+    sse,
+    avx,
+    neon,
+};
+
+const char * simd_isa_name(simd_isa isa);
+
+// Best instruction set this build can use on this CPU.
+simd_isa simd_best_isa();
+
+// Every instruction set usable here, scalar first (for benchmarks and equivalence checks).
+void simd_available_isas(simd_isa * out, int & n_out);
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "streamerbot_ws_client.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct streamerbot_send_item {
+    std::string text;
+    size_t raw_len = 0; // original transcript length (including spaces), excluding any wrapping newlines
+};
+
+// Outcome of one send attempt, reported from the sender thread.
+struct streamerbot_send_report {
+    bool ok = false;
+    bool connected = false;
+    int64_t queue_us = 0;   // enqueue -> dequeue
+    int64_t connect_us = 0; // connect_and_handshake()
+    int64_t send_us = 0;    // do_action_text()
+    std::string text;
+    std::string err;
+};
+
+struct streamerbot_sender_options {
+    // Length-based reading delay between captions. Disable for load tests.
+    bool pace = true;
+    // Print connect/DoAction failures to stderr.
+    bool log_errors = true;
+    // Called on the sender thread after each send attempt (optional).
+    std::function<void(const streamerbot_send_report &)> on_report;
+};
+
+struct streamerbot_sender_stats {
+    uint64_t sent = 0;
+    uint64_t connect_failures = 0;
+    uint64_t send_failures = 0;
+};
+
+class streamerbot_sender {
+public:
+    explicit streamerbot_sender(streamerbot_ws_config cfg, streamerbot_sender_options opts = {})
+        : m_cfg(std::move(cfg))
+        , m_opts(std::move(opts))
+        , m_thread([this]() { this->run(); }) {
+    }
+
+    ~streamerbot_sender() {
+        stop_and_join(/*drain*/true);
+    }
+
+    streamerbot_sender(const streamerbot_sender &) = delete;
+    streamerbot_sender & operator=(const streamerbot_sender &) = delete;
+
+    void enqueue(streamerbot_send_item item) {
+        {
+            std::lock_guard<std::mutex> lock(m_mu);
+            if (m_stop) {
+                return;
+            }
+            m_q.push_back(queued_item{ std::move(item), std::chrono::steady_clock::now() });
+        }
+        m_cv.notify_one();
+    }
+
+    void stop_and_join(const bool drain) {
+        {
+            std::lock_guard<std::mutex> lock(m_mu);
+            if (m_stopped) {
+                // Already joined.
+                return;
+            }
+            m_stop = true;
+            if (!drain) {
+                m_q.clear();
+            }
+        }
+        m_cv.notify_one();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mu);
+            m_stopped = true;
+        }
+    }
+
+    streamerbot_sender_stats stats() const {
+        std::lock_guard<std::mutex> lock(m_mu);
+        return m_stats;
+    }
+
+private:
+    struct queued_item {
+        streamerbot_send_item item;
+        std::chrono::steady_clock::time_point t_enqueue;
+    };
+
+    static int64_t us_between(const std::chrono::steady_clock::time_point & t0, const std::chrono::steady_clock::time_point & t1) {
+        return (int64_t) std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+    }
+
+    static std::chrono::milliseconds compute_delay_ms(const size_t raw_len, const size_t backlog_remaining) {
+        // Length-based reading delay, clamped to [2s, 4s].
+        // When the queue is backing up, speed up slightly (but never below 2s).
+        constexpr double k_min_s = 2.0;
+        constexpr double k_max_s = 4.0;
+        constexpr double k_base_chars_per_s = 16.0;
+        constexpr size_t k_soft_backlog = 5;
+
+        double speedup = 1.0;
+        if (backlog_remaining > k_soft_backlog) {
+            // +25% chars/s per extra queued message, capped.
+            const double extra = 0.25 * (double) (backlog_remaining - k_soft_backlog);
+            speedup = 1.0 + std::min(2.0, extra); // cap at 3x
+        }
+
+        const double cps = k_base_chars_per_s * speedup;
+        const double delay_s = std::clamp((double) raw_len / cps, k_min_s, k_max_s);
+        const int ms = (int) std::llround(delay_s * 1000.0);
+        return std::chrono::milliseconds(std::max(0, ms));
+    }
+
+    void run() {
+        streamerbot_ws_client bot;
+
+        while (true) {
+            queued_item qi;
+            size_t backlog_remaining = 0;
+
+            {
+                std::unique_lock<std::mutex> lock(m_mu);
+                m_cv.wait(lock, [&]() { return m_stop || !m_q.empty(); });
+
+                if (m_q.empty()) {
+                    if (m_stop) {
+                        break;
+                    }
+                    continue;
+                }
+
+                qi = std::move(m_q.front());
+                m_q.pop_front();
+                backlog_remaining = m_q.size();
+            }
+
+            // Best-effort send (same behavior as the main loop used to have).
+            {
+                streamerbot_send_report rep;
+                const auto t_dequeue = std::chrono::steady_clock::now();
+                rep.queue_us = us_between(qi.t_enqueue, t_dequeue);
+
+                rep.connected = bot.connect_and_handshake(m_cfg, rep.err);
+                const auto t_connected = std::chrono::steady_clock::now();
+                rep.connect_us = us_between(t_dequeue, t_connected);
+
+                if (!rep.connected) {
+                    if (m_opts.log_errors) {
+                        std::fprintf(stderr, "Streamer.bot connect failed (%s).\n", rep.err.c_str());
+                    }
+                } else {
+                    rep.ok = bot.do_action_text(m_cfg, qi.item.text, rep.err);
+                    rep.send_us = us_between(t_connected, std::chrono::steady_clock::now());
+                    if (!rep.ok && m_opts.log_errors) {
+                        std::fprintf(stderr, "DoAction failed (%s).\n", rep.err.c_str());
+                    }
+                }
+                bot.close();
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mu);
+                    if (rep.ok) {
+                        m_stats.sent++;
+                    } else if (!rep.connected) {
+                        m_stats.connect_failures++;
+                    } else {
+                        m_stats.send_failures++;
+                    }
+                }
+
+                if (m_opts.on_report) {
+                    rep.text = qi.item.text;
+                    m_opts.on_report(rep);
+                }
+            }
+
+            // If stopping, drain quickly (no additional delay).
+            {
+                std::lock_guard<std::mutex> lock(m_mu);
+                if (m_stop) {
+                    if (m_q.empty()) {
+                        break;
+                    }
+                    continue;
+                }
+            }
+
+            if (m_opts.pace) {
+                std::this_thread::sleep_for(compute_delay_ms(qi.item.raw_len, backlog_remaining));
+            }
+        }
+    }
+
+private:
+    streamerbot_ws_config m_cfg;
+    streamerbot_sender_options m_opts;
+    mutable std::mutex m_mu;
+    std::condition_variable m_cv;
+    std::deque<queued_item> m_q;
+    streamerbot_sender_stats m_stats;
+    bool m_stop = false;
+    bool m_stopped = false;
+    std::thread m_thread;
+};
@@ -0,0 +1,180 @@
+#include "streamerbot_ws_client.h"
+
+// Transport-independent parts of the Streamer.bot client: URL parsing and the
+// Hello/Authenticate/DoAction protocol. The socket layer lives in
+// streamerbot_ws_client_winhttp.cpp (Windows) and streamerbot_ws_client_posix.cpp.
+
+#include <cctype>
+#include <cstring>
+#include <string>
+
+#include "json.hpp"
+
+using nlohmann::json;
+
+static bool starts_with(const std::string & s, const char * prefix) {
+    const size_t n = std::strlen(prefix);
+    return s.size() >= n && std::memcmp(s.data(), prefix, n) == 0;
+}
+
+bool streamerbot_ws_client::parse_ws_url(const std::string & url, ws_url_parts & parts, std::string & err) {
+    err.clear();
+    parts = {};
+
+    std::string u = url;
+    while (!u.empty() && std::isspace((unsigned char) u.back())) u.pop_back();
+    size_t i = 0;
+    while (i < u.size() && std::isspace((unsigned char) u[i])) i++;
+    u = u.substr(i);
+
+    if (starts_with(u, "ws://")) {
+        parts.secure = false;
+        u = u.substr(5);
+        parts.port = 80;
+    } else if (starts_with(u, "wss://")) {
+        parts.secure = true;
+        u = u.substr(6);
+        parts.port = 443;
+    } else {
+        err = "url must start with ws:// or wss://";
+        return false;
+    }
+
+    std::string hostport;
+    std::string path = "/";
+    const size_t slash = u.find('/');
+    if (slash == std::string::npos) {
+        hostport = u;
+    } else {
+        hostport = u.substr(0, slash);
+        path = u.substr(slash);
+        if (path.empty()) {
+            path = "/";
+        }
+    }
+
+    if (hostport.empty()) {
+        err = "missing host";
+        return false;
+    }
+
+    std::string host = hostport;
+    const size_t colon = hostport.rfind(':');
+    if (colon != std::string::npos && hostport.find(']') == std::string::npos) {
+        host = hostport.substr(0, colon);
+        const std::string port_str = hostport.substr(colon + 1);
+        if (port_str.empty()) {
+            err = "missing port after ':'";
+            return false;
+        }
+        const int port = std::stoi(port_str);
+        if (port <= 0 || port > 65535) {
+            err = "invalid port";
+            return false;
+        }
+        parts.port = (unsigned short) port;
+    }
+
+    parts.host = to_wstring_utf8(host);
+    parts.path = to_wstring_utf8(path);
+
+    return true;
+}
+
+bool streamerbot_ws_client::build_authentication(const std::string & password, const std::string & salt_b64, const std::string & challenge_b64, std::string & out_auth, std::string & err) {
+    std::string secret;
+    if (!sha256_base64(password + salt_b64, secret, err)) {
+        return false;
+    }
+    if (!sha256_base64(secret + challenge_b64, out_auth, err)) {
+        return false;
+    }
+    return true;
+}
+
+bool streamerbot_ws_client::connect_and_handshake(const streamerbot_ws_config & cfg, std::string & err) {
+    ws_url_parts parts;
+    if (!parse_ws_url(cfg.url, parts, err)) {
+        return false;
+    }
+
+    if (!connect_internal(parts, err)) {
+        return false;
+    }
+
+    // Expect Hello
+    std::string hello;
+    if (!recv_text_message(hello, err)) {
+        close();
+        return false;
+    }
+
+    json j;
+    try {
+        j = json::parse(hello);
+    } catch (const std::exception & e) {
+        err = std::string("failed to parse Hello JSON: ") + e.what();
+        close();
+        return false;
+    }
+
+    if (!j.contains("request") || j["request"].get<std::string>() != "Hello") {
+        // Some servers might send other messages first; keep going.
+        return true;
+    }
+
+    if (!j.contains("authentication")) {
+        return true;
+    }
+
+    if (!cfg.password.has_value()) {
+        // Authentication is enabled but may not be enforced for DoAction; allow continuing.
+        return true;
+    }
+
+    const auto & a = j["authentication"];
+    if (!a.contains("salt") || !a.contains("challenge")) {
+        return true;
+    }
+
+    const std::string salt = a["salt"].get<std::string>();
+    const std::string challenge = a["challenge"].get<std::string>();
+
+    std::string auth;
+    if (!build_authentication(*cfg.password, salt, challenge, auth, err)) {
+        close();
+        return false;
+    }
+
+    json auth_req;
+    auth_req["request"] = "Authenticate";
+    auth_req["id"] = "ai-subtitler-auth";
+    auth_req["authentication"] = auth;
+
+    if (!send_text_message(auth_req.dump(), err)) {
+        close();
+        return false;
+    }
+
+    // Best-effort: read one response, but don't fail the connection if it doesn't arrive immediately.
+    // Some setups may not enforce auth for DoAction.
+    return true;
+}
+
+bool streamerbot_ws_client::do_action_text(const streamerbot_ws_config & cfg, const std::string & text, std::string & err) {
+    err.clear();
+    if (!is_connected()) {
+        err = "not connected";
+        return false;
+    }
+
+    json req;
+    req["request"] = "DoAction";
+    req["id"] = "ai-subtitler-doaction";
+    req["action"] = json::object();
+    req["action"]["name"] = cfg.action_name;
+    req["args"] = json::object();
+    req["args"][cfg.arg_key] = text;
+
+    return send_text_message(req.dump(), err);
+}
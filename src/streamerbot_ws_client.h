@@ -45,8 +45,13 @@ private:
     static bool build_authentication(const std::string & password, const std::string & salt_b64, const std::string & challenge_b64, std::string & out_auth, std::string & err);
 
 private:
+    // WinHTTP handles (Windows)
     void * m_h_session = nullptr;
     void * m_h_connect = nullptr;
     void * m_h_request = nullptr;
     void * m_h_websocket = nullptr;
+
+    // Plain socket + pending received bytes (POSIX, ws:// only)
+    int m_sock = -1;
+    std::string m_rx;
 };
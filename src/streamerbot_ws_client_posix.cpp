@@ -0,0 +1,453 @@
+#include "streamerbot_ws_client.h"
+
+#ifndef _WIN32
+
+// Minimal RFC 6455 client over a plain TCP socket (ws:// only).
+// This lets the sender run against a local Streamer.bot stand-in on Linux/macOS
+// (see tools/streamerbot_mock_server.cpp). TLS (wss://) is not supported here.
+
+#include "crypto_util.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+
+static constexpr int k_io_timeout_ms = 5000;
+static constexpr size_t k_max_header_bytes = 16 * 1024;
+static constexpr uint64_t k_max_message_bytes = 16u * 1024u * 1024u;
+
+static const char * k_ws_guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+#if defined(MSG_NOSIGNAL)
+static constexpr int k_send_flags = MSG_NOSIGNAL;
+#else
+static constexpr int k_send_flags = 0;
+#endif
+
+static std::string errno_string(const char * what, const int e) {
+    std::string msg = what;
+    msg += ": ";
+    msg += std::strerror(e);
+    return msg;
+}
+
+static std::mt19937 & thread_rng() {
+    thread_local std::mt19937 rng{ std::random_device{}() };
+    return rng;
+}
+
+static bool send_all(const int fd, const char * data, size_t n, std::string & err) {
+    while (n > 0) {
+        const ssize_t rc = ::send(fd, data, n, k_send_flags);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            err = errno_string("send failed", errno);
+            return false;
+        }
+        data += rc;
+        n -= (size_t) rc;
+    }
+    return true;
+}
+
+static bool recv_some(const int fd, std::string & rx, std::string & err) {
+    char buf[16 * 1024];
+    while (true) {
+        const ssize_t rc = ::recv(fd, buf, sizeof(buf), 0);
+        if (rc > 0) {
+            rx.append(buf, (size_t) rc);
+            return true;
+        }
+        if (rc == 0) {
+            err = "connection closed by server";
+            return false;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            err = "receive timed out";
+            return false;
+        }
+        err = errno_string("recv failed", errno);
+        return false;
+    }
+}
+
+static bool recv_at_least(const int fd, std::string & rx, const size_t n, std::string & err) {
+    while (rx.size() < n) {
+        if (!recv_some(fd, rx, err)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Client-to-server frames must be masked (RFC 6455 section 5.3).
+static bool send_frame(const int fd, const int opcode, const std::string & payload, std::string & err) {
+    std::string frame;
+    frame.reserve(payload.size() + 14);
+    frame.push_back((char) (0x80 | (opcode & 0x0f)));
+
+    const uint64_t n = payload.size();
+    if (n < 126) {
+        frame.push_back((char) (0x80 | n));
+    } else if (n <= 0xffff) {
+        frame.push_back((char) (0x80 | 126));
+        frame.push_back((char) ((n >> 8) & 0xff));
+        frame.push_back((char) (n & 0xff));
+    } else {
+        frame.push_back((char) (0x80 | 127));
+        for (int i = 7; i >= 0; --i) {
+            frame.push_back((char) ((n >> (i * 8)) & 0xff));
+        }
+    }
+
+    const uint32_t mask = thread_rng()();
+    unsigned char mask_bytes[4] = {
+        (unsigned char) (mask >> 24), (unsigned char) (mask >> 16), (unsigned char) (mask >> 8), (unsigned char) mask,
+    };
+    frame.append((const char *) mask_bytes, 4);
+
+    for (size_t i = 0; i < payload.size(); ++i) {
+        frame.push_back((char) ((unsigned char) payload[i] ^ mask_bytes[i & 3]));
+    }
+
+    return send_all(fd, frame.data(), frame.size(), err);
+}
+
+static std::string lower_ascii(std::string s) {
+    for (char & c : s) {
+        c = (char) std::tolower((unsigned char) c);
+    }
+    return s;
+}
+
+static std::string find_header_value(const std::string & headers, const std::string & name_lower) {
+    size_t pos = 0;
+    while (pos < headers.size()) {
+        size_t eol = headers.find("\r\n", pos);
+        if (eol == std::string::npos) {
+            eol = headers.size();
+        }
+        const std::string line = headers.substr(pos, eol - pos);
+        const size_t colon = line.find(':');
+        if (colon != std::string::npos && lower_ascii(line.substr(0, colon)) == name_lower) {
+            size_t b = colon + 1;
+            size_t e = line.size();
+            while (b < e && std::isspace((unsigned char) line[b])) b++;
+            while (e > b && std::isspace((unsigned char) line[e - 1])) e--;
+            return line.substr(b, e - b);
+        }
+        pos = eol + 2;
+    }
+    return {};
+}
+
+streamerbot_ws_client::streamerbot_ws_client() = default;
+
+streamerbot_ws_client::~streamerbot_ws_client() {
+    close();
+}
+
+bool streamerbot_ws_client::is_connected() const {
+    return m_sock >= 0;
+}
+
+void streamerbot_ws_client::close() {
+    if (m_sock >= 0) {
+        // Best-effort close handshake; the server may already be gone.
+        std::string ignored;
+        const std::string status = { (char) 0x03, (char) 0xe8 }; // 1000 = normal closure
+        send_frame(m_sock, 0x8, status, ignored);
+        ::shutdown(m_sock, SHUT_RDWR);
+        ::close(m_sock);
+        m_sock = -1;
+    }
+    m_rx.clear();
+}
+
+std::wstring streamerbot_ws_client::to_wstring_utf8(const std::string & s) {
+    std::wstring out;
+    out.reserve(s.size());
+
+    size_t i = 0;
+    while (i < s.size()) {
+        const unsigned char c = (unsigned char) s[i];
+        uint32_t cp = 0xfffd;
+        size_t len = 1;
+        if (c < 0x80) {
+            cp = c;
+        } else if ((c >> 5) == 0x6 && i + 1 < s.size()) {
+            cp = ((c & 0x1fu) << 6) | ((unsigned char) s[i + 1] & 0x3fu);
+            len = 2;
+        } else if ((c >> 4) == 0xe && i + 2 < s.size()) {
+            cp = ((c & 0x0fu) << 12) | (((unsigned char) s[i + 1] & 0x3fu) << 6) | ((unsigned char) s[i + 2] & 0x3fu);
+            len = 3;
+        } else if ((c >> 3) == 0x1e && i + 3 < s.size()) {
+            cp = ((c & 0x07u) << 18) | (((unsigned char) s[i + 1] & 0x3fu) << 12) | (((unsigned char) s[i + 2] & 0x3fu) << 6) | ((unsigned char) s[i + 3] & 0x3fu);
+            len = 4;
+        }
+        out.push_back((wchar_t) cp);
+        i += len;
+    }
+    return out;
+}
+
+std::string streamerbot_ws_client::to_string_utf8(const std::wstring & s) {
+    std::string out;
+    out.reserve(s.size());
+
+    for (const wchar_t wc : s) {
+        const uint32_t cp = (uint32_t) wc;
+        if (cp < 0x80) {
+            out.push_back((char) cp);
+        } else if (cp < 0x800) {
+            out.push_back((char) (0xc0 | (cp >> 6)));
+            out.push_back((char) (0x80 | (cp & 0x3f)));
+        } else if (cp < 0x10000) {
+            out.push_back((char) (0xe0 | (cp >> 12)));
+            out.push_back((char) (0x80 | ((cp >> 6) & 0x3f)));
+            out.push_back((char) (0x80 | (cp & 0x3f)));
+        } else {
+            out.push_back((char) (0xf0 | (cp >> 18)));
+            out.push_back((char) (0x80 | ((cp >> 12) & 0x3f)));
+            out.push_back((char) (0x80 | ((cp >> 6) & 0x3f)));
+            out.push_back((char) (0x80 | (cp & 0x3f)));
+        }
+    }
+    return out;
+}
+
+bool streamerbot_ws_client::sha256_base64(const std::string & data, std::string & out_b64, std::string & err) {
+    err.clear();
+    out_b64 = crypto_base64_encode(crypto_sha256(data));
+    return true;
+}
+
+bool streamerbot_ws_client::connect_internal(const ws_url_parts & parts, std::string & err) {
+    err.clear();
+    close();
+
+    if (parts.secure) {
+        err = "wss:// is not supported by the POSIX client (use ws://)";
+        return false;
+    }
+
+    std::string host = to_string_utf8(parts.host);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    const std::string port = std::to_string(parts.port);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo * res = nullptr;
+    const int gai = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+    if (gai != 0) {
+        err = std::string("getaddrinfo failed: ") + gai_strerror(gai);
+        return false;
+    }
+
+    int last_errno = 0;
+    for (addrinfo * ai = res; ai; ai = ai->ai_next) {
+        const int fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            last_errno = errno;
+            continue;
+        }
+
+        timeval tv{};
+        tv.tv_sec = k_io_timeout_ms / 1000;
+        tv.tv_usec = (k_io_timeout_ms % 1000) * 1000;
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#if defined(SO_NOSIGPIPE)
+        const int one_nosig = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one_nosig, sizeof(one_nosig));
+#endif
+
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            const int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            m_sock = fd;
+            break;
+        }
+        last_errno = errno;
+        ::close(fd);
+    }
+    ::freeaddrinfo(res);
+
+    if (m_sock < 0) {
+        err = errno_string("connect failed", last_errno);
+        return false;
+    }
+
+    std::string key_raw(16, '\0');
+    for (char & c : key_raw) {
+        c = (char) (thread_rng()() & 0xff);
+    }
+    const std::string key = crypto_base64_encode(key_raw);
+
+    std::string req;
+    req += "GET " + to_string_utf8(parts.path) + " HTTP/1.1\r\n";
+    req += "Host: " + to_string_utf8(parts.host) + ":" + port + "\r\n";
+    req += "Upgrade: websocket\r\n";
+    req += "Connection: Upgrade\r\n";
+    req += "Sec-WebSocket-Key: " + key + "\r\n";
+    req += "Sec-WebSocket-Version: 13\r\n";
+    req += "User-Agent: ai-subtitler-streamerbot/1.0\r\n";
+    req += "\r\n";
+
+    if (!send_all(m_sock, req.data(), req.size(), err)) {
+        close();
+        return false;
+    }
+
+    size_t hdr_end = std::string::npos;
+    while ((hdr_end = m_rx.find("\r\n\r\n")) == std::string::npos) {
+        if (m_rx.size() > k_max_header_bytes) {
+            err = "upgrade response headers too large";
+            close();
+            return false;
+        }
+        if (!recv_some(m_sock, m_rx, err)) {
+            err = "upgrade failed: " + err;
+            close();
+            return false;
+        }
+    }
+
+    const std::string headers = m_rx.substr(0, hdr_end);
+    m_rx.erase(0, hdr_end + 4);
+
+    const size_t status_end = headers.find("\r\n");
+    const std::string status_line = headers.substr(0, status_end);
+    if (status_line.find(" 101") == std::string::npos) {
+        err = "upgrade rejected: " + status_line;
+        close();
+        return false;
+    }
+
+    const std::string accept = find_header_value(headers, "sec-websocket-accept");
+    if (accept != crypto_base64_encode(crypto_sha1(key + k_ws_guid))) {
+        err = "upgrade failed: bad Sec-WebSocket-Accept";
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+bool streamerbot_ws_client::recv_text_message(std::string & msg, std::string & err) {
+    err.clear();
+    msg.clear();
+
+    if (m_sock < 0) {
+        err = "not connected";
+        return false;
+    }
+
+    std::string out;
+
+    while (true) {
+        if (!recv_at_least(m_sock, m_rx, 2, err)) {
+            return false;
+        }
+
+        const unsigned char b0 = (unsigned char) m_rx[0];
+        const unsigned char b1 = (unsigned char) m_rx[1];
+        const bool fin = (b0 & 0x80) != 0;
+        const int opcode = b0 & 0x0f;
+        const bool masked = (b1 & 0x80) != 0;
+
+        uint64_t len = b1 & 0x7f;
+        size_t hdr = 2;
+        if (len == 126) {
+            if (!recv_at_least(m_sock, m_rx, 4, err)) {
+                return false;
+            }
+            len = ((uint64_t) (unsigned char) m_rx[2] << 8) | (uint64_t) (unsigned char) m_rx[3];
+            hdr = 4;
+        } else if (len == 127) {
+            if (!recv_at_least(m_sock, m_rx, 10, err)) {
+                return false;
+            }
+            len = 0;
+            for (int i = 0; i < 8; ++i) {
+                len = (len << 8) | (uint64_t) (unsigned char) m_rx[2 + i];
+            }
+            hdr = 10;
+        }
+
+        if (len > k_max_message_bytes || out.size() + len > k_max_message_bytes) {
+            err = "websocket message too large";
+            return false;
+        }
+
+        const size_t mask_off = hdr;
+        if (masked) {
+            hdr += 4;
+        }
+
+        if (!recv_at_least(m_sock, m_rx, hdr + (size_t) len, err)) {
+            return false;
+        }
+
+        std::string payload = m_rx.substr(hdr, (size_t) len);
+        if (masked) {
+            for (size_t i = 0; i < payload.size(); ++i) {
+                payload[i] = (char) ((unsigned char) payload[i] ^ (unsigned char) m_rx[mask_off + (i & 3)]);
+            }
+        }
+        m_rx.erase(0, hdr + (size_t) len);
+
+        if (opcode == 0x8) {
+            err = "websocket closed by server";
+            return false;
+        }
+        if (opcode == 0x9) {
+            if (!send_frame(m_sock, 0xA, payload, err)) {
+                return false;
+            }
+            continue;
+        }
+        if (opcode == 0xA) {
+            continue;
+        }
+
+        // text, binary or continuation
+        out += payload;
+        if (fin) {
+            break;
+        }
+    }
+
+    msg = out;
+    return true;
+}
+
+bool streamerbot_ws_client::send_text_message(const std::string & msg, std::string & err) {
+    err.clear();
+    if (m_sock < 0) {
+        err = "not connected";
+        return false;
+    }
+    return send_frame(m_sock, 0x1, msg, err);
+}
+
+#endif
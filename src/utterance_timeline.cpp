@@ -0,0 +1,283 @@
+#include "utterance_timeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+int32_t endpoint_stats::quantile(double q) const {
+    if (delays_ms.empty()) {
+        return 0;
+    }
+    std::vector<int32_t> v = delays_ms;
+    const size_t k = (size_t) std::lround(std::min(1.0, std::max(0.0, q)) * (double) (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + (ptrdiff_t) k, v.end());
+    return v[k];
+}
+
+utterance_timeline::utterance_timeline(const utterance_timeline_params & p)
+    : m_p(p) {
+    m_p.sample_rate = std::max(1, m_p.sample_rate);
+}
+
+int64_t utterance_timeline::voice_ms() const {
+    return m_in_voice ? samples_to_ms(m_end - m_begin) : -1;
+}
+
+int64_t utterance_timeline::silent_ms(uint64_t now) const {
+    return m_in_voice ? samples_to_ms(now > m_end ? now - m_end : 0) : -1;
+}
+
+void utterance_timeline::set_frame_probs(uint64_t seq, int frame_samples, const float * probs, int n_probs) {
+    m_probs_seq = seq;
+    m_frame_samples = std::max(1, frame_samples);
+    m_probs.assign(probs, probs + std::max(0, n_probs));
+}
+
+void utterance_timeline::measure_drop(uint64_t now) {
+    // Mean probability over the last 300 ms of speech vs over the first 300 ms after it, from the newest window.
+    // Speech that trails off (breath, a held vowel, noise) keeps the probability up just after the segment ends.
+    const uint64_t span = ms_to_samples(300);
+    double sum_in = 0.0;
+    double sum_out = 0.0;
+    int n_in = 0;
+    int n_out = 0;
+    for (size_t i = 0; i < m_probs.size(); ++i) {
+        const uint64_t a = m_probs_seq + (uint64_t) i * (uint64_t) m_frame_samples;
+        const uint64_t b = a + (uint64_t) m_frame_samples;
+        if (b <= m_end && a + span >= m_end) {
+            sum_in += m_probs[i];
+            ++n_in;
+        } else if (a >= m_end && b <= std::min(now, m_end + span)) {
+            sum_out += m_probs[i];
+            ++n_out;
+        }
+    }
+    if (n_in > 0 && n_out >= 2) {
+        m_drop = std::max(m_drop, (float) (sum_in / n_in - sum_out / n_out));
+    }
+}
+
+int32_t utterance_timeline::required_silence_ms() const {
+    if (m_p.endpoint == endpoint_mode::fixed) {
+        return m_p.voice_stop_ms;
+    }
+    // Bursts up to 1 s keep the full wait; from there it shrinks linearly to 40% at 6 s of speech,
+    // and by another quarter when speech stopped sharply.
+    const double v = (double) std::max<int64_t>(0, voice_ms());
+    double f = 1.0 - 0.6 * std::min(1.0, std::max(0.0, (v - 1000.0) / 5000.0));
+    if (v > 1000.0 && sharp_drop()) {
+        f *= 0.75;
+    }
+    return std::max(std::min(m_p.endpoint_min_ms, m_p.voice_stop_ms), (int32_t) std::lround(m_p.voice_stop_ms * f));
+}
+
+bool utterance_timeline::wants_probe(uint64_t now) const {
+    if (m_p.endpoint != endpoint_mode::adaptive || !m_p.endpoint_probe || !m_in_voice || m_probed) {
+        return false;
+    }
+    const int64_t silent = silent_ms(now);
+    return m_end < now && silent >= m_p.endpoint_min_ms && silent < required_silence_ms() && voice_ms() >= m_p.min_voice_ms;
+}
+
+bool utterance_timeline::wants_speculation(uint64_t now) const {
+    if (m_p.speculate_ms <= 0 || !m_in_voice || m_speculated) {
+        return false;
+    }
+    const int64_t silent = silent_ms(now);
+    return m_end < now && silent >= m_p.speculate_ms && silent < required_silence_ms() && voice_ms() >= m_p.min_voice_ms;
+}
+
+void utterance_timeline::accept_probe(uint64_t now) {
+    m_endpoints.delays_ms.push_back((int32_t) silent_ms(now));
+    m_endpoints.by_probe++;
+    reset(now);
+}
+
+void utterance_timeline::note_speech(uint64_t b, uint64_t e) {
+    // A later window can see speech where an earlier one saw a pause (overlapping windows, new context).
+    for (vad_span & g : m_gaps) {
+        if (b < g.end && e > g.begin) {
+            if (b > g.begin) {
+                g.end = b;
+            } else {
+                g.begin = std::min(g.end, e);
+            }
+        }
+    }
+    m_gaps.erase(std::remove_if(m_gaps.begin(), m_gaps.end(), [](const vad_span & g) { return g.end <= g.begin; }), m_gaps.end());
+
+    const uint64_t gap_begin = std::max(m_end, m_consumed);
+    if (b > gap_begin) {
+        m_gaps.push_back({ gap_begin, b });
+    }
+}
+
+void utterance_timeline::cut_chunk(uint64_t now) {
+    // Best pause: long and late (so chunks come out close to max_utterance_ms), including the one in progress,
+    // but not in the first third of the chunk.
+    const uint64_t lo = m_chunk_begin + ms_to_samples(m_p.max_utterance_ms / 3);
+    const uint64_t min_gap = ms_to_samples(100);
+    const double span = (double) std::max<uint64_t>(1, now - m_chunk_begin);
+
+    std::vector<vad_span> gaps = m_gaps;
+    if (m_end < now) {
+        gaps.push_back({ m_end, now });
+    }
+    const vad_span * best = nullptr;
+    double best_score = 0.0;
+    for (const vad_span & g : gaps) {
+        const uint64_t mid = g.begin + (g.end - g.begin) / 2;
+        if (g.end - g.begin < min_gap || mid < lo || mid >= now) {
+            continue;
+        }
+        const double score = (double) (g.end - g.begin) * (0.5 + 0.5 * (double) (mid - m_chunk_begin) / span);
+        if (!best || score > best_score) {
+            best = &g;
+            best_score = score;
+        }
+    }
+
+    uint64_t cut = now;
+    uint64_t next_begin = now;
+    uint64_t cut_end = now;
+    if (best) {
+        // Keep at most `tail` of the pause on this chunk and start the next one at the speech after it.
+        cut = best->begin + (best->end - best->begin) / 2;
+        cut_end = std::min(cut, best->begin + ms_to_samples(m_p.tail_ms));
+        next_begin = std::max(cut, best->end);
+    } else {
+        // No pause: cut at the least speech-like Silero frame of the newest window (between words, usually).
+        float best_p = 2.0f;
+        for (size_t i = 0; i < m_probs.size(); ++i) {
+            const uint64_t a = m_probs_seq + (uint64_t) i * (uint64_t) m_frame_samples;
+            const uint64_t b = a + (uint64_t) m_frame_samples;
+            if (a >= lo && b <= now && m_probs[i] < best_p) {
+                best_p = m_probs[i];
+                cut = a + (uint64_t) m_frame_samples / 2;
+            }
+        }
+        cut_end = cut;
+        next_begin = cut;
+    }
+
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    block_range(cut_end, begin, end);
+    m_chunk_out_begin = begin;
+    m_chunk_out_end = end;
+    m_chunk_out_voiced_ms = voiced_ms(begin, end);
+    m_chunks++;
+
+    m_consumed = std::max(m_consumed, cut);
+    m_chunk_begin = next_begin;
+    m_gaps.erase(std::remove_if(m_gaps.begin(), m_gaps.end(), [&](const vad_span & g) { return g.begin < cut; }), m_gaps.end());
+}
+
+int64_t utterance_timeline::voiced_ms(uint64_t begin, uint64_t end) const {
+    const uint64_t b = std::max(begin, m_chunk_begin);
+    const uint64_t e = std::min(end, m_end);
+    if (!m_in_voice || e <= b) {
+        return 0;
+    }
+    uint64_t n = e - b;
+    for (const vad_span & g : m_gaps) {
+        const uint64_t gb = std::max(g.begin, b);
+        const uint64_t ge = std::min(g.end, e);
+        if (ge > gb) {
+            n -= ge - gb;
+        }
+    }
+    return samples_to_ms(n);
+}
+
+void utterance_timeline::last_chunk(uint64_t & begin, uint64_t & end) const {
+    begin = m_chunk_out_begin;
+    end = m_chunk_out_end;
+}
+
+utterance_timeline::event utterance_timeline::update(uint64_t now, const std::vector<vad_span> & spans) {
+    m_voice_present = false;
+    bool started = false;
+    for (const vad_span & s : spans) {
+        const uint64_t b = std::max(s.begin, m_consumed);
+        const uint64_t e = std::min(s.end, now);
+        if (e <= b) {
+            continue;
+        }
+        m_voice_present = true;
+        if (!m_in_voice) {
+            m_in_voice = true;
+            m_silence_reported = false;
+            m_probed = false;
+            m_speculated = false;
+            m_drop = 0.0f;
+            m_begin = b;
+            m_end = e;
+            m_chunk_begin = b;
+            m_gaps.clear();
+            started = true;
+        } else if (e > m_end) {
+            // Speech resumed (or the segment grew): the drop seen so far no longer marks its end.
+            note_speech(b, e);
+            if (m_end <= m_chunk_begin) {
+                // First speech after a chunk was cut in a pause.
+                m_chunk_begin = b;
+            }
+            m_end = e;
+            m_drop = 0.0f;
+            m_probed = false;
+            m_speculated = false;
+        } else {
+            note_speech(b, e);
+        }
+    }
+
+    if (started) {
+        return event::voice_start;
+    }
+    if (!m_in_voice) {
+        return event::none;
+    }
+    if (m_p.max_utterance_ms > 0 && now > m_chunk_begin && samples_to_ms(now - m_chunk_begin) >= m_p.max_utterance_ms) {
+        cut_chunk(now);
+        return event::chunk;
+    }
+    if (m_end >= now) {
+        // Speech runs up to the newest sample.
+        m_silence_reported = false;
+        return event::none;
+    }
+
+    measure_drop(now);
+    if (silent_ms(now) >= required_silence_ms()) {
+        if (voice_ms() < m_p.min_voice_ms) {
+            return event::drop_short;
+        }
+        m_endpoints.delays_ms.push_back((int32_t) silent_ms(now));
+        m_endpoints.by_silence++;
+        return event::flush;
+    }
+    if (!m_silence_reported) {
+        m_silence_reported = true;
+        return event::voice_end;
+    }
+    return event::none;
+}
+
+void utterance_timeline::block_range(uint64_t now, uint64_t & begin, uint64_t & end) const {
+    const uint64_t preroll = ms_to_samples(m_p.preroll_ms);
+    begin = m_chunk_begin > m_consumed + preroll ? m_chunk_begin - preroll : m_consumed;
+    end = std::min(now, m_end + ms_to_samples(m_p.tail_ms));
+    const uint64_t max_n = ms_to_samples(m_p.max_block_ms);
+    if (end > begin + max_n) {
+        begin = end - max_n;
+    }
+    begin = std::min(begin, end);
+}
+
+void utterance_timeline::reset(uint64_t consumed_until) {
+    m_in_voice = false;
+    m_voice_present = false;
+    m_silence_reported = false;
+    m_consumed = std::max(m_consumed, consumed_until);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Voiced span of a VAD window, in absolute sample indices (the capture ring's audio_view::seq timeline).
+struct vad_span {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+};
+
+enum class endpoint_mode {
+    fixed,    // always wait voice_stop_ms of silence
+    adaptive, // shorter after long utterances and sharp speech-probability drops, the full wait after short bursts
+};
+
+struct utterance_timeline_params {
+    int sample_rate = 16000;
+    int32_t voice_stop_ms = 3000; // silence after the end of speech before a flush
+    int32_t min_voice_ms = 350;   // shorter utterances are dropped as clicks / noise bursts
+    int32_t preroll_ms = 200;     // audio kept before the detected start of speech
+    int32_t tail_ms = 200;        // audio kept after the detected end of speech
+    int32_t max_block_ms = 10000; // longest block handed to Whisper (the newest part is kept)
+    int32_t max_utterance_ms = 0; // longer speech is cut into chunks at its best internal pause (0 = off)
+
+    endpoint_mode endpoint = endpoint_mode::fixed;
+    int32_t endpoint_min_ms = 500; // adaptive: shortest silence that can end an utterance
+    bool endpoint_probe = false;   // adaptive: offer one provisional decode per pause once endpoint_min_ms passed
+    int32_t speculate_ms = 0;      // offer one speculative decode per pause after this much silence (0 = off)
+};
+
+// Silence it took to end each utterance (speech end -> flush decision), for tuning endpointing.
+struct endpoint_stats {
+    std::vector<int32_t> delays_ms;
+    uint64_t by_silence = 0;
+    uint64_t by_probe = 0;
+
+    // Delay at quantile q in [0, 1] (0 when empty).
+    int32_t quantile(double q) const;
+};
+
+// Voice gate state on the sample timeline: speech start/end come from the VAD segment positions,
+// not from when the check loop happened to run, so loop jitter and inference stalls do not skew the cut.
+class utterance_timeline {
+public:
+    enum class event {
+        none,
+        voice_start, // first speech of an utterance
+        voice_end,   // first check after speech stopped
+        flush,       // utterance ended: block_range() is ready
+        chunk,       // speech ran past max_utterance_ms: last_chunk() is ready, the utterance goes on
+        drop_short,  // utterance ended but was too short
+    };
+
+    explicit utterance_timeline(const utterance_timeline_params & p);
+
+    // Per-frame speech probabilities of the next update()'s window; `seq` is the first frame's sample.
+    // Optional: without them the adaptive endpoint cannot see how sharply speech stopped.
+    void set_frame_probs(uint64_t seq, int frame_samples, const float * probs, int n_probs);
+
+    // One VAD check over a window ending at `now` (exclusive, = newest captured sample + 1).
+    // `spans` are the window's voiced spans, oldest first.
+    event update(uint64_t now, const std::vector<vad_span> & spans);
+
+    // Silence that ends the current utterance.
+    int32_t required_silence_ms() const;
+    // Whether the speech-probability drop at the end of speech looked sharp.
+    bool sharp_drop() const { return m_drop >= k_sharp_drop; }
+
+    // Provisional decode: true once per pause in speech when the caller should transcribe block_range() early and
+    // call accept_probe() if the text ends a sentence.
+    bool wants_probe(uint64_t now) const;
+    void mark_probed() { m_probed = true; }
+    // Ends the utterance at `now` on the probe's verdict (records the endpoint and resets).
+    void accept_probe(uint64_t now);
+
+    // Speculative decode: true once per pause in speech when the caller may start transcribing block_range()
+    // ahead of the endpoint. The result is only used if the flush cuts the same range.
+    bool wants_speculation(uint64_t now) const;
+    void mark_speculated() { m_speculated = true; }
+
+    bool in_voice() const { return m_in_voice; }
+    // True when the last update() saw speech (after discarding what an earlier utterance consumed).
+    bool voice_present() const { return m_voice_present; }
+
+    uint64_t speech_begin() const { return m_begin; }
+    uint64_t speech_end() const { return m_end; }
+    int64_t voice_ms() const;
+    int64_t silent_ms(uint64_t now) const;
+
+    // Samples to transcribe for the utterance that just flushed:
+    // [speech_begin - preroll, speech_end + tail), capped at max_block_ms and at `now`.
+    // After a chunk cut it starts where that chunk ended.
+    void block_range(uint64_t now, uint64_t & begin, uint64_t & end) const;
+
+    // Samples of the chunk the last `chunk` event cut off. The next chunk (or the final block) starts after it.
+    void last_chunk(uint64_t & begin, uint64_t & end) const;
+    // Speech in that chunk (its pauses and padding left out).
+    int64_t last_chunk_voiced_ms() const { return m_chunk_out_voiced_ms; }
+    uint64_t chunks() const { return m_chunks; }
+
+    // Speech inside [begin, end) of the current chunk: its span minus the pauses seen in it.
+    int64_t voiced_ms(uint64_t begin, uint64_t end) const;
+
+    // Forget the current utterance; spans before `consumed_until` are ignored from now on.
+    void reset(uint64_t consumed_until);
+
+    const endpoint_stats & endpoints() const { return m_endpoints; }
+
+    int64_t samples_to_ms(uint64_t n) const { return (int64_t) (n * 1000 / (uint64_t) m_p.sample_rate); }
+    uint64_t ms_to_samples(int64_t ms) const { return ms <= 0 ? 0 : (uint64_t) ms * (uint64_t) m_p.sample_rate / 1000; }
+
+private:
+    static constexpr float k_sharp_drop = 0.5f; // mean probability before minus after the end of speech
+
+    void measure_drop(uint64_t now);
+    void note_speech(uint64_t b, uint64_t e);
+    void cut_chunk(uint64_t now);
+
+    utterance_timeline_params m_p;
+    bool m_in_voice = false;
+    bool m_voice_present = false;
+    bool m_silence_reported = false;
+    uint64_t m_begin = 0;
+    uint64_t m_end = 0;
+    uint64_t m_consumed = 0;
+    uint64_t m_chunk_begin = 0;  // speech start of the current chunk (= m_begin until the first cut)
+    std::vector<vad_span> m_gaps; // pauses inside the current chunk, oldest first
+    uint64_t m_chunk_out_begin = 0;
+    uint64_t m_chunk_out_end = 0;
+    int64_t m_chunk_out_voiced_ms = 0;
+    uint64_t m_chunks = 0;
+    bool m_probed = false;
+    bool m_speculated = false;
+    float m_drop = 0.0f;
+
+    uint64_t m_probs_seq = 0;
+    int m_frame_samples = 0;
+    std::vector<float> m_probs;
+
+    endpoint_stats m_endpoints;
+};
@@ -0,0 +1,133 @@
+#include "vad_sweep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+static bool overlaps(const vad_span & a, const vad_span & b) {
+    return a.begin < b.end && b.begin < a.end;
+}
+
+static vad_sweep_result run_point(const vad_sweep_input & in, const vad_sweep_point & pt) {
+    voice_gate_params p = in.base;
+    p.timeline.voice_stop_ms = pt.voice_stop_ms;
+    p.timeline.min_voice_ms = pt.min_voice_ms;
+    p.threshold = pt.threshold;
+    // No Whisper here: no probes. Speculation does not change the flushes.
+    p.timeline.endpoint_probe = false;
+    p.timeline.speculate_ms = 0;
+    voice_gate gate(p);
+
+    vad_sweep_result r;
+    r.point = pt;
+    std::vector<vad_span> blocks;
+
+    const uint64_t rate = (uint64_t) p.timeline.sample_rate;
+    const uint64_t fs = (uint64_t) std::max(1, p.frame_samples);
+    const uint64_t win = (uint64_t) std::max(0, in.window_ms) * rate / 1000;
+    const int64_t total_ms = (int64_t) (in.n_samples * 1000 / rate);
+    const int64_t step_ms = std::max<int32_t>(50, pt.check_ms);
+    // As --test-voice-gate: the file, then enough virtual silence for a trailing utterance to flush.
+    for (int64_t t_ms = 0; t_ms <= total_ms + pt.voice_stop_ms + step_ms; t_ms += step_ms) {
+        const uint64_t now = (uint64_t) t_ms * rate / 1000;
+        const uint64_t end = std::min(in.n_samples, now);
+        const uint64_t begin = end > win ? end - win : 0;
+        // The frames of the one pass that lie inside the window.
+        const uint64_t f0 = (begin + fs - 1) / fs;
+        const uint64_t f1 = std::min<uint64_t>(in.n_probs, end / fs);
+
+        voice_gate_check c;
+        c.now = now;
+        c.seq = f0 * fs;
+        c.n_samples = end > c.seq ? (size_t) (end - c.seq) : 0;
+        if (f1 > f0) {
+            c.probs = in.probs + f0;
+            c.n_probs = (int) (f1 - f0);
+        }
+        const voice_gate_decision d = gate.check(c);
+        if (d.ev == utterance_timeline::event::drop_short) {
+            r.drop_short++;
+        }
+        if (d.block == voice_gate_block::none) {
+            continue;
+        }
+        if (d.too_short) {
+            r.too_short++;
+            continue;
+        }
+        if (d.block == voice_gate_block::flush) r.flushes++;
+        if (d.block == voice_gate_block::chunk) r.chunks++;
+        blocks.push_back({ d.begin, d.end });
+    }
+
+    const endpoint_stats & es = gate.timeline().endpoints();
+    r.delay_p50_ms = es.quantile(0.50);
+    r.delay_p90_ms = es.quantile(0.90);
+
+    if (!in.labels.empty()) {
+        for (const vad_span & b : blocks) {
+            if (std::any_of(in.labels.begin(), in.labels.end(), [&](const vad_span & l) { return overlaps(b, l); })) {
+                r.blocks_matched++;
+            }
+        }
+        for (const vad_span & l : in.labels) {
+            if (std::any_of(blocks.begin(), blocks.end(), [&](const vad_span & b) { return overlaps(b, l); })) {
+                r.refs_hit++;
+            }
+        }
+        r.precision = blocks.empty() ? 0.0 : (double) r.blocks_matched / (double) blocks.size();
+        r.recall = (double) r.refs_hit / (double) in.labels.size();
+    }
+    return r;
+}
+
+std::vector<vad_sweep_result> vad_sweep_run(const vad_sweep_input & in, const std::vector<vad_sweep_point> & grid, int n_threads) {
+    std::vector<vad_sweep_result> results(grid.size());
+    std::atomic<size_t> next{ 0 };
+    auto work = [&]() {
+        for (size_t i = next++; i < grid.size(); i = next++) {
+            results[i] = run_point(in, grid[i]);
+        }
+    };
+    const size_t n = std::min<size_t>(grid.size(), (size_t) std::max(1, n_threads));
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < n; ++t) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (std::thread & t : pool) {
+        t.join();
+    }
+    return results;
+}
+
+bool vad_sweep_load_labels(const std::string & path, int sample_rate, std::vector<vad_span> & labels, std::string & err) {
+    labels.clear();
+    FILE * f = std::fopen(path.c_str(), "r");
+    if (!f) {
+        err = "cannot open " + path;
+        return false;
+    }
+    char line[1024];
+    int line_no = 0;
+    bool ok = true;
+    while (std::fgets(line, sizeof(line), f)) {
+        ++line_no;
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r' || line[0] == '\0') {
+            continue;
+        }
+        double t0 = 0.0;
+        double t1 = 0.0;
+        if (std::sscanf(line, "%lf %lf", &t0, &t1) != 2 || t0 < 0.0 || t1 < t0) {
+            err = "line " + std::to_string(line_no) + ": expected \"start end\" in seconds";
+            ok = false;
+            break;
+        }
+        labels.push_back({ (uint64_t) (t0 * sample_rate), (uint64_t) (t1 * sample_rate) });
+    }
+    std::fclose(f);
+    std::sort(labels.begin(), labels.end(), [](const vad_span & a, const vad_span & b) { return a.begin < b.begin; });
+    return ok;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "voice_gate.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One combination of the swept voice gate settings.
+struct vad_sweep_point {
+    int32_t voice_stop_ms = 3000;
+    int32_t min_voice_ms = 600;
+    float threshold = 0.6f;
+    int32_t check_ms = 30;
+};
+
+struct vad_sweep_result {
+    vad_sweep_point point;
+    int flushes = 0;
+    int chunks = 0;
+    int drop_short = 0;
+    int too_short = 0;
+    int32_t delay_p50_ms = 0; // endpoint delay (speech end -> flush)
+    int32_t delay_p90_ms = 0;
+    // Against the reference labels (when there are any): blocks that overlap a labeled span, and spans some block covers.
+    int blocks_matched = 0;
+    int refs_hit = 0;
+    double precision = 0.0;
+    double recall = 0.0;
+};
+
+// A recording scored by Silero once, front to back: one probability per frame_samples-sample frame from sample 0.
+struct vad_sweep_input {
+    const float * probs = nullptr;
+    size_t n_probs = 0;
+    uint64_t n_samples = 0;
+    int32_t window_ms = 3000;
+    voice_gate_params base;       // settings that are not swept
+    std::vector<vad_span> labels; // reference speech spans (empty = no precision/recall)
+};
+
+// Replays the gate over the recording for every point of `grid`, the way --test-voice-gate steps through a file,
+// but slicing each window's probabilities out of the one pass instead of re-scoring it. Points run in parallel on
+// `n_threads`; results come back in grid order.
+std::vector<vad_sweep_result> vad_sweep_run(const vad_sweep_input & in, const std::vector<vad_sweep_point> & grid, int n_threads);
+
+// Reference speech spans from a label file: one "start end [label]" per line, in seconds (Audacity's label export).
+bool vad_sweep_load_labels(const std::string & path, int sample_rate, std::vector<vad_span> & labels, std::string & err);
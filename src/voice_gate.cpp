@@ -0,0 +1,402 @@
+#include "voice_gate.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+const char * voice_gate_event_name(utterance_timeline::event ev) {
+    switch (ev) {
+        case utterance_timeline::event::none:        return "none";
+        case utterance_timeline::event::voice_start: return "voice_start";
+        case utterance_timeline::event::voice_end:   return "voice_end";
+        case utterance_timeline::event::flush:       return "flush";
+        case utterance_timeline::event::chunk:       return "chunk";
+        case utterance_timeline::event::drop_short:  return "drop_short";
+    }
+    return "none";
+}
+
+const char * voice_gate_block_name(voice_gate_block b) {
+    switch (b) {
+        case voice_gate_block::none:      return "none";
+        case voice_gate_block::flush:     return "flush";
+        case voice_gate_block::chunk:     return "chunk";
+        case voice_gate_block::probe:     return "probe";
+        case voice_gate_block::speculate: return "speculate";
+    }
+    return "none";
+}
+
+void voice_gate_spans(const voice_gate_params & p, const voice_gate_check & c, std::vector<vad_span> & spans) {
+    spans.clear();
+    if (!c.probs || c.n_probs <= 0 || c.n_samples == 0) {
+        return;
+    }
+    const int64_t rate = p.timeline.sample_rate;
+    const int64_t n_window = std::max(1, p.frame_samples);
+    const int64_t audio_len = (int64_t) c.n_probs * n_window;
+    const int64_t min_speech = rate * p.min_speech_ms / 1000;
+    const int64_t min_silence = rate * p.min_silence_ms / 1000;
+    const int64_t pad = rate * p.speech_pad_ms / 1000;
+    const int64_t min_silence_at_max_speech = rate * 98 / 1000;
+    int64_t max_speech = (int64_t) ((double) rate * (double) p.max_speech_s) - n_window - 2 * pad;
+    if (p.max_speech_s > 100000.0f || max_speech <= 0) {
+        max_speech = INT_MAX / 2;
+    }
+    const float neg_threshold = std::max(0.01f, p.threshold - 0.15f);
+
+    struct seg {
+        int64_t start;
+        int64_t end;
+    };
+    std::vector<seg> speeches;
+    bool triggered = false;
+    seg cur = { 0, 0 };
+    int64_t temp_end = 0;
+    int64_t prev_end = 0;
+    int64_t next_start = 0;
+    for (int i = 0; i < c.n_probs; ++i) {
+        const float prob = c.probs[i];
+        const int64_t at = n_window * i;
+        if (prob >= p.threshold && temp_end) {
+            temp_end = 0;
+            if (next_start < prev_end) {
+                next_start = at;
+            }
+        }
+        if (prob >= p.threshold && !triggered) {
+            triggered = true;
+            cur.start = at;
+            continue;
+        }
+        if (triggered && at - cur.start > max_speech) {
+            // Too long: split at the last long-enough silence, or right here.
+            if (prev_end) {
+                cur.end = prev_end;
+                speeches.push_back(cur);
+                if (next_start < prev_end) {
+                    triggered = false;
+                } else {
+                    cur.start = next_start;
+                }
+            } else {
+                cur.end = at;
+                speeches.push_back(cur);
+                triggered = false;
+            }
+            prev_end = 0;
+            next_start = 0;
+            temp_end = 0;
+            continue;
+        }
+        if (prob < neg_threshold && triggered) {
+            if (!temp_end) {
+                temp_end = at;
+            }
+            if (at - temp_end > min_silence_at_max_speech) {
+                prev_end = temp_end;
+            }
+            if (at - temp_end < min_silence) {
+                continue;
+            }
+            cur.end = temp_end;
+            if (cur.end - cur.start > min_speech) {
+                speeches.push_back(cur);
+            }
+            prev_end = 0;
+            next_start = 0;
+            temp_end = 0;
+            triggered = false;
+        }
+    }
+    if (triggered && audio_len - cur.start > min_speech) {
+        cur.end = audio_len;
+        speeches.push_back(cur);
+    }
+
+    // Padding: half the silence between two close segments each, `pad` otherwise.
+    for (size_t i = 0; i < speeches.size(); ++i) {
+        if (i == 0) {
+            speeches[i].start = std::max<int64_t>(0, speeches[i].start - pad);
+        }
+        if (i + 1 < speeches.size()) {
+            const int64_t silence = speeches[i + 1].start - speeches[i].end;
+            if (silence < 2 * pad) {
+                speeches[i].end += silence / 2;
+                speeches[i + 1].start = std::max<int64_t>(0, speeches[i + 1].start - silence / 2);
+            } else {
+                speeches[i].end = std::min(audio_len, speeches[i].end + pad);
+                speeches[i + 1].start = std::max<int64_t>(0, speeches[i + 1].start - pad);
+            }
+        } else {
+            speeches[i].end = std::min(audio_len, speeches[i].end + pad);
+        }
+    }
+
+    for (const seg & s : speeches) {
+        vad_span span;
+        span.begin = c.seq + (uint64_t) std::max<int64_t>(0, s.start);
+        span.end = c.seq + std::min<uint64_t>(c.n_samples, (uint64_t) std::max<int64_t>(0, s.end));
+        if (span.end > span.begin) {
+            spans.push_back(span);
+        }
+    }
+}
+
+voice_gate::voice_gate(const voice_gate_params & p)
+    : m_p(p)
+    , m_tl(p.timeline) {
+    m_p.block_align = std::max<uint64_t>(1, m_p.block_align);
+}
+
+voice_gate_decision voice_gate::check(const voice_gate_check & c) {
+    voice_gate_decision d;
+    const uint64_t now = c.now;
+    if (c.probs && c.n_probs > 0) {
+        m_tl.set_frame_probs(c.seq, m_p.frame_samples, c.probs, c.n_probs);
+    }
+    voice_gate_spans(m_p, c, m_spans);
+    d.n_spans = (int) m_spans.size();
+    d.ev = m_tl.update(now, m_spans);
+    d.voice_present = m_tl.voice_present();
+    d.voice_ms = m_tl.voice_ms();
+    d.silent_ms = m_tl.silent_ms(now);
+    d.required_silence_ms = m_tl.required_silence_ms();
+    d.sharp_drop = m_tl.sharp_drop();
+
+    switch (d.ev) {
+        case utterance_timeline::event::drop_short:
+            // Too short: likely a click / noise burst.
+            m_tl.reset(now);
+            return d;
+        case utterance_timeline::event::chunk:
+            m_tl.last_chunk(d.begin, d.end);
+            d.voiced_ms = m_tl.last_chunk_voiced_ms();
+            d.block = voice_gate_block::chunk;
+            break;
+        case utterance_timeline::event::flush:
+            m_tl.block_range(now, d.begin, d.end);
+            d.block = voice_gate_block::flush;
+            break;
+        default:
+            if (c.allow_probe && m_tl.wants_probe(now)) {
+                m_tl.mark_probed();
+                m_tl.block_range(now, d.begin, d.end);
+                d.block = voice_gate_block::probe;
+            } else if (c.allow_speculation && m_tl.wants_speculation(now)) {
+                m_tl.mark_speculated();
+                m_tl.block_range(now, d.begin, d.end);
+                d.block = voice_gate_block::speculate;
+            }
+            break;
+    }
+    if (d.block == voice_gate_block::none) {
+        return d;
+    }
+    d.begin -= d.begin % m_p.block_align;
+    if (d.block != voice_gate_block::chunk) {
+        d.voiced_ms = m_tl.voiced_ms(d.begin, d.end);
+    }
+    d.too_short = too_short((size_t) (d.end - d.begin));
+    // A probe keeps the utterance open until its text is judged, a chunk until the utterance ends.
+    if (d.block == voice_gate_block::flush) {
+        m_tl.reset(now);
+    }
+    return d;
+}
+
+//
+// voice_gate_recorder
+//
+
+static void write_params(FILE * f, const voice_gate_params & p) {
+    const utterance_timeline_params & t = p.timeline;
+    std::fprintf(f, "# voice gate recording v1\n");
+    std::fprintf(f, "P %d %d %.9g %d %d %.9g %d %d %llu %d %d %d %d %d %d %d %d %d %d\n",
+        t.sample_rate, p.frame_samples, p.threshold, p.min_speech_ms, p.min_silence_ms, p.max_speech_s,
+        p.speech_pad_ms, p.min_block_ms, (unsigned long long) p.block_align,
+        t.voice_stop_ms, t.min_voice_ms, t.preroll_ms, t.tail_ms, t.max_block_ms, t.max_utterance_ms,
+        t.endpoint == endpoint_mode::adaptive ? 1 : 0, t.endpoint_min_ms, t.endpoint_probe ? 1 : 0, t.speculate_ms);
+}
+
+bool voice_gate_recorder::open(const std::string & path, const voice_gate_params & p) {
+    close();
+    FILE * f = std::fopen(path.c_str(), "w");
+    if (!f) {
+        return false;
+    }
+    attach(f, p);
+    m_owned = true;
+    return true;
+}
+
+void voice_gate_recorder::attach(FILE * f, const voice_gate_params & p) {
+    close();
+    m_f = f;
+    m_owned = false;
+    if (m_f) {
+        write_params(m_f, p);
+    }
+}
+
+void voice_gate_recorder::close() {
+    if (m_f && m_owned) {
+        std::fclose(m_f);
+    } else if (m_f) {
+        std::fflush(m_f);
+    }
+    m_f = nullptr;
+    m_owned = false;
+}
+
+void voice_gate_recorder::check(const voice_gate_check & c, const voice_gate_decision & d) {
+    if (!m_f) return;
+    std::fprintf(m_f, "C %llu %llu %zu %d %d %d",
+        (unsigned long long) c.now, (unsigned long long) c.seq, c.n_samples,
+        c.allow_probe ? 1 : 0, c.allow_speculation ? 1 : 0, c.probs ? c.n_probs : 0);
+    for (int i = 0; c.probs && i < c.n_probs; ++i) {
+        std::fprintf(m_f, " %.9g", c.probs[i]);
+    }
+    std::fputc('\n', m_f);
+    if (d.ev != utterance_timeline::event::none || d.block != voice_gate_block::none) {
+        std::fprintf(m_f, "D %s %s %llu %llu %d\n",
+            voice_gate_event_name(d.ev), voice_gate_block_name(d.block),
+            (unsigned long long) d.begin, (unsigned long long) d.end, d.too_short ? 1 : 0);
+    }
+}
+
+void voice_gate_recorder::accept_probe(uint64_t now) {
+    if (!m_f) return;
+    std::fprintf(m_f, "A %llu\n", (unsigned long long) now);
+}
+
+//
+// voice_gate_load
+//
+
+bool voice_gate_load(FILE * f, voice_gate_recording & rec, std::string & err) {
+    rec = voice_gate_recording{};
+    bool have_params = false;
+    int line_no = 0;
+    std::string line;
+    char buf[4096];
+    auto fail = [&](const char * what) {
+        err = "line " + std::to_string(line_no) + ": " + what;
+        return false;
+    };
+
+    while (true) {
+        // Lines of a long window do not fit in buf: read until the newline.
+        line.clear();
+        bool got = false;
+        while (std::fgets(buf, sizeof(buf), f)) {
+            got = true;
+            line += buf;
+            if (!line.empty() && line.back() == '\n') {
+                break;
+            }
+        }
+        if (!got) {
+            break;
+        }
+        ++line_no;
+        const char * s = line.c_str();
+        if (*s == '#' || *s == '\n' || *s == '\r' || *s == '\0') {
+            continue;
+        }
+        if (*s == 'P') {
+            voice_gate_params & p = rec.params;
+            utterance_timeline_params & t = p.timeline;
+            unsigned long long align = 1;
+            int adaptive = 0;
+            int probe = 0;
+            const int n = std::sscanf(s + 1, "%d %d %f %d %d %f %d %d %llu %d %d %d %d %d %d %d %d %d %d",
+                &t.sample_rate, &p.frame_samples, &p.threshold, &p.min_speech_ms, &p.min_silence_ms, &p.max_speech_s,
+                &p.speech_pad_ms, &p.min_block_ms, &align,
+                &t.voice_stop_ms, &t.min_voice_ms, &t.preroll_ms, &t.tail_ms, &t.max_block_ms, &t.max_utterance_ms,
+                &adaptive, &t.endpoint_min_ms, &probe, &t.speculate_ms);
+            if (n != 19) {
+                return fail("bad parameter line");
+            }
+            p.block_align = (uint64_t) align;
+            t.endpoint = adaptive ? endpoint_mode::adaptive : endpoint_mode::fixed;
+            t.endpoint_probe = probe != 0;
+            have_params = true;
+        } else if (*s == 'C') {
+            voice_gate_recording::step st;
+            unsigned long long now = 0;
+            unsigned long long seq = 0;
+            size_t n_samples = 0;
+            int allow_probe = 0;
+            int allow_spec = 0;
+            int n_probs = 0;
+            int used = 0;
+            if (std::sscanf(s + 1, "%llu %llu %zu %d %d %d%n", &now, &seq, &n_samples, &allow_probe, &allow_spec, &n_probs, &used) != 6 || n_probs < 0) {
+                return fail("bad check line");
+            }
+            st.check.now = now;
+            st.check.seq = seq;
+            st.check.n_samples = n_samples;
+            st.check.allow_probe = allow_probe != 0;
+            st.check.allow_speculation = allow_spec != 0;
+            st.check.n_probs = n_probs;
+            st.probs.resize((size_t) n_probs);
+            const char * q = s + 1 + used;
+            for (int i = 0; i < n_probs; ++i) {
+                char * next = nullptr;
+                st.probs[(size_t) i] = std::strtof(q, &next);
+                if (next == q) {
+                    return fail("missing probabilities");
+                }
+                q = next;
+            }
+            rec.steps.push_back(std::move(st));
+        } else if (*s == 'D') {
+            if (rec.steps.empty() || rec.steps.back().accept || rec.steps.back().has_decision) {
+                return fail("decision without a check");
+            }
+            char ev[32] = {};
+            char block[32] = {};
+            unsigned long long begin = 0;
+            unsigned long long end = 0;
+            int too_short = 0;
+            if (std::sscanf(s + 1, "%31s %31s %llu %llu %d", ev, block, &begin, &end, &too_short) != 5) {
+                return fail("bad decision line");
+            }
+            voice_gate_recording::step & st = rec.steps.back();
+            st.has_decision = true;
+            st.ev = ev;
+            st.block = block;
+            st.begin = begin;
+            st.end = end;
+            st.too_short = too_short != 0;
+        } else if (*s == 'A') {
+            unsigned long long now = 0;
+            if (std::sscanf(s + 1, "%llu", &now) != 1) {
+                return fail("bad accept line");
+            }
+            voice_gate_recording::step st;
+            st.accept = true;
+            st.check.now = now;
+            rec.steps.push_back(std::move(st));
+        } else {
+            return fail("unknown record");
+        }
+    }
+    if (!have_params) {
+        err = "no parameter line";
+        return false;
+    }
+    return true;
+}
+
+bool voice_gate_load(const std::string & path, voice_gate_recording & rec, std::string & err) {
+    FILE * f = std::fopen(path.c_str(), "r");
+    if (!f) {
+        err = "cannot open " + path;
+        return false;
+    }
+    const bool ok = voice_gate_load(f, rec, err);
+    std::fclose(f);
+    return ok;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "utterance_timeline.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct voice_gate_params {
+    utterance_timeline_params timeline;
+
+    // Silero segmentation of each window (whisper_vad_params).
+    int frame_samples = 512; // Silero in whisper.cpp scores 512-sample frames at 16 kHz
+    float threshold = 0.5f;
+    int32_t min_speech_ms = 250;
+    int32_t min_silence_ms = 200;
+    float max_speech_s = 30.0f;
+    int32_t speech_pad_ms = 100;
+
+    int32_t min_block_ms = 500; // shorter blocks are not worth a decode (DROP_TOO_SHORT)
+    uint64_t block_align = 1;   // block starts snap down to a multiple of this many samples (the log-mel hop)
+};
+
+// One VAD check: Silero's probabilities for the frames of the window [seq, seq + n_samples), checked at `now`
+// (= newest captured sample + 1; past the end of a file it runs on over virtual silence).
+struct voice_gate_check {
+    uint64_t now = 0;
+    uint64_t seq = 0;
+    size_t n_samples = 0;
+    const float * probs = nullptr;
+    int n_probs = 0;
+    // The caller has no provisional / speculative decode in flight, so the gate may ask for one.
+    bool allow_probe = false;
+    bool allow_speculation = false;
+};
+
+enum class voice_gate_block {
+    none,
+    flush,     // the utterance ended
+    chunk,     // long speech: a chunk up to its best pause, the utterance goes on
+    probe,     // provisional decode (--endpoint-probe); accept_probe() ends the utterance on its verdict
+    speculate, // decode ahead of the endpoint (--speculative-decode)
+};
+
+// What one check decided. Flush and drop_short reset the gate, so the utterance figures are taken before that.
+struct voice_gate_decision {
+    utterance_timeline::event ev = utterance_timeline::event::none;
+    voice_gate_block block = voice_gate_block::none;
+    uint64_t begin = 0; // block samples (block != none)
+    uint64_t end = 0;
+    int64_t voiced_ms = 0;  // speech in the block
+    bool too_short = false; // block under min_block_ms: drop it
+    int n_spans = 0;        // voiced spans Silero found in the window
+    bool voice_present = false;
+
+    int64_t voice_ms = -1;
+    int64_t silent_ms = -1;
+    int32_t required_silence_ms = 0;
+    bool sharp_drop = false;
+};
+
+const char * voice_gate_event_name(utterance_timeline::event ev);
+const char * voice_gate_block_name(voice_gate_block b);
+
+// Silero's get_speech_timestamps() over one window's frame probabilities, as whisper_vad_segments_from_probs()
+// does it, but in absolute samples and clamped to the window.
+void voice_gate_spans(const voice_gate_params & p, const voice_gate_check & c, std::vector<vad_span> & spans);
+
+// The voice gate decision logic, shared by the live pipeline, --test-voice-gate and the replay benchmark:
+// frame probabilities in, utterance events and block ranges out. No audio, no model, no clock.
+class voice_gate {
+public:
+    explicit voice_gate(const voice_gate_params & p);
+
+    voice_gate_decision check(const voice_gate_check & c);
+
+    // A provisional decode's text ended a sentence: end the utterance at `now` (the probe's check).
+    void accept_probe(uint64_t now) { m_tl.accept_probe(now); }
+
+    const utterance_timeline & timeline() const { return m_tl; }
+    const voice_gate_params & params() const { return m_p; }
+    bool too_short(size_t n_samples) const { return n_samples < m_tl.ms_to_samples(m_p.min_block_ms); }
+
+private:
+    voice_gate_params m_p;
+    utterance_timeline m_tl;
+    std::vector<vad_span> m_spans;
+};
+
+// Recorded probability streams (--record-voice-gate), for replaying a session through the gate offline:
+//   P <voice_gate_params fields>
+//   C <now> <seq> <n_samples> <allow_probe> <allow_speculation> <n_probs> <probs...>
+//   D <event> <block> <begin> <end> <too_short>   (decision of the check above, when there was one)
+//   A <now>                                      (accept_probe)
+class voice_gate_recorder {
+public:
+    voice_gate_recorder() = default;
+    ~voice_gate_recorder() { close(); }
+
+    voice_gate_recorder(const voice_gate_recorder &) = delete;
+    voice_gate_recorder & operator=(const voice_gate_recorder &) = delete;
+
+    bool open(const std::string & path, const voice_gate_params & p);
+    // Writes to an open stream (not closed by this).
+    void attach(FILE * f, const voice_gate_params & p);
+    void close();
+    bool is_open() const { return m_f != nullptr; }
+
+    void check(const voice_gate_check & c, const voice_gate_decision & d);
+    void accept_probe(uint64_t now);
+
+private:
+    FILE * m_f = nullptr;
+    bool m_owned = false;
+};
+
+struct voice_gate_recording {
+    struct step {
+        bool accept = false; // accept_probe(now) instead of a check
+        voice_gate_check check;
+        std::vector<float> probs;
+        bool has_decision = false;
+        std::string ev = "none";
+        std::string block = "none";
+        uint64_t begin = 0;
+        uint64_t end = 0;
+        bool too_short = false;
+    };
+
+    voice_gate_params params;
+    std::vector<step> steps;
+};
+
+// Reads a recording; false (with a message in `err`) on a malformed stream.
+bool voice_gate_load(FILE * f, voice_gate_recording & rec, std::string & err);
+bool voice_gate_load(const std::string & path, voice_gate_recording & rec, std::string & err);
@@ -0,0 +1,497 @@
+#include "streamerbot_mock_server.h"
+
+#include "crypto_util.h"
+
+#include "json.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#    include <winsock2.h>
+#    include <ws2tcpip.h>
+#    pragma comment(lib, "ws2_32.lib")
+using socklen_type = int;
+static void close_socket(intptr_t s) { closesocket((SOCKET) s); }
+static void shutdown_socket(intptr_t s) { shutdown((SOCKET) s, SD_BOTH); }
+static constexpr int k_send_flags = 0;
+#else
+#    include <arpa/inet.h>
+#    include <netinet/in.h>
+#    include <netinet/tcp.h>
+#    include <sys/select.h>
+#    include <sys/socket.h>
+#    include <sys/time.h>
+#    include <unistd.h>
+using socklen_type = socklen_t;
+static void close_socket(intptr_t s) { ::close((int) s); }
+static void shutdown_socket(intptr_t s) { ::shutdown((int) s, SHUT_RDWR); }
+#    if defined(MSG_NOSIGNAL)
+static constexpr int k_send_flags = MSG_NOSIGNAL;
+#    else
+static constexpr int k_send_flags = 0;
+#    endif
+#endif
+
+using nlohmann::json;
+
+static const char * k_ws_guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+static constexpr size_t k_max_header_bytes = 16 * 1024;
+static constexpr uint64_t k_max_message_bytes = 1024u * 1024u;
+
+static bool send_all(const intptr_t s, const std::string & data) {
+    size_t off = 0;
+    while (off < data.size()) {
+        const int rc = (int) ::send(s, data.data() + off, (int) (data.size() - off), k_send_flags);
+        if (rc <= 0) {
+            return false;
+        }
+        off += (size_t) rc;
+    }
+    return true;
+}
+
+static bool recv_some(const intptr_t s, std::string & rx) {
+    char buf[8192];
+    const int rc = (int) ::recv(s, buf, (int) sizeof(buf), 0);
+    if (rc <= 0) {
+        return false;
+    }
+    rx.append(buf, (size_t) rc);
+    return true;
+}
+
+static bool recv_at_least(const intptr_t s, std::string & rx, const size_t n) {
+    while (rx.size() < n) {
+        if (!recv_some(s, rx)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Server-to-client frames are never masked.
+static bool send_frame(const intptr_t s, const int opcode, const std::string & payload) {
+    std::string frame;
+    frame.reserve(payload.size() + 10);
+    frame.push_back((char) (0x80 | (opcode & 0x0f)));
+    const uint64_t n = payload.size();
+    if (n < 126) {
+        frame.push_back((char) n);
+    } else if (n <= 0xffff) {
+        frame.push_back((char) 126);
+        frame.push_back((char) ((n >> 8) & 0xff));
+        frame.push_back((char) (n & 0xff));
+    } else {
+        frame.push_back((char) 127);
+        for (int i = 7; i >= 0; --i) {
+            frame.push_back((char) ((n >> (i * 8)) & 0xff));
+        }
+    }
+    frame += payload;
+    return send_all(s, frame);
+}
+
+// Reads one complete data message. Handles ping and close control frames.
+// Returns false when the peer closed or the connection failed.
+static bool recv_message(const intptr_t s, std::string & rx, std::string & msg) {
+    msg.clear();
+    while (true) {
+        if (!recv_at_least(s, rx, 2)) {
+            return false;
+        }
+        const unsigned char b0 = (unsigned char) rx[0];
+        const unsigned char b1 = (unsigned char) rx[1];
+        const bool fin = (b0 & 0x80) != 0;
+        const int opcode = b0 & 0x0f;
+        const bool masked = (b1 & 0x80) != 0;
+
+        uint64_t len = b1 & 0x7f;
+        size_t hdr = 2;
+        if (len == 126) {
+            if (!recv_at_least(s, rx, 4)) return false;
+            len = ((uint64_t) (unsigned char) rx[2] << 8) | (uint64_t) (unsigned char) rx[3];
+            hdr = 4;
+        } else if (len == 127) {
+            if (!recv_at_least(s, rx, 10)) return false;
+            len = 0;
+            for (int i = 0; i < 8; ++i) {
+                len = (len << 8) | (uint64_t) (unsigned char) rx[2 + i];
+            }
+            hdr = 10;
+        }
+        if (len > k_max_message_bytes || msg.size() + len > k_max_message_bytes) {
+            return false;
+        }
+
+        const size_t mask_off = hdr;
+        if (masked) {
+            hdr += 4;
+        }
+        if (!recv_at_least(s, rx, hdr + (size_t) len)) {
+            return false;
+        }
+
+        std::string payload = rx.substr(hdr, (size_t) len);
+        if (masked) {
+            for (size_t i = 0; i < payload.size(); ++i) {
+                payload[i] = (char) ((unsigned char) payload[i] ^ (unsigned char) rx[mask_off + (i & 3)]);
+            }
+        }
+        rx.erase(0, hdr + (size_t) len);
+
+        if (opcode == 0x8) {
+            send_frame(s, 0x8, payload.substr(0, 2));
+            return false;
+        }
+        if (opcode == 0x9) {
+            if (!send_frame(s, 0xA, payload)) return false;
+            continue;
+        }
+        if (opcode == 0xA) {
+            continue;
+        }
+
+        msg += payload;
+        if (fin) {
+            return true;
+        }
+    }
+}
+
+static std::string header_value(const std::string & headers, const char * name_lower) {
+    size_t pos = 0;
+    while (pos < headers.size()) {
+        size_t eol = headers.find("\r\n", pos);
+        if (eol == std::string::npos) {
+            eol = headers.size();
+        }
+        const std::string line = headers.substr(pos, eol - pos);
+        const size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char) std::tolower(c); });
+            if (name == name_lower) {
+                size_t b = colon + 1;
+                size_t e = line.size();
+                while (b < e && std::isspace((unsigned char) line[b])) b++;
+                while (e > b && std::isspace((unsigned char) line[e - 1])) e--;
+                return line.substr(b, e - b);
+            }
+        }
+        pos = eol + 2;
+    }
+    return {};
+}
+
+static void sleep_ms(const int ms) {
+    if (ms > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+streamerbot_mock_server::streamerbot_mock_server() = default;
+
+streamerbot_mock_server::~streamerbot_mock_server() {
+    stop();
+}
+
+void streamerbot_mock_server::set_on_action(std::function<void(const streamerbot_mock_action &)> cb) {
+    std::lock_guard<std::mutex> lock(m_mu);
+    m_on_action = std::move(cb);
+}
+
+streamerbot_mock_stats streamerbot_mock_server::stats() const {
+    std::lock_guard<std::mutex> lock(m_mu);
+    return m_stats;
+}
+
+bool streamerbot_mock_server::roll(const float rate) {
+    if (rate <= 0.0f) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mu);
+    return std::uniform_real_distribution<float>(0.0f, 1.0f)(m_rng) < rate;
+}
+
+bool streamerbot_mock_server::start(const streamerbot_mock_config & cfg, std::string & err) {
+    err.clear();
+    if (m_running) {
+        err = "already running";
+        return false;
+    }
+
+#if defined(_WIN32)
+    WSADATA wsa{};
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        err = "WSAStartup failed";
+        return false;
+    }
+#endif
+
+    m_cfg = cfg;
+    m_rng.seed(cfg.seed);
+    m_stats = {};
+
+    const intptr_t s = (intptr_t) ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s < 0) {
+        err = "socket() failed";
+        return false;
+    }
+
+    const int one = 1;
+    ::setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *) &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short) cfg.port);
+    if (inet_pton(AF_INET, cfg.host.c_str(), &addr.sin_addr) != 1) {
+        err = "invalid IPv4 host: " + cfg.host;
+        close_socket(s);
+        return false;
+    }
+
+    if (::bind(s, (const sockaddr *) &addr, sizeof(addr)) != 0) {
+        err = "bind() failed on " + cfg.host + ":" + std::to_string(cfg.port);
+        close_socket(s);
+        return false;
+    }
+    if (::listen(s, 64) != 0) {
+        err = "listen() failed";
+        close_socket(s);
+        return false;
+    }
+
+    sockaddr_in bound{};
+    socklen_type bound_len = sizeof(bound);
+    ::getsockname(s, (sockaddr *) &bound, &bound_len);
+    m_port = ntohs(bound.sin_port);
+
+    m_listen = s;
+    m_running = true;
+    m_accept_thread = std::thread([this]() { this->accept_loop(); });
+    return true;
+}
+
+void streamerbot_mock_server::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+
+    if (m_accept_thread.joinable()) {
+        m_accept_thread.join();
+    }
+    close_socket(m_listen);
+    m_listen = -1;
+
+    std::unique_lock<std::mutex> lock(m_mu);
+    for (const intptr_t c : m_conn_socks) {
+        shutdown_socket(c);
+    }
+    m_cv.wait(lock, [&]() { return m_active == 0; });
+    lock.unlock();
+
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
+
+void streamerbot_mock_server::accept_loop() {
+    uint64_t next_id = 0;
+    while (m_running) {
+        // Poll so stop() does not depend on platform-specific accept() wakeups.
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(m_listen, &rfds);
+        timeval tv{};
+        tv.tv_usec = 50 * 1000;
+        const int rc = ::select((int) m_listen + 1, &rfds, nullptr, nullptr, &tv);
+        if (rc <= 0) {
+            continue;
+        }
+
+        const intptr_t c = (intptr_t) ::accept(m_listen, nullptr, nullptr);
+        if (c < 0) {
+            continue;
+        }
+
+        const int one = 1;
+        ::setsockopt(c, IPPROTO_TCP, TCP_NODELAY, (const char *) &one, sizeof(one));
+#if defined(SO_NOSIGPIPE)
+        ::setsockopt(c, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+        {
+            std::lock_guard<std::mutex> lock(m_mu);
+            m_conn_socks.push_back(c);
+            m_active++;
+            m_stats.connections++;
+        }
+
+        const uint64_t id = next_id++;
+        std::thread([this, c, id]() {
+            this->serve_connection(c, id);
+
+            close_socket(c);
+            std::lock_guard<std::mutex> lock(m_mu);
+            m_conn_socks.erase(std::remove(m_conn_socks.begin(), m_conn_socks.end(), c), m_conn_socks.end());
+            m_active--;
+            m_cv.notify_all();
+        }).detach();
+    }
+}
+
+void streamerbot_mock_server::serve_connection(const intptr_t s, const uint64_t conn_id) {
+    std::string rx;
+
+    size_t hdr_end = std::string::npos;
+    while ((hdr_end = rx.find("\r\n\r\n")) == std::string::npos) {
+        if (rx.size() > k_max_header_bytes || !recv_some(s, rx)) {
+            return;
+        }
+    }
+    const std::string headers = rx.substr(0, hdr_end);
+    rx.erase(0, hdr_end + 4);
+
+    const std::string key = header_value(headers, "sec-websocket-key");
+    if (key.empty()) {
+        send_all(s, "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        std::lock_guard<std::mutex> lock(m_mu);
+        m_stats.bad_requests++;
+        return;
+    }
+
+    std::string resp;
+    resp += "HTTP/1.1 101 Switching Protocols\r\n";
+    resp += "Upgrade: websocket\r\n";
+    resp += "Connection: Upgrade\r\n";
+    resp += "Sec-WebSocket-Accept: " + crypto_base64_encode(crypto_sha1(key + k_ws_guid)) + "\r\n";
+    resp += "\r\n";
+    if (!send_all(s, resp)) {
+        return;
+    }
+
+    if (roll(m_cfg.disconnect_rate)) {
+        if (m_cfg.verbose) {
+            std::fprintf(stderr, "[mock] conn=%llu injected disconnect\n", (unsigned long long) conn_id);
+        }
+        std::lock_guard<std::mutex> lock(m_mu);
+        m_stats.disconnects_injected++;
+        return;
+    }
+
+    sleep_ms(m_cfg.hello_delay_ms);
+
+    json hello;
+    hello["request"] = "Hello";
+    hello["info"] = json::object();
+    hello["info"]["instanceId"] = "ai-subtitler-mock";
+    hello["info"]["name"] = "Streamer.bot (mock)";
+    hello["info"]["version"] = "0.0.0";
+
+    std::string expected_auth;
+    bool authed = true;
+    if (m_cfg.password.has_value()) {
+        std::string salt_raw(32, '\0');
+        std::string challenge_raw(32, '\0');
+        {
+            std::lock_guard<std::mutex> lock(m_mu);
+            for (char & c : salt_raw) c = (char) (m_rng() & 0xff);
+            for (char & c : challenge_raw) c = (char) (m_rng() & 0xff);
+        }
+        const std::string salt = crypto_base64_encode(salt_raw);
+        const std::string challenge = crypto_base64_encode(challenge_raw);
+        const std::string secret = crypto_base64_encode(crypto_sha256(*m_cfg.password + salt));
+        expected_auth = crypto_base64_encode(crypto_sha256(secret + challenge));
+
+        hello["authentication"] = json::object();
+        hello["authentication"]["salt"] = salt;
+        hello["authentication"]["challenge"] = challenge;
+        authed = false;
+    }
+
+    if (!send_frame(s, 0x1, hello.dump())) {
+        return;
+    }
+
+    std::string msg;
+    while (m_running && recv_message(s, rx, msg)) {
+        sleep_ms(m_cfg.response_delay_ms);
+
+        json req;
+        try {
+            req = json::parse(msg);
+        } catch (const std::exception &) {
+            std::lock_guard<std::mutex> lock(m_mu);
+            m_stats.bad_requests++;
+            continue;
+        }
+
+        const std::string request = (req.contains("request") && req["request"].is_string()) ? req["request"].get<std::string>() : std::string();
+        const std::string id = (req.contains("id") && req["id"].is_string()) ? req["id"].get<std::string>() : std::string();
+
+        json reply;
+        reply["id"] = id;
+        reply["status"] = "ok";
+
+        if (request == "Authenticate") {
+            const std::string got = (req.contains("authentication") && req["authentication"].is_string()) ? req["authentication"].get<std::string>() : std::string();
+            const bool ok = !expected_auth.empty() && got == expected_auth;
+            {
+                std::lock_guard<std::mutex> lock(m_mu);
+                if (ok) {
+                    m_stats.auth_ok++;
+                } else {
+                    m_stats.auth_failed++;
+                }
+            }
+            if (!ok) {
+                reply["status"] = "error";
+                reply["error"] = "Authentication failed";
+                send_frame(s, 0x1, reply.dump());
+                send_frame(s, 0x8, std::string{ (char) 0x0f, (char) 0xa0 }); // 4000: app-defined close
+                return;
+            }
+            authed = true;
+        } else if (request == "DoAction") {
+            if (!authed) {
+                std::lock_guard<std::mutex> lock(m_mu);
+                m_stats.actions_rejected++;
+                reply["status"] = "error";
+                reply["error"] = "Authentication required";
+            } else if (roll(m_cfg.drop_rate)) {
+                std::lock_guard<std::mutex> lock(m_mu);
+                m_stats.actions_dropped++;
+                continue;
+            } else {
+                streamerbot_mock_action a;
+                a.t_recv = std::chrono::steady_clock::now();
+                if (req.contains("action") && req["action"].is_object() && req["action"].contains("name") && req["action"]["name"].is_string()) {
+                    a.action_name = req["action"]["name"].get<std::string>();
+                }
+                if (req.contains("args")) {
+                    a.args_json = req["args"].dump();
+                }
+
+                std::function<void(const streamerbot_mock_action &)> cb;
+                {
+                    std::lock_guard<std::mutex> lock(m_mu);
+                    m_stats.actions++;
+                    cb = m_on_action;
+                }
+                if (m_cfg.verbose) {
+                    std::fprintf(stderr, "[mock] conn=%llu DoAction '%s' %s\n", (unsigned long long) conn_id, a.action_name.c_str(), a.args_json.c_str());
+                }
+                if (cb) {
+                    cb(a);
+                }
+            }
+        }
+
+        if (!send_frame(s, 0x1, reply.dump())) {
+            return;
+        }
+    }
+}
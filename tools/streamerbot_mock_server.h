@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Local stand-in for the Streamer.bot WebSocket server.
+// Speaks the subset of the protocol used by streamerbot_ws_client: Hello (optionally with an
+// authentication challenge), Authenticate and DoAction. Faults can be injected to exercise the
+// sender's reconnect path without a real Streamer.bot instance.
+
+struct streamerbot_mock_config {
+    std::string host = "127.0.0.1";
+    int port = 8080; // 0 = pick a free port (see streamerbot_mock_server::port())
+
+    int hello_delay_ms = 0;      // latency before the Hello message is sent
+    int response_delay_ms = 0;   // latency before each request is processed/answered
+    float drop_rate = 0.0f;      // fraction of DoAction requests silently discarded
+    float disconnect_rate = 0.0f; // fraction of connections closed right after the upgrade (no Hello)
+
+    std::optional<std::string> password; // when set, Hello carries an auth challenge and DoAction requires it
+
+    uint32_t seed = 1;
+    bool verbose = false;
+};
+
+struct streamerbot_mock_action {
+    std::string action_name;
+    std::string args_json;
+    std::chrono::steady_clock::time_point t_recv;
+};
+
+struct streamerbot_mock_stats {
+    uint64_t connections = 0;
+    uint64_t disconnects_injected = 0;
+    uint64_t auth_ok = 0;
+    uint64_t auth_failed = 0;
+    uint64_t actions = 0;          // DoAction requests accepted (delivered)
+    uint64_t actions_dropped = 0;  // discarded by drop_rate
+    uint64_t actions_rejected = 0; // refused because the connection was not authenticated
+    uint64_t bad_requests = 0;
+};
+
+class streamerbot_mock_server {
+public:
+    streamerbot_mock_server();
+    ~streamerbot_mock_server();
+
+    streamerbot_mock_server(const streamerbot_mock_server &) = delete;
+    streamerbot_mock_server & operator=(const streamerbot_mock_server &) = delete;
+
+    // Called on a connection thread for every delivered DoAction.
+    void set_on_action(std::function<void(const streamerbot_mock_action &)> cb);
+
+    bool start(const streamerbot_mock_config & cfg, std::string & err);
+    void stop();
+
+    int port() const { return m_port; }
+    streamerbot_mock_stats stats() const;
+
+private:
+    void accept_loop();
+    void serve_connection(intptr_t sock, uint64_t conn_id);
+    bool roll(float rate);
+
+private:
+    streamerbot_mock_config m_cfg;
+    std::function<void(const streamerbot_mock_action &)> m_on_action;
+
+    intptr_t m_listen = -1;
+    int m_port = 0;
+    std::atomic<bool> m_running{ false };
+    std::thread m_accept_thread;
+
+    mutable std::mutex m_mu;
+    std::condition_variable m_cv;
+    std::vector<intptr_t> m_conn_socks; // open connections (shut down on stop)
+    int m_active = 0;                   // running connection threads (detached)
+    std::mt19937 m_rng;
+    streamerbot_mock_stats m_stats;
+};
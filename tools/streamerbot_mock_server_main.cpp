@@ -0,0 +1,112 @@
+#include "streamerbot_mock_server.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+static std::atomic<bool> g_quit{ false };
+
+static void on_signal(int) {
+    g_quit = true;
+}
+
+static void print_usage(const char * exe) {
+    std::fprintf(stderr, "\n");
+    std::fprintf(stderr, "Usage: %s [options]\n\n", exe);
+    std::fprintf(stderr, "Local Streamer.bot stand-in (Hello/Authenticate/DoAction over ws://).\n\n");
+    std::fprintf(stderr, "  --host <ipv4>              Bind address (default: 127.0.0.1)\n");
+    std::fprintf(stderr, "  --port N                   Listen port (default: 8080; 0 = any free port)\n");
+    std::fprintf(stderr, "  --password <pwd>           Require authentication (Hello carries a salt/challenge)\n");
+    std::fprintf(stderr, "  --hello-delay-ms N         Delay before sending Hello (default: 0)\n");
+    std::fprintf(stderr, "  --response-delay-ms N      Delay before handling each request (default: 0)\n");
+    std::fprintf(stderr, "  --drop-rate X              Fraction of DoAction requests silently dropped (default: 0)\n");
+    std::fprintf(stderr, "  --disconnect-rate X        Fraction of connections closed before Hello (default: 0)\n");
+    std::fprintf(stderr, "  --seed N                   RNG seed for fault injection (default: 1)\n");
+    std::fprintf(stderr, "  --quiet                    Do not print received actions\n\n");
+}
+
+int main(int argc, char ** argv) {
+    streamerbot_mock_config cfg;
+    cfg.verbose = true;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        auto require_value = [&](const char * name) -> const char * {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "error: %s requires a value\n", name);
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--host") {
+            cfg.host = require_value("--host");
+        } else if (arg == "--port") {
+            cfg.port = std::stoi(require_value("--port"));
+        } else if (arg == "--password") {
+            cfg.password = std::string(require_value("--password"));
+        } else if (arg == "--hello-delay-ms") {
+            cfg.hello_delay_ms = std::stoi(require_value("--hello-delay-ms"));
+        } else if (arg == "--response-delay-ms") {
+            cfg.response_delay_ms = std::stoi(require_value("--response-delay-ms"));
+        } else if (arg == "--drop-rate") {
+            cfg.drop_rate = std::stof(require_value("--drop-rate"));
+        } else if (arg == "--disconnect-rate") {
+            cfg.disconnect_rate = std::stof(require_value("--disconnect-rate"));
+        } else if (arg == "--seed") {
+            cfg.seed = (uint32_t) std::stoul(require_value("--seed"));
+        } else if (arg == "--quiet") {
+            cfg.verbose = false;
+        } else {
+            std::fprintf(stderr, "error: unknown argument: %s\n", arg.c_str());
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    streamerbot_mock_server server;
+    std::string err;
+    if (!server.start(cfg, err)) {
+        std::fprintf(stderr, "error: %s\n", err.c_str());
+        return 2;
+    }
+
+    std::fprintf(stderr, "Streamer.bot mock listening on ws://%s:%d/ (auth=%s drop=%.2f disconnect=%.2f hello_delay=%dms response_delay=%dms)\n",
+        cfg.host.c_str(),
+        server.port(),
+        cfg.password ? "on" : "off",
+        cfg.drop_rate,
+        cfg.disconnect_rate,
+        cfg.hello_delay_ms,
+        cfg.response_delay_ms);
+
+    while (!g_quit) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    server.stop();
+
+    const streamerbot_mock_stats st = server.stats();
+    std::fprintf(stderr,
+        "\nconnections=%llu actions=%llu dropped=%llu rejected=%llu disconnects=%llu auth_ok=%llu auth_failed=%llu bad=%llu\n",
+        (unsigned long long) st.connections,
+        (unsigned long long) st.actions,
+        (unsigned long long) st.actions_dropped,
+        (unsigned long long) st.actions_rejected,
+        (unsigned long long) st.disconnects_injected,
+        (unsigned long long) st.auth_ok,
+        (unsigned long long) st.auth_failed,
+        (unsigned long long) st.bad_requests);
+    return 0;
+}
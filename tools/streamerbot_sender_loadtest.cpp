@@ -0,0 +1,304 @@
+#include "streamerbot_mock_server.h"
+#include "streamerbot_sender.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Pushes many captions through streamerbot_sender (with reading-delay pacing disabled)
+// against the in-process Streamer.bot mock, then reports delivery and latency figures.
+
+struct loadtest_params {
+    int captions = 2000;
+    double rate = 0.0; // captions/s, 0 = enqueue everything at once
+    int timeout_s = 120;
+
+    std::string ws_url; // external server; empty = in-process mock
+    std::optional<std::string> password;
+
+    streamerbot_mock_config mock;
+};
+
+static void print_usage(const char * exe) {
+    std::fprintf(stderr, "\n");
+    std::fprintf(stderr, "Usage: %s [options]\n\n", exe);
+    std::fprintf(stderr, "Sender:\n");
+    std::fprintf(stderr, "  --captions N               Number of captions to send (default: 2000)\n");
+    std::fprintf(stderr, "  --rate X                   Enqueue rate in captions/s (default: 0 = all at once)\n");
+    std::fprintf(stderr, "  --password <pwd>           Password used by the client\n");
+    std::fprintf(stderr, "  --ws-url <url>             Use an external server instead of the in-process mock\n");
+    std::fprintf(stderr, "  --timeout-s N              Give up waiting for the queue to drain after N seconds (default: 120)\n\n");
+    std::fprintf(stderr, "Mock server (in-process):\n");
+    std::fprintf(stderr, "  --server-password <pwd>    Require authentication (default: same as --password)\n");
+    std::fprintf(stderr, "  --hello-delay-ms N         Delay before Hello (default: 0)\n");
+    std::fprintf(stderr, "  --response-delay-ms N      Delay before each request is handled (default: 0)\n");
+    std::fprintf(stderr, "  --drop-rate X              Fraction of DoAction requests dropped (default: 0)\n");
+    std::fprintf(stderr, "  --disconnect-rate X        Fraction of connections closed before Hello (default: 0)\n");
+    std::fprintf(stderr, "  --seed N                   RNG seed for fault injection (default: 1)\n\n");
+}
+
+static bool parse_args(int argc, char ** argv, loadtest_params & p) {
+    bool server_password_set = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        auto require_value = [&](const char * name) -> const char * {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "error: %s requires a value\n", name);
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            std::exit(0);
+        } else if (arg == "--captions") {
+            p.captions = std::stoi(require_value("--captions"));
+        } else if (arg == "--rate") {
+            p.rate = std::stod(require_value("--rate"));
+        } else if (arg == "--timeout-s") {
+            p.timeout_s = std::stoi(require_value("--timeout-s"));
+        } else if (arg == "--ws-url") {
+            p.ws_url = require_value("--ws-url");
+        } else if (arg == "--password") {
+            p.password = std::string(require_value("--password"));
+        } else if (arg == "--server-password") {
+            p.mock.password = std::string(require_value("--server-password"));
+            server_password_set = true;
+        } else if (arg == "--hello-delay-ms") {
+            p.mock.hello_delay_ms = std::stoi(require_value("--hello-delay-ms"));
+        } else if (arg == "--response-delay-ms") {
+            p.mock.response_delay_ms = std::stoi(require_value("--response-delay-ms"));
+        } else if (arg == "--drop-rate") {
+            p.mock.drop_rate = std::stof(require_value("--drop-rate"));
+        } else if (arg == "--disconnect-rate") {
+            p.mock.disconnect_rate = std::stof(require_value("--disconnect-rate"));
+        } else if (arg == "--seed") {
+            p.mock.seed = (uint32_t) std::stoul(require_value("--seed"));
+        } else {
+            std::fprintf(stderr, "error: unknown argument: %s\n", arg.c_str());
+            return false;
+        }
+    }
+
+    if (!server_password_set) {
+        p.mock.password = p.password;
+    }
+    p.captions = std::max(1, p.captions);
+    return true;
+}
+
+static double percentile_ms(std::vector<int64_t> v_us, const double p) {
+    if (v_us.empty()) return 0.0;
+    std::sort(v_us.begin(), v_us.end());
+    const size_t idx = (size_t) std::min<double>((double) v_us.size() - 1.0, std::ceil(p * (double) v_us.size()) - 1.0);
+    return (double) v_us[idx] / 1000.0;
+}
+
+static void print_distribution(const char * name, const std::vector<int64_t> & v_us) {
+    std::fprintf(stderr, "- %s ms: n=%zu p50=%.2f p90=%.2f p99=%.2f max=%.2f\n",
+        name,
+        v_us.size(),
+        percentile_ms(v_us, 0.50),
+        percentile_ms(v_us, 0.90),
+        percentile_ms(v_us, 0.99),
+        percentile_ms(v_us, 1.00));
+}
+
+// Captions are tagged "#<index>"; recover it from the DoAction args JSON.
+static int caption_index_from_args(const std::string & args_json) {
+    const size_t hash = args_json.find('#');
+    if (hash == std::string::npos) return -1;
+    int idx = 0;
+    size_t i = hash + 1;
+    if (i >= args_json.size() || !std::isdigit((unsigned char) args_json[i])) return -1;
+    while (i < args_json.size() && std::isdigit((unsigned char) args_json[i])) {
+        idx = idx * 10 + (args_json[i] - '0');
+        ++i;
+    }
+    return idx;
+}
+
+int main(int argc, char ** argv) {
+    loadtest_params params;
+    if (!parse_args(argc, argv, params)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const bool use_mock = params.ws_url.empty();
+
+    std::mutex mu;
+    std::vector<std::chrono::steady_clock::time_point> t_enqueue((size_t) params.captions);
+    std::vector<int64_t> delivered_us;
+    std::vector<int64_t> connect_us;
+    std::vector<int64_t> failed_connect_us;
+    delivered_us.reserve((size_t) params.captions);
+    connect_us.reserve((size_t) params.captions);
+
+    streamerbot_mock_server server;
+    streamerbot_ws_config bot;
+    bot.password = params.password;
+
+    if (use_mock) {
+        params.mock.port = 0;
+        params.mock.verbose = false;
+        server.set_on_action([&](const streamerbot_mock_action & a) {
+            const int idx = caption_index_from_args(a.args_json);
+            std::lock_guard<std::mutex> lock(mu);
+            if (idx >= 0 && idx < params.captions) {
+                delivered_us.push_back((int64_t) std::chrono::duration_cast<std::chrono::microseconds>(a.t_recv - t_enqueue[(size_t) idx]).count());
+            }
+        });
+
+        std::string err;
+        if (!server.start(params.mock, err)) {
+            std::fprintf(stderr, "error: failed to start mock server: %s\n", err.c_str());
+            return 2;
+        }
+        bot.url = "ws://127.0.0.1:" + std::to_string(server.port()) + "/";
+    } else {
+        bot.url = params.ws_url;
+    }
+
+    std::fprintf(stderr, "\nStreamer.bot sender load test\n");
+    std::fprintf(stderr, "- server: %s (%s)\n", bot.url.c_str(), use_mock ? "in-process mock" : "external");
+    if (use_mock) {
+        std::fprintf(stderr, "- mock: auth=%s hello_delay=%dms response_delay=%dms drop=%.2f disconnect=%.2f seed=%u\n",
+            params.mock.password ? "on" : "off",
+            params.mock.hello_delay_ms,
+            params.mock.response_delay_ms,
+            params.mock.drop_rate,
+            params.mock.disconnect_rate,
+            (unsigned) params.mock.seed);
+    }
+    if (params.rate > 0.0) {
+        std::fprintf(stderr, "- captions: %d at %.1f/s\n\n", params.captions, params.rate);
+    } else {
+        std::fprintf(stderr, "- captions: %d (burst)\n\n", params.captions);
+    }
+
+    streamerbot_sender_options opts;
+    opts.pace = false;
+    opts.log_errors = false;
+    opts.on_report = [&](const streamerbot_send_report & rep) {
+        std::lock_guard<std::mutex> lock(mu);
+        if (rep.connected) {
+            connect_us.push_back(rep.connect_us);
+        } else {
+            failed_connect_us.push_back(rep.connect_us);
+        }
+    };
+
+    const auto t_start = std::chrono::steady_clock::now();
+    streamerbot_sender_stats sender_stats;
+    bool timed_out = false;
+    {
+        streamerbot_sender sender(bot, opts);
+
+        for (int i = 0; i < params.captions; ++i) {
+            if (params.rate > 0.0) {
+                const auto t_due = t_start + std::chrono::microseconds((int64_t) (1e6 * (double) i / params.rate));
+                std::this_thread::sleep_until(t_due);
+            }
+            const std::string text = "loadtest #" + std::to_string(i) + " the quick brown fox jumps over the lazy dog";
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                t_enqueue[(size_t) i] = std::chrono::steady_clock::now();
+            }
+            sender.enqueue(streamerbot_send_item{ text, text.size() });
+        }
+
+        // Wait for the queue to drain (or give up).
+        const auto t_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(std::max(1, params.timeout_s));
+        while (true) {
+            const streamerbot_sender_stats st = sender.stats();
+            if ((int64_t) (st.sent + st.connect_failures + st.send_failures) >= (int64_t) params.captions) {
+                break;
+            }
+            if (std::chrono::steady_clock::now() > t_deadline) {
+                timed_out = true;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        sender.stop_and_join(/*drain*/!timed_out);
+        sender_stats = sender.stats();
+    }
+    const auto t_sent = std::chrono::steady_clock::now();
+
+    streamerbot_mock_stats server_stats;
+    if (use_mock) {
+        // The last DoAction may still be in flight on a server connection thread.
+        const auto t_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::chrono::steady_clock::now() < t_deadline) {
+            server_stats = server.stats();
+            if (server_stats.actions + server_stats.actions_dropped + server_stats.actions_rejected >= sender_stats.sent) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        server.stop();
+        server_stats = server.stats();
+    }
+
+    const double elapsed_s = std::chrono::duration<double>(t_sent - t_start).count();
+
+    std::fprintf(stderr, "Results\n");
+    std::fprintf(stderr, "- sender: sent=%llu connect_failures=%llu send_failures=%llu%s\n",
+        (unsigned long long) sender_stats.sent,
+        (unsigned long long) sender_stats.connect_failures,
+        (unsigned long long) sender_stats.send_failures,
+        timed_out ? " (TIMED OUT)" : "");
+    if (use_mock) {
+        std::fprintf(stderr, "- server: delivered=%llu dropped=%llu rejected=%llu connections=%llu disconnects_injected=%llu auth_ok=%llu auth_failed=%llu\n",
+            (unsigned long long) server_stats.actions,
+            (unsigned long long) server_stats.actions_dropped,
+            (unsigned long long) server_stats.actions_rejected,
+            (unsigned long long) server_stats.connections,
+            (unsigned long long) server_stats.disconnects_injected,
+            (unsigned long long) server_stats.auth_ok,
+            (unsigned long long) server_stats.auth_failed);
+        std::fprintf(stderr, "- delivered: %llu/%d (%.1f%%)\n",
+            (unsigned long long) server_stats.actions,
+            params.captions,
+            100.0 * (double) server_stats.actions / (double) params.captions);
+    }
+    std::fprintf(stderr, "- elapsed: %.2fs (%.1f captions/s)\n", elapsed_s, elapsed_s > 0.0 ? (double) params.captions / elapsed_s : 0.0);
+
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        if (use_mock) {
+            print_distribution("latency enqueue->delivered", delivered_us);
+        }
+        print_distribution("reconnect (connect+handshake)", connect_us);
+        if (!failed_connect_us.empty()) {
+            print_distribution("failed connect", failed_connect_us);
+        }
+    }
+
+    if (timed_out) {
+        return 3;
+    }
+
+    // Every DoAction the sender believes it sent must be accounted for by the server.
+    if (use_mock) {
+        const uint64_t seen = server_stats.actions + server_stats.actions_dropped + server_stats.actions_rejected;
+        if (seen != sender_stats.sent) {
+            std::fprintf(stderr, "FAIL: sender sent %llu but server saw %llu\n", (unsigned long long) sender_stats.sent, (unsigned long long) seen);
+            return 4;
+        }
+    }
+
+    return 0;
+}